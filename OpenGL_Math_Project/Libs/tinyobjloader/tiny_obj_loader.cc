@@ -5,6 +5,8 @@
 //
 
 //
+// version 0.9.16: Flat face storage, pre-scan to reserve arrays.
+// version 0.9.15: Add streaming MeshSink API (no shape_t copies).
 // version 0.9.14: Support specular highlight, bump, displacement and alpha map(#53)
 // version 0.9.13: Report "Material file not found message" in `err`(#46)
 // version 0.9.12: Fix groups being ignored if they have 'usemtl' just before 'g' (#44)
@@ -35,6 +37,7 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <algorithm>
 #include <fstream>
 #include <sstream>
 
@@ -303,22 +306,67 @@ static vertex_index parseTriple(const char *&token, int vsize, int vnsize,
   return vi;
 }
 
-static unsigned int
-updateVertex(std::map<vertex_index, unsigned int> &vertexCache,
-             std::vector<float> &positions, std::vector<float> &normals,
-             std::vector<float> &texcoords,
-             const std::vector<float> &in_positions,
-             const std::vector<float> &in_normals,
-             const std::vector<float> &in_texcoords, const vertex_index &i) {
-  const std::map<vertex_index, unsigned int>::iterator it = vertexCache.find(i);
-
-  if (it != vertexCache.end()) {
-    // found cache
-    return it->second;
+// Vertex cache without one allocation per vertex: the (vt, vn) variants of
+// each position are chained in a flat array. The entry number is the number
+// given to the vertex.
+struct vertex_chain_cache {
+  struct entry {
+    int v_idx, vt_idx, vn_idx;
+    int next;
+  };
+  std::vector<int> head; // first entry per position index, -1 if none
+  std::vector<entry> entries;
+
+  // Returns the number of vertex 'i', 'added' is true if it was not cached.
+  unsigned int lookup(const vertex_index &i, size_t positionCount,
+                      bool &added) {
+    if (head.size() <= static_cast<size_t>(i.v_idx)) {
+      head.resize(positionCount, -1);
+    }
+    for (int e = head[i.v_idx]; e >= 0; e = entries[e].next) {
+      if (entries[e].vt_idx == i.vt_idx && entries[e].vn_idx == i.vn_idx) {
+        // found cache
+        added = false;
+        return static_cast<unsigned int>(e);
+      }
+    }
+
+    entry n;
+    n.v_idx = i.v_idx;
+    n.vt_idx = i.vt_idx;
+    n.vn_idx = i.vn_idx;
+    n.next = head[i.v_idx];
+    head[i.v_idx] = static_cast<int>(entries.size());
+    entries.push_back(n);
+    added = true;
+    return static_cast<unsigned int>(entries.size() - 1);
   }
 
+  // Forgets the cached vertices, in O(cached vertices). Keeps the memory.
+  void clear() {
+    for (size_t e = 0; e < entries.size(); e++) {
+      head[entries[e].v_idx] = -1;
+    }
+    entries.clear();
+  }
+};
+
+static unsigned int updateVertex(vertex_chain_cache &vertexCache,
+                                 std::vector<float> &positions,
+                                 std::vector<float> &normals,
+                                 std::vector<float> &texcoords,
+                                 const std::vector<float> &in_positions,
+                                 const std::vector<float> &in_normals,
+                                 const std::vector<float> &in_texcoords,
+                                 const vertex_index &i) {
   assert(in_positions.size() > (unsigned int)(3 * i.v_idx + 2));
 
+  bool added;
+  unsigned int idx = vertexCache.lookup(i, in_positions.size() / 3, added);
+  if (!added) {
+    return idx;
+  }
+
   positions.push_back(in_positions[3 * i.v_idx + 0]);
   positions.push_back(in_positions[3 * i.v_idx + 1]);
   positions.push_back(in_positions[3 * i.v_idx + 2]);
@@ -334,12 +382,87 @@ updateVertex(std::map<vertex_index, unsigned int> &vertexCache,
     texcoords.push_back(in_texcoords[2 * i.vt_idx + 1]);
   }
 
-  unsigned int idx = static_cast<unsigned int>(positions.size() / 3 - 1);
-  vertexCache[i] = idx;
+  return idx;
+}
+
+static unsigned int emitVertex(vertex_chain_cache &vertexCache, MeshSink &sink,
+                               const std::vector<float> &in_positions,
+                               const std::vector<float> &in_normals,
+                               const std::vector<float> &in_texcoords,
+                               const vertex_index &i) {
+  assert(in_positions.size() > (unsigned int)(3 * i.v_idx + 2));
 
+  bool added;
+  unsigned int idx = vertexCache.lookup(i, in_positions.size() / 3, added);
+  if (added) {
+    sink.AddVertex(&in_positions[3 * i.v_idx],
+                   i.vn_idx >= 0 ? &in_normals[3 * i.vn_idx] : NULL,
+                   i.vt_idx >= 0 ? &in_texcoords[2 * i.vt_idx] : NULL);
+  }
   return idx;
 }
 
+// Counts gathered by a first pass over the text, used to reserve the arrays.
+struct obj_counts {
+  size_t v, vn, vt;
+  size_t faces, corners, triangles;
+};
+
+// Reads the next line into 'buf' without its '\r\n' or '\n'.
+// Returns false at the end of the stream.
+static bool readObjLine(std::istream &inStream, std::vector<char> &buf) {
+  if (inStream.peek() == -1) {
+    return false;
+  }
+  inStream.getline(&buf[0], static_cast<std::streamsize>(buf.size()));
+
+  size_t len = strlen(&buf[0]);
+  while (len > 0 && (buf[len - 1] == '\n' || buf[len - 1] == '\r')) {
+    buf[--len] = '\0';
+  }
+  return true;
+}
+
+// First pass over the stream, then rewinds it for the parser. The counts stay
+// at zero (nothing is reserved) when the stream cannot seek back.
+static void scanObjCounts(std::istream &inStream, std::vector<char> &buf,
+                          obj_counts &counts) {
+  memset(&counts, 0, sizeof(counts));
+  const std::streampos start = inStream.tellg();
+  if (start == std::streampos(-1) || !inStream.seekg(start)) {
+    inStream.clear();
+    return;
+  }
+
+  while (readObjLine(inStream, buf)) {
+    const char *token = &buf[0] + strspn(&buf[0], " \t");
+    if (token[0] == 'v' && isSpace(token[1])) {
+      counts.v++;
+    } else if (token[0] == 'v' && token[1] == 'n' && isSpace(token[2])) {
+      counts.vn++;
+    } else if (token[0] == 'v' && token[1] == 't' && isSpace(token[2])) {
+      counts.vt++;
+    } else if (token[0] == 'f' && isSpace(token[1])) {
+      size_t corners = 0;
+      token += 2;
+      token += strspn(token, " \t");
+      while (token[0] != '\0') {
+        corners++;
+        token += strcspn(token, " \t");
+        token += strspn(token, " \t");
+      }
+      counts.faces++;
+      counts.corners += corners;
+      if (corners >= 3) {
+        counts.triangles += corners - 2;
+      }
+    }
+  }
+
+  inStream.clear();
+  inStream.seekg(start);
+}
+
 void InitMaterial(material_t &material) {
   material.name = "";
   material.ambient_texname = "";
@@ -363,27 +486,54 @@ void InitMaterial(material_t &material) {
   material.unknown_parameter.clear();
 }
 
+// Faces are stored flat: face f uses faceIndices[faceOffsets[f]] to
+// faceIndices[faceOffsets[f + 1] - 1], faceOffsets starts with 0.
 static bool exportFaceGroupToShape(
-    shape_t &shape, std::map<vertex_index, unsigned int> vertexCache,
+    shape_t &shape, vertex_chain_cache &vertexCache,
     const std::vector<float> &in_positions,
     const std::vector<float> &in_normals,
     const std::vector<float> &in_texcoords,
-    const std::vector<std::vector<vertex_index> > &faceGroup,
+    const std::vector<vertex_index> &faceIndices,
+    const std::vector<unsigned int> &faceOffsets,
     const int material_id, const std::string &name, bool clearCache) {
-  if (faceGroup.empty()) {
+  if (faceOffsets.size() < 2) {
     return false;
   }
 
+  const size_t faceCount = faceOffsets.size() - 1;
+  size_t triangleCount = 0;
+  for (size_t f = 0; f < faceCount; f++) {
+    const size_t npolys = faceOffsets[f + 1] - faceOffsets[f];
+    if (npolys >= 3) {
+      triangleCount += npolys - 2;
+    }
+  }
+
+  // A group never has more distinct vertices than face corners.
+  const size_t vertexCount = std::min(
+      faceIndices.size(),
+      std::max(in_positions.size() / 3,
+               std::max(in_normals.size() / 3, in_texcoords.size() / 2)));
+  shape.mesh.positions.reserve(3 * vertexCount);
+  if (!in_normals.empty())
+    shape.mesh.normals.reserve(3 * vertexCount);
+  if (!in_texcoords.empty())
+    shape.mesh.texcoords.reserve(2 * vertexCount);
+  shape.mesh.indices.reserve(3 * triangleCount);
+  shape.mesh.material_ids.reserve(triangleCount);
+
   // Flatten vertices and indices
-  for (size_t i = 0; i < faceGroup.size(); i++) {
-    const std::vector<vertex_index> &face = faceGroup[i];
+  for (size_t f = 0; f < faceCount; f++) {
+    const vertex_index *face = &faceIndices[faceOffsets[f]];
+    size_t npolys = faceOffsets[f + 1] - faceOffsets[f];
+    if (npolys < 3) {
+      continue;
+    }
 
     vertex_index i0 = face[0];
     vertex_index i1(-1);
     vertex_index i2 = face[1];
 
-    size_t npolys = face.size();
-
     // Polygon -> triangle fan conversion
     for (size_t k = 2; k < npolys; k++) {
       i1 = i2;
@@ -699,40 +849,34 @@ std::string LoadObj(std::vector<shape_t> &shapes,
   std::vector<float> v;
   std::vector<float> vn;
   std::vector<float> vt;
-  std::vector<std::vector<vertex_index> > faceGroup;
+  // Faces of the current group, flat (see exportFaceGroupToShape). The
+  // arrays are cleared between groups but keep their memory.
+  std::vector<vertex_index> faceIndices;
+  std::vector<unsigned int> faceOffsets(1, 0);
   std::string name;
 
   // material
   std::map<std::string, int> material_map;
-  std::map<vertex_index, unsigned int> vertexCache;
+  vertex_chain_cache vertexCache;
   int material = -1;
 
   shape_t shape;
 
   int maxchars = 8192;             // Alloc enough size.
   std::vector<char> buf(maxchars); // Alloc enough size.
-  while (inStream.peek() != -1) {
-    inStream.getline(&buf[0], maxchars);
-
-    std::string linebuf(&buf[0]);
 
-    // Trim newline '\r\n' or '\n'
-    if (linebuf.size() > 0) {
-      if (linebuf[linebuf.size() - 1] == '\n')
-        linebuf.erase(linebuf.size() - 1);
-    }
-    if (linebuf.size() > 0) {
-      if (linebuf[linebuf.size() - 1] == '\r')
-        linebuf.erase(linebuf.size() - 1);
-    }
-
-    // Skip if empty line.
-    if (linebuf.empty()) {
-      continue;
-    }
+  obj_counts counts;
+  scanObjCounts(inStream, buf, counts);
+  v.reserve(3 * counts.v);
+  vn.reserve(3 * counts.vn);
+  vt.reserve(2 * counts.vt);
+  faceIndices.reserve(counts.corners);
+  faceOffsets.reserve(counts.faces + 1);
+  vertexCache.head.reserve(counts.v);
 
+  while (readObjLine(inStream, buf)) {
     // Skip leading space.
-    const char *token = linebuf.c_str();
+    const char *token = &buf[0];
     token += strspn(token, " \t");
 
     assert(token);
@@ -779,16 +923,15 @@ std::string LoadObj(std::vector<shape_t> &shapes,
       token += 2;
       token += strspn(token, " \t");
 
-      std::vector<vertex_index> face;
       while (!isNewLine(token[0])) {
         vertex_index vi =
             parseTriple(token, static_cast<int>(v.size() / 3), static_cast<int>(vn.size() / 3), static_cast<int>(vt.size() / 2));
-        face.push_back(vi);
+        faceIndices.push_back(vi);
         size_t n = strspn(token, " \t\r");
         token += n;
       }
 
-      faceGroup.push_back(face);
+      faceOffsets.push_back(static_cast<unsigned int>(faceIndices.size()));
 
       continue;
     }
@@ -805,13 +948,15 @@ std::string LoadObj(std::vector<shape_t> &shapes,
 #endif
 
       // Create face group per material.
-      bool ret = exportFaceGroupToShape(shape, vertexCache, v, vn, vt,
-                                        faceGroup, material, name, true);
+      bool ret = exportFaceGroupToShape(shape, vertexCache, v, vn, vt, faceIndices,
+                                        faceOffsets, material, name, true);
       if (ret) {
-          shapes.push_back(shape);
+        shapes.push_back(shape_t());
+        std::swap(shapes.back(), shape);
       }
       shape = shape_t();
-      faceGroup.clear();
+      faceIndices.clear();
+      faceOffsets.resize(1);
 
       if (material_map.find(namebuf) != material_map.end()) {
         material = material_map[namebuf];
@@ -835,7 +980,7 @@ std::string LoadObj(std::vector<shape_t> &shapes,
 
       std::string err_mtl = readMatFn(namebuf, materials, material_map);
       if (!err_mtl.empty()) {
-        faceGroup.clear(); // for safety
+        faceIndices.clear(); // for safety
         return err_mtl;
       }
 
@@ -846,16 +991,18 @@ std::string LoadObj(std::vector<shape_t> &shapes,
     if (token[0] == 'g' && isSpace((token[1]))) {
 
       // flush previous face group.
-      bool ret = exportFaceGroupToShape(shape, vertexCache, v, vn, vt,
-                                        faceGroup, material, name, true);
+      bool ret = exportFaceGroupToShape(shape, vertexCache, v, vn, vt, faceIndices,
+                                        faceOffsets, material, name, true);
       if (ret) {
-        shapes.push_back(shape);
+        shapes.push_back(shape_t());
+        std::swap(shapes.back(), shape);
       }
 
       shape = shape_t();
 
       // material = -1;
-      faceGroup.clear();
+      faceIndices.clear();
+      faceOffsets.resize(1);
 
       std::vector<std::string> names;
       while (!isNewLine(token[0])) {
@@ -880,14 +1027,16 @@ std::string LoadObj(std::vector<shape_t> &shapes,
     if (token[0] == 'o' && isSpace((token[1]))) {
 
       // flush previous face group.
-      bool ret = exportFaceGroupToShape(shape, vertexCache, v, vn, vt,
-                                        faceGroup, material, name, true);
+      bool ret = exportFaceGroupToShape(shape, vertexCache, v, vn, vt, faceIndices,
+                                        faceOffsets, material, name, true);
       if (ret) {
-        shapes.push_back(shape);
+        shapes.push_back(shape_t());
+        std::swap(shapes.back(), shape);
       }
 
       // material = -1;
-      faceGroup.clear();
+      faceIndices.clear();
+      faceOffsets.resize(1);
       shape = shape_t();
 
       // @todo { multiple object name? }
@@ -906,12 +1055,229 @@ std::string LoadObj(std::vector<shape_t> &shapes,
     // Ignore unknown command.
   }
 
-  bool ret = exportFaceGroupToShape(shape, vertexCache, v, vn, vt, faceGroup,
-                                    material, name, true);
+  bool ret = exportFaceGroupToShape(shape, vertexCache, v, vn, vt, faceIndices,
+                                    faceOffsets, material, name, true);
   if (ret) {
-    shapes.push_back(shape);
+    shapes.push_back(shape_t());
+    std::swap(shapes.back(), shape);
+  }
+  faceIndices.clear(); // for safety
+
+  return err.str();
+}
+
+std::string LoadObj(MeshSink &sink,
+                    std::vector<material_t> &materials, // [output]
+                    const char *filename, const char *mtl_basepath) {
+  std::stringstream err;
+
+  std::ifstream ifs(filename);
+  if (!ifs) {
+    err << "Cannot open file [" << filename << "]" << std::endl;
+    return err.str();
+  }
+
+  std::string basePath;
+  if (mtl_basepath) {
+    basePath = mtl_basepath;
+  }
+  MaterialFileReader matFileReader(basePath);
+
+  return LoadObj(sink, materials, ifs, matFileReader);
+}
+
+// Same grammar as the shape_t loader, but faces are triangulated and sent to
+// the sink as soon as they are read: no face group, no per-line std::string.
+std::string LoadObj(MeshSink &sink,
+                    std::vector<material_t> &materials, // [output]
+                    std::istream &inStream, MaterialReader &readMatFn) {
+  std::stringstream err;
+
+  std::vector<float> v;
+  std::vector<float> vn;
+  std::vector<float> vt;
+  std::vector<vertex_index> face;
+  std::string name;
+
+  // material
+  std::map<std::string, int> material_map;
+  vertex_chain_cache vertexCache;
+  int material = -1;
+  bool shapeStarted = false;
+
+  int maxchars = 8192;             // Alloc enough size.
+  std::vector<char> buf(maxchars); // Alloc enough size.
+
+  obj_counts counts;
+  scanObjCounts(inStream, buf, counts);
+  v.reserve(3 * counts.v);
+  vn.reserve(3 * counts.vn);
+  vt.reserve(2 * counts.vt);
+  vertexCache.head.reserve(counts.v);
+  sink.Reserve(std::max(counts.v, std::max(counts.vn, counts.vt)),
+               counts.triangles);
+
+  while (readObjLine(inStream, buf)) {
+    // Skip leading space.
+    const char *token = &buf[0];
+    token += strspn(token, " \t");
+
+    assert(token);
+    if (token[0] == '\0')
+      continue; // empty line
+
+    if (token[0] == '#')
+      continue; // comment line
+
+    // vertex
+    if (token[0] == 'v' && isSpace((token[1]))) {
+      token += 2;
+      float x, y, z;
+      parseFloat3(x, y, z, token);
+      v.push_back(x);
+      v.push_back(y);
+      v.push_back(z);
+      continue;
+    }
+
+    // normal
+    if (token[0] == 'v' && token[1] == 'n' && isSpace((token[2]))) {
+      token += 3;
+      float x, y, z;
+      parseFloat3(x, y, z, token);
+      vn.push_back(x);
+      vn.push_back(y);
+      vn.push_back(z);
+      continue;
+    }
+
+    // texcoord
+    if (token[0] == 'v' && token[1] == 't' && isSpace((token[2]))) {
+      token += 3;
+      float x, y;
+      parseFloat2(x, y, token);
+      vt.push_back(x);
+      vt.push_back(y);
+      continue;
+    }
+
+    // face
+    if (token[0] == 'f' && isSpace((token[1]))) {
+      token += 2;
+      token += strspn(token, " \t");
+
+      face.clear();
+      while (!isNewLine(token[0])) {
+        vertex_index vi =
+            parseTriple(token, static_cast<int>(v.size() / 3), static_cast<int>(vn.size() / 3), static_cast<int>(vt.size() / 2));
+        face.push_back(vi);
+        size_t n = strspn(token, " \t\r");
+        token += n;
+      }
+
+      if (face.size() < 3) {
+        continue;
+      }
+
+      if (!shapeStarted) {
+        sink.BeginShape(name, material);
+        shapeStarted = true;
+      }
+
+      // Polygon -> triangle fan conversion
+      unsigned int v0 = emitVertex(vertexCache, sink, v, vn, vt, face[0]);
+      unsigned int v2 = emitVertex(vertexCache, sink, v, vn, vt, face[1]);
+      for (size_t k = 2; k < face.size(); k++) {
+        unsigned int v1 = v2;
+        v2 = emitVertex(vertexCache, sink, v, vn, vt, face[k]);
+        sink.AddTriangle(v0, v1, v2);
+      }
+
+      continue;
+    }
+
+    // use mtl
+    if ((0 == strncmp(token, "usemtl", 6)) && isSpace((token[6]))) {
+
+      char namebuf[TINYOBJ_SSCANF_BUFFER_SIZE];
+      token += 7;
+#ifdef _MSC_VER
+      sscanf_s(token, "%s", namebuf, (unsigned)_countof(namebuf));
+#else
+      sscanf(token, "%s", namebuf);
+#endif
+
+      if (material_map.find(namebuf) != material_map.end()) {
+        material = material_map[namebuf];
+      } else {
+        // { error!! material not found }
+        material = -1;
+      }
+      shapeStarted = false;
+
+      continue;
+    }
+
+    // load mtl
+    if ((0 == strncmp(token, "mtllib", 6)) && isSpace((token[6]))) {
+      char namebuf[TINYOBJ_SSCANF_BUFFER_SIZE];
+      token += 7;
+#ifdef _MSC_VER
+      sscanf_s(token, "%s", namebuf, (unsigned)_countof(namebuf));
+#else
+      sscanf(token, "%s", namebuf);
+#endif
+
+      std::string err_mtl = readMatFn(namebuf, materials, material_map);
+      if (!err_mtl.empty()) {
+        return err_mtl;
+      }
+
+      continue;
+    }
+
+    // group name
+    if (token[0] == 'g' && isSpace((token[1]))) {
+
+      std::vector<std::string> names;
+      while (!isNewLine(token[0])) {
+        std::string str = parseString(token);
+        names.push_back(str);
+        token += strspn(token, " \t\r"); // skip tag
+      }
+
+      assert(names.size() > 0);
+
+      // names[0] must be 'g', so skip the 0th element.
+      if (names.size() > 1) {
+        name = names[1];
+      } else {
+        name = "";
+      }
+      shapeStarted = false;
+
+      continue;
+    }
+
+    // object name
+    if (token[0] == 'o' && isSpace((token[1]))) {
+
+      // @todo { multiple object name? }
+      char namebuf[TINYOBJ_SSCANF_BUFFER_SIZE];
+      token += 2;
+#ifdef _MSC_VER
+      sscanf_s(token, "%s", namebuf, (unsigned)_countof(namebuf));
+#else
+      sscanf(token, "%s", namebuf);
+#endif
+      name = std::string(namebuf);
+      shapeStarted = false;
+
+      continue;
+    }
+
+    // Ignore unknown command.
   }
-  faceGroup.clear(); // for safety
 
   return err.str();
 }
@@ -72,6 +72,35 @@ private:
   std::string m_mtlBasePath;
 };
 
+/// Receives the geometry of an .obj while it is parsed, without building
+/// shape_t copies. Vertices are deduplicated on their (v, vt, vn) triple over
+/// the whole file and numbered in the order they are emitted (0, 1, 2...);
+/// triangles refer to these numbers. Polygons are triangulated as fans.
+/// The sink decides where the data goes (vectors, an arena, a mapped buffer).
+class MeshSink {
+public:
+  MeshSink() {}
+  virtual ~MeshSink() {}
+
+  /// Called once before anything else with upper bounds from a pre-scan:
+  /// the number of distinct vertices is at most 'vertex_count_hint' for
+  /// usual files (it is only a hint), 'triangle_count' is exact.
+  virtual void Reserve(size_t vertex_count_hint, size_t triangle_count) {
+    (void)vertex_count_hint;
+    (void)triangle_count;
+  }
+  /// Called before the first triangle of each object/group/material run.
+  virtual void BeginShape(const std::string &name, int material_id) {
+    (void)name;
+    (void)material_id;
+  }
+  /// 'normal' and 'texcoord' are NULL when the face does not reference them.
+  virtual void AddVertex(const float *position, const float *normal,
+                         const float *texcoord) = 0;
+  virtual void AddTriangle(unsigned int i0, unsigned int i1,
+                           unsigned int i2) = 0;
+};
+
 /// Loads .obj from a file.
 /// 'shapes' will be filled with parsed shape data
 /// The function returns error string.
@@ -88,6 +117,17 @@ std::string LoadObj(std::vector<shape_t> &shapes,       // [output]
                     std::vector<material_t> &materials, // [output]
                     std::istream &inStream, MaterialReader &readMatFn);
 
+/// Loads .obj from a file and streams its vertices and triangles to 'sink'.
+/// Returns empty string when loading .obj success.
+std::string LoadObj(MeshSink &sink,                     // [output]
+                    std::vector<material_t> &materials, // [output]
+                    const char *filename, const char *mtl_basepath = NULL);
+
+/// Same as above, from a std::istream.
+std::string LoadObj(MeshSink &sink,                     // [output]
+                    std::vector<material_t> &materials, // [output]
+                    std::istream &inStream, MaterialReader &readMatFn);
+
 /// Loads materials into std::map
 /// Returns an empty string if successful
 std::string LoadMtl(std::map<std::string, int> &material_map,
@@ -0,0 +1,86 @@
+#include "AllocationStats.h"
+
+#if ALLOCATOR_STATS
+
+#include <cstdlib>
+#include <atomic>
+#include <new>
+
+// la taille est stockee devant le bloc, l'entete garde l'alignement de malloc
+static const size_t AllocationHeader = 16;
+static std::atomic<size_t> s_AllocationCount(0);
+static std::atomic<size_t> s_LiveBytes(0);
+static std::atomic<size_t> s_PeakBytes(0);
+
+// Toutes les formes de new et de delete passent par ces deux fonctions : aucun operateur n'en appelle un
+// autre, et le bloc rendu a free est toujours celui obtenu de malloc (pointeur utilisateur - entete)
+static void* AllocateBlock(size_t size)
+{
+	char* block = static_cast<char*>(malloc(size + AllocationHeader));
+	if(!block)
+		throw std::bad_alloc();
+	*reinterpret_cast<size_t*>(block) = size;
+	s_AllocationCount.fetch_add(1, std::memory_order_relaxed);
+	const size_t live = s_LiveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+	size_t peak = s_PeakBytes.load(std::memory_order_relaxed);
+	while(live > peak && !s_PeakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+		;
+	return block + AllocationHeader;
+}
+
+static void FreeBlock(void* pointer)
+{
+	if(!pointer)
+		return;
+	char* block = static_cast<char*>(pointer) - AllocationHeader;
+	s_LiveBytes.fetch_sub(*reinterpret_cast<const size_t*>(block), std::memory_order_relaxed);
+	free(block);
+}
+
+void* operator new(size_t size)
+{
+	return AllocateBlock(size);
+}
+
+void* operator new[](size_t size)
+{
+	return AllocateBlock(size);
+}
+
+void operator delete(void* pointer) noexcept
+{
+	FreeBlock(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+	FreeBlock(pointer);
+}
+
+// versions avec taille (C++14) : sans elles, la bibliotheque standard pourrait liberer un bloc de notre
+// operator new avec son propre delete. La taille de l'entete fait foi.
+void operator delete(void* pointer, size_t) noexcept
+{
+	FreeBlock(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept
+{
+	FreeBlock(pointer);
+}
+
+AllocationStats GetAllocationStats()
+{
+	AllocationStats stats;
+	stats.count = s_AllocationCount.load();
+	stats.liveBytes = s_LiveBytes.load();
+	stats.peakBytes = s_PeakBytes.load();
+	return stats;
+}
+
+void ResetAllocationPeak()
+{
+	s_PeakBytes.store(s_LiveBytes.load());
+}
+
+#endif
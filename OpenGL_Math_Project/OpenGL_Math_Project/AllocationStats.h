@@ -0,0 +1,23 @@
+#ifndef __ALLOCATION_STATS_H__
+#define __ALLOCATION_STATS_H__
+
+#include <cstddef>
+
+#include "FrameAllocator.h"
+
+// Compteurs de toutes les allocations du programme : operator new / delete sont remplaces dans
+// AllocationStats.cpp avec les compteurs des allocateurs (ALLOCATOR_STATS, actif en Debug). Sinon rien
+// n'est remplace et ces fonctions n'existent pas (--alloc-check echoue, --obj-bench ne mesure que les temps).
+#if ALLOCATOR_STATS
+struct AllocationStats
+{
+	size_t count;		// nombre d'appels a operator new depuis le lancement
+	size_t liveBytes;
+	size_t peakBytes;	// maximum de liveBytes depuis le dernier ResetAllocationPeak
+};
+
+AllocationStats GetAllocationStats();
+void ResetAllocationPeak();
+#endif
+
+#endif //__ALLOCATION_STATS_H__
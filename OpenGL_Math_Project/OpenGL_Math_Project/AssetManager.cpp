@@ -0,0 +1,575 @@
+#include "AssetManager.h"
+
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <istream>
+#include <streambuf>
+
+#include "tinyobjloader/tiny_obj_loader.h"
+#include "stb/stb_image.h"
+
+#include "MeshSimplify.h"
+#include "FrameAllocator.h"
+
+static const char* AssetTypeNames[ASSET_TYPE_COUNT] = { "textures", "modeles" };
+
+// FNV-1a 64 bits
+static const uint64_t FnvOffsetBasis = 14695981039346656037ULL;
+static const uint64_t FnvPrime = 1099511628211ULL;
+
+static uint64_t HashBytes(const void* data, size_t size, uint64_t hash)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	for(size_t i = 0; i < size; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= FnvPrime;
+	}
+	return hash;
+}
+
+// Fichier complet dans l'arena (mode binaire : le hash ne depend pas des fins de ligne de la plateforme)
+static const uint8_t* ReadFile(const char* filename, LinearArena& arena, size_t& size)
+{
+	FILE* file = fopen(filename, "rb");
+	if(file == NULL)
+		return NULL;
+	fseek(file, 0, SEEK_END);
+	const long count = ftell(file);
+	rewind(file);
+	uint8_t* data = NULL;
+	if(count > 0)
+	{
+		data = arena.AllocateArray<uint8_t>(count);
+		size = fread(data, 1, count, file);
+	}
+	fclose(file);
+	return data;
+}
+
+// Flux de lecture sur un fichier deja en memoire. tinyobj::LoadObj parcourt le flux deux fois (comptage puis
+// lecture) : seekoff et seekpos doivent etre implementes.
+class MemoryStreamBuffer : public std::streambuf
+{
+public:
+	MemoryStreamBuffer(const uint8_t* data, size_t size)
+	{
+		char* begin = const_cast<char*>(reinterpret_cast<const char*>(data));
+		setg(begin, begin, begin + size);
+	}
+
+protected:
+	pos_type seekoff(off_type offset, std::ios_base::seekdir direction, std::ios_base::openmode which)
+	{
+		if(!(which & std::ios_base::in))
+			return pos_type(off_type(-1));
+		off_type position = offset;
+		if(direction == std::ios_base::cur)
+			position += gptr() - eback();
+		else if(direction == std::ios_base::end)
+			position += egptr() - eback();
+		if(position < 0 || position > egptr() - eback())
+			return pos_type(off_type(-1));
+		setg(eback(), eback() + position, egptr());
+		return pos_type(position);
+	}
+	pos_type seekpos(pos_type position, std::ios_base::openmode which)
+	{
+		return seekoff(off_type(position), std::ios_base::beg, which);
+	}
+};
+
+// Chaine CPU d'un .obj : formes fusionnees, materiaux fusionnes, triangles tries par materiau puis niveaux
+// simplifies ajoutes a la suite du mesh complet
+static bool BuildModel(const std::string& name, const uint8_t* data, size_t size, int lodLevels, ModelData& model)
+{
+	MemoryStreamBuffer buffer(data, size);
+	std::istream stream(&buffer);
+	tinyobj::MaterialFileReader materialReader("");
+
+	// les sommets arrivent directement dans le MeshData (toutes les formes du fichier)
+	std::vector<tinyobj::material_t> materials;
+	MeshData& mesh = model.mesh;
+	MeshDataSink sink(mesh);
+	std::string err = tinyobj::LoadObj(sink, materials, stream, materialReader);
+	if(!err.empty())
+		printf("%s : %s\n", name.c_str(), err.c_str());
+	if(mesh.indices.empty())
+		return false;
+	ComputeBounds(mesh);
+
+	// les triangles de toutes les formes sont regroupes par materiau : une plage contigue de l'IBO par materiau
+	MergeMaterials(materials, mesh, model.textures);
+	std::vector<Submesh> submeshes;
+	SortTrianglesByMaterial(mesh.indices, 0, mesh.indices.size(), mesh.triangleMaterials, (int) model.textures.size(), submeshes);
+	if(sink.GetShapeCount() > 1 || materials.size() > 1)
+	{
+		printf("%s : %d formes, %u materiaux (%u apres fusion), %u plages\n", name.c_str(), sink.GetShapeCount(),
+			   (unsigned) materials.size(), (unsigned) model.textures.size(), (unsigned) submeshes.size());
+	}
+
+	std::vector<MeshLod> lods;
+	BuildLodChain(mesh, std::max(lodLevels, 1), 0.5f, lods);
+	model.lods.resize(lods.size());
+	for(size_t level = 0; level < lods.size(); ++level)
+	{
+		ModelLod& lod = model.lods[level];
+		lod.firstIndex = (level == 0) ? 0 : (uint32_t) mesh.indices.size();
+		lod.indexCount = (uint32_t) lods[level].indices.size();
+		lod.error = lods[level].error;
+		if(level == 0)
+		{
+			lod.submeshes = submeshes;
+		}
+		else
+		{
+			std::vector<int> lodMaterials;
+			InheritTriangleMaterials(mesh, lods[level].indices, lodMaterials);
+			mesh.indices.insert(mesh.indices.end(), lods[level].indices.begin(), lods[level].indices.end());
+			SortTrianglesByMaterial(mesh.indices, lod.firstIndex, lod.indexCount, lodMaterials, (int) model.textures.size(), lod.submeshes);
+			printf("%s LOD %u : %u triangles (ratio %.3f), erreur de Hausdorff %g\n", name.c_str(), (unsigned) level,
+				   lod.indexCount / 3, lods[level].targetRatio, lods[level].error);
+		}
+	}
+	return true;
+}
+
+static size_t GetModelBytes(const ModelData& model)
+{
+	const MeshData& mesh = model.mesh;
+	size_t bytes = (mesh.positions.size() + mesh.normals.size() + mesh.texcoords.size()) * sizeof(float)
+				 + mesh.indices.size() * sizeof(uint32_t) + mesh.triangleMaterials.size() * sizeof(int);
+	for(size_t level = 0; level < model.lods.size(); ++level)
+		bytes += sizeof(ModelLod) + model.lods[level].submeshes.size() * sizeof(Submesh);
+	return bytes;
+}
+
+static size_t UploadFloatMesh(const MeshData& mesh, MeshArena& arena, ModelGpu& gpu)
+{
+	const std::vector<uint32_t>& indices = mesh.indices;
+	const std::vector<float>& positions = mesh.positions;
+	const std::vector<float>& normals = mesh.normals;
+	const std::vector<float>& texcoords = mesh.texcoords;
+
+	gpu.positionScale = glm::vec3(1.0f);
+	gpu.positionOffset = glm::vec3(0.0f);
+
+	const size_t count = mesh.VertexCount();
+
+	gpu.arena = &arena;
+	gpu.allocation = arena.Allocate(count, indices.size() * sizeof(uint32_t));
+	gpu.indexType = GL_UNSIGNED_INT;
+	arena.UploadIndices(gpu.allocation, &indices[0]);
+
+	// le format float de l'arena a toujours les 3 attributs : ceux absents du mesh sont mis a zero.
+	// Il est imperatif d'appeler UnmapVertices() une fois que l'on a termine car le
+	// driver peut tres bien etre amener a modifier l'emplacement memoire du BO.
+	FloatVertex* vertices = (FloatVertex*) arena.MapVertices(gpu.allocation);
+	memset(vertices, 0, count * sizeof(FloatVertex));
+	for(size_t index = 0; index < count; ++index)
+	{
+		if(positions.size())
+			memcpy(vertices[index].position, &positions[index * 3], 3 * sizeof(float));
+		if(normals.size())
+			memcpy(vertices[index].normal, &normals[index * 3], 3 * sizeof(float));
+		if(texcoords.size())
+			memcpy(vertices[index].texcoords, &texcoords[index * 2], 2 * sizeof(float));
+	}
+	arena.UnmapVertices();
+	return count * sizeof(FloatVertex) + indices.size() * sizeof(uint32_t);
+}
+
+static size_t UploadCompactMesh(const std::string& name, const ModelData& model, MeshArena& arena, ModelGpu& gpu)
+{
+	const MeshData& mesh = model.mesh;
+	QuantizedMesh quantized;
+	if(!QuantizeMesh(mesh, quantized))
+	{
+		printf("%s : erreur de quantification hors bornes (position %g > %g ou normale %g > %g rad)\n", name.c_str(),
+			   quantized.maxPositionError, quantized.positionErrorBound, quantized.maxNormalError, quantized.normalErrorBound);
+	}
+
+	gpu.positionScale = quantized.positionScale;
+	gpu.positionOffset = quantized.positionOffset;
+
+	const bool shortIndices = !quantized.indices16.empty();
+	const size_t indexSize = shortIndices ? sizeof(uint16_t) : sizeof(uint32_t);
+	const size_t indexBytes = (shortIndices ? quantized.indices16.size() : quantized.indices32.size()) * indexSize;
+	const size_t vertexBytes = quantized.vertices.size() * sizeof(CompactVertex);
+
+	// les indices 16 et 32 bits cohabitent dans l'IBO de l'arena, le type est porte par l'objet
+	gpu.arena = &arena;
+	gpu.allocation = arena.Allocate(quantized.vertices.size(), indexBytes);
+	gpu.indexType = shortIndices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+	arena.UploadIndices(gpu.allocation, shortIndices ? (const void*) &quantized.indices16[0] : (const void*) &quantized.indices32[0]);
+
+	memcpy(arena.MapVertices(gpu.allocation), &quantized.vertices[0], vertexBytes);
+	arena.UnmapVertices();
+
+	// Bilan memoire : le format float fait 12 + 12 + 8 octets par sommet et 4 octets par index
+	size_t floatStride = 3 * sizeof(float);
+	if(mesh.normals.size())
+		floatStride += 3 * sizeof(float);
+	if(mesh.texcoords.size())
+		floatStride += 2 * sizeof(float);
+	const size_t elementCount = model.lods[0].indexCount;
+	const size_t floatBytes = mesh.VertexCount() * floatStride + mesh.indices.size() * sizeof(uint32_t);
+	const size_t compactBytes = vertexBytes + indexBytes;
+	// bande passante par instance dessinee : chaque index est lu, et au pire chaque index provoque un fetch de sommet
+	const size_t floatFetch = elementCount * (floatStride + sizeof(uint32_t));
+	const size_t compactFetch = elementCount * (sizeof(CompactVertex) + indexSize);
+	printf("%s : %u sommets, %u indices %s\n", name.c_str(), (unsigned) mesh.VertexCount(), (unsigned) elementCount, shortIndices ? "16 bits" : "32 bits");
+	printf("    memoire : %.1f Ko -> %.1f Ko (-%.0f%%), bande passante max par instance : %.1f Ko -> %.1f Ko\n",
+		   floatBytes / 1024.0, compactBytes / 1024.0, 100.0 * (1.0 - (double) compactBytes / floatBytes),
+		   floatFetch / 1024.0, compactFetch / 1024.0);
+	printf("    erreur max : position %g (borne %g), normale %g rad (borne %g), uv %g\n",
+		   quantized.maxPositionError, quantized.positionErrorBound, quantized.maxNormalError, quantized.normalErrorBound, quantized.maxTexcoordError);
+	return compactBytes;
+}
+
+AssetManager::Asset::Asset(AssetType type, const std::string& path, int lodLevels, VertexFormat format)
+	: type(type), path(path), lodLevels(lodLevels), format(format), refCount(0), alias(InvalidHandle)
+	, identified(false), missing(false), contentHash(0), lastUsedFrame(0), texture(0)
+{
+	for(int memory = 0; memory < ASSET_MEMORY_COUNT; ++memory)
+	{
+		resident[memory] = false;
+		bytes[memory] = 0;
+	}
+	gpu.arena = NULL;
+	gpu.allocation = MeshArena::InvalidHandle;
+	gpu.indexType = GL_UNSIGNED_INT;
+	gpu.positionScale = glm::vec3(1.0f);
+	gpu.positionOffset = glm::vec3(0.0f);
+}
+
+AssetManager::AssetManager() : m_Arenas(NULL), m_Frame(0), m_SharedRequests(0), m_SharedContents(0)
+{
+	SetBudgets(0, 0);
+	for(int type = 0; type < ASSET_TYPE_COUNT; ++type)
+	{
+		m_Loads[type] = 0;
+		m_Evictions[type] = 0;
+	}
+}
+
+void AssetManager::Create(MeshArena* arenas, size_t cpuBudget, size_t gpuBudget)
+{
+	m_Arenas = arenas;
+	SetBudgets(cpuBudget, gpuBudget);
+}
+
+void AssetManager::Destroy()
+{
+	for(size_t i = 0; i < m_Assets.size(); ++i)
+	{
+		EvictCpu(m_Assets[i]);
+		EvictGpu(m_Assets[i]);
+	}
+	m_Assets.clear();
+	m_Paths.clear();
+	m_Contents.clear();
+	m_Arenas = NULL;
+}
+
+AssetManager::Handle AssetManager::AcquireTexture(const std::string& path)
+{
+	return Acquire(ASSET_TEXTURE, path, 0, VERTEX_FORMAT_FLOAT);
+}
+
+AssetManager::Handle AssetManager::AcquireModel(const std::string& path, int lodLevels, VertexFormat format)
+{
+	return Acquire(ASSET_MODEL, path, std::max(lodLevels, 1), format);
+}
+
+AssetManager::Handle AssetManager::Acquire(AssetType type, const std::string& path, int lodLevels, VertexFormat format)
+{
+	if(path.empty())
+		return InvalidHandle;
+
+	// rien n'est lu ici : le fichier est charge au premier Get
+	char variant[32];
+	sprintf(variant, "%d|%d|%d|", (int) type, lodLevels, (int) format);
+	const std::string key = variant + path;
+	std::unordered_map<std::string, Handle>::iterator found = m_Paths.find(key);
+	if(found != m_Paths.end())
+	{
+		++m_Assets[Resolve(found->second)].refCount;
+		++m_SharedRequests;
+		return found->second;
+	}
+
+	const Handle handle = (Handle) m_Assets.size();
+	m_Assets.push_back(Asset(type, path, lodLevels, format));
+	m_Assets.back().refCount = 1;
+	m_Paths[key] = handle;
+	return handle;
+}
+
+void AssetManager::Release(Handle handle)
+{
+	if(handle == InvalidHandle || m_Assets.empty())
+		return;
+	// un asset sans reference reste en cache, EndFrame l'evince s'il faut de la place
+	Asset& asset = m_Assets[Resolve(handle)];
+	if(asset.refCount > 0)
+		--asset.refCount;
+}
+
+AssetManager::Handle AssetManager::Resolve(Handle handle) const
+{
+	while(m_Assets[handle].alias != InvalidHandle)
+		handle = m_Assets[handle].alias;
+	return handle;
+}
+
+AssetManager::Asset* AssetManager::Touch(Handle handle, AssetMemory memory)
+{
+	if(handle == InvalidHandle)
+		return NULL;
+	handle = Resolve(handle);
+	if(!m_Assets[handle].identified)
+	{
+		LoadCpu(handle);
+		handle = Resolve(handle);
+	}
+
+	Asset& asset = m_Assets[handle];
+	if(!asset.missing && !asset.resident[memory])
+	{
+		if(memory == ASSET_CPU)
+			LoadCpu(handle);
+		else
+			LoadGpu(handle);
+	}
+	asset.lastUsedFrame = m_Frame;
+	return asset.missing ? NULL : &asset;
+}
+
+bool AssetManager::LoadCpu(Handle handle)
+{
+	ArenaScope scratch(GetScratchArena());
+	Asset* asset = &m_Assets[handle];
+	size_t size = 0;
+	const uint8_t* data = ReadFile(asset->path.c_str(), scratch.GetArena(), size);
+	if(data == NULL)
+	{
+		asset->identified = true;
+		asset->missing = true;
+		return false;
+	}
+	++m_Loads[asset->type];
+
+	if(!asset->identified)
+	{
+		// la variante fait partie de l'identite : le meme .obj avec d'autres LODs ou un autre format n'est pas partage
+		const int variant[3] = { (int) asset->type, asset->lodLevels, (int) asset->format };
+		asset->contentHash = HashBytes(variant, sizeof(variant), HashBytes(data, size, FnvOffsetBasis));
+		asset->identified = true;
+		std::unordered_map<uint64_t, Handle>::iterator found = m_Contents.find(asset->contentHash);
+		if(found == m_Contents.end())
+		{
+			m_Contents[asset->contentHash] = handle;
+		}
+		else
+		{
+			// meme contenu sous un autre chemin : les references passent a l'asset deja connu
+			Asset& target = m_Assets[found->second];
+			target.refCount += asset->refCount;
+			asset->refCount = 0;
+			asset->alias = found->second;
+			++m_SharedContents;
+			printf("%s : contenu identique a %s, partage\n", asset->path.c_str(), target.path.c_str());
+			if(target.resident[ASSET_CPU] || target.missing)
+				return !target.missing;
+			asset = &target;
+		}
+	}
+
+	if(asset->type == ASSET_TEXTURE)
+	{
+		int w, h;
+		uint8_t* pixels = stbi_load_from_memory(data, (int) size, &w, &h, nullptr, STBI_rgb_alpha);
+		if(pixels == nullptr)
+		{
+			asset->missing = true;
+			return false;
+		}
+		asset->image.width = w;
+		asset->image.height = h;
+		asset->image.texels.resize(w * h);
+		memcpy(&asset->image.texels[0], pixels, w * h * 4);
+		stbi_image_free(pixels);
+		asset->bytes[ASSET_CPU] = asset->image.texels.size() * sizeof(uint32_t);
+	}
+	else
+	{
+		if(!BuildModel(asset->path, data, size, asset->lodLevels, asset->model))
+		{
+			asset->model = ModelData();
+			asset->missing = true;
+			return false;
+		}
+		asset->bytes[ASSET_CPU] = GetModelBytes(asset->model);
+	}
+	asset->resident[ASSET_CPU] = true;
+	return true;
+}
+
+bool AssetManager::LoadGpu(Handle handle)
+{
+	// la partie GPU est construite depuis la partie CPU, rechargee si elle a ete evincee
+	Asset& asset = m_Assets[handle];
+	if(!asset.resident[ASSET_CPU] && !LoadCpu(handle))
+		return false;
+
+	if(asset.type == ASSET_TEXTURE)
+	{
+		glGenTextures(1, &asset.texture);
+		glBindTexture(GL_TEXTURE_2D, asset.texture);
+		// memes parametres que LoadAndCreateTextureRGBA
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, asset.image.width, asset.image.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, &asset.image.texels[0]);
+		asset.bytes[ASSET_GPU] = asset.image.texels.size() * sizeof(uint32_t);
+	}
+	else
+	{
+		MeshArena& arena = m_Arenas[asset.format];
+		if(asset.format == VERTEX_FORMAT_COMPACT)
+			asset.bytes[ASSET_GPU] = UploadCompactMesh(asset.path, asset.model, arena, asset.gpu);
+		else
+			asset.bytes[ASSET_GPU] = UploadFloatMesh(asset.model.mesh, arena, asset.gpu);
+	}
+	asset.resident[ASSET_GPU] = true;
+	return true;
+}
+
+void AssetManager::EvictCpu(Asset& asset)
+{
+	if(!asset.resident[ASSET_CPU])
+		return;
+	// affectation d'objets vides : la memoire des vectors est rendue, pas seulement videe
+	asset.image = SoftwareTexture();
+	asset.model = ModelData();
+	asset.bytes[ASSET_CPU] = 0;
+	asset.resident[ASSET_CPU] = false;
+}
+
+void AssetManager::EvictGpu(Asset& asset)
+{
+	if(!asset.resident[ASSET_GPU])
+		return;
+	if(asset.texture)
+		glDeleteTextures(1, &asset.texture);
+	asset.texture = 0;
+	if(asset.gpu.arena)
+		asset.gpu.arena->Free(asset.gpu.allocation);
+	asset.gpu.arena = NULL;
+	asset.gpu.allocation = MeshArena::InvalidHandle;
+	asset.bytes[ASSET_GPU] = 0;
+	asset.resident[ASSET_GPU] = false;
+}
+
+GLuint AssetManager::GetTexture(Handle handle)
+{
+	Asset* asset = Touch(handle, ASSET_GPU);
+	return asset ? asset->texture : 0;
+}
+
+const SoftwareTexture* AssetManager::GetTextureImage(Handle handle)
+{
+	Asset* asset = Touch(handle, ASSET_CPU);
+	return asset ? &asset->image : NULL;
+}
+
+const ModelData* AssetManager::GetModel(Handle handle)
+{
+	Asset* asset = Touch(handle, ASSET_CPU);
+	return asset ? &asset->model : NULL;
+}
+
+const ModelGpu* AssetManager::GetModelGpu(Handle handle)
+{
+	Asset* asset = Touch(handle, ASSET_GPU);
+	return asset ? &asset->gpu : NULL;
+}
+
+void AssetManager::EndFrame()
+{
+	for(int memory = 0; memory < ASSET_MEMORY_COUNT; ++memory)
+	{
+		size_t residentBytes = 0;
+		for(size_t i = 0; i < m_Assets.size(); ++i)
+			residentBytes += m_Assets[i].bytes[memory];
+		if(m_Budgets[memory] == 0 || residentBytes <= m_Budgets[memory])
+			continue;
+
+		// candidats : rien de ce qui a servi a cette frame, ni la partie CPU d'un asset encore reference
+		// (les objets pointent dessus), ni la geometrie d'un modele encore reference
+		ArenaScope scratch(GetScratchArena());
+		ArenaVector<Handle> candidates(scratch.GetArena());
+		candidates.reserve(m_Assets.size());
+		for(size_t i = 0; i < m_Assets.size(); ++i)
+		{
+			const Asset& asset = m_Assets[i];
+			if(!asset.resident[memory] || asset.lastUsedFrame == m_Frame)
+				continue;
+			if(asset.refCount > 0 && (memory == ASSET_CPU || asset.type == ASSET_MODEL))
+				continue;
+			candidates.push_back((Handle) i);
+		}
+		// les moins recemment utilises d'abord
+		std::stable_sort(candidates.begin(), candidates.end(), [this](Handle a, Handle b) { return m_Assets[a].lastUsedFrame < m_Assets[b].lastUsedFrame; });
+
+		for(size_t c = 0; c < candidates.size() && residentBytes > m_Budgets[memory]; ++c)
+		{
+			Asset& asset = m_Assets[candidates[c]];
+			residentBytes -= asset.bytes[memory];
+			if(memory == ASSET_CPU)
+				EvictCpu(asset);
+			else
+				EvictGpu(asset);
+			++m_Evictions[asset.type];
+		}
+	}
+	++m_Frame;
+}
+
+void AssetManager::GetStats(AssetStats& stats) const
+{
+	memset(&stats, 0, sizeof(stats));
+	for(size_t i = 0; i < m_Assets.size(); ++i)
+	{
+		const Asset& asset = m_Assets[i];
+		if(asset.alias != InvalidHandle)
+			continue;
+		++stats.assets[asset.type];
+		for(int memory = 0; memory < ASSET_MEMORY_COUNT; ++memory)
+			stats.residentBytes[asset.type][memory] += asset.bytes[memory];
+	}
+	for(int type = 0; type < ASSET_TYPE_COUNT; ++type)
+	{
+		stats.loads[type] = m_Loads[type];
+		stats.evictions[type] = m_Evictions[type];
+	}
+	stats.sharedRequests = m_SharedRequests;
+	stats.sharedContents = m_SharedContents;
+}
+
+void AssetManager::PrintStats() const
+{
+	AssetStats stats;
+	GetStats(stats);
+	printf("Assets : %d demandes servies par un asset deja connu, %d fichiers au contenu identique partages\n",
+		   stats.sharedRequests, stats.sharedContents);
+	for(int type = 0; type < ASSET_TYPE_COUNT; ++type)
+	{
+		printf("    %s : %d, CPU %.1f Mo, GPU %.1f Mo, %d chargements, %d evictions\n", AssetTypeNames[type], stats.assets[type],
+			   stats.residentBytes[type][ASSET_CPU] / (1024.0 * 1024.0), stats.residentBytes[type][ASSET_GPU] / (1024.0 * 1024.0),
+			   stats.loads[type], stats.evictions[type]);
+	}
+}
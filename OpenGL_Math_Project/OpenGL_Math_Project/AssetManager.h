@@ -0,0 +1,153 @@
+#ifndef __ASSET_MANAGER_H__
+#define __ASSET_MANAGER_H__
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <cstdint>
+
+#include "Common.h"
+#include "Mesh.h"
+#include "MeshArena.h"
+#include "SoftwareRasterizer.h"
+
+enum AssetType
+{
+	ASSET_TEXTURE,
+	ASSET_MODEL,
+	ASSET_TYPE_COUNT
+};
+
+// Chaque asset a une partie CPU (pixels decodes, mesh et LODs) et une partie GPU (texture, allocation dans une MeshArena)
+enum AssetMemory
+{
+	ASSET_CPU,
+	ASSET_GPU,
+	ASSET_MEMORY_COUNT
+};
+
+// Niveau de detail d'un modele : plage de mesh.indices (les niveaux simplifies suivent le mesh complet)
+struct ModelLod
+{
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	float error;						// erreur geometrique (Hausdorff) dans le repere local
+	std::vector<Submesh> submeshes;		// plages du niveau regroupees par materiau
+};
+
+// Partie CPU d'un modele .obj : toutes les formes, materiaux fusionnes, triangles tries par materiau
+struct ModelData
+{
+	MeshData mesh;						// indices du niveau 0 puis des niveaux simplifies, comme l'IBO
+	std::vector<ModelLod> lods;
+	std::vector<std::string> textures;	// texture diffuse de chaque materiau fusionne ("" : aucune)
+};
+
+// Partie GPU d'un modele : position = a_position * positionScale + positionOffset
+struct ModelGpu
+{
+	MeshArena* arena;
+	MeshArena::Handle allocation;
+	GLenum indexType;
+	glm::vec3 positionScale;
+	glm::vec3 positionOffset;
+};
+
+struct AssetStats
+{
+	size_t residentBytes[ASSET_TYPE_COUNT][ASSET_MEMORY_COUNT];
+	int assets[ASSET_TYPE_COUNT];		// contenus distincts connus
+	int loads[ASSET_TYPE_COUNT];		// lectures depuis le disque (rechargements apres eviction compris)
+	int evictions[ASSET_TYPE_COUNT];	// parties CPU ou GPU rendues pour tenir les budgets
+	int sharedRequests;					// Acquire d'un chemin deja connu
+	int sharedContents;					// fichiers differents au contenu identique (meme hash)
+};
+
+// Assets partages par tous les objets, sur le thread GL uniquement :
+// - un handle par chemin (et variante : niveaux de detail, format de sommet), compte de references
+// - chargement paresseux au premier Get, le contenu est identifie par un hash FNV-1a du fichier :
+//   deux chemins au meme contenu partagent la meme texture ou la meme allocation de geometrie
+// - les parties non utilisees a la frame courante sont evincees (LRU) a EndFrame tant que les budgets
+//   CPU et GPU sont depasses, puis rechargees au prochain Get. La partie CPU d'un asset reference
+//   n'est jamais evincee : les objets rasterisent et lancent leurs rayons directement sur ces donnees,
+//   sans en garder de copie. La geometrie d'un modele reference non plus : les draws la lisent dans l'arena.
+class AssetManager
+{
+public:
+	typedef uint32_t Handle;
+	static const Handle InvalidHandle = 0xffffffff;
+
+	AssetManager();
+
+	// arenas : une par format de sommet (VERTEX_FORMAT_COUNT), budgets en octets (0 : sans limite)
+	void Create(MeshArena* arenas, size_t cpuBudget, size_t gpuBudget);
+	// tout est rendu, les handles deviennent invalides
+	void Destroy();
+
+	// "" : InvalidHandle (Get renvoie la texture 0)
+	Handle AcquireTexture(const std::string& path);
+	Handle AcquireModel(const std::string& path, int lodLevels, VertexFormat format);
+	void Release(Handle handle);
+
+	// Acces avec chargement paresseux, marquent l'asset utilise a cette frame.
+	// GetTextureImage, GetModel et GetModelGpu : valables tant que le handle n'est pas rendu (parties epinglees),
+	// GetTexture : jusqu'au prochain EndFrame (eviction possible).
+	GLuint GetTexture(Handle handle);
+	const SoftwareTexture* GetTextureImage(Handle handle);			// NULL si illisible
+	const ModelData* GetModel(Handle handle);
+	const ModelGpu* GetModelGpu(Handle handle);
+
+	inline void SetBudgets(size_t cpuBytes, size_t gpuBytes) { m_Budgets[ASSET_CPU] = cpuBytes; m_Budgets[ASSET_GPU] = gpuBytes; }
+	// fin de frame : evictions LRU jusqu'a repasser sous les budgets
+	void EndFrame();
+
+	void GetStats(AssetStats& stats) const;
+	void PrintStats() const;
+
+private:
+	struct Asset
+	{
+		AssetType type;
+		std::string path;
+		int lodLevels;					// modeles
+		VertexFormat format;
+		int refCount;
+		Handle alias;					// meme contenu qu'un autre asset : tout lui est delegue
+		bool identified;				// hash du contenu connu
+		bool missing;					// fichier illisible
+		uint64_t contentHash;
+		uint32_t lastUsedFrame;
+		bool resident[ASSET_MEMORY_COUNT];
+		size_t bytes[ASSET_MEMORY_COUNT];
+		SoftwareTexture image;
+		GLuint texture;
+		ModelData model;
+		ModelGpu gpu;
+
+		Asset(AssetType type, const std::string& path, int lodLevels, VertexFormat format);
+	};
+
+	Handle Acquire(AssetType type, const std::string& path, int lodLevels, VertexFormat format);
+	// suit les alias jusqu'a l'asset qui porte le contenu
+	Handle Resolve(Handle handle) const;
+	// identifie le contenu au premier acces (handle peut alors devenir un alias) puis charge la partie memory
+	Asset* Touch(Handle handle, AssetMemory memory);
+	bool LoadCpu(Handle handle);
+	bool LoadGpu(Handle handle);
+	void EvictCpu(Asset& asset);
+	void EvictGpu(Asset& asset);
+
+	MeshArena* m_Arenas;
+	std::deque<Asset> m_Assets;						// adresses stables quand un asset est ajoute
+	std::unordered_map<std::string, Handle> m_Paths;		// type, variante et chemin
+	std::unordered_map<uint64_t, Handle> m_Contents;		// hash du contenu et de la variante
+	size_t m_Budgets[ASSET_MEMORY_COUNT];
+	uint32_t m_Frame;
+	int m_Loads[ASSET_TYPE_COUNT];
+	int m_Evictions[ASSET_TYPE_COUNT];
+	int m_SharedRequests;
+	int m_SharedContents;
+};
+
+#endif //__ASSET_MANAGER_H__
@@ -0,0 +1,1099 @@
+#include "Benchmarks.h"
+
+#define _USE_MATH_DEFINES
+
+#include <cstdio>
+#include <cmath>
+#include <cfloat>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+
+#include "glm/gtc/matrix_transform.hpp"
+
+#include "tinyobjloader/tiny_obj_loader.h"
+
+#include "Mesh.h"
+#include "MeshSimplify.h"
+#include "DynamicBvh.h"
+#include "TriangleBvh.h"
+#include "SoftwareRasterizer.h"
+#include "RayTracer.h"
+#include "Culling.h"
+#include "OcclusionCulling.h"
+#include "Parallel.h"
+#include "SpscQueue.h"
+#include "TripleBuffer.h"
+#include "AllocationStats.h"
+
+typedef std::chrono::high_resolution_clock BenchmarkClock;
+
+static double ElapsedMilliseconds(const BenchmarkClock::time_point& start)
+{
+	return std::chrono::duration<double, std::milli>(BenchmarkClock::now() - start).count();
+}
+
+void RunDynamicBvhBenchmark()
+{
+	const int objectCounts[] = { 1000, 100000, 1000000 };
+	const int queryCount = 1000;
+
+	printf("DynamicBvh : insertion SAH + rotations, refit par frame, requetes par lot sur %d coeurs\n", GetWorkerCount());
+	for(size_t test = 0; test < sizeof(objectCounts) / sizeof(objectCounts[0]); ++test)
+	{
+		const int count = objectCounts[test];
+		// densite constante : le volume de la scene grandit avec le nombre d'objets
+		const float extent = 10.0f * cbrtf((float) count);
+
+		std::mt19937 random(1234);
+		std::uniform_real_distribution<float> position(-extent, extent);
+		std::uniform_real_distribution<float> size(0.2f, 2.0f);
+		std::uniform_real_distribution<float> velocity(-0.5f, 0.5f);
+
+		std::vector<Aabb> boxes(count);
+		std::vector<glm::vec3> velocities(count);
+		for(int i = 0; i < count; ++i)
+		{
+			const glm::vec3 center(position(random), position(random), position(random));
+			const glm::vec3 half(size(random), size(random), size(random));
+			boxes[i] = Aabb(center - half, center + half);
+			velocities[i] = glm::vec3(velocity(random), velocity(random), velocity(random));
+		}
+
+		DynamicBvh tree;
+		std::vector<int> proxies(count);
+		BenchmarkClock::time_point start = BenchmarkClock::now();
+		for(int i = 0; i < count; ++i)
+			proxies[i] = tree.CreateProxy(boxes[i], i);
+		const double insertTime = ElapsedMilliseconds(start);
+		const float insertCost = tree.ComputeSahCost();
+		const int insertHeight = tree.GetHeight();
+
+		// quelques frames d'animation : on deplace tout puis refit
+		const int frameCount = 10;
+		double refitTime = 0.0;
+		for(int frame = 0; frame < frameCount; ++frame)
+		{
+			for(int i = 0; i < count; ++i)
+			{
+				boxes[i].min += velocities[i];
+				boxes[i].max += velocities[i];
+				tree.SetProxyBounds(proxies[i], boxes[i]);
+			}
+			start = BenchmarkClock::now();
+			tree.Refit();
+			refitTime += ElapsedMilliseconds(start);
+		}
+		refitTime /= frameCount;
+
+		printf("%8d objets : insertion %9.2f ms (%.3f us/objet), hauteur %d, cout SAH %.1f\n",
+			   count, insertTime, insertTime * 1000.0 / count, insertHeight, insertCost);
+		printf("           refit + rotations %8.2f ms/frame, hauteur %d, cout SAH %.1f, arbre %s\n",
+			   refitTime, tree.GetHeight(), tree.ComputeSahCost(), tree.Validate() ? "valide" : "INVALIDE");
+
+		// requetes : un frustum, un lot de rayons et un lot de spheres
+		const glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, extent);
+		const glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, extent), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		Frustum frustum;
+		ExtractFrustumPlanes(projection * view, frustum);
+
+		std::vector<Ray> rays(queryCount);
+		std::vector<glm::vec3> centers(queryCount);
+		std::vector<float> radii(queryCount);
+		for(int i = 0; i < queryCount; ++i)
+		{
+			rays[i].origin = glm::vec3(position(random), position(random), position(random));
+			rays[i].direction = glm::normalize(glm::vec3(velocity(random), velocity(random), velocity(random)));
+			rays[i].maxDistance = extent;
+			centers[i] = glm::vec3(position(random), position(random), position(random));
+			radii[i] = 5.0f;
+		}
+
+		std::vector<int> frustumResults;
+		start = BenchmarkClock::now();
+		tree.QueryFrustum(frustum, frustumResults);
+		const double frustumTime = ElapsedMilliseconds(start);
+
+		std::vector<std::vector<int> > rayResults, sphereResults;
+		start = BenchmarkClock::now();
+		tree.QueryRays(rays, rayResults);
+		const double rayTime = ElapsedMilliseconds(start);
+		start = BenchmarkClock::now();
+		tree.QuerySpheres(centers, radii, sphereResults);
+		const double sphereTime = ElapsedMilliseconds(start);
+
+		// verification force brute (memes tests boite par boite)
+		size_t bruteFrustum = 0, bruteRays = 0, bruteSpheres = 0;
+		size_t treeRays = 0, treeSpheres = 0;
+		start = BenchmarkClock::now();
+		for(int i = 0; i < count; ++i)
+		{
+			bool inside = true;
+			for(int p = 0; p < 6 && inside; ++p)
+			{
+				const glm::vec3 normal(frustum.planes[p]);
+				const glm::vec3 positive(normal.x >= 0.0f ? boxes[i].max.x : boxes[i].min.x,
+										 normal.y >= 0.0f ? boxes[i].max.y : boxes[i].min.y,
+										 normal.z >= 0.0f ? boxes[i].max.z : boxes[i].min.z);
+				inside = glm::dot(normal, positive) + frustum.planes[p].w >= 0.0f;
+			}
+			bruteFrustum += inside;
+		}
+		const double bruteFrustumTime = ElapsedMilliseconds(start);
+		// les rayons et spheres force brute sont couteux a 1M : on n'en verifie qu'une partie
+		const int checkedQueries = std::max(1, std::min(queryCount, 100000000 / count / 10));
+		for(int q = 0; q < checkedQueries; ++q)
+		{
+			const glm::vec3 inverseDirection = 1.0f / rays[q].direction;
+			for(int i = 0; i < count; ++i)
+			{
+				if(IntersectRayAabb(rays[q].origin, inverseDirection, boxes[i], rays[q].maxDistance) >= 0.0f)
+					++bruteRays;
+				const glm::vec3 d = centers[q] - glm::clamp(centers[q], boxes[i].min, boxes[i].max);
+				if(glm::dot(d, d) <= radii[q] * radii[q])
+					++bruteSpheres;
+			}
+			treeRays += rayResults[q].size();
+			treeSpheres += sphereResults[q].size();
+		}
+
+		printf("           frustum %.3f ms (%u objets, force brute %.3f ms %s)\n", frustumTime, (unsigned) frustumResults.size(),
+			   bruteFrustumTime, bruteFrustum == frustumResults.size() ? "ok" : "DIFFERENT");
+		printf("           %d rayons %.3f ms (%.2f us/rayon), %d spheres %.3f ms (%.2f us/sphere), verification sur %d : %s\n",
+			   queryCount, rayTime, rayTime * 1000.0 / queryCount, queryCount, sphereTime, sphereTime * 1000.0 / queryCount,
+			   checkedQueries, (bruteRays == treeRays && bruteSpheres == treeSpheres) ? "ok" : "DIFFERENT");
+	}
+}
+
+void RunTriangleBvhBenchmark()
+{
+	const char* inputFile = "Dwarf_2_Low.obj";
+	std::vector<tinyobj::shape_t> shapes;
+	std::vector<tinyobj::material_t> materials;
+	const std::string err = tinyobj::LoadObj(shapes, materials, inputFile);
+	if(shapes.empty())
+	{
+		printf("Impossible de charger %s : %s\n", inputFile, err.c_str());
+		return;
+	}
+
+	// toutes les formes dans un seul mesh
+	std::vector<float> positions;
+	std::vector<uint32_t> indices;
+	for(size_t s = 0; s < shapes.size(); ++s)
+	{
+		const uint32_t base = (uint32_t) (positions.size() / 3);
+		positions.insert(positions.end(), shapes[s].mesh.positions.begin(), shapes[s].mesh.positions.end());
+		for(size_t i = 0; i < shapes[s].mesh.indices.size(); ++i)
+			indices.push_back(base + shapes[s].mesh.indices[i]);
+	}
+
+	printf("TriangleBvh : %s, %u triangles, SAH binnee (%d cases), %d coeurs\n",
+		   inputFile, (unsigned) (indices.size() / 3), TriangleBvh::BinCount, GetWorkerCount());
+
+	TriangleBvh bvh;
+	const int buildCount = 10;
+	double buildTime = 0.0;
+	for(int build = 0; build < buildCount; ++build)
+	{
+		const BenchmarkClock::time_point start = BenchmarkClock::now();
+		bvh.Build(positions, &indices[0], indices.size());
+		buildTime += ElapsedMilliseconds(start);
+	}
+	printf("    construction %.3f ms, %u noeuds de %u octets, profondeur %d\n", buildTime / buildCount,
+		   (unsigned) bvh.GetNodeCount(), (unsigned) sizeof(TriangleBvhNode), bvh.GetDepth());
+
+	// rayons de picking : depuis une sphere autour du mesh vers un point de sa boite
+	glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX);
+	for(size_t i = 0; i < positions.size(); i += 3)
+	{
+		boundsMin = glm::min(boundsMin, glm::vec3(positions[i], positions[i + 1], positions[i + 2]));
+		boundsMax = glm::max(boundsMax, glm::vec3(positions[i], positions[i + 1], positions[i + 2]));
+	}
+	const glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+	const float radius = glm::length(boundsMax - boundsMin);
+
+	const int rayCount = 100000;
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::vector<Ray> rays(rayCount);
+	for(int i = 0; i < rayCount; ++i)
+	{
+		const float z = unit(random) * 2.0f - 1.0f;
+		const float phi = unit(random) * 2.0f * (float) M_PI;
+		const float r = sqrtf(1.0f - z * z);
+		rays[i].origin = center + radius * glm::vec3(r * cosf(phi), r * sinf(phi), z);
+		const glm::vec3 target = boundsMin + (boundsMax - boundsMin) * glm::vec3(unit(random), unit(random), unit(random));
+		rays[i].direction = glm::normalize(target - rays[i].origin);
+		rays[i].maxDistance = 2.0f * radius;
+	}
+
+	std::vector<TriangleHit> hits(rayCount);
+	std::vector<uint8_t> found(rayCount);
+	BenchmarkClock::time_point start = BenchmarkClock::now();
+	for(int i = 0; i < rayCount; ++i)
+		found[i] = bvh.Intersect(rays[i].origin, rays[i].direction, rays[i].maxDistance, hits[i]);
+	const double queryTime = ElapsedMilliseconds(start);
+	const int hitCount = (int) std::count(found.begin(), found.end(), 1);
+
+	// verification force brute sur une partie des rayons (meme triangle, ou meme distance si deux triangles se touchent)
+	const int checkedRays = 2000;
+	int mismatches = 0;
+	start = BenchmarkClock::now();
+	for(int i = 0; i < checkedRays; ++i)
+	{
+		TriangleHit reference;
+		const bool referenceFound = bvh.IntersectBruteForce(rays[i].origin, rays[i].direction, rays[i].maxDistance, reference);
+		if(referenceFound != (found[i] != 0))
+			++mismatches;
+		else if(referenceFound && reference.triangle != hits[i].triangle && fabsf(reference.distance - hits[i].distance) > 1e-4f * radius)
+			++mismatches;
+	}
+	const double bruteTime = ElapsedMilliseconds(start);
+
+	printf("    %d rayons %.3f ms (%.3f us/rayon, %d touches), force brute %.2f us/rayon, verification sur %d : %s\n",
+		   rayCount, queryTime, queryTime * 1000.0 / rayCount, hitCount, bruteTime * 1000.0 / checkedRays,
+		   checkedRays, mismatches == 0 ? "ok" : "DIFFERENT");
+}
+
+void RunSoftwareRasterizerBenchmark(const std::vector<glm::mat4>& instances, const glm::mat4& viewMatrix,
+									const glm::mat4& projectionMatrix, const glm::vec3& lightDirection)
+{
+	const char* inputFile = "rock.obj";
+	std::vector<tinyobj::shape_t> shapes;
+	std::vector<tinyobj::material_t> materials;
+	const std::string err = tinyobj::LoadObj(shapes, materials, inputFile);
+	if(shapes.empty())
+	{
+		printf("Impossible de charger %s : %s\n", inputFile, err.c_str());
+		return;
+	}
+
+	SoftwareMesh mesh;
+	mesh.positions.swap(shapes[0].mesh.positions);
+	mesh.normals.swap(shapes[0].mesh.normals);
+	mesh.texcoords.swap(shapes[0].mesh.texcoords);
+	mesh.indices.swap(shapes[0].mesh.indices);
+	SoftwareTexture texture;
+	if(materials.empty() || !texture.Load(materials[0].diffuse_texname.c_str()))
+		printf("Texture de %s introuvable, ombrage sans texture\n", inputFile);
+
+	const int width = 1280, height = 720;
+	SoftwareRasterizer rasterizer;
+	rasterizer.Create(width, height);
+	printf("SoftwareRasterizer : %u rochers de %u triangles, %dx%d, tuiles de %d pixels, %d coeurs\n",
+		   (unsigned) instances.size(), (unsigned) (mesh.indices.size() / 3), width, height,
+		   SoftwareRasterizer::TileSize, GetWorkerCount());
+
+	std::vector<unsigned int> threadCounts;
+	for(unsigned int count = 1; count < GetWorkerCount(); count *= 2)
+		threadCounts.push_back(count);
+	threadCounts.push_back(GetWorkerCount());
+
+	const int frameCount = 20;
+	double singleThreadTime = 0.0;
+	for(size_t test = 0; test < threadCounts.size(); ++test)
+	{
+		rasterizer.SetThreadCount(threadCounts[test]);
+		double frameTime = 0.0;
+		// une frame de chauffe (allocation des lots et des tuiles)
+		for(int frame = -1; frame < frameCount; ++frame)
+		{
+			const BenchmarkClock::time_point start = BenchmarkClock::now();
+			rasterizer.Begin(viewMatrix, projectionMatrix, lightDirection, 0xff808080);
+			for(size_t i = 0; i < instances.size(); ++i)
+				rasterizer.AddDraw(mesh, 0, (uint32_t) mesh.indices.size(), instances[i], texture);
+			rasterizer.Render();
+			if(frame >= 0)
+				frameTime += ElapsedMilliseconds(start);
+		}
+		frameTime /= frameCount;
+		if(test == 0)
+			singleThreadTime = frameTime;
+
+		printf("    %2u threads : %8.3f ms/frame, %7.2f Mtriangles/s, %7.2f Mpixels/s, acceleration x%.2f\n",
+			   threadCounts[test], frameTime, rasterizer.GetSubmittedTriangleCount() / (frameTime * 1000.0),
+			   width * height / (frameTime * 1000.0), singleThreadTime / frameTime);
+	}
+
+	// couverture : pixels differents du fond
+	const uint32_t* color = rasterizer.GetColorBuffer();
+	int covered = 0;
+	for(int y = 0; y < height; ++y)
+	{
+		for(int x = 0; x < width; ++x)
+			covered += color[y * rasterizer.GetStride() + x] != 0xff808080;
+	}
+	printf("    %u triangles rasterises sur %u soumis, %.1f%% de l'image couverte\n",
+		   (unsigned) rasterizer.GetRasterizedTriangleCount(), (unsigned) rasterizer.GetSubmittedTriangleCount(),
+		   100.0 * covered / (width * height));
+}
+
+void RunRayTracerBenchmark(const std::vector<glm::mat4>& instances, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix,
+						   const glm::vec3& lightDirection, const char* skyboxFiles[])
+{
+	const char* inputFile = "rock.obj";
+	std::vector<tinyobj::shape_t> shapes;
+	std::vector<tinyobj::material_t> materials;
+	const std::string err = tinyobj::LoadObj(shapes, materials, inputFile);
+	if(shapes.empty())
+	{
+		printf("Impossible de charger %s : %s\n", inputFile, err.c_str());
+		return;
+	}
+
+	SoftwareMesh mesh;
+	mesh.positions.swap(shapes[0].mesh.positions);
+	mesh.normals.swap(shapes[0].mesh.normals);
+	mesh.texcoords.swap(shapes[0].mesh.texcoords);
+	mesh.indices.swap(shapes[0].mesh.indices);
+	SoftwareTexture texture;
+	if(materials.empty() || !texture.Load(materials[0].diffuse_texname.c_str()))
+		printf("Texture de %s introuvable, ombrage sans texture\n", inputFile);
+	SoftwareCubeMap skybox;
+	const bool hasSkybox = skybox.Load(skyboxFiles);
+	if(!hasSkybox)
+		printf("Skybox introuvable, fond uni\n");
+
+	TriangleBvh bvh;
+	bvh.Build(mesh.positions, &mesh.indices[0], mesh.indices.size());
+
+	RayTracer tracer;
+	tracer.Begin();
+	for(size_t i = 0; i < instances.size(); ++i)
+		tracer.AddInstance(bvh, mesh, instances[i], texture);
+	tracer.Build();
+	tracer.SetSkybox(hasSkybox ? &skybox : NULL);
+	tracer.SetLightDirection(lightDirection);
+
+	const int width = 1280, height = 720;
+	printf("RayTracer : %u rochers de %u triangles, %dx%d, paquets de 8 rayons, %d coeurs\n",
+		   (unsigned) instances.size(), (unsigned) (mesh.indices.size() / 3), width, height, GetWorkerCount());
+
+	std::vector<uint32_t> reference, image;
+	for(int shadows = 0; shadows < 2; ++shadows)
+	{
+		tracer.SetShadows(shadows != 0);
+		double times[2];
+		for(int packets = 0; packets < 2; ++packets)
+		{
+			tracer.SetPacketTracing(packets != 0);
+			const BenchmarkClock::time_point start = BenchmarkClock::now();
+			tracer.Render(viewMatrix, projectionMatrix, width, height, packets ? image : reference);
+			times[packets] = ElapsedMilliseconds(start);
+		}
+
+		// les deux parcours doivent trouver les memes impacts : on compare les images. Sur une arete partagee,
+		// l'ordre de parcours peut choisir l'autre triangle, d'ou une tolerance d'arrondi par composante
+		int differences = 0;
+		for(size_t i = 0; i < image.size(); ++i)
+		{
+			for(int channel = 0; channel < 32; channel += 8)
+			{
+				if(abs((int) ((image[i] >> channel) & 0xff) - (int) ((reference[i] >> channel) & 0xff)) > 2)
+				{
+					++differences;
+					break;
+				}
+			}
+		}
+
+		printf("    %s : un par un %8.2f ms (%6.2f Mrayons/s), paquets %8.2f ms (%6.2f Mrayons/s), x%.2f, %u rayons, %d pixels differents\n",
+			   shadows ? "avec ombres" : "sans ombres", times[0], tracer.GetRayCount() / (times[0] * 1000.0),
+			   times[1], tracer.GetRayCount() / (times[1] * 1000.0), times[0] / times[1], (unsigned) tracer.GetRayCount(), differences);
+	}
+
+	if(WriteImagePng("reference.png", width, height, image))
+		printf("    image ecrite dans reference.png\n");
+}
+
+// Chemin d'origine de LoadOBJ : shape_t de tinyobjloader, attributs echanges dans un MeshData,
+// puis entrelacement dans le buffer de sommets (ici un vecteur a la place du buffer mappe)
+static void LoadObjShapes(std::istream& stream, std::vector<FloatVertex>& vertices, std::vector<uint32_t>& indices)
+{
+	std::vector<tinyobj::shape_t> shapes;
+	std::vector<tinyobj::material_t> materials;
+	tinyobj::MaterialFileReader materialReader("");
+	tinyobj::LoadObj(shapes, materials, stream, materialReader);
+
+	MeshData mesh;
+	for(size_t s = 0; s < shapes.size(); ++s)
+	{
+		tinyobj::mesh_t& shape = shapes[s].mesh;
+		if(s == 0)
+		{
+			mesh.positions.swap(shape.positions);
+			mesh.normals.swap(shape.normals);
+			mesh.texcoords.swap(shape.texcoords);
+			mesh.indices.swap(shape.indices);
+			continue;
+		}
+		const uint32_t base = (uint32_t) mesh.VertexCount();
+		mesh.positions.insert(mesh.positions.end(), shape.positions.begin(), shape.positions.end());
+		mesh.normals.insert(mesh.normals.end(), shape.normals.begin(), shape.normals.end());
+		mesh.texcoords.insert(mesh.texcoords.end(), shape.texcoords.begin(), shape.texcoords.end());
+		for(size_t i = 0; i < shape.indices.size(); ++i)
+			mesh.indices.push_back(base + shape.indices[i]);
+	}
+
+	const size_t count = mesh.VertexCount();
+	vertices.resize(count);
+	memset(&vertices[0], 0, count * sizeof(FloatVertex));
+	for(size_t index = 0; index < count; ++index)
+	{
+		memcpy(vertices[index].position, &mesh.positions[index * 3], 3 * sizeof(float));
+		if(mesh.normals.size())
+			memcpy(vertices[index].normal, &mesh.normals[index * 3], 3 * sizeof(float));
+		if(mesh.texcoords.size())
+			memcpy(vertices[index].texcoords, &mesh.texcoords[index * 2], 2 * sizeof(float));
+	}
+	indices.swap(mesh.indices);
+}
+
+static void LoadObjSink(std::istream& stream, std::vector<FloatVertex>& vertices, std::vector<uint32_t>& indices)
+{
+	std::vector<tinyobj::material_t> materials;
+	tinyobj::MaterialFileReader materialReader("");
+	FloatVertexSink sink(vertices, indices);
+	tinyobj::LoadObj(sink, materials, stream, materialReader);
+}
+
+// Les deux chemins ne numerotent pas les sommets pareil (deduplication par forme ou sur tout le fichier) :
+// on compare les attributs de chaque coin de triangle
+static bool SameTriangles(const std::vector<FloatVertex>& verticesA, const std::vector<uint32_t>& indicesA,
+						  const std::vector<FloatVertex>& verticesB, const std::vector<uint32_t>& indicesB)
+{
+	if(indicesA.size() != indicesB.size())
+		return false;
+	for(size_t i = 0; i < indicesA.size(); ++i)
+	{
+		if(memcmp(&verticesA[indicesA[i]], &verticesB[indicesB[i]], sizeof(FloatVertex)) != 0)
+			return false;
+	}
+	return true;
+}
+
+void RunObjLoaderBenchmark()
+{
+	struct Source
+	{
+		std::string name;
+		std::string text;
+	};
+	std::vector<Source> sources;
+
+	const char* files[] = { "rock.obj", "Smallcar.obj", "Dwarf_2_Low.obj" };
+	for(size_t f = 0; f < sizeof(files) / sizeof(files[0]); ++f)
+	{
+		std::ifstream file(files[f], std::ios::binary);
+		if(!file)
+		{
+			printf("%s introuvable\n", files[f]);
+			continue;
+		}
+		Source source;
+		source.name = files[f];
+		source.text.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		sources.push_back(source);
+	}
+
+	// grille de 500x500 quads avec positions, uv et normales : 251001 sommets, 500000 triangles
+	{
+		const int quads = 500;
+		std::ostringstream text;
+		for(int y = 0; y <= quads; ++y)
+		{
+			for(int x = 0; x <= quads; ++x)
+			{
+				text << "v " << x * 0.1f << " " << sinf(x * 0.05f) * cosf(y * 0.05f) << " " << y * 0.1f << "\n";
+				text << "vt " << (float) x / quads << " " << (float) y / quads << "\n";
+				text << "vn 0 1 0\n";
+			}
+		}
+		for(int y = 0; y < quads; ++y)
+		{
+			for(int x = 0; x < quads; ++x)
+			{
+				const int a = y * (quads + 1) + x + 1, b = a + 1, c = a + quads + 2, d = a + quads + 1;
+				text << "f " << a << "/" << a << "/" << a << " " << b << "/" << b << "/" << b << " "
+					 << c << "/" << c << "/" << c << " " << d << "/" << d << "/" << d << "\n";
+			}
+		}
+		Source source;
+		source.name = "grille 500x500";
+		source.text = text.str();
+		sources.push_back(source);
+	}
+
+	printf("Chargement OBJ (texte deja en memoire, meilleur temps sur %d essais, pic = memoire allouee au-dela de l'existant)\n", 5);
+	for(size_t s = 0; s < sources.size(); ++s)
+	{
+		std::vector<FloatVertex> vertices[2];
+		std::vector<uint32_t> indices[2];
+		double times[2];
+#if ALLOCATOR_STATS
+		size_t peaks[2], allocations[2];
+#endif
+		for(int path = 0; path < 2; ++path)
+		{
+			times[path] = DBL_MAX;
+			for(int run = 0; run < 5; ++run)
+			{
+				vertices[path].clear();
+				vertices[path].shrink_to_fit();
+				indices[path].clear();
+				indices[path].shrink_to_fit();
+
+				std::istringstream stream(sources[s].text);
+#if ALLOCATOR_STATS
+				ResetAllocationPeak();
+				const AllocationStats before = GetAllocationStats();
+#endif
+				const BenchmarkClock::time_point start = BenchmarkClock::now();
+				if(path == 0)
+					LoadObjShapes(stream, vertices[path], indices[path]);
+				else
+					LoadObjSink(stream, vertices[path], indices[path]);
+				times[path] = std::min(times[path], ElapsedMilliseconds(start));
+#if ALLOCATOR_STATS
+				const AllocationStats after = GetAllocationStats();
+				peaks[path] = after.peakBytes - before.liveBytes;
+				allocations[path] = after.count - before.count;
+#endif
+			}
+		}
+
+		const size_t resultBytes = vertices[1].size() * sizeof(FloatVertex) + indices[1].size() * sizeof(uint32_t);
+		printf("%s : %u triangles, %u sommets (%u avant deduplication globale), resultat %.1f Ko, %s\n", sources[s].name.c_str(),
+			   (unsigned) (indices[1].size() / 3), (unsigned) vertices[1].size(), (unsigned) vertices[0].size(), resultBytes / 1024.0,
+			   SameTriangles(vertices[0], indices[0], vertices[1], indices[1]) ? "triangles identiques" : "TRIANGLES DIFFERENTS");
+		const char* names[2] = { "shape_t + entrelacement", "MeshSink -> FloatVertex" };
+		for(int path = 0; path < 2; ++path)
+		{
+#if ALLOCATOR_STATS
+			printf("    %-24s %9.2f ms, pic %8.1f Ko (x%.2f le resultat), %8u allocations\n", names[path], times[path],
+				   peaks[path] / 1024.0, (double) peaks[path] / resultBytes, (unsigned) allocations[path]);
+#else
+			printf("    %-24s %9.2f ms\n", names[path], times[path]);
+#endif
+		}
+	}
+}
+
+// --- Frustum culling ------------------------------------------------------------
+
+// Reference scalaire en double : distance signee de la sphere a chaque plan, marge au plan le plus proche
+static bool CullSphereReference(const Frustum& frustum, const glm::vec3& center, float radius, double& margin)
+{
+	bool inside = true;
+	margin = DBL_MAX;
+	for(int p = 0; p < 6; ++p)
+	{
+		const glm::vec4& plane = frustum.planes[p];
+		const double distance = (double) plane.x * center.x + (double) plane.y * center.y + (double) plane.z * center.z + plane.w + radius;
+		inside = inside && distance >= 0.0;
+		margin = std::min(margin, fabs(distance));
+	}
+	return inside;
+}
+
+bool RunCullingCheck()
+{
+	bool passed = true;
+	printf("Frustum culling : cas connus et chemin SSE contre la reference scalaire\n");
+
+	// camera a l'origine vers -z, 90 degres et carree : les plans lateraux sont x = +-z et y = +-z
+	const glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	const glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 100.0f);
+	Frustum frustum;
+	ExtractFrustumPlanes(projection * view, frustum);
+
+	struct Case
+	{
+		const char* name;
+		glm::vec3 center;
+		float radius;
+		bool visible;
+	};
+	const Case cases[] = {
+		{ "devant la camera", glm::vec3(0.0f, 0.0f, -10.0f), 1.0f, true },
+		{ "derriere la camera", glm::vec3(0.0f, 0.0f, 10.0f), 1.0f, false },
+		{ "au-dela du plan lointain", glm::vec3(0.0f, 0.0f, -110.0f), 1.0f, false },
+		{ "a cheval sur le plan lointain", glm::vec3(0.0f, 0.0f, -100.5f), 1.0f, true },
+		{ "a cheval sur le plan gauche", glm::vec3(-10.5f, 0.0f, -10.0f), 1.0f, true },
+		{ "juste hors du plan gauche", glm::vec3(-10.5f, 0.0f, -10.0f), 0.2f, false },
+		{ "sur le cote", glm::vec3(50.0f, 0.0f, -10.0f), 1.0f, false },
+	};
+	const size_t caseCount = sizeof(cases) / sizeof(cases[0]);
+
+	// tous les cas dans un lot (4 par 4 en SSE, le reste en scalaire), puis chacun seul (scalaire)
+	SphereBatch batch;
+	for(size_t c = 0; c < caseCount; ++c)
+		batch.Add(cases[c].center, cases[c].radius);
+	std::vector<uint8_t> visible;
+	CullSpheres(frustum, batch, visible);
+	for(size_t c = 0; c < caseCount; ++c)
+	{
+		SphereBatch single;
+		single.Add(cases[c].center, cases[c].radius);
+		std::vector<uint8_t> singleVisible;
+		CullSpheres(frustum, single, singleVisible);
+		double margin;
+		const bool reference = CullSphereReference(frustum, cases[c].center, cases[c].radius, margin);
+		const bool casePassed = (visible[c] != 0) == cases[c].visible && (singleVisible[0] != 0) == cases[c].visible && reference == cases[c].visible;
+		printf("    %-30s %s%s\n", cases[c].name, cases[c].visible ? "visible" : "cullee", casePassed ? "" : " ECHEC");
+		passed &= casePassed;
+	}
+
+	// spheres aleatoires autour du frustum, un nombre qui n'est pas multiple de 4. Les ecarts d'arrondi
+	// entre float et double ne sont toleres que tout pres d'un plan.
+	const size_t sphereCount = 100003;
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> position(-120.0f, 120.0f);
+	std::uniform_real_distribution<float> size(0.1f, 10.0f);
+	batch.Clear();
+	for(size_t i = 0; i < sphereCount; ++i)
+		batch.Add(glm::vec3(position(random), position(random), position(random)), size(random));
+	const size_t visibleCount = CullSpheres(frustum, batch, visible);
+	size_t mismatches = 0, referenceCount = 0;
+	for(size_t i = 0; i < sphereCount; ++i)
+	{
+		double margin;
+		const bool reference = CullSphereReference(frustum, glm::vec3(batch.centerX[i], batch.centerY[i], batch.centerZ[i]), batch.radius[i], margin);
+		referenceCount += reference;
+		if((visible[i] != 0) != reference && margin > 1.0e-4)
+			++mismatches;
+	}
+	const bool randomPassed = mismatches == 0 && visibleCount == (size_t) std::count(visible.begin(), visible.end(), 1);
+	printf("    %u spheres aleatoires : %u visibles (reference %u), %u differences%s\n", (unsigned) sphereCount, (unsigned) visibleCount,
+		   (unsigned) referenceCount, (unsigned) mismatches, randomPassed ? "" : " ECHEC");
+	passed &= randomPassed;
+
+	printf("%s\n", passed ? "OK" : "ECHEC");
+	return passed;
+}
+
+// --- Niveaux de detail ---------------------------------------------------------
+
+bool RunLodCheck()
+{
+	bool passed = true;
+	printf("Niveaux de detail : distance de Hausdorff echantillonnee et chaine de LODs\n");
+
+	// Quadrilatere plie le long de AC contre le meme plie le long de BD : memes sommets, une distance
+	// calculee sur les sommets seuls serait nulle. Le milieu de AC est a 1/sqrt(3) du plan ABD.
+	MeshData quad;
+	const float corners[] = { 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f };
+	quad.positions.assign(corners, corners + 12);
+	const uint32_t foldAC[] = { 0, 1, 2, 0, 2, 3 };
+	const uint32_t foldBD[] = { 0, 1, 3, 1, 2, 3 };
+	const std::vector<uint32_t> a(foldAC, foldAC + 6), b(foldBD, foldBD + 6);
+	const float fold = ComputeHausdorffDistance(quad, a, b);
+	const float expectedFold = 1.0f / sqrtf(3.0f);
+	const float same = ComputeHausdorffDistance(quad, a, a);
+	const bool foldPassed = fabsf(fold - expectedFold) < 1.0e-4f && same == 0.0f;
+	printf("    quadrilatere plie : %g (attendu %g), identique : %g%s\n", fold, expectedFold, same, foldPassed ? "" : " ECHEC");
+	passed &= foldPassed;
+
+	// chaine de rock.obj : nombre de triangles proche de la cible, decroissant, erreur non nulle et bornee par le mesh
+	const char* inputFile = "rock.obj";
+	MeshData mesh;
+	MeshDataSink sink(mesh);
+	std::vector<tinyobj::material_t> materials;
+	const std::string err = tinyobj::LoadObj(sink, materials, inputFile);
+	if(mesh.indices.empty())
+	{
+		printf("Impossible de charger %s : %s\n", inputFile, err.c_str());
+		return false;
+	}
+	ComputeBounds(mesh);
+
+	// les niveaux des rochers (rockLodLevels) : au-dela, les sommets verrouilles (bords, coutures) empechent d'atteindre la cible
+	const int levelCount = 4;
+	const float ratio = 0.5f;
+	std::vector<MeshLod> lods;
+	BuildLodChain(mesh, levelCount, ratio, lods);
+	const size_t triangleCount = mesh.indices.size() / 3;
+	for(int level = 0; level < levelCount; ++level)
+	{
+		const size_t triangles = lods[level].indices.size() / 3;
+		const float target = triangleCount * powf(ratio, (float) level);
+		bool levelPassed;
+		if(level == 0)
+		{
+			levelPassed = triangles == triangleCount && lods[level].error == 0.0f;
+		}
+		else
+		{
+			// une contraction retire au moins deux triangles : la cible peut etre depassee de peu
+			const float tolerance = std::max(2.0f, target * 0.1f);
+			levelPassed = fabsf(triangles - target) <= tolerance && triangles < lods[level - 1].indices.size() / 3
+						&& lods[level].error > 0.0f && lods[level].error <= 2.0f * mesh.sphereRadius;
+		}
+		printf("    %s LOD %d : %u triangles (cible %.0f), erreur %g (rayon %g)%s\n", inputFile, level, (unsigned) triangles,
+			   target, lods[level].error, mesh.sphereRadius, levelPassed ? "" : " ECHEC");
+		passed &= levelPassed;
+	}
+	printf("%s\n", passed ? "OK" : "ECHEC");
+	return passed;
+}
+
+// --- Occlusion culling ---------------------------------------------------------
+
+// pixels ou l'occulteur est devant le mesh complet (il cacherait a tort ce qui est entre les deux)
+static int CountOccluderOverhang(OcclusionCuller& culler, const glm::mat4& viewProjection, const MeshData& mesh,
+								 const std::vector<float>& occluderPositions, const std::vector<uint32_t>& occluderIndices,
+								 int& occluderPixels)
+{
+	const size_t pixelCount = (size_t) culler.GetWidth() * culler.GetHeight();
+	culler.Begin(viewProjection);
+	culler.AddOccluder(mesh.positions, mesh.indices, glm::mat4(1.0f));
+	culler.Rasterize();
+	const std::vector<float> meshDepth(culler.GetDepth(), culler.GetDepth() + pixelCount);
+	culler.Begin(viewProjection);
+	culler.AddOccluder(occluderPositions, occluderIndices, glm::mat4(1.0f));
+	culler.Rasterize();
+	const float* occluderDepth = culler.GetDepth();
+	int overhang = 0;
+	occluderPixels = 0;
+	for(size_t p = 0; p < pixelCount; ++p)
+	{
+		if(occluderDepth[p] < 1.0f)
+			++occluderPixels;
+		if(occluderDepth[p] < meshDepth[p] - 1.0e-5f)
+			++overhang;
+	}
+	return overhang;
+}
+
+bool RunOcclusionCheck()
+{
+	bool passed = true;
+	printf("Occlusion culling : cas connus et occulteur conservatif\n");
+
+	// camera a l'origine vers -z, mur de 10x10 en z = -10 face a la camera
+	OcclusionCuller culler;
+	culler.Create(320, 180);
+	const glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	const glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+	const float wallCorners[] = { -5.0f, -5.0f, -10.0f, 5.0f, -5.0f, -10.0f, 5.0f, 5.0f, -10.0f, -5.0f, 5.0f, -10.0f };
+	const uint32_t wallTriangles[] = { 0, 1, 2, 0, 2, 3 };
+	const std::vector<float> wallPositions(wallCorners, wallCorners + 12);
+	const std::vector<uint32_t> wallIndices(wallTriangles, wallTriangles + 6);
+	culler.Begin(projection * view);
+	culler.AddOccluder(wallPositions, wallIndices, glm::mat4(1.0f));
+	culler.Rasterize();
+
+	struct OcclusionCase
+	{
+		const char* name;
+		glm::vec3 center;
+		bool occluded;
+	};
+	// le bord du mur (x = 5 en z = -10) se projette en x = 10 a z = -20
+	const OcclusionCase cases[] =
+	{
+		{ "derriere le mur", glm::vec3(0.0f, 0.0f, -20.0f), true },
+		{ "derriere le mur, loin", glm::vec3(2.0f, -3.0f, -80.0f), true },
+		{ "devant le mur", glm::vec3(0.0f, 0.0f, -5.0f), false },
+		{ "derriere, a cote du mur", glm::vec3(20.0f, 0.0f, -30.0f), false },
+		{ "derriere, a cheval sur le bord", glm::vec3(10.0f, 0.0f, -20.0f), false },
+		{ "traverse le mur", glm::vec3(0.0f, 0.0f, -10.0f), false },
+	};
+	const glm::vec3 halfExtent(0.5f);
+	for(size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i)
+	{
+		const OcclusionCase& c = cases[i];
+		const bool occluded = culler.IsOccluded(c.center - halfExtent, c.center + halfExtent, glm::mat4(1.0f));
+		const bool casePassed = occluded == c.occluded;
+		printf("    %-32s : %s%s\n", c.name, occluded ? "cache" : "visible", casePassed ? "" : " ECHEC");
+		passed &= casePassed;
+	}
+
+	// l'occulteur de rock.obj (choisi et rentre de son erreur comme dans LoadOBJ) ne doit jamais etre devant le
+	// mesh complet, le niveau brut peut l'etre : il est seulement a moins de son erreur de la surface
+	const char* inputFile = "rock.obj";
+	MeshData mesh;
+	MeshDataSink sink(mesh);
+	std::vector<tinyobj::material_t> materials;
+	const std::string err = tinyobj::LoadObj(sink, materials, inputFile);
+	if(mesh.indices.empty())
+	{
+		printf("Impossible de charger %s : %s\n", inputFile, err.c_str());
+		return false;
+	}
+	ComputeBounds(mesh);
+	std::vector<MeshLod> lods;
+	BuildLodChain(mesh, 4, 0.5f, lods);
+	size_t occluderLevel = 0;
+	for(size_t level = 1; level < lods.size(); ++level)
+	{
+		if(lods[level].error <= OccluderMaxError * mesh.sphereRadius)
+			occluderLevel = level;
+	}
+	const MeshLod& occluderLod = lods[occluderLevel];
+	std::vector<float> occluderPositions;
+	std::vector<uint32_t> occluderIndices;
+	BuildConservativeOccluder(mesh.positions, &occluderLod.indices[0], occluderLod.indices.size(), occluderLod.error,
+							  occluderPositions, occluderIndices);
+	printf("    %s : occulteur du LOD %d (%u triangles, erreur %g)\n", inputFile, (int) occluderLevel,
+		   (unsigned) (occluderIndices.size() / 3), occluderLod.error);
+
+	const glm::vec3 directions[] =
+	{
+		glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f),
+		glm::vec3(0.0f, 1.0f, 0.01f), glm::vec3(0.0f, -1.0f, 0.01f), glm::vec3(1.0f, 1.0f, 1.0f), glm::vec3(-1.0f, 0.5f, -1.0f),
+	};
+	const glm::mat4 rockProjection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.01f, 100.0f * mesh.sphereRadius);
+	for(size_t i = 0; i < sizeof(directions) / sizeof(directions[0]); ++i)
+	{
+		const glm::vec3 eye = mesh.sphereCenter + glm::normalize(directions[i]) * (3.0f * mesh.sphereRadius);
+		const glm::mat4 viewProjection = rockProjection * glm::lookAt(eye, mesh.sphereCenter, glm::vec3(0.0f, 1.0f, 0.0f));
+		int rawPixels, occluderPixels, meshPixels;
+		const int rawOverhang = CountOccluderOverhang(culler, viewProjection, mesh, mesh.positions, occluderLod.indices, rawPixels);
+		const int overhang = CountOccluderOverhang(culler, viewProjection, mesh, occluderPositions, occluderIndices, occluderPixels);
+		CountOccluderOverhang(culler, viewProjection, mesh, mesh.positions, mesh.indices, meshPixels);
+		// l'occulteur doit rester utile : il couvre encore l'essentiel de la silhouette
+		const bool viewPassed = overhang == 0 && occluderPixels * 2 > meshPixels;
+		printf("    %s vue %d : occulteur %d pixels devant le mesh (niveau brut %d), couverture %d/%d%s\n", inputFile, (int) i,
+			   overhang, rawOverhang, occluderPixels, meshPixels, viewPassed ? "" : " ECHEC");
+		passed &= viewPassed;
+	}
+	printf("%s\n", passed ? "OK" : "ECHEC");
+	return passed;
+}
+
+// --- Files du pipeline de simulation -------------------------------------------
+
+// valeur echangee : tous les champs derives du meme numero, une lecture dechiree ne les verifie plus
+struct PipelineItem
+{
+	uint64_t sequence;
+	uint64_t words[7];
+
+	void Fill(uint64_t value)
+	{
+		sequence = value;
+		for(int i = 0; i < 7; ++i)
+			words[i] = value * (i + 2) + 1;
+	}
+	bool IsConsistent() const
+	{
+		for(int i = 0; i < 7; ++i)
+		{
+			if(words[i] != sequence * (i + 2) + 1)
+				return false;
+		}
+		return true;
+	}
+};
+
+bool RunPipelineCheck()
+{
+	bool passed = true;
+	printf("Pipeline de simulation : SpscQueue et TripleBuffer entre deux threads\n");
+
+	// file : tout ce qui est pousse ressort une fois, dans l'ordre et entier, meme quand elle est souvent pleine
+	{
+		const uint64_t itemCount = 2000000;
+		static SpscQueue<PipelineItem, 16> queue;
+		int fullCount = 0;
+		const BenchmarkClock::time_point start = BenchmarkClock::now();
+		std::thread producer([&fullCount, itemCount]()
+		{
+			PipelineItem item;
+			for(uint64_t value = 0; value < itemCount; ++value)
+			{
+				item.Fill(value);
+				while(!queue.Push(item))
+				{
+					++fullCount;
+					std::this_thread::yield();
+				}
+			}
+		});
+		uint64_t expected = 0, errors = 0;
+		PipelineItem item;
+		while(expected < itemCount)
+		{
+			if(!queue.Pop(item))
+			{
+				std::this_thread::yield();
+				continue;
+			}
+			if(item.sequence != expected || !item.IsConsistent())
+				++errors;
+			expected = item.sequence + 1;
+		}
+		producer.join();
+		const bool queuePassed = errors == 0 && queue.IsEmpty() && !queue.Pop(item);
+		printf("    SpscQueue<16> : %u valeurs en %.1f ms, file pleine %d fois, %u erreurs%s\n", (unsigned) itemCount,
+			   ElapsedMilliseconds(start), fullCount, (unsigned) errors, queuePassed ? "" : " ECHEC");
+		passed &= queuePassed;
+	}
+
+	// triple buffer : chaque valeur lue est entiere, plus recente que la precedente, et stable entre deux Acquire
+	{
+		const uint64_t publishCount = 2000000;
+		static TripleBuffer<PipelineItem> buffer;
+		const BenchmarkClock::time_point start = BenchmarkClock::now();
+		std::thread producer([publishCount]()
+		{
+			for(uint64_t value = 1; value <= publishCount; ++value)
+			{
+				buffer.GetWriteBuffer().Fill(value);
+				buffer.Publish();
+				// laisse le consommateur lire pendant les publications, meme sur un seul coeur
+				if(value % 256 == 0)
+					std::this_thread::yield();
+			}
+		});
+		uint64_t last = 0, acquired = 0, errors = 0;
+		while(last < publishCount)
+		{
+			if(!buffer.Acquire())
+			{
+				// rien de nouveau : la valeur lue ne doit pas bouger
+				if(acquired > 0 && buffer.GetReadBuffer().sequence != last)
+					++errors;
+				std::this_thread::yield();
+				continue;
+			}
+			const PipelineItem& item = buffer.GetReadBuffer();
+			if(item.sequence <= last || !item.IsConsistent())
+				++errors;
+			last = item.sequence;
+			++acquired;
+		}
+		producer.join();
+		const bool bufferPassed = errors == 0 && !buffer.Acquire();
+		printf("    TripleBuffer : %u publications en %.1f ms, %u lues, %u erreurs%s\n", (unsigned) publishCount,
+			   ElapsedMilliseconds(start), (unsigned) acquired, (unsigned) errors, bufferPassed ? "" : " ECHEC");
+		passed &= bufferPassed;
+	}
+	printf("%s\n", passed ? "OK" : "ECHEC");
+	return passed;
+}
+
+// --- Ordonnanceur de jobs ------------------------------------------------------
+
+// Arbre binaire complet : chaque noeud lance un fils en job, descend dans l'autre puis attend le premier
+static void ForkJoinNode(int depth, std::atomic<int>& leaves)
+{
+	if(depth == 0)
+	{
+		leaves.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	JobCounter counter;
+	RunJob([depth, &leaves]() { ForkJoinNode(depth - 1, leaves); }, counter);
+	ForkJoinNode(depth - 1, leaves);
+	WaitForCounter(counter);
+}
+
+// Meme arbre sans attente intermediaire : les fils sont des enfants du job courant, seule la racine attend
+static void ChildJobNode(int depth, std::atomic<int>& leaves)
+{
+	if(depth == 0)
+	{
+		leaves.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	RunChildJob([depth, &leaves]() { ChildJobNode(depth - 1, leaves); });
+	RunChildJob([depth, &leaves]() { ChildJobNode(depth - 1, leaves); });
+}
+
+static inline float ParallelForKernel(float value)
+{
+	return std::sqrt(value) * std::sin(value) + std::cos(value * 0.5f);
+}
+
+bool RunJobSystemBenchmark()
+{
+	const int batchCount = 200, batchSize = 512;
+	const int treeDepth = 16;
+	const size_t elementCount = 1000000;
+	const int repeatCount = 5;
+
+	printf("JobSystem : deques de Chase-Lev, %u threads de travail + le thread appelant\n", GetJobWorkerCount());
+
+	std::mt19937 generator(42);
+	std::uniform_real_distribution<float> distribution(0.0f, 100.0f);
+	std::vector<float> values(elementCount), expected(elementCount), results(elementCount);
+	for(size_t i = 0; i < elementCount; ++i)
+		values[i] = distribution(generator);
+	double serialTime = DBL_MAX;
+	for(int repeat = 0; repeat < repeatCount; ++repeat)
+	{
+		const BenchmarkClock::time_point start = BenchmarkClock::now();
+		for(size_t i = 0; i < elementCount; ++i)
+			expected[i] = ParallelForKernel(values[i]);
+		serialTime = std::min(serialTime, ElapsedMilliseconds(start));
+	}
+	printf("    boucle simple sur %u elements : %.3f ms\n", (unsigned) elementCount, serialTime);
+
+	bool passed = true;
+
+	std::vector<unsigned int> threadCounts;
+	for(unsigned int count = 1; count < GetWorkerCount(); count *= 2)
+		threadCounts.push_back(count);
+	threadCounts.push_back(GetWorkerCount());
+
+	for(size_t test = 0; test < threadCounts.size(); ++test)
+	{
+		const unsigned int threads = threadCounts[test];
+		SetActiveJobWorkers(threads - 1);
+
+		// meilleur temps sur repeatCount essais, verification a chaque essai
+		double emptyTime = DBL_MAX, forkJoinTime = DBL_MAX, childTime = DBL_MAX, parallelForTime = DBL_MAX;
+		bool correct = true;
+		for(int repeat = 0; repeat < repeatCount; ++repeat)
+		{
+			BenchmarkClock::time_point start = BenchmarkClock::now();
+			for(int batch = 0; batch < batchCount; ++batch)
+			{
+				JobCounter counter;
+				for(int i = 0; i < batchSize; ++i)
+					RunJob([]() {}, counter);
+				WaitForCounter(counter);
+			}
+			emptyTime = std::min(emptyTime, ElapsedMilliseconds(start));
+
+			std::atomic<int> leaves(0);
+			start = BenchmarkClock::now();
+			ForkJoinNode(treeDepth, leaves);
+			forkJoinTime = std::min(forkJoinTime, ElapsedMilliseconds(start));
+			correct &= leaves.load() == (1 << treeDepth);
+
+			leaves = 0;
+			start = BenchmarkClock::now();
+			JobCounter root;
+			RunJob([&leaves]() { ChildJobNode(treeDepth, leaves); }, root);
+			WaitForCounter(root);
+			childTime = std::min(childTime, ElapsedMilliseconds(start));
+			correct &= leaves.load() == (1 << treeDepth);
+
+			std::fill(results.begin(), results.end(), 0.0f);
+			start = BenchmarkClock::now();
+			ParallelFor(elementCount, [&](size_t i) { results[i] = ParallelForKernel(values[i]); }, threads);
+			parallelForTime = std::min(parallelForTime, ElapsedMilliseconds(start));
+			correct &= results == expected;
+		}
+
+		printf("    %2u threads : jobs vides %6.0f ns/job, fork-join %7.3f ms, enfants %7.3f ms (%d feuilles), "
+			   "ParallelFor %7.3f ms (x%.2f)%s\n", threads, emptyTime * 1.0e6 / (batchCount * batchSize),
+			   forkJoinTime, childTime, 1 << treeDepth, parallelForTime, serialTime / parallelForTime, correct ? "" : " RESULTATS FAUX");
+		passed &= correct;
+	}
+	SetActiveJobWorkers(GetJobWorkerCount());
+	printf("%s\n", passed ? "OK" : "ECHEC");
+	return passed;
+}
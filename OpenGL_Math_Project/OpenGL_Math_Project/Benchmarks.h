@@ -0,0 +1,57 @@
+#ifndef __BENCHMARKS_H__
+#define __BENCHMARKS_H__
+
+#include <vector>
+#include <cstddef>
+
+#include "glm/glm.hpp"
+
+// Benchmarks CPU lances depuis la ligne de commande (voir main), ils n'ont pas besoin de contexte OpenGL.
+// Chaque benchmark verifie aussi ses resultats contre une version force brute.
+
+// --bvh-bench : arbre d'AABB dynamique a 1k, 100k et 1M objets (insertion, refit, requetes)
+void RunDynamicBvhBenchmark();
+
+// --pick-bench : BVH de triangles de Dwarf_2_Low.obj (construction, rayons aleatoires de picking)
+void RunTriangleBvhBenchmark();
+
+// --raster-bench : rasteriseur logiciel sur la scene de la spirale (rock.obj, matrices monde et camera
+// fournies par main), en 1280x720 avec 1, 2, 4... threads jusqu'au nombre de coeurs
+void RunSoftwareRasterizerBenchmark(const std::vector<glm::mat4>& instances, const glm::mat4& viewMatrix,
+									const glm::mat4& projectionMatrix, const glm::vec3& lightDirection);
+
+// --trace-bench : lanceur de rayons de reference sur la meme scene avec la skybox (faces dans skyboxFiles),
+// rayons un par un contre paquets de 8, avec et sans ombres. L'image est ecrite dans reference.png
+void RunRayTracerBenchmark(const std::vector<glm::mat4>& instances, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix,
+						   const glm::vec3& lightDirection, const char* skyboxFiles[]);
+
+// --obj-bench : chargement OBJ par tinyobj::LoadObj en shape_t (ancien chemin de LoadOBJ) contre le MeshSink
+// en flux, sur les OBJ du projet et une grille generee de 500k triangles : temps et pic memoire
+void RunObjLoaderBenchmark();
+
+// --cull-check : frustum culling sur des cas connus (derriere la camera, au-dela du plan lointain, a cheval
+// sur un plan, sur le cote) et chemin SSE de CullSpheres contre une reference scalaire. Retourne false si une
+// verification echoue
+bool RunCullingCheck();
+
+// --lod-check : distance de Hausdorff sur un cas connu et chaine de LODs de rock.obj (nombre de triangles
+// par niveau, erreur bornee). Retourne false si une verification echoue
+bool RunLodCheck();
+
+// --occlusion-check : occlusion culling derriere un mur sur des cas connus (cache, devant, a cote, a cheval sur
+// le bord) et occulteur conservatif de rock.obj jamais devant le mesh complet, sous plusieurs angles. Retourne
+// false si une verification echoue
+bool RunOcclusionCheck();
+
+// --pipeline-check : SpscQueue et TripleBuffer du thread de simulation entre un producteur et un consommateur
+// (ordre, valeurs jamais dechirees ni perdues dans la file, valeurs toujours plus recentes dans le triple
+// buffer). Retourne false si une verification echoue
+bool RunPipelineCheck();
+
+// --job-bench : ordonnanceur de jobs avec 1, 2, 4... threads jusqu'au nombre de coeurs : jobs vides, arbre
+// fork-join de 2^16 feuilles (attente a chaque noeud, puis enfants d'un seul compteur), ParallelFor sur 1M
+// elements compare a une boucle simple. Retourne false si un resultat est faux (verification sous
+// ThreadSanitizer : common/JobSystemCheck.cpp)
+bool RunJobSystemBenchmark();
+
+#endif //__BENCHMARKS_H__
@@ -0,0 +1,119 @@
+#include "Culling.h"
+
+#include <cmath>
+#include <algorithm>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE__)
+#define CULLING_USE_SSE 1
+#include <xmmintrin.h>
+#endif
+
+void ExtractFrustumPlanes(const glm::mat4& viewProjection, Frustum& frustum)
+{
+	// glm est en colonnes : la ligne i de la matrice est (m[0][i], m[1][i], m[2][i], m[3][i])
+	const glm::mat4& m = viewProjection;
+	const glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+	const glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+	const glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+	const glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+	// -w <= x, y, z <= w en coordonnees de clipping
+	frustum.planes[0] = row3 + row0;
+	frustum.planes[1] = row3 - row0;
+	frustum.planes[2] = row3 + row1;
+	frustum.planes[3] = row3 - row1;
+	frustum.planes[4] = row3 + row2;
+	frustum.planes[5] = row3 - row2;
+
+	// normalisation pour que a.x + b.y + c.z + d soit une distance signee
+	for(int i = 0; i < 6; ++i)
+		frustum.planes[i] /= glm::length(glm::vec3(frustum.planes[i]));
+}
+
+void TransformSphere(const glm::mat4& worldMatrix, const glm::vec3& center, float radius,
+					 glm::vec3& worldCenter, float& worldRadius)
+{
+	worldCenter = glm::vec3(worldMatrix * glm::vec4(center, 1.0f));
+	const float scale2 = std::max(glm::dot(glm::vec3(worldMatrix[0]), glm::vec3(worldMatrix[0])),
+						 std::max(glm::dot(glm::vec3(worldMatrix[1]), glm::vec3(worldMatrix[1])),
+								  glm::dot(glm::vec3(worldMatrix[2]), glm::vec3(worldMatrix[2]))));
+	worldRadius = radius * sqrtf(scale2);
+}
+
+void SphereBatch::Clear()
+{
+	centerX.clear();
+	centerY.clear();
+	centerZ.clear();
+	radius.clear();
+}
+
+void SphereBatch::Add(const glm::vec3& center, float r)
+{
+	centerX.push_back(center.x);
+	centerY.push_back(center.y);
+	centerZ.push_back(center.z);
+	radius.push_back(r);
+}
+
+size_t CullSpheres(const Frustum& frustum, const SphereBatch& spheres, std::vector<uint8_t>& visible)
+{
+	const size_t count = spheres.GetCount();
+	visible.resize(count);
+
+	size_t visibleCount = 0;
+	size_t i = 0;
+
+#ifdef CULLING_USE_SSE
+	// chaque composante des 6 plans est repliquee dans un registre, on teste 4 spheres par iteration
+	__m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+	for(int p = 0; p < 6; ++p)
+	{
+		planeX[p] = _mm_set1_ps(frustum.planes[p].x);
+		planeY[p] = _mm_set1_ps(frustum.planes[p].y);
+		planeZ[p] = _mm_set1_ps(frustum.planes[p].z);
+		planeW[p] = _mm_set1_ps(frustum.planes[p].w);
+	}
+
+	for(; i + 4 <= count; i += 4)
+	{
+		const __m128 x = _mm_loadu_ps(&spheres.centerX[i]);
+		const __m128 y = _mm_loadu_ps(&spheres.centerY[i]);
+		const __m128 z = _mm_loadu_ps(&spheres.centerZ[i]);
+		const __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&spheres.radius[i]));
+
+		// une sphere est rejetee des que sa distance a un plan est inferieure a -rayon
+		__m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[0], x), _mm_mul_ps(planeY[0], y)),
+												_mm_add_ps(_mm_mul_ps(planeZ[0], z), planeW[0])), negativeRadius);
+		for(int p = 1; p < 6; ++p)
+		{
+			const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], x), _mm_mul_ps(planeY[p], y)),
+											   _mm_add_ps(_mm_mul_ps(planeZ[p], z), planeW[p]));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+		}
+
+		const int mask = _mm_movemask_ps(inside);
+		for(int lane = 0; lane < 4; ++lane)
+		{
+			visible[i + lane] = (mask >> lane) & 1;
+			visibleCount += visible[i + lane];
+		}
+	}
+#endif
+
+	// reste (ou tout le tableau sans SSE)
+	for(; i < count; ++i)
+	{
+		const glm::vec3 center(spheres.centerX[i], spheres.centerY[i], spheres.centerZ[i]);
+		uint8_t inside = 1;
+		for(int p = 0; p < 6 && inside; ++p)
+		{
+			if(glm::dot(glm::vec3(frustum.planes[p]), center) + frustum.planes[p].w < -spheres.radius[i])
+				inside = 0;
+		}
+		visible[i] = inside;
+		visibleCount += inside;
+	}
+
+	return visibleCount;
+}
@@ -0,0 +1,41 @@
+#ifndef __CULLING_H__
+#define __CULLING_H__
+
+#include <vector>
+#include <cstdint>
+
+#include "glm/glm.hpp"
+
+// Les 6 plans du frustum (gauche, droite, bas, haut, proche, lointain) sous la forme
+// a.x + b.y + c.z + d, normalises et orientes vers l'interieur, en repere monde
+struct Frustum
+{
+	glm::vec4 planes[6];
+};
+
+// Extraction de Gribb & Hartmann a partir de projection * vue
+void ExtractFrustumPlanes(const glm::mat4& viewProjection, Frustum& frustum);
+
+// Sphere locale -> sphere monde (le rayon suit la plus grande echelle de la matrice)
+void TransformSphere(const glm::mat4& worldMatrix, const glm::vec3& center, float radius,
+					 glm::vec3& worldCenter, float& worldRadius);
+
+// Spheres englobantes en SoA : chaque composante dans son propre tableau
+// pour tester 4 spheres a la fois avec SSE
+struct SphereBatch
+{
+	std::vector<float> centerX;
+	std::vector<float> centerY;
+	std::vector<float> centerZ;
+	std::vector<float> radius;
+
+	void Clear();
+	void Add(const glm::vec3& center, float r);
+	inline size_t GetCount() const { return radius.size(); }
+};
+
+// visible[i] = 1 si la sphere i coupe ou est dans le frustum, 0 sinon.
+// Retourne le nombre de spheres visibles.
+size_t CullSpheres(const Frustum& frustum, const SphereBatch& spheres, std::vector<uint8_t>& visible);
+
+#endif //__CULLING_H__
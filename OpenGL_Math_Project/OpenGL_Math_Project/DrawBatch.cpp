@@ -0,0 +1,179 @@
+#include "DrawBatch.h"
+
+#include <algorithm>
+
+bool DrawBatch::IsMultiDrawSupported()
+{
+	return GLEW_VERSION_4_3 || GLEW_ARB_multi_draw_indirect;
+}
+
+bool DrawBatch::IsBaseInstanceSupported()
+{
+	return GLEW_VERSION_4_2 || GLEW_ARB_base_instance;
+}
+
+void DrawBatch::Create(size_t capacity)
+{
+	glGenBuffers(1, &m_DrawIndexBuffer);
+	glGenBuffers(1, &m_IndirectBuffer);
+	glGenBuffers(1, &m_DrawDataBuffer);
+
+	glGenTextures(1, &m_DrawDataTexture);
+	glBindTexture(GL_TEXTURE_BUFFER, m_DrawDataTexture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_DrawDataBuffer);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+	m_Draws.reserve(capacity);
+	m_Commands.reserve(capacity);
+	m_DrawData.reserve(capacity);
+	ReserveDrawIndices(capacity);
+}
+
+void DrawBatch::Destroy()
+{
+	if(m_DrawDataTexture)
+		glDeleteTextures(1, &m_DrawDataTexture);
+	if(m_DrawIndexBuffer)
+		glDeleteBuffers(1, &m_DrawIndexBuffer);
+	if(m_IndirectBuffer)
+		glDeleteBuffers(1, &m_IndirectBuffer);
+	if(m_DrawDataBuffer)
+		glDeleteBuffers(1, &m_DrawDataBuffer);
+	m_DrawDataTexture = m_DrawIndexBuffer = m_IndirectBuffer = m_DrawDataBuffer = 0;
+	m_DrawIndexCapacity = 0;
+}
+
+void DrawBatch::ReserveDrawIndices(size_t count)
+{
+	if(count <= m_DrawIndexCapacity)
+		return;
+
+	// le nom du buffer ne change pas : les VAO qui le referencent restent valides
+	m_DrawIndexCapacity = std::max(count, m_DrawIndexCapacity * 2);
+	std::vector<GLuint> indices(m_DrawIndexCapacity);
+	for(size_t i = 0; i < indices.size(); ++i)
+		indices[i] = (GLuint) i;
+	glBindBuffer(GL_ARRAY_BUFFER, m_DrawIndexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, indices.size() * sizeof(GLuint), &indices[0], GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void DrawBatch::Clear()
+{
+	m_Draws.clear();
+	m_DrawData.clear();
+}
+
+void DrawBatch::Add(const MeshArena& arena, MeshArena::Handle allocation, GLenum indexType,
+					GLuint firstIndex, GLuint indexCount, const DrawData& data)
+{
+	const MeshArena::Allocation& range = arena.Get(allocation);
+	const size_t indexSize = (indexType == GL_UNSIGNED_SHORT) ? sizeof(uint16_t) : sizeof(uint32_t);
+
+	Draw draw;
+	draw.arena = &arena;
+	draw.indexType = indexType;
+	draw.command.count = indexCount;
+	draw.command.instanceCount = 1;
+	// les plages de l'arena sont alignees sur 4 octets, la division est donc exacte
+	draw.command.firstIndex = (GLuint) (range.indexOffset / indexSize) + firstIndex;
+	draw.command.baseVertex = range.baseVertex;
+	draw.command.baseInstance = (GLuint) m_DrawData.size();
+	m_Draws.push_back(draw);
+	m_DrawData.push_back(data);
+}
+
+void DrawBatch::Submit(GLenum mode, GLuint drawDataUnit, bool multiDraw)
+{
+	m_SubmitCount = m_SubmitTriangles = m_SubmitBinds = m_SubmitUploadBytes = 0;
+	if(m_Draws.empty())
+		return;
+
+	ReserveDrawIndices(m_Draws.size());
+	multiDraw = multiDraw && IsMultiDrawSupported();
+	const bool baseInstance = IsBaseInstanceSupported();
+
+	// un appel indirect ne peut melanger ni les VAO ni les types d'index : on regroupe les draws,
+	// l'ordre est conserve dans chaque groupe et baseInstance suit le draw
+	std::stable_sort(m_Draws.begin(), m_Draws.end(), [](const Draw& a, const Draw& b) {
+		return (a.arena != b.arena) ? (a.arena < b.arena) : (a.indexType < b.indexType);
+	});
+	m_Commands.resize(m_Draws.size());
+	for(size_t i = 0; i < m_Draws.size(); ++i)
+		m_Commands[i] = m_Draws[i].command;
+
+	// orphelinage : le driver fournit un nouveau stockage sans attendre les draws de la frame precedente
+	glBindBuffer(GL_TEXTURE_BUFFER, m_DrawDataBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, m_DrawData.size() * sizeof(DrawData), nullptr, GL_STREAM_DRAW);
+	glBufferSubData(GL_TEXTURE_BUFFER, 0, m_DrawData.size() * sizeof(DrawData), &m_DrawData[0]);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	glActiveTexture(GL_TEXTURE0 + drawDataUnit);
+	glBindTexture(GL_TEXTURE_BUFFER, m_DrawDataTexture);
+	glActiveTexture(GL_TEXTURE0);
+	m_SubmitBinds = 1;
+	m_SubmitUploadBytes = m_DrawData.size() * sizeof(DrawData);
+
+	if(multiDraw)
+	{
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_IndirectBuffer);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, m_Commands.size() * sizeof(DrawElementsIndirectCommand), nullptr, GL_STREAM_DRAW);
+		glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, m_Commands.size() * sizeof(DrawElementsIndirectCommand), &m_Commands[0]);
+		m_SubmitUploadBytes += m_Commands.size() * sizeof(DrawElementsIndirectCommand);
+	}
+	if(mode == GL_TRIANGLES)
+	{
+		for(size_t i = 0; i < m_Commands.size(); ++i)
+			m_SubmitTriangles += m_Commands[i].count / 3;
+	}
+
+	size_t begin = 0;
+	while(begin < m_Draws.size())
+	{
+		const MeshArena* arena = m_Draws[begin].arena;
+		const GLenum indexType = m_Draws[begin].indexType;
+		size_t end = begin + 1;
+		while(end < m_Draws.size() && m_Draws[end].arena == arena && m_Draws[end].indexType == indexType)
+			++end;
+
+		glBindVertexArray(arena->GetVAO());
+		++m_SubmitBinds;
+		if(multiDraw)
+		{
+			glMultiDrawElementsIndirect(mode, indexType, (GLvoid*) (begin * sizeof(DrawElementsIndirectCommand)),
+										(GLsizei) (end - begin), 0);
+			++m_SubmitCount;
+		}
+		else
+		{
+			const size_t indexSize = (indexType == GL_UNSIGNED_SHORT) ? sizeof(uint16_t) : sizeof(uint32_t);
+			if(!baseInstance)
+			{
+				// sans GL 4.2 l'index de draw est passe comme valeur constante de l'attribut
+				glDisableVertexAttribArray(DrawIndexLocation);
+			}
+			for(size_t i = begin; i < end; ++i)
+			{
+				const DrawElementsIndirectCommand& command = m_Commands[i];
+				const GLvoid* offset = (GLvoid*) (command.firstIndex * indexSize);
+				if(baseInstance)
+				{
+					glDrawElementsInstancedBaseVertexBaseInstance(mode, command.count, indexType, offset,
+																  command.instanceCount, command.baseVertex, command.baseInstance);
+				}
+				else
+				{
+					glVertexAttribI1ui(DrawIndexLocation, command.baseInstance);
+					glDrawElementsBaseVertex(mode, command.count, indexType, offset, command.baseVertex);
+				}
+			}
+			if(!baseInstance)
+				glEnableVertexAttribArray(DrawIndexLocation);
+			m_SubmitCount += end - begin;
+		}
+		begin = end;
+	}
+
+	if(multiDraw)
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
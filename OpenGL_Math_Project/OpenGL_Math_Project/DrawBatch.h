@@ -0,0 +1,91 @@
+#ifndef __DRAW_BATCH_H__
+#define __DRAW_BATCH_H__
+
+#include <vector>
+#include <cstdint>
+
+#include "Common.h"
+#include "MeshArena.h"
+
+// Format impose par glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand
+{
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;		// en indices (pas en octets) depuis le debut de l'IBO
+	GLint baseVertex;
+	GLuint baseInstance;	// sert d'index de draw : il est transmis au shader par l'attribut a_drawIndex
+};
+
+// Donnees par draw lues par le vertex shader dans le texture buffer u_drawData (7 texels RGBA32F)
+struct DrawData
+{
+	glm::mat4 worldMatrix;
+	glm::vec4 positionScale;	// w = 1 si les normales sont encodees en octaedre
+	glm::vec4 positionOffset;	// w = couche du tableau de textures (TextureAtlas)
+	glm::vec4 texcoordTransform;	// uv atlas = clamp(uv, 0, 1) * xy + zw, (1, 1, 0, 0) hors atlas
+};
+
+// Liste de draws construite chaque frame sur le CPU puis envoyee en un glMultiDrawElementsIndirect
+// par arena et par type d'index (un seul appel pour toute la scene si tout partage le meme format).
+// Le shader retrouve ses donnees grace a baseInstance : l'attribut instancie a_drawIndex (location 3,
+// divisor 1) lit un buffer 0, 1, 2... et vaut donc baseInstance pour l'unique instance du draw.
+class DrawBatch
+{
+public:
+	static const GLuint DrawIndexLocation = 3;
+	static const GLuint TexelsPerDraw = sizeof(DrawData) / (4 * sizeof(float));
+
+	DrawBatch() : m_DrawIndexBuffer(0), m_DrawIndexCapacity(0), m_IndirectBuffer(0), m_DrawDataBuffer(0)
+				, m_DrawDataTexture(0), m_SubmitCount(0), m_SubmitTriangles(0), m_SubmitBinds(0), m_SubmitUploadBytes(0) {}
+
+	void Create(size_t capacity);
+	void Destroy();
+
+	// le buffer d'index de draw doit etre attache au VAO de chaque arena (MeshArena::SetDrawIndexBuffer)
+	inline GLuint GetDrawIndexBuffer() const { return m_DrawIndexBuffer; }
+
+	void Clear();
+	void Add(const MeshArena& arena, MeshArena::Handle allocation, GLenum indexType,
+			 GLuint firstIndex, GLuint indexCount, const DrawData& data);
+
+	// multiDraw = false : un appel par draw (chemin de reference et de repli sans GL 4.3)
+	void Submit(GLenum mode, GLuint drawDataUnit, bool multiDraw = true);
+
+	inline size_t GetDrawCount() const { return m_Draws.size(); }
+	// nombre d'appels de dessin emis par le dernier Submit
+	inline size_t GetSubmitCount() const { return m_SubmitCount; }
+	// triangles (mode GL_TRIANGLES), liaisons (VAO et texture buffer) et octets envoyes par le dernier Submit
+	inline size_t GetSubmitTriangles() const { return m_SubmitTriangles; }
+	inline size_t GetSubmitBinds() const { return m_SubmitBinds; }
+	inline size_t GetSubmitUploadBytes() const { return m_SubmitUploadBytes; }
+
+	static bool IsMultiDrawSupported();
+	static bool IsBaseInstanceSupported();
+
+private:
+	struct Draw
+	{
+		const MeshArena* arena;
+		GLenum indexType;
+		DrawElementsIndirectCommand command;
+	};
+
+	void ReserveDrawIndices(size_t count);
+
+	std::vector<Draw> m_Draws;
+	std::vector<DrawElementsIndirectCommand> m_Commands;
+	std::vector<DrawData> m_DrawData;
+
+	GLuint m_DrawIndexBuffer;
+	size_t m_DrawIndexCapacity;
+	GLuint m_IndirectBuffer;
+	GLuint m_DrawDataBuffer;
+	GLuint m_DrawDataTexture;
+	size_t m_SubmitCount;
+	size_t m_SubmitTriangles;
+	size_t m_SubmitBinds;
+	size_t m_SubmitUploadBytes;
+};
+
+#endif //__DRAW_BATCH_H__
@@ -0,0 +1,453 @@
+#include "DynamicBvh.h"
+
+#include "Parallel.h"
+
+Aabb TransformAabb(const Aabb& box, const glm::mat4& matrix)
+{
+	// Arvo : chaque colonne de la matrice contribue a min ou a max selon son signe
+	const glm::vec3 translation(matrix[3]);
+	Aabb result(translation, translation);
+	for(int column = 0; column < 3; ++column)
+	{
+		const glm::vec3 axis(matrix[column]);
+		const glm::vec3 a = axis * box.min[column];
+		const glm::vec3 b = axis * box.max[column];
+		result.min += glm::min(a, b);
+		result.max += glm::max(a, b);
+	}
+	return result;
+}
+
+// --- Gestion des noeuds ----------------------------------------------------
+
+void DynamicBvh::Clear()
+{
+	m_Nodes.clear();
+	m_Root = NullNode;
+	m_FreeList = NullNode;
+	m_LeafCount = 0;
+}
+
+int DynamicBvh::AllocateNode()
+{
+	int node;
+	if(m_FreeList != NullNode)
+	{
+		node = m_FreeList;
+		m_FreeList = m_Nodes[node].parent;
+	}
+	else
+	{
+		node = (int) m_Nodes.size();
+		m_Nodes.push_back(Node());
+	}
+	m_Nodes[node].parent = NullNode;
+	m_Nodes[node].child1 = NullNode;
+	m_Nodes[node].child2 = NullNode;
+	m_Nodes[node].height = 0;
+	m_Nodes[node].userData = -1;
+	return node;
+}
+
+void DynamicBvh::FreeNode(int node)
+{
+	m_Nodes[node].parent = m_FreeList;
+	m_Nodes[node].height = -1;
+	m_FreeList = node;
+}
+
+int DynamicBvh::CreateProxy(const Aabb& box, int userData)
+{
+	const int proxy = AllocateNode();
+	m_Nodes[proxy].box = box;
+	m_Nodes[proxy].userData = userData;
+	InsertLeaf(proxy);
+	++m_LeafCount;
+	return proxy;
+}
+
+void DynamicBvh::DestroyProxy(int proxy)
+{
+	RemoveLeaf(proxy);
+	FreeNode(proxy);
+	--m_LeafCount;
+}
+
+void DynamicBvh::UpdateNode(int node)
+{
+	Node& n = m_Nodes[node];
+	n.box = Aabb::Union(m_Nodes[n.child1].box, m_Nodes[n.child2].box);
+	n.height = 1 + std::max(m_Nodes[n.child1].height, m_Nodes[n.child2].height);
+}
+
+// --- Insertion / suppression -----------------------------------------------
+
+void DynamicBvh::InsertLeaf(int leaf)
+{
+	if(m_Root == NullNode)
+	{
+		m_Root = leaf;
+		m_Nodes[leaf].parent = NullNode;
+		return;
+	}
+
+	// descente gloutonne : a chaque niveau on compare le cout de creer ici un nouveau parent
+	// (2 x aire de l'union) au cout minimal de descendre dans chacun des enfants.
+	// Le cout d'heritage est l'augmentation d'aire imposee a tous les ancetres.
+	const Aabb& leafBox = m_Nodes[leaf].box;
+	int index = m_Root;
+	while(!m_Nodes[index].IsLeaf())
+	{
+		const Node& node = m_Nodes[index];
+		const float area = node.box.SurfaceArea();
+		const float combinedArea = Aabb::Union(node.box, leafBox).SurfaceArea();
+		const float cost = 2.0f * combinedArea;
+		const float inheritanceCost = 2.0f * (combinedArea - area);
+
+		float childCost[2];
+		const int children[2] = { node.child1, node.child2 };
+		for(int i = 0; i < 2; ++i)
+		{
+			const Node& child = m_Nodes[children[i]];
+			const float unionArea = Aabb::Union(child.box, leafBox).SurfaceArea();
+			childCost[i] = (child.IsLeaf() ? unionArea : unionArea - child.box.SurfaceArea()) + inheritanceCost;
+		}
+
+		if(cost < childCost[0] && cost < childCost[1])
+			break;
+		index = (childCost[0] < childCost[1]) ? node.child1 : node.child2;
+	}
+
+	const int sibling = index;
+	const int oldParent = m_Nodes[sibling].parent;
+	const int newParent = AllocateNode();
+	m_Nodes[newParent].parent = oldParent;
+	m_Nodes[newParent].child1 = sibling;
+	m_Nodes[newParent].child2 = leaf;
+	m_Nodes[sibling].parent = newParent;
+	m_Nodes[leaf].parent = newParent;
+
+	if(oldParent != NullNode)
+	{
+		if(m_Nodes[oldParent].child1 == sibling)
+			m_Nodes[oldParent].child1 = newParent;
+		else
+			m_Nodes[oldParent].child2 = newParent;
+	}
+	else
+	{
+		m_Root = newParent;
+	}
+
+	// remontee : boites, hauteurs et rotations locales
+	for(index = newParent; index != NullNode; index = m_Nodes[index].parent)
+	{
+		UpdateNode(index);
+		Rotate(index);
+	}
+}
+
+void DynamicBvh::RemoveLeaf(int leaf)
+{
+	if(leaf == m_Root)
+	{
+		m_Root = NullNode;
+		return;
+	}
+
+	// le frere remplace le parent
+	const int parent = m_Nodes[leaf].parent;
+	const int grandParent = m_Nodes[parent].parent;
+	const int sibling = (m_Nodes[parent].child1 == leaf) ? m_Nodes[parent].child2 : m_Nodes[parent].child1;
+
+	if(grandParent != NullNode)
+	{
+		if(m_Nodes[grandParent].child1 == parent)
+			m_Nodes[grandParent].child1 = sibling;
+		else
+			m_Nodes[grandParent].child2 = sibling;
+		m_Nodes[sibling].parent = grandParent;
+		FreeNode(parent);
+
+		for(int index = grandParent; index != NullNode; index = m_Nodes[index].parent)
+		{
+			UpdateNode(index);
+			Rotate(index);
+		}
+	}
+	else
+	{
+		m_Root = sibling;
+		m_Nodes[sibling].parent = NullNode;
+		FreeNode(parent);
+	}
+}
+
+// --- Rotations -------------------------------------------------------------
+
+// Pour un noeud A d'enfants B et C, on essaie d'echanger B avec un enfant de C ou C avec un enfant
+// de B. Les feuilles sous A ne changent pas (la boite de A non plus), seule l'aire de l'enfant
+// modifie varie : on garde la rotation qui la reduit le plus.
+void DynamicBvh::Rotate(int node)
+{
+	const Node& a = m_Nodes[node];
+	if(a.IsLeaf())
+		return;
+
+	const int b = a.child1, c = a.child2;
+	float bestGain = 0.0f;
+	int bestSwapOut = NullNode, bestSwapIn = NullNode, bestTarget = NullNode;
+
+	// target = enfant interne dont un petit-enfant est echange avec l'autre enfant (other)
+	const int targets[2] = { c, b };
+	const int others[2] = { b, c };
+	for(int i = 0; i < 2; ++i)
+	{
+		const Node& target = m_Nodes[targets[i]];
+		if(target.IsLeaf())
+			continue;
+		const float area = target.box.SurfaceArea();
+		const Aabb& otherBox = m_Nodes[others[i]].box;
+
+		// other <-> target.child1 : target contient alors other et child2
+		float gain = area - Aabb::Union(otherBox, m_Nodes[target.child2].box).SurfaceArea();
+		if(gain > bestGain)
+		{
+			bestGain = gain;
+			bestTarget = targets[i];
+			bestSwapOut = others[i];
+			bestSwapIn = target.child1;
+		}
+		gain = area - Aabb::Union(otherBox, m_Nodes[target.child1].box).SurfaceArea();
+		if(gain > bestGain)
+		{
+			bestGain = gain;
+			bestTarget = targets[i];
+			bestSwapOut = others[i];
+			bestSwapIn = target.child2;
+		}
+	}
+
+	if(bestTarget == NullNode)
+		return;
+
+	// bestSwapOut (enfant de node) prend la place de bestSwapIn (enfant de bestTarget) et inversement
+	Node& n = m_Nodes[node];
+	if(n.child1 == bestSwapOut)
+		n.child1 = bestSwapIn;
+	else
+		n.child2 = bestSwapIn;
+	Node& t = m_Nodes[bestTarget];
+	if(t.child1 == bestSwapIn)
+		t.child1 = bestSwapOut;
+	else
+		t.child2 = bestSwapOut;
+	m_Nodes[bestSwapIn].parent = node;
+	m_Nodes[bestSwapOut].parent = bestTarget;
+
+	UpdateNode(bestTarget);
+	UpdateNode(node);
+}
+
+// --- Refit -----------------------------------------------------------------
+
+void DynamicBvh::Refit(bool rotate)
+{
+	if(m_Root == NullNode)
+		return;
+
+	// parcours post-ordre iteratif : un noeud est traite apres ses deux enfants
+	std::vector<int>& stack = m_RefitStack;
+	std::vector<int>& order = m_RefitOrder;
+	stack.clear();
+	order.clear();
+	stack.reserve(m_Nodes.size());
+	order.reserve(m_Nodes.size());
+	stack.push_back(m_Root);
+	while(!stack.empty())
+	{
+		const int index = stack.back();
+		stack.pop_back();
+		const Node& node = m_Nodes[index];
+		if(node.IsLeaf())
+			continue;
+		order.push_back(index);
+		stack.push_back(node.child1);
+		stack.push_back(node.child2);
+	}
+
+	// order est en pre-ordre : parcouru a l'envers, les enfants passent avant leur parent
+	for(size_t i = order.size(); i-- > 0;)
+	{
+		UpdateNode(order[i]);
+		if(rotate)
+			Rotate(order[i]);
+	}
+}
+
+// --- Requetes --------------------------------------------------------------
+
+void DynamicBvh::QueryFrustum(const Frustum& frustum, std::vector<int>& results) const
+{
+	if(m_Root == NullNode)
+		return;
+
+	// (noeud, masque des plans qui restent a tester) : un noeud entierement du bon cote
+	// d'un plan dispense ses descendants de ce plan
+	std::vector<std::pair<int, int> >& stack = m_FrustumStack;
+	stack.clear();
+	stack.reserve(m_Nodes.size());
+	stack.push_back(std::make_pair(m_Root, 0x3f));
+	while(!stack.empty())
+	{
+		const int index = stack.back().first;
+		int planeMask = stack.back().second;
+		stack.pop_back();
+		const Node& node = m_Nodes[index];
+
+		bool outside = false;
+		for(int p = 0; p < 6 && !outside; ++p)
+		{
+			if(!(planeMask & (1 << p)))
+				continue;
+			const glm::vec3 normal(frustum.planes[p]);
+			// coin le plus loin (p-vertex) et le plus proche (n-vertex) dans la direction de la normale
+			const glm::vec3 positive(normal.x >= 0.0f ? node.box.max.x : node.box.min.x,
+									 normal.y >= 0.0f ? node.box.max.y : node.box.min.y,
+									 normal.z >= 0.0f ? node.box.max.z : node.box.min.z);
+			const glm::vec3 negative(normal.x >= 0.0f ? node.box.min.x : node.box.max.x,
+									 normal.y >= 0.0f ? node.box.min.y : node.box.max.y,
+									 normal.z >= 0.0f ? node.box.min.z : node.box.max.z);
+			if(glm::dot(normal, positive) + frustum.planes[p].w < 0.0f)
+				outside = true;
+			else if(glm::dot(normal, negative) + frustum.planes[p].w >= 0.0f)
+				planeMask &= ~(1 << p);
+		}
+		if(outside)
+			continue;
+
+		if(node.IsLeaf())
+		{
+			results.push_back(node.userData);
+		}
+		else
+		{
+			stack.push_back(std::make_pair(node.child1, planeMask));
+			stack.push_back(std::make_pair(node.child2, planeMask));
+		}
+	}
+}
+
+void DynamicBvh::QuerySphere(const glm::vec3& center, float radius, std::vector<int>& results) const
+{
+	if(m_Root == NullNode)
+		return;
+
+	const float radius2 = radius * radius;
+	std::vector<int> stack;
+	stack.push_back(m_Root);
+	while(!stack.empty())
+	{
+		const Node& node = m_Nodes[stack.back()];
+		stack.pop_back();
+
+		// distance au carre entre le centre et le point le plus proche de la boite
+		const glm::vec3 d = center - glm::clamp(center, node.box.min, node.box.max);
+		if(glm::dot(d, d) > radius2)
+			continue;
+
+		if(node.IsLeaf())
+		{
+			results.push_back(node.userData);
+		}
+		else
+		{
+			stack.push_back(node.child1);
+			stack.push_back(node.child2);
+		}
+	}
+}
+
+void DynamicBvh::QueryRay(const Ray& ray, std::vector<int>& results) const
+{
+	float maxDistance = ray.maxDistance;
+	RayCast(ray, maxDistance, [&results](int userData, float&) { results.push_back(userData); });
+}
+
+void DynamicBvh::QuerySpheres(const std::vector<glm::vec3>& centers, const std::vector<float>& radii,
+							  std::vector<std::vector<int> >& results) const
+{
+	results.resize(centers.size());
+	// les requetes sont independantes et l'arbre n'est que lu
+	ParallelFor(centers.size(), [&](size_t i) {
+		results[i].clear();
+		QuerySphere(centers[i], radii[i], results[i]);
+	});
+}
+
+void DynamicBvh::QueryRays(const std::vector<Ray>& rays, std::vector<std::vector<int> >& results) const
+{
+	results.resize(rays.size());
+	ParallelFor(rays.size(), [&](size_t i) {
+		results[i].clear();
+		QueryRay(rays[i], results[i]);
+	});
+}
+
+// --- Statistiques ----------------------------------------------------------
+
+int DynamicBvh::GetHeight() const
+{
+	return (m_Root == NullNode) ? 0 : m_Nodes[m_Root].height;
+}
+
+float DynamicBvh::ComputeSahCost() const
+{
+	if(m_Root == NullNode)
+		return 0.0f;
+
+	double total = 0.0;
+	for(size_t i = 0; i < m_Nodes.size(); ++i)
+	{
+		if(m_Nodes[i].height > 0)
+			total += m_Nodes[i].box.SurfaceArea();
+	}
+	const float rootArea = m_Nodes[m_Root].box.SurfaceArea();
+	return rootArea > 0.0f ? (float) (total / rootArea) : 0.0f;
+}
+
+bool DynamicBvh::Validate() const
+{
+	if(m_Root == NullNode)
+		return m_LeafCount == 0;
+	if(m_Nodes[m_Root].parent != NullNode)
+		return false;
+
+	int leaves = 0;
+	std::vector<int> stack;
+	stack.push_back(m_Root);
+	while(!stack.empty())
+	{
+		const int index = stack.back();
+		stack.pop_back();
+		const Node& node = m_Nodes[index];
+		if(node.IsLeaf())
+		{
+			if(node.height != 0)
+				return false;
+			++leaves;
+			continue;
+		}
+		const Node& child1 = m_Nodes[node.child1];
+		const Node& child2 = m_Nodes[node.child2];
+		if(child1.parent != index || child2.parent != index)
+			return false;
+		if(node.height != 1 + std::max(child1.height, child2.height))
+			return false;
+		if(!node.box.Contains(child1.box) || !node.box.Contains(child2.box))
+			return false;
+		stack.push_back(node.child1);
+		stack.push_back(node.child2);
+	}
+	return leaves == m_LeafCount;
+}
@@ -0,0 +1,191 @@
+#ifndef __DYNAMIC_BVH_H__
+#define __DYNAMIC_BVH_H__
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#include "glm/glm.hpp"
+
+#include "Culling.h"
+
+struct Aabb
+{
+	glm::vec3 min;
+	glm::vec3 max;
+
+	Aabb() {}
+	Aabb(const glm::vec3& boxMin, const glm::vec3& boxMax) : min(boxMin), max(boxMax) {}
+
+	inline float SurfaceArea() const
+	{
+		const glm::vec3 d = max - min;
+		return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+	}
+	inline bool Contains(const Aabb& other) const
+	{
+		return min.x <= other.min.x && min.y <= other.min.y && min.z <= other.min.z
+			&& other.max.x <= max.x && other.max.y <= max.y && other.max.z <= max.z;
+	}
+	static inline Aabb Union(const Aabb& a, const Aabb& b)
+	{
+		return Aabb(glm::min(a.min, b.min), glm::max(a.max, b.max));
+	}
+};
+
+// Boite locale transformee par une matrice : boite monde qui contient la boite orientee
+Aabb TransformAabb(const Aabb& box, const glm::mat4& matrix);
+
+struct Ray
+{
+	glm::vec3 origin;
+	glm::vec3 direction;
+	float maxDistance;
+};
+
+// Arbre d'AABB dynamique sur les objets de la scene (proxy = une feuille, userData = index de l'objet).
+// - insertion guidee par la SAH (descente gloutonne vers le frere le moins couteux)
+// - rotations d'arbre (Kopta et al. 2012) apres insertion et pendant le refit pour garder une SAH basse
+// - refit par frame pour les objets animes : on met a jour les feuilles puis on recalcule les noeuds
+//   internes de bas en haut, sans reconstruction
+class DynamicBvh
+{
+public:
+	static const int NullNode = -1;
+
+	DynamicBvh() : m_Root(NullNode), m_FreeList(NullNode), m_LeafCount(0) {}
+
+	void Clear();
+
+	// retourne l'identifiant du proxy
+	int CreateProxy(const Aabb& box, int userData);
+	void DestroyProxy(int proxy);
+
+	// met a jour la boite d'une feuille sans toucher aux noeuds internes (voir Refit)
+	inline void SetProxyBounds(int proxy, const Aabb& box) { m_Nodes[proxy].box = box; }
+	inline const Aabb& GetProxyBounds(int proxy) const { return m_Nodes[proxy].box; }
+	inline int GetUserData(int proxy) const { return m_Nodes[proxy].userData; }
+
+	// recalcule toutes les boites internes (et applique des rotations si rotate = true)
+	void Refit(bool rotate = true);
+
+	// --- Requetes : userData des feuilles touchees ---
+	// QueryFrustum reutilise une pile membre : pas d'appels concurrents sur le meme arbre
+	void QueryFrustum(const Frustum& frustum, std::vector<int>& results) const;
+	void QuerySphere(const glm::vec3& center, float radius, std::vector<int>& results) const;
+	void QueryRay(const Ray& ray, std::vector<int>& results) const;
+
+	// requetes par lot, reparties sur tous les coeurs (results[i] pour la requete i)
+	void QuerySpheres(const std::vector<glm::vec3>& centers, const std::vector<float>& radii,
+					  std::vector<std::vector<int> >& results) const;
+	void QueryRays(const std::vector<Ray>& rays, std::vector<std::vector<int> >& results) const;
+
+	// Parcours du rayon du plus proche au plus lointain. func(userData, maxDistance) est appelee pour
+	// chaque feuille dont la boite est touchee avant maxDistance et peut reduire maxDistance (plus proche impact)
+	template<typename Func>
+	void RayCast(const Ray& ray, float& maxDistance, const Func& func) const;
+
+	// --- Statistiques ---
+	inline int GetLeafCount() const { return m_LeafCount; }
+	int GetHeight() const;
+	// somme des aires des noeuds internes divisee par l'aire de la racine (cout SAH relatif)
+	float ComputeSahCost() const;
+	// verifie parents, hauteurs et inclusion des boites (debug)
+	bool Validate() const;
+
+private:
+	struct Node
+	{
+		Aabb box;
+		int parent;			// ou suivant dans la liste libre
+		int child1;
+		int child2;
+		int height;			// 0 pour une feuille
+		int userData;
+
+		inline bool IsLeaf() const { return child1 == NullNode; }
+	};
+
+	int AllocateNode();
+	void FreeNode(int node);
+	void InsertLeaf(int leaf);
+	void RemoveLeaf(int leaf);
+	void UpdateNode(int node);
+	void Rotate(int node);
+
+	std::vector<Node> m_Nodes;
+	int m_Root;
+	int m_FreeList;
+	int m_LeafCount;
+
+	// piles de parcours de Refit et QueryFrustum (appeles a chaque frame), gardees d'un appel a l'autre :
+	// reservees au nombre de noeuds, elles n'allouent plus une fois l'arbre construit
+	std::vector<int> m_RefitStack;
+	std::vector<int> m_RefitOrder;
+	mutable std::vector<std::pair<int, int> > m_FrustumStack;
+};
+
+// test rayon / boite par les dalles, retourne la distance d'entree ou -1
+inline float IntersectRayAabb(const glm::vec3& origin, const glm::vec3& inverseDirection, const Aabb& box, float maxDistance)
+{
+	const glm::vec3 t0 = (box.min - origin) * inverseDirection;
+	const glm::vec3 t1 = (box.max - origin) * inverseDirection;
+	const glm::vec3 tMin = glm::min(t0, t1);
+	const glm::vec3 tMax = glm::max(t0, t1);
+	const float enter = std::max(std::max(tMin.x, tMin.y), std::max(tMin.z, 0.0f));
+	const float exit = std::min(std::min(tMax.x, tMax.y), std::min(tMax.z, maxDistance));
+	return (enter <= exit) ? enter : -1.0f;
+}
+
+template<typename Func>
+void DynamicBvh::RayCast(const Ray& ray, float& maxDistance, const Func& func) const
+{
+	if(m_Root == NullNode)
+		return;
+
+	const glm::vec3 inverseDirection = 1.0f / ray.direction;
+	struct Entry
+	{
+		int node;
+		float distance;
+		Entry(int n, float d) : node(n), distance(d) {}
+	};
+	std::vector<Entry> stack;
+	stack.reserve(64);
+
+	const float rootDistance = IntersectRayAabb(ray.origin, inverseDirection, m_Nodes[m_Root].box, maxDistance);
+	if(rootDistance < 0.0f)
+		return;
+	stack.push_back(Entry(m_Root, rootDistance));
+
+	while(!stack.empty())
+	{
+		const Entry entry = stack.back();
+		stack.pop_back();
+		if(entry.distance > maxDistance)
+			continue;
+
+		const Node& node = m_Nodes[entry.node];
+		if(node.IsLeaf())
+		{
+			func(node.userData, maxDistance);
+			continue;
+		}
+
+		// l'enfant le plus proche est empile en dernier pour etre traite en premier
+		float distance1 = IntersectRayAabb(ray.origin, inverseDirection, m_Nodes[node.child1].box, maxDistance);
+		float distance2 = IntersectRayAabb(ray.origin, inverseDirection, m_Nodes[node.child2].box, maxDistance);
+		int first = node.child1, second = node.child2;
+		if(distance2 >= 0.0f && (distance1 < 0.0f || distance2 < distance1))
+		{
+			std::swap(first, second);
+			std::swap(distance1, distance2);
+		}
+		if(distance2 >= 0.0f)
+			stack.push_back(Entry(second, distance2));
+		if(distance1 >= 0.0f)
+			stack.push_back(Entry(first, distance1));
+	}
+}
+
+#endif //__DYNAMIC_BVH_H__
@@ -0,0 +1,147 @@
+#include "DynamicResolution.h"
+
+#include <cstdio>
+#include <algorithm>
+#include <cmath>
+
+// gains du regulateur, appliques a l'erreur relative (budget - temps) / budget a chaque mesure
+static const float ProportionalGain = 0.1f;
+static const float IntegralGain = 0.05f;
+static const float DerivativeGain = 0.02f;
+// en dessous de 3% d'ecart l'echelle ne bouge plus : pas d'oscillation autour du budget
+static const float ErrorDeadband = 0.03f;
+// variation maximale de l'echelle par mesure
+static const float MaxScaleStep = 0.05f;
+
+void DynamicResolution::Create()
+{
+	glGenFramebuffers(1, &m_Framebuffer);
+	glGenTextures(1, &m_ColorTexture);
+	glGenRenderbuffers(1, &m_DepthBuffer);
+
+	m_TimerQueries = GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+	if(m_TimerQueries)
+	{
+		for(int i = 0; i < QueryLatency; ++i)
+			glGenQueries(2, m_Queries[i]);
+	}
+	m_Width = m_Height = 0;
+	m_Frame = 0;
+	Reset();
+}
+
+void DynamicResolution::Destroy()
+{
+	if(m_TimerQueries)
+	{
+		for(int i = 0; i < QueryLatency; ++i)
+			glDeleteQueries(2, m_Queries[i]);
+	}
+	m_TimerQueries = false;
+	if(m_Framebuffer)
+		glDeleteFramebuffers(1, &m_Framebuffer);
+	if(m_ColorTexture)
+		glDeleteTextures(1, &m_ColorTexture);
+	if(m_DepthBuffer)
+		glDeleteRenderbuffers(1, &m_DepthBuffer);
+	m_Framebuffer = m_ColorTexture = m_DepthBuffer = 0;
+	m_Width = m_Height = 0;
+}
+
+void DynamicResolution::Reset()
+{
+	m_Scale = 1.0f;
+	m_PreviousError = m_PreviousError2 = 0.0f;
+	// les mesures en vol datent d'avant la pause : elles ne doivent pas piloter la prochaine echelle
+	for(int i = 0; i < QueryLatency; ++i)
+		m_QueryIssued[i] = false;
+}
+
+void DynamicResolution::Resize(int width, int height)
+{
+	glBindTexture(GL_TEXTURE_2D, m_ColorTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_DepthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_Framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_ColorTexture, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_DepthBuffer);
+	if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		printf("Resolution dynamique : framebuffer %dx%d incomplet\n", width, height);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	m_Width = width;
+	m_Height = height;
+}
+
+void DynamicResolution::UpdateScale(float budgetMs, float minScale)
+{
+	// erreur positive : marge sous le budget, l'echelle peut monter
+	float error = std::max(-1.0f, std::min(1.0f, (budgetMs - m_GpuTime) / std::max(budgetMs, 0.1f)));
+	if(std::fabs(error) < ErrorDeadband)
+		error = 0.0f;
+
+	// forme incrementale : pas d'integrale a borner, la saturation de l'echelle suffit
+	float step = ProportionalGain * (error - m_PreviousError) + IntegralGain * error
+			   + DerivativeGain * (error - 2.0f * m_PreviousError + m_PreviousError2);
+	step = std::max(-MaxScaleStep, std::min(MaxScaleStep, step));
+	m_PreviousError2 = m_PreviousError;
+	m_PreviousError = error;
+
+	m_Scale = std::max(std::min(minScale, 1.0f), std::min(1.0f, m_Scale + step));
+}
+
+void DynamicResolution::BeginScene(int windowWidth, int windowHeight, float budgetMs, float minScale)
+{
+	if(m_Width != windowWidth || m_Height != windowHeight)
+		Resize(windowWidth, windowHeight);
+
+	// le slot de cette frame a servi QueryLatency frames plus tot
+	const int slot = m_Frame % QueryLatency;
+	if(m_TimerQueries && m_QueryIssued[slot])
+	{
+		GLint available = 0;
+		glGetQueryObjectiv(m_Queries[slot][1], GL_QUERY_RESULT_AVAILABLE, &available);
+		if(available)
+		{
+			GLuint64 start = 0, end = 0;
+			glGetQueryObjectui64v(m_Queries[slot][0], GL_QUERY_RESULT, &start);
+			glGetQueryObjectui64v(m_Queries[slot][1], GL_QUERY_RESULT, &end);
+			m_GpuTime = (float) ((end - start) / 1.0e6);
+			UpdateScale(budgetMs, minScale);
+		}
+	}
+	// le minimum peut avoir change depuis la TweakBar sans nouvelle mesure
+	m_Scale = std::max(std::min(minScale, 1.0f), m_Scale);
+
+	m_RenderWidth = std::max(1, (int) (windowWidth * m_Scale + 0.5f));
+	m_RenderHeight = std::max(1, (int) (windowHeight * m_Scale + 0.5f));
+	glBindFramebuffer(GL_FRAMEBUFFER, m_Framebuffer);
+	glViewport(0, 0, m_RenderWidth, m_RenderHeight);
+
+	if(m_TimerQueries)
+		glQueryCounter(m_Queries[slot][0], GL_TIMESTAMP);
+}
+
+void DynamicResolution::EndScene()
+{
+	const int slot = m_Frame % QueryLatency;
+	if(m_TimerQueries)
+	{
+		glQueryCounter(m_Queries[slot][1], GL_TIMESTAMP);
+		m_QueryIssued[slot] = true;
+	}
+	++m_Frame;
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, m_Framebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	glBlitFramebuffer(0, 0, m_RenderWidth, m_RenderHeight, 0, 0, m_Width, m_Height, GL_COLOR_BUFFER_BIT,
+					  m_RenderWidth == m_Width && m_RenderHeight == m_Height ? GL_NEAREST : GL_LINEAR);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(0, 0, m_Width, m_Height);
+}
@@ -0,0 +1,59 @@
+#ifndef __DYNAMIC_RESOLUTION_H__
+#define __DYNAMIC_RESOLUTION_H__
+
+#include "Common.h"
+
+// Resolution dynamique de la scene :
+// - la scene est rendue dans un framebuffer hors ecran (couleur + profondeur) de la taille de la
+//   fenetre, dans un viewport reduit de GetScale() sur chaque axe : changer d'echelle ne realloue rien
+// - EndScene agrandit ce rectangle dans la fenetre (glBlitFramebuffer lineaire). La TweakBar et le HUD
+//   sont dessines ensuite, a la resolution native
+// - le temps GPU de la scene est mesure par deux glQueryCounter, relus QueryLatency frames plus tard
+//   sans attendre le GPU, et un regulateur PID (forme incrementale) ajuste l'echelle pour tenir le budget
+class DynamicResolution
+{
+public:
+	static const int QueryLatency = 3;
+
+	DynamicResolution() : m_Framebuffer(0), m_ColorTexture(0), m_DepthBuffer(0), m_Width(0), m_Height(0)
+						, m_RenderWidth(0), m_RenderHeight(0), m_TimerQueries(false), m_Frame(0), m_Scale(1.0f)
+						, m_GpuTime(0.0f), m_PreviousError(0.0f), m_PreviousError2(0.0f) {}
+
+	void Create();
+	void Destroy();
+
+	// debut de la scene : recupere la mesure la plus ancienne, ajuste l'echelle (budget en millisecondes,
+	// echelle dans [minScale, 1]) puis lie le framebuffer et son viewport reduit
+	void BeginScene(int windowWidth, int windowHeight, float budgetMs, float minScale);
+	// fin de la scene : copie agrandie dans le framebuffer de la fenetre, viewport de la fenetre
+	void EndScene();
+	// echelle pleine et regulateur remis a zero (resolution dynamique desactivee)
+	void Reset();
+
+	inline float GetScale() const { return m_Scale; }
+	inline int GetRenderWidth() const { return m_RenderWidth; }
+	inline int GetRenderHeight() const { return m_RenderHeight; }
+	// dernier temps GPU mesure de la scene, en millisecondes (0 sans timer queries)
+	inline float GetGpuTime() const { return m_GpuTime; }
+
+private:
+	void Resize(int width, int height);
+	void UpdateScale(float budgetMs, float minScale);
+
+	GLuint m_Framebuffer;
+	GLuint m_ColorTexture;
+	GLuint m_DepthBuffer;
+	int m_Width, m_Height;					// taille allouee (celle de la fenetre)
+	int m_RenderWidth, m_RenderHeight;		// viewport de la frame en cours
+
+	bool m_TimerQueries;
+	GLuint m_Queries[QueryLatency][2];		// debut et fin de la scene
+	bool m_QueryIssued[QueryLatency];
+	unsigned int m_Frame;
+
+	float m_Scale;
+	float m_GpuTime;
+	float m_PreviousError, m_PreviousError2;
+};
+
+#endif //__DYNAMIC_RESOLUTION_H__
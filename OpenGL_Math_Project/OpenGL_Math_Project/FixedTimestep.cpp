@@ -0,0 +1,81 @@
+#include "FixedTimestep.h"
+
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+#include <chrono>
+
+int64_t FixedTimestep::Now()
+{
+	// steady_clock : jamais recule par un changement d'heure, contrairement a system_clock
+	static const std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - origin).count();
+}
+
+void FixedTimestep::Reset(int64_t time)
+{
+	m_PreviousTime = time;
+	// l'accumulateur est garde : l'interpolation du rendu ne saute pas
+	m_LastPresent = -1;
+}
+
+int FixedTimestep::Advance(int64_t time)
+{
+	if(m_PreviousTime < 0 || time < m_PreviousTime)
+		m_PreviousTime = time;
+	m_Accumulator += (time - m_PreviousTime) * 1.0e-6;
+	m_PreviousTime = time;
+
+	int steps = (int) (m_Accumulator / m_Step);
+	if(steps > MaxStepsPerFrame)
+	{
+		m_DroppedTime += (steps - MaxStepsPerFrame) * m_Step;
+		m_Accumulator -= (steps - MaxStepsPerFrame) * m_Step;
+		steps = MaxStepsPerFrame;
+	}
+	m_Accumulator -= steps * m_Step;
+	m_SimulationTime += steps * m_Step;
+	return steps;
+}
+
+void FixedTimestep::Present(int64_t time)
+{
+	if(m_LastPresent >= 0)
+	{
+		const float frameTime = (time - m_LastPresent) / 1000.0f;
+		m_FrameTimes[m_PacingIndex] = frameTime;
+		m_PacingIndex = (m_PacingIndex + 1) % PacingWindow;
+		if(m_PacingCount < PacingWindow)
+			++m_PacingCount;
+		++m_SessionFrames;
+		m_SessionSum += frameTime;
+		m_SessionSquares += (double) frameTime * frameTime;
+	}
+	m_LastPresent = time;
+}
+
+void FixedTimestep::GetFrameTimeStats(float& mean, float& deviation) const
+{
+	mean = deviation = 0.0f;
+	if(m_PacingCount == 0)
+		return;
+	double sum = 0.0;
+	for(int i = 0; i < m_PacingCount; ++i)
+		sum += m_FrameTimes[i];
+	const double average = sum / m_PacingCount;
+	double variance = 0.0;
+	for(int i = 0; i < m_PacingCount; ++i)
+		variance += (m_FrameTimes[i] - average) * (m_FrameTimes[i] - average);
+	mean = (float) average;
+	deviation = (float) std::sqrt(variance / m_PacingCount);
+}
+
+void FixedTimestep::PrintStats() const
+{
+	if(m_SessionFrames == 0)
+		return;
+	const double average = m_SessionSum / m_SessionFrames;
+	const double variance = std::max(0.0, m_SessionSquares / m_SessionFrames - average * average);
+	printf("Pacing : %d frames, %.3f ms en moyenne, ecart-type %.3f ms (variance %.3f ms2), %.3f s de retard abandonne\n",
+		   m_SessionFrames, average, std::sqrt(variance), variance, m_DroppedTime);
+}
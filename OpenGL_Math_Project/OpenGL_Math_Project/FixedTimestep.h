@@ -0,0 +1,62 @@
+#ifndef __FIXED_TIMESTEP_H__
+#define __FIXED_TIMESTEP_H__
+
+#include <cstdint>
+
+// Boucle a pas de simulation fixe :
+// - le temps de chaque frame (horloge monotone en microsecondes, ou horloge virtuelle du rejeu) remplit
+//   un accumulateur vide par pas de GetStep() secondes : la simulation ne depend plus de la cadence
+// - le rendu interpole entre l'etat d'avant le dernier pas et l'etat courant avec GetAlpha(), soit un pas
+//   de retard mais un mouvement regulier quelle que soit la frequence d'affichage
+// - au-dela de MaxStepsPerFrame pas dans une frame, le retard est abandonne (pas de spirale de rattrapage)
+// Mesure aussi la regularite des presentations : moyenne et ecart-type du temps entre deux frames.
+class FixedTimestep
+{
+public:
+	static const int MaxStepsPerFrame = 8;
+	static const int PacingWindow = 240;		// frames de la fenetre glissante des statistiques
+
+	FixedTimestep() : m_Step(1.0 / 120.0), m_PreviousTime(-1), m_Accumulator(0.0), m_SimulationTime(0.0), m_DroppedTime(0.0)
+					, m_LastPresent(-1), m_PacingCount(0), m_PacingIndex(0), m_SessionFrames(0), m_SessionSum(0.0), m_SessionSquares(0.0) {}
+
+	// horloge monotone haute resolution, en microsecondes depuis le premier appel
+	static int64_t Now();
+
+	inline void SetStep(double step) { m_Step = step > 0.0 ? step : m_Step; }
+	inline double GetStep() const { return m_Step; }
+
+	// debut de frame : nombre de pas a simuler jusqu'a time (microsecondes)
+	int Advance(int64_t time);
+	// reprend a time sans rattraper le temps ecoule (sortie d'attente, debut de rejeu)
+	void Reset(int64_t time);
+
+	// position du rendu entre l'avant-dernier et le dernier pas, dans [0, 1[
+	inline double GetAlpha() const { return m_Accumulator / m_Step; }
+	// temps simule apres le dernier pas, et temps interpole affiche par le rendu (secondes)
+	inline double GetSimulationTime() const { return m_SimulationTime; }
+	inline double GetRenderTime() const { return m_SimulationTime - m_Step + m_Accumulator; }
+	// retard abandonne depuis le debut (secondes)
+	inline double GetDroppedTime() const { return m_DroppedTime; }
+
+	// apres glutSwapBuffers : temps entre deux presentations
+	void Present(int64_t time);
+	// sur la fenetre glissante, en millisecondes
+	void GetFrameTimeStats(float& mean, float& deviation) const;
+	void PrintStats() const;
+
+private:
+	double m_Step;
+	int64_t m_PreviousTime;
+	double m_Accumulator;
+	double m_SimulationTime;
+	double m_DroppedTime;
+
+	int64_t m_LastPresent;
+	float m_FrameTimes[PacingWindow];
+	int m_PacingCount, m_PacingIndex;
+	// toute la session
+	int m_SessionFrames;
+	double m_SessionSum, m_SessionSquares;
+};
+
+#endif //__FIXED_TIMESTEP_H__
@@ -0,0 +1,445 @@
+#ifndef _CRT_SECURE_NO_WARNINGS
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "FrameCapture.h"
+
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "stb/stb_image_write.h"
+
+#include "Parallel.h"
+
+// defini par l'implementation de stb_image_write (RayTracer.cpp) : sa table de CRC est remplie au premier
+// appel sans protection, on la remplit donc avant de lancer plusieurs encodeurs PNG en parallele
+unsigned int stbiw__crc32(unsigned char* buffer, int len);
+
+bool FrameCapture::Start(const char* path, Output output, int width, int height, int maxFrames, unsigned int workerCount)
+{
+	if(m_Capturing)
+		Stop();
+	if(width <= 0 || height <= 0 || (output == OUTPUT_RAW && maxFrames <= 0))
+		return false;
+
+	m_Output = output;
+	m_Path = path;
+	m_Width = width;
+	m_Height = height;
+	m_FrameSize = (size_t) width * height * 4;
+	m_MaxFrames = maxFrames;
+	if(output == OUTPUT_RAW && !OpenRawFile(path))
+	{
+		printf("Capture : impossible de creer %s\n", path);
+		return false;
+	}
+
+	CreateBuffers();
+	m_Buffers.assign(MaxQueuedFrames, std::vector<uint8_t>());
+	m_AllocatedBuffers = 0;
+	m_FreeBuffers.clear();
+
+	m_NextFrame = 0;
+	m_NextSlot = 0;
+	m_OldestSlot = 0;
+	m_WrittenFrames = 0;
+	m_DroppedFrames = 0;
+	m_LastIssueTime = 0.0f;
+	m_TotalIssueTime = 0.0;
+	m_IssuedFrames = 0;
+
+	if(output == OUTPUT_PNG)
+	{
+		unsigned char byte = 0;
+		stbiw__crc32(&byte, 1);
+	}
+
+	// le thread de rendu garde son coeur
+	if(workerCount == 0)
+		workerCount = std::max(1u, GetWorkerCount() - 1);
+	m_Quit = false;
+	m_InFlightJobs = 0;
+	for(unsigned int i = 0; i < workerCount; ++i)
+		m_Workers.push_back(std::thread(&FrameCapture::WorkerLoop, this));
+
+	m_Capturing = true;
+	return true;
+}
+
+void FrameCapture::CaptureFrame()
+{
+	if(!m_Capturing)
+		return;
+	if(m_MaxFrames > 0 && m_NextFrame >= (uint32_t) m_MaxFrames)
+	{
+		Stop();
+		return;
+	}
+
+	const std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	// recupere les lectures terminees depuis les frames precedentes
+	RetireReadbacks(false);
+
+	Slot& slot = m_Slots[m_NextSlot];
+	if(slot.state != SLOT_FREE)
+	{
+		// tout l'anneau est encore en vol : on saute la frame plutot que d'attendre le GPU
+		++m_DroppedFrames;
+	}
+	else
+	{
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+		glReadPixels(0, 0, m_Width, m_Height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		slot.state = SLOT_READBACK;
+		m_NextSlot = (m_NextSlot + 1) % RingSize;
+	}
+
+	m_LastIssueTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	m_TotalIssueTime += m_LastIssueTime;
+	++m_IssuedFrames;
+}
+
+void FrameCapture::Stop()
+{
+	if(!m_Capturing)
+		return;
+	m_Capturing = false;
+
+	RetireReadbacks(true);
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_JobDone.wait(lock, [this]() { return m_FirstJob == nullptr && m_InFlightJobs == 0; });
+		m_Quit = true;
+	}
+	m_JobAvailable.notify_all();
+	for(size_t i = 0; i < m_Workers.size(); ++i)
+		m_Workers[i].join();
+	m_Workers.clear();
+
+	DestroyBuffers();
+	m_Buffers.clear();
+	m_FreeBuffers.clear();
+	if(m_Output == OUTPUT_RAW)
+		CloseRawFile();
+
+	printf("Capture %s : %d frames ecrites, %d abandonnees, %.3f ms par frame sur le thread de rendu (%s)\n",
+		   m_Path.c_str(), (int) m_WrittenFrames, m_DroppedFrames, m_IssuedFrames ? m_TotalIssueTime / m_IssuedFrames : 0.0,
+		   m_Persistent ? "PBO persistants" : "copie des PBO");
+}
+
+void FrameCapture::CreateBuffers()
+{
+	m_Persistent = GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+	for(int i = 0; i < RingSize; ++i)
+	{
+		Slot& slot = m_Slots[i];
+		glGenBuffers(1, &slot.buffer);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+		if(m_Persistent)
+		{
+			const GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			glBufferStorage(GL_PIXEL_PACK_BUFFER, m_FrameSize, nullptr, flags | GL_CLIENT_STORAGE_BIT);
+			slot.mapped = (uint8_t*) glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, m_FrameSize, flags);
+		}
+		else
+		{
+			glBufferData(GL_PIXEL_PACK_BUFFER, m_FrameSize, nullptr, GL_STREAM_READ);
+			slot.mapped = nullptr;
+		}
+		slot.fence = nullptr;
+		slot.state = SLOT_FREE;
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void FrameCapture::DestroyBuffers()
+{
+	for(int i = 0; i < RingSize; ++i)
+	{
+		Slot& slot = m_Slots[i];
+		if(slot.mapped)
+		{
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+			slot.mapped = nullptr;
+		}
+		if(slot.buffer)
+			glDeleteBuffers(1, &slot.buffer);
+		slot.buffer = 0;
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+// Les slots sont remplis a tour de role : on les recupere dans le meme ordre, en s'arretant au premier
+// dont le fence n'est pas encore passe (sauf si wait)
+void FrameCapture::RetireReadbacks(bool wait)
+{
+	while(m_Slots[m_OldestSlot].state == SLOT_READBACK)
+	{
+		Slot& slot = m_Slots[m_OldestSlot];
+		if(!wait && glClientWaitSync(slot.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+			break;
+		Retire(slot, m_OldestSlot, wait);
+		m_OldestSlot = (m_OldestSlot + 1) % RingSize;
+	}
+}
+
+void FrameCapture::Retire(Slot& slot, int slotIndex, bool wait)
+{
+	if(wait)
+	{
+		while(glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED)
+			;
+	}
+	glDeleteSync(slot.fence);
+	slot.fence = nullptr;
+
+	// frames lues en trop au-dela de maxFrames
+	if(m_MaxFrames > 0 && m_NextFrame >= (uint32_t) m_MaxFrames)
+	{
+		slot.state = SLOT_FREE;
+		return;
+	}
+
+	Job job;
+	job.slot = -1;
+	job.buffer = -1;
+	job.frame = 0;
+
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	if(!m_Persistent || m_Output == OUTPUT_PNG)
+	{
+		if(m_FreeBuffers.empty())
+		{
+			if(m_AllocatedBuffers == MaxQueuedFrames)
+			{
+				// les encodeurs sont en retard
+				lock.unlock();
+				slot.state = SLOT_FREE;
+				++m_DroppedFrames;
+				return;
+			}
+			m_Buffers[m_AllocatedBuffers].resize(m_FrameSize);
+			m_FreeBuffers.push_back(m_AllocatedBuffers++);
+		}
+		job.buffer = m_FreeBuffers.back();
+		m_FreeBuffers.pop_back();
+	}
+	job.frame = m_NextFrame++;
+
+	if(m_Persistent)
+	{
+		// un thread d'encodage copie directement depuis le mapping puis libere le slot : ces copies
+		// passent avant les encodages en attente pour que l'anneau se libere vite
+		job.slot = slotIndex;
+		slot.state = SLOT_COPYING;
+		PushJob(job, true);
+		++m_InFlightJobs;
+		lock.unlock();
+		m_JobAvailable.notify_one();
+		return;
+	}
+	else
+	{
+		lock.unlock();
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+		const void* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, m_FrameSize, GL_MAP_READ_BIT);
+		if(pixels)
+			memcpy(&m_Buffers[job.buffer][0], pixels, m_FrameSize);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		slot.state = SLOT_FREE;
+		lock.lock();
+	}
+
+	PushJob(job, false);
+	++m_InFlightJobs;
+	lock.unlock();
+	m_JobAvailable.notify_one();
+}
+
+void FrameCapture::PushJob(const Job& job, bool front)
+{
+	JobNode* node = m_JobNodes.Create();
+	node->job = job;
+	node->next = nullptr;
+	if(!m_FirstJob)
+	{
+		m_FirstJob = m_LastJob = node;
+	}
+	else if(front)
+	{
+		node->next = m_FirstJob;
+		m_FirstJob = node;
+	}
+	else
+	{
+		m_LastJob->next = node;
+		m_LastJob = node;
+	}
+}
+
+bool FrameCapture::PopJob(Job& job)
+{
+	JobNode* node = m_FirstJob;
+	if(!node)
+		return false;
+	m_FirstJob = node->next;
+	if(!m_FirstJob)
+		m_LastJob = nullptr;
+	job = node->job;
+	m_JobNodes.Destroy(node);
+	return true;
+}
+
+void FrameCapture::WorkerLoop()
+{
+	for(;;)
+	{
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_JobAvailable.wait(lock, [this]() { return m_Quit || m_FirstJob != nullptr; });
+			if(!PopJob(job))
+				return;
+		}
+
+		// copie d'un PBO persistant vers le pool avant un PNG : l'encodage repart en fin de file
+		if(job.slot >= 0 && m_Output == OUTPUT_PNG)
+		{
+			Slot& slot = m_Slots[job.slot];
+			memcpy(&m_Buffers[job.buffer][0], slot.mapped, m_FrameSize);
+			slot.state = SLOT_FREE;
+			job.slot = -1;
+			{
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				PushJob(job, false);
+			}
+			m_JobAvailable.notify_one();
+			continue;
+		}
+
+		RunJob(job);
+
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			if(job.buffer >= 0)
+				m_FreeBuffers.push_back(job.buffer);
+			--m_InFlightJobs;
+		}
+		m_JobDone.notify_all();
+	}
+}
+
+void FrameCapture::RunJob(const Job& job)
+{
+	if(m_Output == OUTPUT_RAW)
+	{
+		uint8_t* frame = m_RawView + RawHeaderSize + (size_t) job.frame * m_FrameSize;
+		if(job.slot >= 0)
+		{
+			memcpy(frame, m_Slots[job.slot].mapped, m_FrameSize);
+			m_Slots[job.slot].state = SLOT_FREE;
+		}
+		else
+		{
+			memcpy(frame, &m_Buffers[job.buffer][0], m_FrameSize);
+		}
+	}
+	else
+	{
+		// glReadPixels donne la ligne du bas en premier : pas negatif pour ecrire l'image a l'endroit
+		char filename[512];
+		sprintf(filename, "%s%05u.png", m_Path.c_str(), job.frame);
+		const int stride = m_Width * 4;
+		const uint8_t* frame = &m_Buffers[job.buffer][0];
+		if(!stbi_write_png(filename, m_Width, m_Height, 4, frame + (size_t) (m_Height - 1) * stride, -stride))
+			return;
+	}
+	++m_WrittenFrames;
+}
+
+// --- Sequence brute -----------------------------------------------------------
+
+bool FrameCapture::OpenRawFile(const char* path)
+{
+	const uint64_t size = RawHeaderSize + (uint64_t) m_FrameSize * m_MaxFrames;
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(file == INVALID_HANDLE_VALUE)
+		return false;
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE, (DWORD) (size >> 32), (DWORD) size, NULL);
+	void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, (SIZE_T) size) : nullptr;
+	if(!view)
+	{
+		if(mapping)
+			CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+	m_RawFile = file;
+	m_RawMapping = mapping;
+#else
+	const int file = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if(file < 0)
+		return false;
+	void* view = ftruncate(file, (off_t) size) == 0 ? mmap(nullptr, (size_t) size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0) : MAP_FAILED;
+	if(view == MAP_FAILED)
+	{
+		close(file);
+		return false;
+	}
+	m_RawFile = (void*) (intptr_t) file;
+	m_RawMapping = nullptr;
+#endif
+	m_RawView = (uint8_t*) view;
+	return true;
+}
+
+void FrameCapture::CloseRawFile()
+{
+	if(!m_RawView)
+		return;
+
+	RawSequenceHeader header;
+	memcpy(header.magic, "ESGIRAW1", sizeof(header.magic));
+	header.width = m_Width;
+	header.height = m_Height;
+	header.frameCount = m_WrittenFrames;
+	header.frameSize = (uint32_t) m_FrameSize;
+	memcpy(m_RawView, &header, sizeof(header));
+
+	// le fichier avait ete dimensionne pour maxFrames : on le tronque aux frames ecrites
+	const uint64_t size = RawHeaderSize + (uint64_t) m_FrameSize * header.frameCount;
+#ifdef _WIN32
+	UnmapViewOfFile(m_RawView);
+	CloseHandle((HANDLE) m_RawMapping);
+	LARGE_INTEGER end;
+	end.QuadPart = (LONGLONG) size;
+	SetFilePointerEx((HANDLE) m_RawFile, end, NULL, FILE_BEGIN);
+	SetEndOfFile((HANDLE) m_RawFile);
+	CloseHandle((HANDLE) m_RawFile);
+#else
+	const int file = (int) (intptr_t) m_RawFile;
+	munmap(m_RawView, RawHeaderSize + m_FrameSize * m_MaxFrames);
+	if(ftruncate(file, (off_t) size) != 0)
+		printf("Capture : impossible de tronquer %s\n", m_Path.c_str());
+	close(file);
+#endif
+	m_RawFile = nullptr;
+	m_RawMapping = nullptr;
+	m_RawView = nullptr;
+}
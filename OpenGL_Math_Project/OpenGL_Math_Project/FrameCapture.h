@@ -0,0 +1,164 @@
+#ifndef __FRAME_CAPTURE_H__
+#define __FRAME_CAPTURE_H__
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <string>
+#include <cstdint>
+
+#include "Common.h"
+#include "FrameAllocator.h"
+
+// Entete d'un fichier de sequence brute : RawHeaderSize octets, puis frameCount images RGBA8 de
+// frameSize octets, ligne 0 en bas (ordre de glReadPixels). Les images restent alignees sur les pages.
+struct RawSequenceHeader
+{
+	char magic[8];			// "ESGIRAW1"
+	uint32_t width;
+	uint32_t height;
+	uint32_t frameCount;
+	uint32_t frameSize;
+};
+
+// Capture de frames sans bloquer la boucle de rendu :
+// - glReadPixels vers un anneau de RingSize pixel pack buffers, chacun protege par un fence,
+//   les pixels sont recuperes RingSize frames plus tard quand le GPU a fini (jamais d'attente)
+// - avec GL 4.4 (ARB_buffer_storage) les PBO sont mappes en permanence et ce sont les threads
+//   d'encodage qui copient les pixels, sinon le thread de rendu copie le PBO dans un buffer du pool
+// - les threads d'encodage ecrivent un PNG par frame (stb_image_write) ou copient la frame dans un
+//   fichier de sequence brute mappe en memoire (beaucoup plus rapide, a convertir apres coup)
+// Si les encodeurs prennent trop de retard, les frames sont abandonnees (GetDroppedFrames) plutot
+// que de ralentir le rendu.
+class FrameCapture
+{
+public:
+	enum Output
+	{
+		OUTPUT_PNG,
+		OUTPUT_RAW
+	};
+
+	static const int RingSize = 3;
+	static const int MaxQueuedFrames = 16;		// frames copiees en attente d'encodage (pool)
+	static const uint32_t RawHeaderSize = 4096;
+
+	FrameCapture() : m_Capturing(false), m_Output(OUTPUT_PNG), m_Persistent(false), m_Width(0), m_Height(0), m_FrameSize(0)
+				   , m_MaxFrames(0), m_NextFrame(0), m_NextSlot(0), m_OldestSlot(0), m_AllocatedBuffers(0)
+				   , m_JobNodes(MaxQueuedFrames + RingSize), m_FirstJob(nullptr), m_LastJob(nullptr), m_Quit(false), m_InFlightJobs(0)
+				   , m_RawFile(nullptr), m_RawMapping(nullptr), m_RawView(nullptr), m_WrittenFrames(0), m_DroppedFrames(0)
+				   , m_LastIssueTime(0.0f), m_TotalIssueTime(0.0), m_IssuedFrames(0)
+	{
+		for(int i = 0; i < RingSize; ++i)
+		{
+			m_Slots[i].buffer = 0;
+			m_Slots[i].fence = nullptr;
+			m_Slots[i].mapped = nullptr;
+			m_Slots[i].state = SLOT_FREE;
+		}
+	}
+
+	// PNG : path est le prefixe des fichiers (path00000.png...), RAW : le fichier de sequence,
+	// dimensionne pour maxFrames images (obligatoire en RAW, 0 = illimite en PNG).
+	// workerCount = 0 : un thread d'encodage par coeur moins le thread de rendu
+	bool Start(const char* path, Output output, int width, int height, int maxFrames = 0, unsigned int workerCount = 0);
+	// a appeler apres le rendu de la frame, avant glutSwapBuffers
+	void CaptureFrame();
+	// attend les lectures et les encodages en cours puis ferme la sequence et libere les PBO
+	// (contexte GL courant)
+	void Stop();
+
+	inline bool IsCapturing() const { return m_Capturing; }
+	inline int GetWidth() const { return m_Width; }
+	inline int GetHeight() const { return m_Height; }
+	inline int GetWrittenFrames() const { return m_WrittenFrames; }
+	inline int GetDroppedFrames() const { return m_DroppedFrames; }
+	// temps CPU passe dans le dernier CaptureFrame, en millisecondes
+	inline float GetLastIssueTime() const { return m_LastIssueTime; }
+
+private:
+	enum SlotState
+	{
+		SLOT_FREE,
+		SLOT_READBACK,		// glReadPixels emis, fence en attente
+		SLOT_COPYING		// PBO persistant lu par un thread d'encodage
+	};
+
+	struct Slot
+	{
+		GLuint buffer;
+		GLsync fence;
+		uint8_t* mapped;		// mapping persistant, nullptr sinon
+		std::atomic<int> state;
+	};
+
+	struct Job
+	{
+		int slot;				// PBO persistant a copier, -1 si les pixels sont deja dans buffer
+		int buffer;				// buffer du pool, -1 en RAW avec PBO persistant
+		uint32_t frame;			// numero dans la sequence (pas de trou pour les frames abandonnees)
+	};
+
+	struct JobNode
+	{
+		Job job;
+		JobNode* next;
+	};
+
+	void CreateBuffers();
+	void DestroyBuffers();
+	void RetireReadbacks(bool wait);
+	void Retire(Slot& slot, int slotIndex, bool wait);
+	// file des jobs, sous m_Mutex
+	void PushJob(const Job& job, bool front);
+	bool PopJob(Job& job);
+	void WorkerLoop();
+	void RunJob(const Job& job);
+	bool OpenRawFile(const char* path);
+	void CloseRawFile();
+
+	bool m_Capturing;
+	Output m_Output;
+	bool m_Persistent;
+	std::string m_Path;
+	int m_Width, m_Height;
+	size_t m_FrameSize;
+	int m_MaxFrames;
+	uint32_t m_NextFrame;
+
+	Slot m_Slots[RingSize];
+	int m_NextSlot;
+	int m_OldestSlot;
+
+	// pool de frames et file des encodeurs (proteges par m_Mutex). Les buffers du pool sont alloues
+	// par le thread de rendu au premier usage, m_Buffers n'est jamais redimensionne pendant la capture
+	std::vector<std::vector<uint8_t> > m_Buffers;
+	int m_AllocatedBuffers;
+	std::vector<int> m_FreeBuffers;
+	// file des jobs : liste chainee de noeuds pris dans un pool, aucune allocation par frame capturee
+	// (une deque de petits elements alloue un bloc tous les quelques jobs)
+	ObjectPool<JobNode> m_JobNodes;
+	JobNode* m_FirstJob;
+	JobNode* m_LastJob;
+	std::vector<std::thread> m_Workers;
+	std::mutex m_Mutex;
+	std::condition_variable m_JobAvailable;
+	std::condition_variable m_JobDone;
+	bool m_Quit;
+	int m_InFlightJobs;
+
+	// sequence brute mappee en memoire
+	void* m_RawFile;
+	void* m_RawMapping;
+	uint8_t* m_RawView;
+
+	std::atomic<int> m_WrittenFrames;
+	int m_DroppedFrames;
+	float m_LastIssueTime;
+	double m_TotalIssueTime;
+	int m_IssuedFrames;
+};
+
+#endif //__FRAME_CAPTURE_H__
@@ -0,0 +1,116 @@
+#include "FrameScheduler.h"
+
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+// en periode active, les compteurs CPU sont mis a jour au moins a cet intervalle (affichage TweakBar)
+static const double SegmentSeconds = 1.0;
+
+// temps CPU (utilisateur + noyau) consomme par tous les threads du processus, en secondes
+static double ProcessCpuSeconds()
+{
+#ifdef _WIN32
+	FILETIME creation, exitTime, kernel, user;
+	if(!GetProcessTimes(GetCurrentProcess(), &creation, &exitTime, &kernel, &user))
+		return 0.0;
+	// unites de 100 ns
+	const uint64_t kernelTime = ((uint64_t) kernel.dwHighDateTime << 32) | kernel.dwLowDateTime;
+	const uint64_t userTime = ((uint64_t) user.dwHighDateTime << 32) | user.dwLowDateTime;
+	return (kernelTime + userTime) * 1.0e-7;
+#else
+	rusage usage;
+	if(getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0.0;
+	return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1.0e-6;
+#endif
+}
+
+void FrameScheduler::Watch(const char* /*name*/, void* variable, size_t size)
+{
+	Variable watched;
+	watched.data = (uint8_t*) variable;
+	watched.previous.assign(watched.data, watched.data + size);
+	m_Variables.push_back(watched);
+}
+
+void FrameScheduler::CloseSegment()
+{
+	const Clock::time_point now = Clock::now();
+	const double cpu = ProcessCpuSeconds();
+	if(m_SegmentStart != Clock::time_point())
+	{
+		CpuUsage& usage = m_Usage[m_Idle ? 1 : 0];
+		usage.wallSeconds += std::chrono::duration<double>(now - m_SegmentStart).count();
+		usage.cpuSeconds += cpu - m_SegmentCpu;
+	}
+	m_SegmentStart = now;
+	m_SegmentCpu = cpu;
+}
+
+bool FrameScheduler::Resume()
+{
+	if(!m_Idle)
+		return false;
+	CloseSegment();
+	m_Idle = false;
+	return true;
+}
+
+void FrameScheduler::EnterIdle()
+{
+	if(m_Idle)
+		return;
+	CloseSegment();
+	m_Idle = true;
+}
+
+bool FrameScheduler::Schedule(bool continuous, int maxFps)
+{
+	if(m_SegmentStart == Clock::time_point() || std::chrono::duration<double>(Clock::now() - m_SegmentStart).count() > SegmentSeconds)
+		CloseSegment();
+
+	bool changed = m_Invalidated;
+	m_Invalidated = false;
+	// toutes les copies sont mises a jour, meme apres la premiere difference
+	for(size_t i = 0; i < m_Variables.size(); ++i)
+	{
+		Variable& variable = m_Variables[i];
+		if(memcmp(&variable.previous[0], variable.data, variable.previous.size()) == 0)
+			continue;
+		memcpy(&variable.previous[0], variable.data, variable.previous.size());
+		changed = true;
+	}
+	if(!changed && !continuous)
+		return false;
+
+	if(maxFps > 0)
+	{
+		// la precision depend de l'ordonnanceur du systeme, pas d'attente active
+		const Clock::time_point next = m_LastFrame + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / maxFps));
+		if(Clock::now() < next)
+			std::this_thread::sleep_until(next);
+	}
+	m_LastFrame = Clock::now();
+	++m_RenderedFrames;
+	return true;
+}
+
+float FrameScheduler::GetCpuPercent(bool idle) const
+{
+	const CpuUsage& usage = m_Usage[idle ? 1 : 0];
+	return usage.wallSeconds > 0.0 ? (float) (100.0 * usage.cpuSeconds / usage.wallSeconds) : 0.0f;
+}
+
+void FrameScheduler::PrintStats()
+{
+	CloseSegment();
+	printf("Scheduler : %d frames rendues, actif %.1f s (CPU %.1f%%), inactif %.1f s (CPU %.1f%%)\n", m_RenderedFrames,
+		   m_Usage[0].wallSeconds, GetCpuPercent(false), m_Usage[1].wallSeconds, GetCpuPercent(true));
+}
@@ -0,0 +1,75 @@
+#ifndef __FRAME_SCHEDULER_H__
+#define __FRAME_SCHEDULER_H__
+
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+// Rendu a la demande : une frame n'est rendue que si ses entrees ont change depuis la precedente
+// - les variables surveillees (camera, TweakBar) sont comparees octet par octet a la fin de chaque Update
+// - les callbacks d'entree appellent Invalidate, l'animation et la capture demandent un rendu continu
+// - sans rien a rendre, l'application retire sa fonction idle et GLUT attend le prochain evenement
+//   (attente bloquante, pas de CPU consomme) ; le plafond de frames attend aussi en dormant
+// Le temps CPU du processus est accumule separement pendant les periodes actives et inactives.
+class FrameScheduler
+{
+public:
+	FrameScheduler() : m_Invalidated(true), m_Idle(false), m_RenderedFrames(0), m_SegmentCpu(0.0) {}
+
+	// meme signature que InputLog::Watch, le nom ne sert qu'a la lecture du code
+	void Watch(const char* name, void* variable, size_t size);
+	template<typename T>
+	inline void Watch(const char* name, T* variable) { Watch(name, (void*) variable, sizeof(T)); }
+
+	// une entree (clavier, souris, fenetre) demande une nouvelle frame
+	inline void Invalidate() { m_Invalidated = true; }
+
+	// debut de l'Update : true si l'application sortait d'une attente, le temps ecoule pendant
+	// l'attente ne doit pas faire avancer la camera
+	bool Resume();
+	// fin de l'Update : true si la frame doit etre rendue. continuous force le rendu (animation, capture...).
+	// maxFps > 0 : dort jusqu'au moment de la frame suivante avant de rendre
+	bool Schedule(bool continuous, int maxFps);
+	// plus rien a rendre : l'appelant arrete d'appeler Update jusqu'au prochain evenement
+	void EnterIdle();
+
+	inline bool IsIdle() const { return m_Idle; }
+	inline int GetRenderedFrames() const { return m_RenderedFrames; }
+	// utilisation CPU du processus (100 = un coeur) pendant les periodes actives ou inactives
+	float GetCpuPercent(bool idle) const;
+	// resume de la session dans la console
+	void PrintStats();
+
+private:
+	typedef std::chrono::high_resolution_clock Clock;
+
+	struct Variable
+	{
+		uint8_t* data;
+		std::vector<uint8_t> previous;
+	};
+
+	struct CpuUsage
+	{
+		double wallSeconds;
+		double cpuSeconds;
+
+		CpuUsage() : wallSeconds(0.0), cpuSeconds(0.0) {}
+	};
+
+	// cloture la periode en cours dans le compteur de l'etat courant
+	void CloseSegment();
+
+	std::vector<Variable> m_Variables;
+	bool m_Invalidated;
+	bool m_Idle;
+	int m_RenderedFrames;
+	Clock::time_point m_LastFrame;
+
+	CpuUsage m_Usage[2];				// [0] actif, [1] inactif
+	Clock::time_point m_SegmentStart;
+	double m_SegmentCpu;
+};
+
+#endif //__FRAME_SCHEDULER_H__
@@ -0,0 +1,273 @@
+#include "InputLog.h"
+
+#include <algorithm>
+#include <cstring>
+
+static const char LogMagic[8] = { 'E', 'S', 'G', 'I', 'I', 'N', 'P', '2' };
+
+void InputLog::Watch(const char* name, void* variable, size_t size)
+{
+	Variable watched;
+	watched.name = name;
+	watched.data = (uint8_t*) variable;
+	watched.previous.assign(watched.data, watched.data + size);
+	m_Variables.push_back(watched);
+}
+
+void InputLog::Write(const void* data, size_t size)
+{
+	fwrite(data, 1, size, m_File);
+}
+
+void InputLog::WriteEvent(const void* data, size_t size)
+{
+	m_PendingEvents.insert(m_PendingEvents.end(), (const uint8_t*) data, (const uint8_t*) data + size);
+}
+
+bool InputLog::Read(void* data, size_t size)
+{
+	if(m_ReadOffset + size > m_Data.size())
+	{
+		m_ReadOffset = m_Data.size();
+		return false;
+	}
+	memcpy(data, &m_Data[m_ReadOffset], size);
+	m_ReadOffset += size;
+	return true;
+}
+
+bool InputLog::StartRecording(const char* path, int width, int height)
+{
+	Stop();
+	m_File = fopen(path, "wb");
+	if(!m_File)
+	{
+		printf("Input log : impossible de creer %s\n", path);
+		return false;
+	}
+	m_Width = width;
+	m_Height = height;
+	Write(LogMagic, sizeof(LogMagic));
+	Write<int32_t>(width);
+	Write<int32_t>(height);
+	Write<uint32_t>((uint32_t) m_Variables.size());
+	for(size_t i = 0; i < m_Variables.size(); ++i)
+	{
+		Write(m_Variables[i].name.c_str(), m_Variables[i].name.size() + 1);
+		Write<uint32_t>((uint32_t) m_Variables[i].previous.size());
+		// etat de depart : les valeurs courantes sont la reference des comparaisons
+		memcpy(&m_Variables[i].previous[0], m_Variables[i].data, m_Variables[i].previous.size());
+	}
+	m_Mode = MODE_RECORD;
+	m_PendingEvents.clear();
+	m_Frame = 0;
+	m_FramePending = false;
+	printf("Input log : enregistrement dans %s\n", path);
+	return true;
+}
+
+bool InputLog::StartReplay(const char* path)
+{
+	Stop();
+	FILE* file = fopen(path, "rb");
+	if(!file)
+	{
+		printf("Input log : impossible d'ouvrir %s\n", path);
+		return false;
+	}
+	m_Data.clear();
+	uint8_t chunk[64 * 1024];
+	size_t read;
+	while((read = fread(chunk, 1, sizeof(chunk), file)) > 0)
+		m_Data.insert(m_Data.end(), chunk, chunk + read);
+	fclose(file);
+
+	m_ReadOffset = 0;
+	char magic[sizeof(LogMagic)];
+	if(!Read(magic, sizeof(magic)) || memcmp(magic, LogMagic, sizeof(LogMagic)) != 0)
+	{
+		printf("Input log : %s n'est pas un log d'entrees\n", path);
+		return false;
+	}
+	m_Width = Read<int32_t>();
+	m_Height = Read<int32_t>();
+	const uint32_t variableCount = Read<uint32_t>();
+	if(variableCount != m_Variables.size())
+	{
+		printf("Input log : %u variables enregistrees, %zu surveillees\n", variableCount, m_Variables.size());
+		return false;
+	}
+	for(uint32_t i = 0; i < variableCount; ++i)
+	{
+		const char* name = (const char*) &m_Data[std::min(m_ReadOffset, m_Data.size() - 1)];
+		const size_t length = strnlen(name, m_Data.size() - m_ReadOffset);
+		m_ReadOffset += length + 1;
+		const uint32_t size = Read<uint32_t>();
+		if(m_Variables[i].name != std::string(name, length) || size != m_Variables[i].previous.size())
+		{
+			printf("Input log : la variable %u (%s) ne correspond pas\n", i, m_Variables[i].name.c_str());
+			return false;
+		}
+	}
+
+	m_Mode = MODE_REPLAY;
+	m_Frame = 0;
+	m_FramePending = false;
+	m_FrameTimes.clear();
+	m_LastFrameEnd = std::chrono::high_resolution_clock::now();
+	printf("Input log : rejeu de %s (%dx%d)\n", path, m_Width, m_Height);
+	return true;
+}
+
+void InputLog::Stop()
+{
+	if(m_Mode == MODE_RECORD)
+	{
+		fclose(m_File);
+		m_File = nullptr;
+		printf("Input log : %d frames enregistrees\n", m_Frame);
+	}
+	else if(m_Mode == MODE_REPLAY && !m_FrameTimes.empty())
+	{
+		// la premiere frame comprend le chargement de la fenetre : elle est ignoree
+		std::vector<float> times(m_FrameTimes.begin() + (m_FrameTimes.size() > 1 ? 1 : 0), m_FrameTimes.end());
+		double total = 0.0;
+		for(size_t i = 0; i < times.size(); ++i)
+			total += times[i];
+		std::sort(times.begin(), times.end());
+		printf("Input log : %d frames rejouees, CPU moyenne %.3f ms, mediane %.3f ms, 95%% %.3f ms, max %.3f ms\n",
+			   m_Frame, total / times.size(), times[times.size() / 2], times[times.size() * 95 / 100], times.back());
+	}
+	m_Mode = MODE_OFF;
+	m_Data.clear();
+	m_FrameEvents.clear();
+}
+
+bool InputLog::BeginFrame(int64_t realTime)
+{
+	if(m_Mode == MODE_OFF)
+	{
+		m_Time = realTime;
+		return true;
+	}
+	// Update sans Render depuis le dernier BeginFrame : meme frame, ses evenements ont deja ete appliques
+	if(m_FramePending)
+	{
+		m_FrameEvents.clear();
+		return true;
+	}
+	m_FramePending = true;
+
+	if(m_Mode == MODE_RECORD)
+	{
+		m_Time = realTime;
+		Write<uint8_t>(RECORD_FRAME);
+		Write<int64_t>(m_Time);
+		// variables modifiees par la TweakBar depuis la frame precedente
+		for(size_t i = 0; i < m_Variables.size(); ++i)
+		{
+			Variable& variable = m_Variables[i];
+			if(memcmp(&variable.previous[0], variable.data, variable.previous.size()) == 0)
+				continue;
+			memcpy(&variable.previous[0], variable.data, variable.previous.size());
+			Write<uint8_t>(RECORD_VARIABLE);
+			Write<uint16_t>((uint16_t) i);
+			Write(variable.data, variable.previous.size());
+		}
+		if(!m_PendingEvents.empty())
+			Write(&m_PendingEvents[0], m_PendingEvents.size());
+		m_PendingEvents.clear();
+		return true;
+	}
+
+	// rejeu : lit le marqueur de la frame puis ses enregistrements jusqu'au marqueur suivant
+	m_FrameEvents.clear();
+	uint8_t type = 0;
+	if(!Read(&type, sizeof(type)) || type != RECORD_FRAME)
+		return false;
+	m_Time = Read<int64_t>();
+	while(m_ReadOffset < m_Data.size() && m_Data[m_ReadOffset] != RECORD_FRAME)
+	{
+		type = Read<uint8_t>();
+		InputEvent event = InputEvent();
+		switch(type)
+		{
+		case RECORD_KEY:
+			event.type = InputEvent::KEY;
+			event.key = Read<uint8_t>();
+			event.down = Read<uint8_t>() != 0;
+			m_FrameEvents.push_back(event);
+			break;
+		case RECORD_MOUSE_BUTTON:
+			event.type = InputEvent::MOUSE_BUTTON;
+			event.button = Read<int8_t>();
+			event.state = Read<int8_t>();
+			event.x = Read<int16_t>();
+			event.y = Read<int16_t>();
+			event.handled = Read<uint8_t>() != 0;
+			m_FrameEvents.push_back(event);
+			break;
+		case RECORD_MOTION:
+			event.type = InputEvent::MOTION;
+			event.x = Read<int16_t>();
+			event.y = Read<int16_t>();
+			m_FrameEvents.push_back(event);
+			break;
+		case RECORD_VARIABLE:
+		{
+			const uint16_t index = Read<uint16_t>();
+			if(index >= m_Variables.size() || !Read(m_Variables[index].data, m_Variables[index].previous.size()))
+				return false;
+			break;
+		}
+		default:
+			printf("Input log : enregistrement inconnu (%u) a l'octet %zu\n", type, m_ReadOffset - 1);
+			return false;
+		}
+	}
+	return true;
+}
+
+void InputLog::EndFrame()
+{
+	if(m_Mode == MODE_OFF || !m_FramePending)
+		return;
+	m_FramePending = false;
+	++m_Frame;
+	if(m_Mode == MODE_REPLAY)
+	{
+		const std::chrono::high_resolution_clock::time_point now = std::chrono::high_resolution_clock::now();
+		m_FrameTimes.push_back(std::chrono::duration<float, std::milli>(now - m_LastFrameEnd).count());
+		m_LastFrameEnd = now;
+	}
+}
+
+void InputLog::RecordKey(unsigned char key, bool down)
+{
+	if(m_Mode != MODE_RECORD)
+		return;
+	WriteEvent<uint8_t>(RECORD_KEY);
+	WriteEvent<uint8_t>(key);
+	WriteEvent<uint8_t>(down ? 1 : 0);
+}
+
+void InputLog::RecordMouseButton(int button, int state, int x, int y, bool handled)
+{
+	if(m_Mode != MODE_RECORD)
+		return;
+	WriteEvent<uint8_t>(RECORD_MOUSE_BUTTON);
+	WriteEvent<int8_t>((int8_t) button);
+	WriteEvent<int8_t>((int8_t) state);
+	WriteEvent<int16_t>((int16_t) x);
+	WriteEvent<int16_t>((int16_t) y);
+	WriteEvent<uint8_t>(handled ? 1 : 0);
+}
+
+void InputLog::RecordMotion(int x, int y)
+{
+	if(m_Mode != MODE_RECORD)
+		return;
+	WriteEvent<uint8_t>(RECORD_MOTION);
+	WriteEvent<int16_t>((int16_t) x);
+	WriteEvent<int16_t>((int16_t) y);
+}
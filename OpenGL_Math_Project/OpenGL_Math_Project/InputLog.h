@@ -0,0 +1,132 @@
+#ifndef __INPUT_LOG_H__
+#define __INPUT_LOG_H__
+
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+
+// Evenement d'entree enregistre (ou rejoue) au debut d'une frame
+struct InputEvent
+{
+	enum Type
+	{
+		KEY,				// key, down
+		MOUSE_BUTTON,		// button, state, x, y, handled (consomme par la TweakBar)
+		MOTION				// x, y (seulement les mouvements que la TweakBar n'a pas consommes)
+	};
+
+	Type type;
+	unsigned char key;
+	bool down;
+	int button, state;
+	int x, y;
+	bool handled;
+};
+
+// Enregistrement et rejeu deterministe des entrees, pour des mesures de performance reproductibles :
+// - l'horloge de l'application passe par GetTime (en microsecondes) : horloge monotone en enregistrement
+//   (et sans log), temps enregistre de chaque frame en rejeu (horloge virtuelle, independante de la machine)
+// - les evenements clavier/souris et les variables surveillees (celles de la TweakBar, comparees
+//   octet par octet a chaque frame) sont ecrits avec la frame a laquelle ils s'appliquent
+// - en rejeu, BeginFrame restaure les variables et retourne les evenements de la frame ; une frame
+//   n'avance qu'apres le Render de la precedente, ce qui donne les memes frames d'une build a l'autre
+//
+// Fichier : "ESGIINP2", largeur et hauteur de la fenetre (int32), nombre de variables (uint32) puis
+// pour chacune son nom (termine par 0) et sa taille (uint32). Ensuite une suite d'enregistrements
+// [uint8 type][donnees] : frame (int64 temps en microsecondes), touche, bouton, mouvement ou variable
+// (uint16 index puis ses octets).
+class InputLog
+{
+public:
+	enum Mode
+	{
+		MODE_OFF,
+		MODE_RECORD,
+		MODE_REPLAY
+	};
+
+	InputLog() : m_Mode(MODE_OFF), m_File(nullptr), m_Width(0), m_Height(0), m_Time(0), m_FramePending(false)
+			   , m_Frame(0), m_ReadOffset(0) {}
+
+	// a declarer avant Start* : meme liste et meme ordre a l'enregistrement et au rejeu
+	void Watch(const char* name, void* variable, size_t size);
+	template<typename T>
+	inline void Watch(const char* name, T* variable) { Watch(name, (void*) variable, sizeof(T)); }
+
+	bool StartRecording(const char* path, int width, int height);
+	// charge tout le log ; la fenetre doit etre ramenee a GetWidth() x GetHeight()
+	bool StartReplay(const char* path);
+	// ferme l'enregistrement, ou affiche le resume des temps de frame du rejeu
+	void Stop();
+
+	// debut de frame (Update). Retourne false quand le rejeu est termine.
+	bool BeginFrame(int64_t realTime);
+	// fin de frame (apres le Render)
+	void EndFrame();
+
+	// evenements a appliquer pour la frame en cours (rejeu)
+	inline const std::vector<InputEvent>& GetFrameEvents() const { return m_FrameEvents; }
+
+	void RecordKey(unsigned char key, bool down);
+	void RecordMouseButton(int button, int state, int x, int y, bool handled);
+	void RecordMotion(int x, int y);
+
+	inline Mode GetMode() const { return m_Mode; }
+	inline bool IsReplaying() const { return m_Mode == MODE_REPLAY; }
+	inline int64_t GetTime() const { return m_Time; }
+	inline int GetFrame() const { return m_Frame; }
+	inline int GetWidth() const { return m_Width; }
+	inline int GetHeight() const { return m_Height; }
+
+private:
+	enum RecordType
+	{
+		RECORD_FRAME,
+		RECORD_KEY,
+		RECORD_MOUSE_BUTTON,
+		RECORD_MOTION,
+		RECORD_VARIABLE
+	};
+
+	struct Variable
+	{
+		std::string name;
+		uint8_t* data;
+		std::vector<uint8_t> previous;		// valeur a la frame precedente (enregistrement)
+	};
+
+	void Write(const void* data, size_t size);
+	template<typename T>
+	inline void Write(T value) { Write(&value, sizeof(T)); }
+	void WriteEvent(const void* data, size_t size);
+	template<typename T>
+	inline void WriteEvent(T value) { WriteEvent(&value, sizeof(T)); }
+	bool Read(void* data, size_t size);
+	template<typename T>
+	inline T Read() { T value = T(); Read(&value, sizeof(T)); return value; }
+
+	Mode m_Mode;
+	FILE* m_File;
+	int m_Width, m_Height;
+	int64_t m_Time;
+	bool m_FramePending;		// BeginFrame sans Render depuis : les Update suivants n'avancent pas
+	int m_Frame;
+
+	std::vector<Variable> m_Variables;
+	std::vector<InputEvent> m_FrameEvents;
+	// enregistrement : evenements recus depuis le dernier BeginFrame. GLUT les traite entre deux frames,
+	// ils sont donc ecrits avec la frame suivante, celle dont l'Update les voit
+	std::vector<uint8_t> m_PendingEvents;
+
+	// rejeu : tout le fichier en memoire
+	std::vector<uint8_t> m_Data;
+	size_t m_ReadOffset;
+
+	// temps CPU mesures entre deux EndFrame du rejeu, en millisecondes
+	std::chrono::high_resolution_clock::time_point m_LastFrameEnd;
+	std::vector<float> m_FrameTimes;
+};
+
+#endif //__INPUT_LOG_H__
@@ -0,0 +1,298 @@
+#include "Mesh.h"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include "glm/gtc/packing.hpp"
+
+#include "FrameAllocator.h"
+
+void ComputeBounds(MeshData& mesh)
+{
+	const size_t count = mesh.VertexCount();
+	if(count == 0)
+	{
+		mesh.boundsMin = mesh.boundsMax = mesh.sphereCenter = glm::vec3(0.f);
+		mesh.sphereRadius = 0.f;
+		return;
+	}
+
+	mesh.boundsMin = mesh.boundsMax = glm::vec3(mesh.positions[0], mesh.positions[1], mesh.positions[2]);
+	for(size_t index = 1; index < count; ++index)
+	{
+		const glm::vec3 p(mesh.positions[index * 3 + 0], mesh.positions[index * 3 + 1], mesh.positions[index * 3 + 2]);
+		mesh.boundsMin = glm::min(mesh.boundsMin, p);
+		mesh.boundsMax = glm::max(mesh.boundsMax, p);
+	}
+
+	// plus serree que la demi-diagonale de l'AABB pour les meshs arrondis
+	mesh.sphereCenter = (mesh.boundsMin + mesh.boundsMax) * 0.5f;
+	float radius2 = 0.f;
+	for(size_t index = 0; index < count; ++index)
+	{
+		const glm::vec3 p(mesh.positions[index * 3 + 0], mesh.positions[index * 3 + 1], mesh.positions[index * 3 + 2]);
+		const glm::vec3 d = p - mesh.sphereCenter;
+		radius2 = std::max(radius2, glm::dot(d, d));
+	}
+	mesh.sphereRadius = sqrtf(radius2);
+}
+
+void MeshDataSink::Reserve(size_t vertexCountHint, size_t triangleCount)
+{
+	m_Mesh.positions.reserve(m_Mesh.positions.size() + vertexCountHint * 3);
+	m_Mesh.indices.reserve(m_Mesh.indices.size() + triangleCount * 3);
+	m_Mesh.triangleMaterials.reserve(m_Mesh.triangleMaterials.size() + triangleCount);
+}
+
+void MeshDataSink::BeginShape(const std::string& /*name*/, int materialId)
+{
+	m_Material = materialId;
+	++m_ShapeCount;
+}
+
+void MeshDataSink::AddVertex(const float* position, const float* normal, const float* texcoord)
+{
+	m_Mesh.positions.insert(m_Mesh.positions.end(), position, position + 3);
+	// normales et coordonnees de texture sont optionnelles : reservees au premier sommet qui en a
+	if(normal)
+	{
+		if(m_Mesh.normals.capacity() == 0)
+			m_Mesh.normals.reserve(m_Mesh.positions.capacity());
+		m_Mesh.normals.insert(m_Mesh.normals.end(), normal, normal + 3);
+	}
+	if(texcoord)
+	{
+		if(m_Mesh.texcoords.capacity() == 0)
+			m_Mesh.texcoords.reserve(m_Mesh.positions.capacity() / 3 * 2);
+		m_Mesh.texcoords.insert(m_Mesh.texcoords.end(), texcoord, texcoord + 2);
+	}
+}
+
+void MeshDataSink::AddTriangle(unsigned int i0, unsigned int i1, unsigned int i2)
+{
+	m_Mesh.indices.push_back(i0);
+	m_Mesh.indices.push_back(i1);
+	m_Mesh.indices.push_back(i2);
+	m_Mesh.triangleMaterials.push_back(m_Material);
+}
+
+void FloatVertexSink::Reserve(size_t vertexCountHint, size_t triangleCount)
+{
+	m_Vertices.reserve(m_Vertices.size() + vertexCountHint);
+	m_Indices.reserve(m_Indices.size() + triangleCount * 3);
+}
+
+void FloatVertexSink::AddVertex(const float* position, const float* normal, const float* texcoord)
+{
+	FloatVertex vertex;
+	memcpy(vertex.position, position, sizeof(vertex.position));
+	if(normal)
+		memcpy(vertex.normal, normal, sizeof(vertex.normal));
+	else
+		memset(vertex.normal, 0, sizeof(vertex.normal));
+	if(texcoord)
+		memcpy(vertex.texcoords, texcoord, sizeof(vertex.texcoords));
+	else
+		memset(vertex.texcoords, 0, sizeof(vertex.texcoords));
+	m_Vertices.push_back(vertex);
+}
+
+void FloatVertexSink::AddTriangle(unsigned int i0, unsigned int i1, unsigned int i2)
+{
+	m_Indices.push_back(i0);
+	m_Indices.push_back(i1);
+	m_Indices.push_back(i2);
+}
+
+void MergeMaterials(const std::vector<tinyobj::material_t>& materials, MeshData& mesh, std::vector<std::string>& textures)
+{
+	textures.clear();
+	ArenaScope scratch(GetScratchArena());
+	int* remap = scratch.GetArena().AllocateArray<int>(materials.size());
+	for(size_t i = 0; i < materials.size(); ++i)
+	{
+		const std::vector<std::string>::iterator found = std::find(textures.begin(), textures.end(), materials[i].diffuse_texname);
+		remap[i] = (int) (found - textures.begin());
+		if(found == textures.end())
+			textures.push_back(materials[i].diffuse_texname);
+	}
+	if(textures.empty())
+		textures.push_back(std::string());
+
+	mesh.triangleMaterials.resize(mesh.indices.size() / 3, -1);
+	for(size_t triangle = 0; triangle < mesh.triangleMaterials.size(); ++triangle)
+	{
+		const int material = mesh.triangleMaterials[triangle];
+		mesh.triangleMaterials[triangle] = (material >= 0 && material < (int) materials.size()) ? remap[material] : 0;
+	}
+}
+
+// Tri par denombrement : une passe pour compter les triangles de chaque materiau, une pour les placer.
+// Les tableaux de travail sont dans l'arena du thread, seul le nouveau triangleMaterials va sur le tas.
+void SortTrianglesByMaterial(std::vector<uint32_t>& indices, size_t firstIndex, size_t indexCount,
+							 std::vector<int>& triangleMaterials, int materialCount, std::vector<Submesh>& submeshes)
+{
+	const size_t triangleCount = indexCount / 3;
+	ArenaScope scratch(GetScratchArena());
+	size_t* offsets = scratch.GetArena().AllocateArray<size_t>(materialCount + 1);
+	std::fill(offsets, offsets + materialCount + 1, (size_t) 0);
+	for(size_t triangle = 0; triangle < triangleCount; ++triangle)
+		++offsets[triangleMaterials[triangle] + 1];
+	for(int material = 0; material < materialCount; ++material)
+	{
+		if(offsets[material + 1] > 0)
+		{
+			Submesh submesh;
+			submesh.firstIndex = (uint32_t) (firstIndex + offsets[material] * 3);
+			submesh.indexCount = (uint32_t) (offsets[material + 1] * 3);
+			submesh.material = material;
+			submeshes.push_back(submesh);
+		}
+		offsets[material + 1] += offsets[material];
+	}
+
+	uint32_t* sortedIndices = scratch.GetArena().AllocateArray<uint32_t>(indexCount);
+	std::vector<int> sortedMaterials(triangleCount);
+	for(size_t triangle = 0; triangle < triangleCount; ++triangle)
+	{
+		const int material = triangleMaterials[triangle];
+		const size_t slot = offsets[material]++;
+		memcpy(&sortedIndices[slot * 3], &indices[firstIndex + triangle * 3], 3 * sizeof(uint32_t));
+		sortedMaterials[slot] = material;
+	}
+	std::copy(sortedIndices, sortedIndices + indexCount, indices.begin() + firstIndex);
+	triangleMaterials.swap(sortedMaterials);
+}
+
+void InheritTriangleMaterials(const MeshData& mesh, const std::vector<uint32_t>& indices, std::vector<int>& triangleMaterials)
+{
+	ArenaScope scratch(GetScratchArena());
+	int* vertexMaterials = scratch.GetArena().AllocateArray<int>(mesh.VertexCount());
+	std::fill(vertexMaterials, vertexMaterials + mesh.VertexCount(), 0);
+	for(size_t triangle = mesh.triangleMaterials.size(); triangle-- > 0; )
+	{
+		for(int corner = 0; corner < 3; ++corner)
+			vertexMaterials[mesh.indices[triangle * 3 + corner]] = mesh.triangleMaterials[triangle];
+	}
+
+	triangleMaterials.resize(indices.size() / 3);
+	for(size_t triangle = 0; triangle < triangleMaterials.size(); ++triangle)
+		triangleMaterials[triangle] = vertexMaterials[indices[triangle * 3]];
+}
+
+// Encodage octaedrique : on projette la sphere unite sur l'octaedre |x|+|y|+|z| = 1
+// puis on deplie l'hemisphere inferieur sur les coins du carre [-1, 1]^2
+glm::vec2 OctahedralEncode(const glm::vec3& n)
+{
+	const float invL1 = 1.0f / (fabsf(n.x) + fabsf(n.y) + fabsf(n.z));
+	glm::vec2 e(n.x * invL1, n.y * invL1);
+	if(n.z < 0.0f)
+	{
+		const glm::vec2 folded((1.0f - fabsf(e.y)) * (e.x >= 0.0f ? 1.0f : -1.0f),
+							   (1.0f - fabsf(e.x)) * (e.y >= 0.0f ? 1.0f : -1.0f));
+		e = folded;
+	}
+	return e;
+}
+
+glm::vec3 OctahedralDecode(const glm::vec2& e)
+{
+	glm::vec3 n(e.x, e.y, 1.0f - fabsf(e.x) - fabsf(e.y));
+	if(n.z < 0.0f)
+	{
+		const float x = (1.0f - fabsf(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f);
+		const float y = (1.0f - fabsf(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f);
+		n.x = x;
+		n.y = y;
+	}
+	return glm::normalize(n);
+}
+
+bool QuantizeMesh(const MeshData& mesh, QuantizedMesh& quantized)
+{
+	const size_t count = mesh.VertexCount();
+	const bool hasNormals = mesh.normals.size() == count * 3;
+	const bool hasTexcoords = mesh.texcoords.size() == count * 2;
+
+	// une dimension nulle (mesh plan) donnerait une division par zero
+	const glm::vec3 extent = glm::max(mesh.boundsMax - mesh.boundsMin, glm::vec3(1e-6f));
+	quantized.positionOffset = mesh.boundsMin;
+	quantized.positionScale = extent;
+
+	quantized.maxPositionError = 0.0f;
+	quantized.maxNormalError = 0.0f;
+	quantized.maxTexcoordError = 0.0f;
+	// demi pas de quantification sur l'axe le plus long (+ marge pour l'arrondi float)
+	quantized.positionErrorBound = glm::length(extent) * (0.5f / 65535.0f) * 1.01f + 1e-6f;
+	// pas de 1/32767 dans le domaine de l'octaedre, etire au plus d'un facteur ~2 sur la sphere
+	quantized.normalErrorBound = 4.0f / 32767.0f;
+
+	quantized.vertices.resize(count);
+	for(size_t index = 0; index < count; ++index)
+	{
+		CompactVertex& vertex = quantized.vertices[index];
+
+		const glm::vec3 p(mesh.positions[index * 3 + 0], mesh.positions[index * 3 + 1], mesh.positions[index * 3 + 2]);
+		const glm::vec3 unorm = (p - mesh.boundsMin) / extent;
+		for(int axis = 0; axis < 3; ++axis)
+		{
+			vertex.position[axis] = glm::packUnorm1x16(unorm[axis]);
+		}
+		vertex.position[3] = 0;
+
+		const glm::vec3 decodedP = glm::vec3(glm::unpackUnorm1x16(vertex.position[0]),
+											 glm::unpackUnorm1x16(vertex.position[1]),
+											 glm::unpackUnorm1x16(vertex.position[2])) * extent + mesh.boundsMin;
+		quantized.maxPositionError = std::max(quantized.maxPositionError, glm::length(decodedP - p));
+
+		if(hasNormals)
+		{
+			glm::vec3 n(mesh.normals[index * 3 + 0], mesh.normals[index * 3 + 1], mesh.normals[index * 3 + 2]);
+			const float length = glm::length(n);
+			n = (length > 0.0f) ? n / length : glm::vec3(0.0f, 0.0f, 1.0f);
+
+			const glm::vec2 e = OctahedralEncode(n);
+			vertex.normal[0] = (int16_t) glm::packSnorm1x16(e.x);
+			vertex.normal[1] = (int16_t) glm::packSnorm1x16(e.y);
+
+			const glm::vec3 decodedN = OctahedralDecode(glm::vec2(glm::unpackSnorm1x16((uint16_t) vertex.normal[0]),
+																  glm::unpackSnorm1x16((uint16_t) vertex.normal[1])));
+			// atan2 plutot que acos, trop imprecis en float pour des angles aussi petits
+			const float angle = atan2f(glm::length(glm::cross(decodedN, n)), glm::dot(decodedN, n));
+			quantized.maxNormalError = std::max(quantized.maxNormalError, angle);
+		}
+		else
+		{
+			vertex.normal[0] = vertex.normal[1] = 0;
+		}
+
+		if(hasTexcoords)
+		{
+			for(int axis = 0; axis < 2; ++axis)
+			{
+				const float uv = mesh.texcoords[index * 2 + axis];
+				vertex.texcoords[axis] = glm::packHalf1x16(uv);
+				quantized.maxTexcoordError = std::max(quantized.maxTexcoordError, fabsf(glm::unpackHalf1x16(vertex.texcoords[axis]) - uv));
+			}
+		}
+		else
+		{
+			vertex.texcoords[0] = vertex.texcoords[1] = 0;
+		}
+	}
+
+	quantized.indices16.clear();
+	quantized.indices32.clear();
+	if(count <= 0x10000)
+	{
+		quantized.indices16.assign(mesh.indices.begin(), mesh.indices.end());
+	}
+	else
+	{
+		quantized.indices32 = mesh.indices;
+	}
+
+	return quantized.maxPositionError <= quantized.positionErrorBound
+		&& quantized.maxNormalError <= quantized.normalErrorBound;
+}
@@ -0,0 +1,147 @@
+#ifndef __MESH_H__
+#define __MESH_H__
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include "glm/glm.hpp"
+
+#include "tinyobjloader/tiny_obj_loader.h"
+
+// Donnees CPU d'un mesh, attributs separes (tels que produits par tinyobjloader)
+struct MeshData
+{
+	std::vector<float> positions;		// 3 floats par sommet
+	std::vector<float> normals;			// 3 floats par sommet (optionnel)
+	std::vector<float> texcoords;		// 2 floats par sommet (optionnel)
+	std::vector<uint32_t> indices;
+	std::vector<int> triangleMaterials;	// materiau de chaque triangle (optionnel, -1 : aucun)
+
+	// AABB et sphere englobante dans le repere local du mesh
+	glm::vec3 boundsMin;
+	glm::vec3 boundsMax;
+	glm::vec3 sphereCenter;		// centre de l'AABB
+	float sphereRadius;			// distance max entre le centre et un sommet
+
+	inline size_t VertexCount() const { return positions.size() / 3; }
+};
+
+void ComputeBounds(MeshData& mesh);
+
+// Plage contigue d'indices dont tous les triangles utilisent le meme materiau
+struct Submesh
+{
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	int material;
+};
+
+// Fusionne les materiaux du .mtl qui donnent le meme rendu (meme texture diffuse, seule donnee lue par
+// les shaders) et renumerote mesh.triangleMaterials de 0 a textures.size() - 1. textures recoit la
+// texture diffuse de chaque materiau fusionne. Les triangles sans materiau prennent le premier du
+// fichier, ou un materiau sans texture si le fichier n'en a pas.
+void MergeMaterials(const std::vector<tinyobj::material_t>& materials, MeshData& mesh, std::vector<std::string>& textures);
+
+// Regroupe par materiau les triangles de indices[firstIndex, firstIndex + indexCount) : tri stable
+// (l'ordre des triangles d'un meme materiau est conserve), triangleMaterials (un par triangle de la
+// plage) est trie avec. Ajoute a submeshes une plage par materiau present, par materiau croissant.
+void SortTrianglesByMaterial(std::vector<uint32_t>& indices, size_t firstIndex, size_t indexCount,
+							 std::vector<int>& triangleMaterials, int materialCount, std::vector<Submesh>& submeshes);
+
+// Materiaux des triangles d'un niveau simplifie (qui reutilise les sommets du mesh) : celui du premier
+// triangle de mesh qui utilise le premier sommet du triangle
+void InheritTriangleMaterials(const MeshData& mesh, const std::vector<uint32_t>& indices, std::vector<int>& triangleMaterials);
+
+enum VertexFormat
+{
+	VERTEX_FORMAT_FLOAT,		// FloatVertex
+	VERTEX_FORMAT_COMPACT,		// CompactVertex
+	VERTEX_FORMAT_COUNT
+};
+
+// Format de sommet float (32 octets), les attributs absents du mesh sont mis a zero
+struct FloatVertex
+{
+	float position[3];
+	float normal[3];
+	float texcoords[2];
+};
+
+// Format de sommet compact (16 octets au lieu de 32) :
+// - position en unorm16 relative a l'AABB du mesh (le 4eme composant sert de padding)
+// - normale encodee en octaedre sur 2 x snorm16
+// - coordonnees de texture en half float
+struct CompactVertex
+{
+	uint16_t position[4];
+	int16_t normal[2];
+	uint16_t texcoords[2];
+};
+
+struct QuantizedMesh
+{
+	std::vector<CompactVertex> vertices;
+	// un seul des deux tableaux est rempli selon le nombre de sommets
+	std::vector<uint16_t> indices16;
+	std::vector<uint32_t> indices32;
+
+	// position = unorm * scale + offset
+	glm::vec3 positionOffset;
+	glm::vec3 positionScale;
+
+	// erreurs maximales mesurees apres decodage (et bornes theoriques associees)
+	float maxPositionError;
+	float positionErrorBound;
+	float maxNormalError;		// en radians
+	float normalErrorBound;
+	float maxTexcoordError;
+};
+
+// Quantifie un mesh dans le format compact et verifie l'erreur de reconstruction.
+// Retourne false si l'erreur mesuree depasse les bornes theoriques.
+bool QuantizeMesh(const MeshData& mesh, QuantizedMesh& quantized);
+
+// Recepteurs de tinyobj::LoadObj en flux : les sommets dedupliques arrivent directement dans le
+// stockage final, sans les shape_t intermediaires ni leurs copies
+
+// Attributs separes (MeshData), pour la chaine CPU (LOD, BVH, quantification...).
+// Le materiau de chaque forme du fichier est note par triangle (MeshData::triangleMaterials).
+class MeshDataSink : public tinyobj::MeshSink
+{
+public:
+	MeshDataSink(MeshData& mesh) : m_Mesh(mesh), m_Material(-1), m_ShapeCount(0) {}
+
+	virtual void Reserve(size_t vertexCountHint, size_t triangleCount);
+	virtual void BeginShape(const std::string& name, int materialId);
+	virtual void AddVertex(const float* position, const float* normal, const float* texcoord);
+	virtual void AddTriangle(unsigned int i0, unsigned int i1, unsigned int i2);
+
+	inline int GetShapeCount() const { return m_ShapeCount; }
+
+private:
+	MeshData& m_Mesh;
+	int m_Material;
+	int m_ShapeCount;
+};
+
+// Sommets entrelaces au format de l'arena float (attributs absents a zero) et indices 32 bits,
+// prets a etre copies d'un bloc dans les buffers GL
+class FloatVertexSink : public tinyobj::MeshSink
+{
+public:
+	FloatVertexSink(std::vector<FloatVertex>& vertices, std::vector<uint32_t>& indices) : m_Vertices(vertices), m_Indices(indices) {}
+
+	virtual void Reserve(size_t vertexCountHint, size_t triangleCount);
+	virtual void AddVertex(const float* position, const float* normal, const float* texcoord);
+	virtual void AddTriangle(unsigned int i0, unsigned int i1, unsigned int i2);
+
+private:
+	std::vector<FloatVertex>& m_Vertices;
+	std::vector<uint32_t>& m_Indices;
+};
+
+glm::vec2 OctahedralEncode(const glm::vec3& n);
+glm::vec3 OctahedralDecode(const glm::vec2& e);
+
+#endif //__MESH_H__
@@ -0,0 +1,398 @@
+#include "MeshArena.h"
+
+#include <cstdio>
+#include <cstddef>
+#include <algorithm>
+
+// --- FreeListAllocator -----------------------------------------------------
+
+void FreeListAllocator::Reset(size_t capacity)
+{
+	m_Capacity = capacity;
+	m_FreeBlocks.clear();
+	if(capacity > 0)
+	{
+		Block block = { 0, capacity };
+		m_FreeBlocks.push_back(block);
+	}
+}
+
+void FreeListAllocator::Grow(size_t capacity)
+{
+	if(capacity <= m_Capacity)
+		return;
+	Free(m_Capacity, capacity - m_Capacity);
+	m_Capacity = capacity;
+}
+
+void FreeListAllocator::Rebuild(size_t capacity, const std::vector<std::pair<size_t, size_t> >& used)
+{
+	m_Capacity = capacity;
+	m_FreeBlocks.clear();
+
+	size_t cursor = 0;
+	for(size_t i = 0; i <= used.size(); ++i)
+	{
+		const size_t end = (i < used.size()) ? used[i].first : capacity;
+		if(end > cursor)
+		{
+			Block block = { cursor, end - cursor };
+			m_FreeBlocks.push_back(block);
+		}
+		if(i < used.size())
+			cursor = used[i].first + used[i].second;
+	}
+}
+
+bool FreeListAllocator::Allocate(size_t size, size_t alignment, size_t& offset)
+{
+	for(size_t i = 0; i < m_FreeBlocks.size(); ++i)
+	{
+		Block& block = m_FreeBlocks[i];
+		const size_t aligned = (block.offset + alignment - 1) / alignment * alignment;
+		const size_t padding = aligned - block.offset;
+		if(block.size < size + padding)
+			continue;
+
+		offset = aligned;
+		const Block tail = { aligned + size, block.size - size - padding };
+		if(padding > 0)
+		{
+			// le padding d'alignement reste un bloc libre
+			block.size = padding;
+			if(tail.size > 0)
+				m_FreeBlocks.insert(m_FreeBlocks.begin() + i + 1, tail);
+		}
+		else if(tail.size > 0)
+		{
+			block = tail;
+		}
+		else
+		{
+			m_FreeBlocks.erase(m_FreeBlocks.begin() + i);
+		}
+		return true;
+	}
+	return false;
+}
+
+void FreeListAllocator::Free(size_t offset, size_t size)
+{
+	if(size == 0)
+		return;
+
+	const Block freed = { offset, size };
+	std::vector<Block>::iterator it = std::lower_bound(m_FreeBlocks.begin(), m_FreeBlocks.end(), freed,
+		[](const Block& a, const Block& b) { return a.offset < b.offset; });
+	it = m_FreeBlocks.insert(it, freed);
+
+	// fusion avec le bloc suivant puis le precedent
+	std::vector<Block>::iterator next = it + 1;
+	if(next != m_FreeBlocks.end() && it->offset + it->size == next->offset)
+	{
+		it->size += next->size;
+		it = m_FreeBlocks.erase(next) - 1;
+	}
+	if(it != m_FreeBlocks.begin())
+	{
+		std::vector<Block>::iterator previous = it - 1;
+		if(previous->offset + previous->size == it->offset)
+		{
+			previous->size += it->size;
+			m_FreeBlocks.erase(it);
+		}
+	}
+}
+
+size_t FreeListAllocator::GetFreeSize() const
+{
+	size_t total = 0;
+	for(size_t i = 0; i < m_FreeBlocks.size(); ++i)
+		total += m_FreeBlocks[i].size;
+	return total;
+}
+
+size_t FreeListAllocator::GetLargestFreeBlock() const
+{
+	size_t largest = 0;
+	for(size_t i = 0; i < m_FreeBlocks.size(); ++i)
+		largest = std::max(largest, m_FreeBlocks[i].size);
+	return largest;
+}
+
+// --- MeshArena -------------------------------------------------------------
+
+// les indices 16 et 32 bits cohabitent dans l'IBO, on aligne toutes les plages sur 4 octets
+static const size_t IndexAlignment = 4;
+
+void MeshArena::Create(VertexFormat format, size_t vertexCapacity, size_t indexCapacity)
+{
+	m_Format = format;
+	m_Stride = (format == VERTEX_FORMAT_COMPACT) ? sizeof(CompactVertex) : sizeof(FloatVertex);
+
+	m_Vertices.Reset(vertexCapacity);
+	m_Indices.Reset(indexCapacity);
+	m_Allocations.clear();
+	m_FreeHandles.clear();
+
+	glGenBuffers(1, &m_VBO);
+	glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+	glBufferData(GL_ARRAY_BUFFER, vertexCapacity * m_Stride, nullptr, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glGenBuffers(1, &m_IBO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_IBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCapacity, nullptr, GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	glGenVertexArrays(1, &m_VAO);
+	SetupVertexArray();
+}
+
+void MeshArena::Destroy()
+{
+	if(m_VAO)
+		glDeleteVertexArrays(1, &m_VAO);
+	if(m_VBO)
+		glDeleteBuffers(1, &m_VBO);
+	if(m_IBO)
+		glDeleteBuffers(1, &m_IBO);
+	m_VAO = m_VBO = m_IBO = 0;
+	m_Allocations.clear();
+	m_FreeHandles.clear();
+}
+
+void MeshArena::SetDrawIndexBuffer(GLuint buffer)
+{
+	m_DrawIndexBuffer = buffer;
+	SetupVertexArray();
+}
+
+void MeshArena::SetupVertexArray()
+{
+	// l'IBO fait partie de l'etat du VAO : un seul glBindVertexArray suffit pour dessiner
+	glBindVertexArray(m_VAO);
+	glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_IBO);
+
+	if(m_Format == VERTEX_FORMAT_COMPACT)
+	{
+		// les attributs normalises sont convertis en [0, 1] ou [-1, 1] par le GPU,
+		// le vertex shader applique ensuite l'echelle et l'offset de l'AABB et decode la normale
+		glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, m_Stride, (GLvoid *) offsetof(CompactVertex, position));
+		glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, m_Stride, (GLvoid *) offsetof(CompactVertex, normal));
+		glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, m_Stride, (GLvoid *) offsetof(CompactVertex, texcoords));
+	}
+	else
+	{
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, m_Stride, (GLvoid *) offsetof(FloatVertex, position));
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, m_Stride, (GLvoid *) offsetof(FloatVertex, normal));
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, m_Stride, (GLvoid *) offsetof(FloatVertex, texcoords));
+	}
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+	glEnableVertexAttribArray(2);
+
+	if(m_DrawIndexBuffer)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, m_DrawIndexBuffer);
+		glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, sizeof(GLuint), nullptr);
+		glVertexAttribDivisor(3, 1);
+		glEnableVertexAttribArray(3);
+	}
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+MeshArena::Handle MeshArena::Allocate(size_t vertexCount, size_t indexBytes)
+{
+	size_t vertexOffset = 0, indexOffset = 0;
+	bool vertexOk = m_Vertices.Allocate(vertexCount, 1, vertexOffset);
+	bool indexOk = m_Indices.Allocate(indexBytes, IndexAlignment, indexOffset);
+
+	if(!vertexOk || !indexOk)
+	{
+		if(vertexOk)
+			m_Vertices.Free(vertexOffset, vertexCount);
+		if(indexOk)
+			m_Indices.Free(indexOffset, indexBytes);
+
+		// si l'espace libre total suffit, compacter evite d'agrandir les buffers
+		const bool fitsVertices = m_Vertices.GetFreeSize() >= vertexCount;
+		const bool fitsIndices = m_Indices.GetFreeSize() >= indexBytes + IndexAlignment;
+		size_t vertexCapacity = m_Vertices.GetCapacity();
+		size_t indexCapacity = m_Indices.GetCapacity();
+		if(!fitsVertices)
+			vertexCapacity = std::max(vertexCapacity * 2, vertexCapacity + vertexCount);
+		if(!fitsIndices)
+			indexCapacity = std::max(indexCapacity * 2, indexCapacity + indexBytes + IndexAlignment);
+		Reallocate(vertexCapacity, indexCapacity);
+
+		vertexOk = m_Vertices.Allocate(vertexCount, 1, vertexOffset);
+		indexOk = m_Indices.Allocate(indexBytes, IndexAlignment, indexOffset);
+		if(!vertexOk || !indexOk)
+			return InvalidHandle;
+	}
+
+	Handle handle;
+	if(!m_FreeHandles.empty())
+	{
+		handle = m_FreeHandles.back();
+		m_FreeHandles.pop_back();
+	}
+	else
+	{
+		handle = (Handle) m_Allocations.size();
+		m_Allocations.push_back(Allocation());
+	}
+
+	Allocation& allocation = m_Allocations[handle];
+	allocation.baseVertex = (GLint) vertexOffset;
+	allocation.vertexCount = vertexCount;
+	allocation.indexOffset = indexOffset;
+	allocation.indexBytes = indexBytes;
+	allocation.live = true;
+	return handle;
+}
+
+void MeshArena::Free(Handle handle)
+{
+	if(handle == InvalidHandle || !m_Allocations[handle].live)
+		return;
+
+	Allocation& allocation = m_Allocations[handle];
+	m_Vertices.Free(allocation.baseVertex, allocation.vertexCount);
+	m_Indices.Free(allocation.indexOffset, allocation.indexBytes);
+	allocation.live = false;
+	m_FreeHandles.push_back(handle);
+}
+
+void* MeshArena::MapVertices(Handle handle)
+{
+	const Allocation& allocation = m_Allocations[handle];
+
+	// glMapBufferRange ne mappe que la plage de l'allocation : le driver n'a pas
+	// besoin de synchroniser le reste du buffer qui peut etre en cours d'utilisation
+	glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+	return glMapBufferRange(GL_ARRAY_BUFFER, allocation.baseVertex * m_Stride, allocation.vertexCount * m_Stride,
+							GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+}
+
+void MeshArena::UnmapVertices()
+{
+	glUnmapBuffer(GL_ARRAY_BUFFER);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void MeshArena::UploadIndices(Handle handle, const void* indices)
+{
+	const Allocation& allocation = m_Allocations[handle];
+
+	// pas de VAO actif : on ne modifie pas l'IBO attache a un VAO par erreur
+	glBindVertexArray(0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_IBO);
+	glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, allocation.indexOffset, allocation.indexBytes, indices);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+void MeshArena::Defragment()
+{
+	Reallocate(m_Vertices.GetCapacity(), m_Indices.GetCapacity());
+}
+
+void MeshArena::Reallocate(size_t vertexCapacity, size_t indexCapacity)
+{
+	GLuint vbo, ibo;
+	glGenBuffers(1, &vbo);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+	glBufferData(GL_COPY_WRITE_BUFFER, vertexCapacity * m_Stride, nullptr, GL_STATIC_DRAW);
+	glGenBuffers(1, &ibo);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, ibo);
+	glBufferData(GL_COPY_WRITE_BUFFER, indexCapacity, nullptr, GL_STATIC_DRAW);
+
+	// les handles restent valides : seuls baseVertex et indexOffset changent
+	std::vector<Handle> order;
+	for(Handle handle = 0; handle < m_Allocations.size(); ++handle)
+	{
+		if(m_Allocations[handle].live)
+			order.push_back(handle);
+	}
+	std::sort(order.begin(), order.end(), [this](Handle a, Handle b) {
+		return m_Allocations[a].baseVertex < m_Allocations[b].baseVertex;
+	});
+
+	size_t vertexCursor = 0, indexCursor = 0;
+	for(size_t i = 0; i < order.size(); ++i)
+	{
+		Allocation& allocation = m_Allocations[order[i]];
+		const size_t vertexOffset = vertexCursor;
+		const size_t indexOffset = (indexCursor + IndexAlignment - 1) / IndexAlignment * IndexAlignment;
+		vertexCursor = vertexOffset + allocation.vertexCount;
+		indexCursor = indexOffset + allocation.indexBytes;
+
+		glBindBuffer(GL_COPY_READ_BUFFER, m_VBO);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, allocation.baseVertex * m_Stride,
+							vertexOffset * m_Stride, allocation.vertexCount * m_Stride);
+		glBindBuffer(GL_COPY_READ_BUFFER, m_IBO);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, ibo);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, allocation.indexOffset,
+							indexOffset, allocation.indexBytes);
+
+		allocation.baseVertex = (GLint) vertexOffset;
+		allocation.indexOffset = indexOffset;
+	}
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	// reconstruit les listes libres a partir des allocations vivantes
+	std::vector<std::pair<size_t, size_t> > usedVertices, usedIndices;
+	for(size_t i = 0; i < order.size(); ++i)
+	{
+		const Allocation& allocation = m_Allocations[order[i]];
+		usedVertices.push_back(std::make_pair((size_t) allocation.baseVertex, allocation.vertexCount));
+		usedIndices.push_back(std::make_pair(allocation.indexOffset, allocation.indexBytes));
+	}
+	std::sort(usedVertices.begin(), usedVertices.end());
+	std::sort(usedIndices.begin(), usedIndices.end());
+	m_Vertices.Rebuild(vertexCapacity, usedVertices);
+	m_Indices.Rebuild(indexCapacity, usedIndices);
+
+	glDeleteBuffers(1, &m_VBO);
+	glDeleteBuffers(1, &m_IBO);
+	m_VBO = vbo;
+	m_IBO = ibo;
+	SetupVertexArray();
+}
+
+void MeshArena::GetStats(Stats& stats) const
+{
+	stats.liveAllocations = m_Allocations.size() - m_FreeHandles.size();
+
+	stats.vertexCapacity = m_Vertices.GetCapacity();
+	stats.vertexFree = m_Vertices.GetFreeSize();
+	stats.vertexFreeBlocks = m_Vertices.GetFreeBlockCount();
+	stats.vertexLargestFree = m_Vertices.GetLargestFreeBlock();
+	stats.vertexFragmentation = stats.vertexFree ? 1.0f - (float) stats.vertexLargestFree / stats.vertexFree : 0.0f;
+
+	stats.indexCapacity = m_Indices.GetCapacity();
+	stats.indexFree = m_Indices.GetFreeSize();
+	stats.indexFreeBlocks = m_Indices.GetFreeBlockCount();
+	stats.indexLargestFree = m_Indices.GetLargestFreeBlock();
+	stats.indexFragmentation = stats.indexFree ? 1.0f - (float) stats.indexLargestFree / stats.indexFree : 0.0f;
+}
+
+void MeshArena::PrintStats(const char* name) const
+{
+	Stats stats;
+	GetStats(stats);
+	printf("Arena %s : %u meshs\n", name, (unsigned) stats.liveAllocations);
+	printf("    sommets : %u / %u libres, %u blocs libres, plus grand %u, fragmentation %.1f%%\n",
+		   (unsigned) stats.vertexFree, (unsigned) stats.vertexCapacity, (unsigned) stats.vertexFreeBlocks,
+		   (unsigned) stats.vertexLargestFree, stats.vertexFragmentation * 100.0f);
+	printf("    indices : %u / %u octets libres, %u blocs libres, plus grand %u, fragmentation %.1f%%\n",
+		   (unsigned) stats.indexFree, (unsigned) stats.indexCapacity, (unsigned) stats.indexFreeBlocks,
+		   (unsigned) stats.indexLargestFree, stats.indexFragmentation * 100.0f);
+}
@@ -0,0 +1,115 @@
+#ifndef __MESH_ARENA_H__
+#define __MESH_ARENA_H__
+
+#include <vector>
+#include <utility>
+#include <cstdint>
+
+#include "Common.h"
+#include "Mesh.h"
+
+// Allocateur par liste de blocs libres sur une plage [0, capacity).
+// Les blocs libres sont tries par offset et fusionnes a la liberation.
+class FreeListAllocator
+{
+public:
+	FreeListAllocator() : m_Capacity(0) {}
+
+	void Reset(size_t capacity);
+	// agrandit la plage, le nouvel espace est ajoute a la fin
+	void Grow(size_t capacity);
+	// reconstruit la liste libre a partir des plages occupees (offset, taille) triees par offset
+	void Rebuild(size_t capacity, const std::vector<std::pair<size_t, size_t> >& used);
+
+	// first-fit, offset aligne sur alignment
+	bool Allocate(size_t size, size_t alignment, size_t& offset);
+	void Free(size_t offset, size_t size);
+
+	inline size_t GetCapacity() const { return m_Capacity; }
+	size_t GetFreeSize() const;
+	size_t GetLargestFreeBlock() const;
+	inline size_t GetFreeBlockCount() const { return m_FreeBlocks.size(); }
+
+private:
+	struct Block
+	{
+		size_t offset;
+		size_t size;
+	};
+
+	std::vector<Block> m_FreeBlocks;
+	size_t m_Capacity;
+};
+
+// Tous les meshs d'un meme format de sommet sont sous-alloues dans un VBO et un IBO communs,
+// decrits par un seul VAO. Les draws utilisent glDrawElementsBaseVertex.
+class MeshArena
+{
+public:
+	typedef uint32_t Handle;
+	static const Handle InvalidHandle = 0xffffffff;
+
+	struct Allocation
+	{
+		GLint baseVertex;		// premier sommet dans le VBO
+		size_t vertexCount;
+		size_t indexOffset;		// en octets dans l'IBO
+		size_t indexBytes;
+		bool live;
+	};
+
+	struct Stats
+	{
+		size_t liveAllocations;
+		size_t vertexCapacity, vertexFree, vertexFreeBlocks, vertexLargestFree;
+		size_t indexCapacity, indexFree, indexFreeBlocks, indexLargestFree;
+		// 0 = tout l'espace libre est contigu, tend vers 1 quand il est eparpille
+		float vertexFragmentation;
+		float indexFragmentation;
+	};
+
+	MeshArena() : m_Format(VERTEX_FORMAT_FLOAT), m_VBO(0), m_IBO(0), m_VAO(0), m_DrawIndexBuffer(0) {}
+
+	void Create(VertexFormat format, size_t vertexCapacity, size_t indexCapacity);
+	void Destroy();
+
+	Handle Allocate(size_t vertexCount, size_t indexBytes);
+	void Free(Handle handle);
+
+	// ecriture des donnees d'une allocation (le buffer est mappe sur la plage concernee)
+	void* MapVertices(Handle handle);
+	void UnmapVertices();
+	void UploadIndices(Handle handle, const void* indices);
+
+	// compacte toutes les allocations vivantes en debut de buffer
+	void Defragment();
+
+	// attache l'attribut instancie a_drawIndex au VAO (voir DrawBatch)
+	void SetDrawIndexBuffer(GLuint buffer);
+
+	inline const Allocation& Get(Handle handle) const { return m_Allocations[handle]; }
+	inline GLuint GetVAO() const { return m_VAO; }
+	inline VertexFormat GetFormat() const { return m_Format; }
+
+	void GetStats(Stats& stats) const;
+	void PrintStats(const char* name) const;
+
+private:
+	// realloue les buffers et y recopie les allocations vivantes de maniere contigue
+	void Reallocate(size_t vertexCapacity, size_t indexCapacity);
+	void SetupVertexArray();
+
+	VertexFormat m_Format;
+	GLsizei m_Stride;
+	GLuint m_VBO;
+	GLuint m_IBO;
+	GLuint m_VAO;
+	GLuint m_DrawIndexBuffer;
+
+	FreeListAllocator m_Vertices;	// en sommets
+	FreeListAllocator m_Indices;	// en octets
+	std::vector<Allocation> m_Allocations;
+	std::vector<Handle> m_FreeHandles;
+};
+
+#endif //__MESH_ARENA_H__
@@ -0,0 +1,471 @@
+#include "MeshSimplify.h"
+
+#include <cmath>
+#include <cfloat>
+#include <queue>
+#include <functional>
+#include <algorithm>
+
+#include "Parallel.h"
+
+namespace
+{
+	// Matrice 4x4 symetrique stockee sur 10 coefficients
+	struct Quadric
+	{
+		double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+
+		Quadric() : a2(0), ab(0), ac(0), ad(0), b2(0), bc(0), bd(0), c2(0), cd(0), d2(0) {}
+
+		// quadrique du plan ax + by + cz + d = 0 ponderee par weight
+		Quadric(double a, double b, double c, double d, double weight)
+			: a2(a*a*weight), ab(a*b*weight), ac(a*c*weight), ad(a*d*weight)
+			, b2(b*b*weight), bc(b*c*weight), bd(b*d*weight)
+			, c2(c*c*weight), cd(c*d*weight), d2(d*d*weight)
+		{
+		}
+
+		Quadric& operator+=(const Quadric& q)
+		{
+			a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+			b2 += q.b2; bc += q.bc; bd += q.bd;
+			c2 += q.c2; cd += q.cd; d2 += q.d2;
+			return *this;
+		}
+
+		double Evaluate(const glm::vec3& p) const
+		{
+			const double x = p.x, y = p.y, z = p.z;
+			return x*x*a2 + 2*x*y*ab + 2*x*z*ac + 2*x*ad
+				+ y*y*b2 + 2*y*z*bc + 2*y*bd
+				+ z*z*c2 + 2*z*cd + d2;
+		}
+	};
+
+	// contraction d'une position vers une autre
+	struct Collapse
+	{
+		double cost;
+		uint32_t from, to;
+		uint32_t fromVersion, toVersion;
+
+		bool operator>(const Collapse& other) const { return cost > other.cost; }
+	};
+
+	inline glm::vec3 GetPosition(const MeshData& mesh, uint32_t index)
+	{
+		return glm::vec3(mesh.positions[index * 3 + 0], mesh.positions[index * 3 + 1], mesh.positions[index * 3 + 2]);
+	}
+
+	// Regroupe les sommets qui partagent la meme position (coutures d'UV / de normales).
+	// Les sommets d'une position p sont wedges[wedgeOffsets[p] .. wedgeOffsets[p + 1]).
+	void WeldPositions(const MeshData& mesh, std::vector<uint32_t>& positionIds,
+					   std::vector<uint32_t>& wedges, std::vector<uint32_t>& wedgeOffsets)
+	{
+		const uint32_t count = (uint32_t) mesh.VertexCount();
+		positionIds.clear();
+		wedges.clear();
+		wedgeOffsets.assign(1, 0);
+		if(count == 0)
+			return;
+		wedges.resize(count);
+		for(uint32_t i = 0; i < count; ++i)
+			wedges[i] = i;
+
+		const float* p = &mesh.positions[0];
+		std::sort(wedges.begin(), wedges.end(), [p](uint32_t a, uint32_t b) {
+			if(p[a * 3 + 0] != p[b * 3 + 0]) return p[a * 3 + 0] < p[b * 3 + 0];
+			if(p[a * 3 + 1] != p[b * 3 + 1]) return p[a * 3 + 1] < p[b * 3 + 1];
+			return p[a * 3 + 2] < p[b * 3 + 2];
+		});
+
+		positionIds.resize(count);
+		wedgeOffsets.clear();
+		for(uint32_t i = 0; i < count; ++i)
+		{
+			const uint32_t v = wedges[i];
+			const bool same = i > 0 && p[v * 3 + 0] == p[wedges[i - 1] * 3 + 0]
+				&& p[v * 3 + 1] == p[wedges[i - 1] * 3 + 1]
+				&& p[v * 3 + 2] == p[wedges[i - 1] * 3 + 2];
+			if(!same)
+				wedgeOffsets.push_back(i);
+			positionIds[v] = (uint32_t) wedgeOffsets.size() - 1;
+		}
+		wedgeOffsets.push_back(count);
+	}
+
+	// Verrouille les positions situees sur un bord ou sur une arete non-manifold,
+	// et compte les aretes de couture (les deux triangles n'utilisent pas les memes sommets) par position
+	void ClassifyEdges(const std::vector<uint32_t>& indices, const std::vector<uint32_t>& positionIds,
+					   std::vector<bool>& locked, std::vector<uint32_t>& seamEdgeCount)
+	{
+		struct Edge
+		{
+			uint64_t key;
+			uint32_t v0, v1;	// sommets (et non positions) dans l'ordre de la cle
+			bool operator<(const Edge& other) const { return key < other.key; }
+		};
+
+		std::vector<Edge> edges;
+		edges.reserve(indices.size());
+		for(size_t t = 0; t < indices.size(); t += 3)
+		{
+			for(int e = 0; e < 3; ++e)
+			{
+				Edge edge = { 0, indices[t + e], indices[t + (e + 1) % 3] };
+				uint64_t a = positionIds[edge.v0];
+				uint64_t b = positionIds[edge.v1];
+				if(a > b)
+				{
+					std::swap(a, b);
+					std::swap(edge.v0, edge.v1);
+				}
+				edge.key = (a << 32) | b;
+				edges.push_back(edge);
+			}
+		}
+		std::sort(edges.begin(), edges.end());
+
+		for(size_t i = 0; i < edges.size();)
+		{
+			size_t j = i;
+			while(j < edges.size() && edges[j].key == edges[i].key)
+				++j;
+			const uint32_t a = (uint32_t) (edges[i].key >> 32);
+			const uint32_t b = (uint32_t) (edges[i].key & 0xffffffff);
+			if(j - i != 2)
+			{
+				locked[a] = true;
+				locked[b] = true;
+			}
+			else if(edges[i].v0 != edges[i + 1].v0 || edges[i].v1 != edges[i + 1].v1)
+			{
+				seamEdgeCount[a]++;
+				seamEdgeCount[b]++;
+			}
+			i = j;
+		}
+	}
+
+	float PointTriangleDistance(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+	{
+		// Ericson, Real-Time Collision Detection, 5.1.5
+		const glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+		const float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+		if(d1 <= 0.0f && d2 <= 0.0f)
+			return glm::length(p - a);
+
+		const glm::vec3 bp = p - b;
+		const float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+		if(d3 >= 0.0f && d4 <= d3)
+			return glm::length(p - b);
+
+		const float vc = d1 * d4 - d3 * d2;
+		if(vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+			return glm::length(p - (a + ab * (d1 / (d1 - d3))));
+
+		const glm::vec3 cp = p - c;
+		const float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+		if(d6 >= 0.0f && d5 <= d6)
+			return glm::length(p - c);
+
+		const float vb = d5 * d2 - d1 * d6;
+		if(vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+			return glm::length(p - (a + ac * (d2 / (d2 - d6))));
+
+		const float va = d3 * d6 - d5 * d4;
+		if(va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+			return glm::length(p - (b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)))));
+
+		const float denom = 1.0f / (va + vb + vc);
+		return glm::length(p - (a + ab * (vb * denom) + ac * (vc * denom)));
+	}
+
+	// Points d'echantillonnage d'un triangle : grille barycentrique (i, j, k) / HausdorffSubdivisions avec
+	// i + j + k = HausdorffSubdivisions, soit les sommets, des points sur les aretes et a l'interieur.
+	// Les sommets seuls ne suffisent pas : ceux d'un LOD sont des sommets du mesh d'origine, la distance
+	// LOD -> origine serait toujours nulle.
+	const int HausdorffSubdivisions = 4;
+
+	// distance max des points echantillonnes sur les triangles de 'from' a la surface 'to'
+	float DirectedHausdorff(const MeshData& mesh, const std::vector<uint32_t>& from, const std::vector<uint32_t>& to)
+	{
+		float result = 0.0f;
+		for(size_t f = 0; f < from.size(); f += 3)
+		{
+			const glm::vec3 a = GetPosition(mesh, from[f]);
+			const glm::vec3 b = GetPosition(mesh, from[f + 1]);
+			const glm::vec3 c = GetPosition(mesh, from[f + 2]);
+			for(int i = 0; i <= HausdorffSubdivisions; ++i)
+			{
+				for(int j = 0; i + j <= HausdorffSubdivisions; ++j)
+				{
+					const float u = (float) i / HausdorffSubdivisions, v = (float) j / HausdorffSubdivisions;
+					const glm::vec3 p = a * (1.0f - u - v) + b * u + c * v;
+					// un point deja plus proche que le maximum courant ne peut pas le changer
+					float best = FLT_MAX;
+					for(size_t t = 0; t < to.size() && best > result; t += 3)
+					{
+						best = std::min(best, PointTriangleDistance(p, GetPosition(mesh, to[t]), GetPosition(mesh, to[t + 1]), GetPosition(mesh, to[t + 2])));
+					}
+					result = std::max(result, best);
+				}
+			}
+		}
+		return result;
+	}
+}
+
+size_t SimplifyMesh(const MeshData& mesh, const std::vector<uint32_t>& indices,
+					size_t targetIndexCount, std::vector<uint32_t>& result)
+{
+	const uint32_t vertexCount = (uint32_t) mesh.VertexCount();
+	const uint32_t triangleCount = (uint32_t) (indices.size() / 3);
+
+	std::vector<uint32_t> positionIds, wedges, wedgeOffsets;
+	WeldPositions(mesh, positionIds, wedges, wedgeOffsets);
+	const uint32_t positionCount = (uint32_t) wedgeOffsets.size() - 1;
+
+	// Une position partagee par 2 sommets est sur une couture : elle ne peut glisser que le long
+	// de la couture (et uniquement au milieu d'une chaine de couture, 2 aretes de couture).
+	// Au-dela (coins de cartes UV), ainsi que sur les bords, la position est verrouillee.
+	std::vector<bool> locked(positionCount, false);
+	std::vector<uint32_t> seamEdgeCount(positionCount, 0);
+	ClassifyEdges(indices, positionIds, locked, seamEdgeCount);
+	for(uint32_t p = 0; p < positionCount; ++p)
+	{
+		const uint32_t wedgeCount = wedgeOffsets[p + 1] - wedgeOffsets[p];
+		if(wedgeCount > 2 || (wedgeCount == 2 && seamEdgeCount[p] != 2))
+			locked[p] = true;
+	}
+
+	// quadriques accumulees par position, ponderees par l'aire des triangles
+	std::vector<Quadric> quadrics(positionCount);
+	std::vector<uint32_t> triangles(indices);
+	std::vector<std::vector<uint32_t> > vertexTriangles(vertexCount);
+	for(uint32_t t = 0; t < triangleCount; ++t)
+	{
+		const glm::vec3 p0 = GetPosition(mesh, triangles[t * 3 + 0]);
+		const glm::vec3 p1 = GetPosition(mesh, triangles[t * 3 + 1]);
+		const glm::vec3 p2 = GetPosition(mesh, triangles[t * 3 + 2]);
+		const glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+		const float area = glm::length(n) * 0.5f;
+		if(area > 0.0f)
+		{
+			const glm::vec3 unit = n / (2.0f * area);
+			const Quadric q(unit.x, unit.y, unit.z, -glm::dot(unit, p0), area);
+			for(int k = 0; k < 3; ++k)
+				quadrics[positionIds[triangles[t * 3 + k]]] += q;
+		}
+		for(int k = 0; k < 3; ++k)
+			vertexTriangles[triangles[t * 3 + k]].push_back(t);
+	}
+
+	std::vector<bool> removedTriangle(triangleCount, false);
+	std::vector<uint32_t> version(positionCount, 0);
+	std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse> > heap;
+
+	auto pushCandidates = [&](uint32_t t) {
+		for(int k = 0; k < 3; ++k)
+		{
+			const uint32_t from = positionIds[triangles[t * 3 + k]];
+			if(locked[from])
+				continue;
+			for(int j = 1; j < 3; ++j)
+			{
+				const uint32_t to = positionIds[triangles[t * 3 + (k + j) % 3]];
+				Quadric q = quadrics[from];
+				q += quadrics[to];
+				Collapse c = { q.Evaluate(GetPosition(mesh, wedges[wedgeOffsets[to]])), from, to, version[from], version[to] };
+				heap.push(c);
+			}
+		}
+	};
+
+	// parcourt les triangles vivants d'une position (tous sommets confondus)
+	auto forEachTriangle = [&](uint32_t position, const std::function<void(uint32_t)>& func) {
+		for(uint32_t w = wedgeOffsets[position]; w < wedgeOffsets[position + 1]; ++w)
+		{
+			const std::vector<uint32_t>& list = vertexTriangles[wedges[w]];
+			for(size_t i = 0; i < list.size(); ++i)
+			{
+				if(!removedTriangle[list[i]])
+					func(list[i]);
+			}
+		}
+	};
+
+	auto containsPosition = [&](uint32_t t, uint32_t position) {
+		return positionIds[triangles[t * 3 + 0]] == position
+			|| positionIds[triangles[t * 3 + 1]] == position
+			|| positionIds[triangles[t * 3 + 2]] == position;
+	};
+
+	for(uint32_t t = 0; t < triangleCount; ++t)
+		pushCandidates(t);
+
+	size_t liveIndexCount = indices.size();
+	std::vector<uint32_t> neighbours;
+	std::vector<std::pair<uint32_t, uint32_t> > remap;
+	while(liveIndexCount > targetIndexCount && !heap.empty())
+	{
+		const Collapse c = heap.top();
+		heap.pop();
+
+		if(version[c.from] != c.fromVersion || version[c.to] != c.toVersion)
+			continue;
+
+		// chaque sommet de 'from' doit rejoindre le sommet de 'to' situe du meme cote de la couture :
+		// on le trouve dans un triangle qui contient l'arete. Pour une position sur une couture,
+		// echouer ici signifie que l'arete ne suit pas la couture.
+		remap.clear();
+		bool valid = true;
+		for(uint32_t w = wedgeOffsets[c.from]; w < wedgeOffsets[c.from + 1] && valid; ++w)
+		{
+			const uint32_t vertex = wedges[w];
+			uint32_t target = ~0u;
+			const std::vector<uint32_t>& list = vertexTriangles[vertex];
+			for(size_t i = 0; i < list.size() && target == ~0u; ++i)
+			{
+				if(removedTriangle[list[i]])
+					continue;
+				for(int k = 0; k < 3; ++k)
+				{
+					if(positionIds[triangles[list[i] * 3 + k]] == c.to)
+						target = triangles[list[i] * 3 + k];
+				}
+			}
+			if(target == ~0u)
+			{
+				// un sommet sans triangle vivant n'a plus besoin d'etre remappe
+				bool alive = false;
+				for(size_t i = 0; i < list.size(); ++i)
+					alive |= !removedTriangle[list[i]];
+				valid = !alive;
+			}
+			else
+			{
+				remap.push_back(std::make_pair(vertex, target));
+			}
+		}
+		if(!valid || remap.empty())
+			continue;
+
+		// condition de lien : une arete interieure ne doit avoir que 2 voisins communs,
+		// sinon la contraction cree une surface non-manifold
+		neighbours.clear();
+		forEachTriangle(c.from, [&](uint32_t t) {
+			for(int k = 0; k < 3; ++k)
+				neighbours.push_back(positionIds[triangles[t * 3 + k]]);
+		});
+		std::sort(neighbours.begin(), neighbours.end());
+		neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+
+		size_t shared = 0;
+		forEachTriangle(c.to, [&](uint32_t t) {
+			for(int k = 0; k < 3; ++k)
+			{
+				const uint32_t p = positionIds[triangles[t * 3 + k]];
+				std::vector<uint32_t>::iterator it = std::lower_bound(neighbours.begin(), neighbours.end(), p);
+				if(p != c.from && p != c.to && it != neighbours.end() && *it == p)
+				{
+					neighbours.erase(it);
+					++shared;
+				}
+			}
+		});
+		if(shared != 2)
+			continue;
+
+		// on refuse les contractions qui retournent un triangle
+		const glm::vec3 target = GetPosition(mesh, remap[0].second);
+		bool flipped = false;
+		forEachTriangle(c.from, [&](uint32_t t) {
+			if(flipped || containsPosition(t, c.to))
+				return;
+			glm::vec3 p[3];
+			for(int k = 0; k < 3; ++k)
+				p[k] = GetPosition(mesh, triangles[t * 3 + k]);
+			const glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+			for(int k = 0; k < 3; ++k)
+			{
+				if(positionIds[triangles[t * 3 + k]] == c.from)
+					p[k] = target;
+			}
+			const glm::vec3 after = glm::cross(p[1] - p[0], p[2] - p[0]);
+			flipped = glm::dot(before, after) <= 0.0f;
+		});
+		if(flipped)
+			continue;
+
+		// contraction : les triangles qui contiennent l'arete disparaissent, les autres sont rattaches a 'to'
+		quadrics[c.to] += quadrics[c.from];
+		for(size_t r = 0; r < remap.size(); ++r)
+		{
+			const uint32_t from = remap[r].first;
+			const uint32_t to = remap[r].second;
+			std::vector<uint32_t>& list = vertexTriangles[from];
+			for(size_t i = 0; i < list.size(); ++i)
+			{
+				const uint32_t t = list[i];
+				if(removedTriangle[t])
+					continue;
+				if(containsPosition(t, c.to))
+				{
+					removedTriangle[t] = true;
+					liveIndexCount -= 3;
+					continue;
+				}
+				for(int k = 0; k < 3; ++k)
+				{
+					if(triangles[t * 3 + k] == from)
+						triangles[t * 3 + k] = to;
+				}
+				vertexTriangles[to].push_back(t);
+			}
+			list.clear();
+		}
+		// la position disparait : plus aucun candidat ne peut la referencer
+		locked[c.from] = true;
+		version[c.from]++;
+
+		// seule la quadrique de 'to' a change : les aretes qui la touchent sont reevaluees, celles entre
+		// deux voisins gardent leur cout et leurs candidats restent valides
+		version[c.to]++;
+		forEachTriangle(c.to, pushCandidates);
+	}
+
+	result.clear();
+	result.reserve(liveIndexCount);
+	for(uint32_t t = 0; t < triangleCount; ++t)
+	{
+		if(removedTriangle[t])
+			continue;
+		result.push_back(triangles[t * 3 + 0]);
+		result.push_back(triangles[t * 3 + 1]);
+		result.push_back(triangles[t * 3 + 2]);
+	}
+	return result.size();
+}
+
+void BuildLodChain(const MeshData& mesh, int levelCount, float ratio, std::vector<MeshLod>& lods)
+{
+	lods.resize(levelCount);
+	lods[0].indices = mesh.indices;
+	lods[0].targetRatio = 1.0f;
+	lods[0].error = 0.0f;
+
+	// chaque niveau part du mesh d'origine, ils sont donc independants
+	ParallelFor(levelCount - 1, [&](size_t i) {
+		MeshLod& lod = lods[i + 1];
+		lod.targetRatio = powf(ratio, (float) (i + 1));
+		const size_t target = (size_t) (mesh.indices.size() / 3 * lod.targetRatio) * 3;
+		SimplifyMesh(mesh, mesh.indices, target, lod.indices);
+		lod.error = ComputeHausdorffDistance(mesh, mesh.indices, lod.indices);
+	});
+}
+
+float ComputeHausdorffDistance(const MeshData& mesh, const std::vector<uint32_t>& a, const std::vector<uint32_t>& b)
+{
+	return std::max(DirectedHausdorff(mesh, a, b), DirectedHausdorff(mesh, b, a));
+}
@@ -0,0 +1,33 @@
+#ifndef __MESH_SIMPLIFY_H__
+#define __MESH_SIMPLIFY_H__
+
+#include <vector>
+#include <cstdint>
+
+#include "Mesh.h"
+
+// Un niveau de detail : sous-ensemble de triangles qui reference les sommets du mesh
+// d'origine (on ne cree jamais de sommet), ce qui permet a tous les niveaux de partager le VBO
+struct MeshLod
+{
+	std::vector<uint32_t> indices;
+	float targetRatio;		// ratio de triangles demande par rapport au mesh d'origine
+	float error;			// distance de Hausdorff au mesh d'origine, dans le repere du mesh
+};
+
+// Simplification par contraction d'aretes guidee par les quadriques d'erreur (Garland & Heckbert).
+// Les contractions se font sur un des deux sommets de l'arete (half-edge collapse).
+// Les sommets situes sur une couture d'UV / de normales ou sur un bord sont verrouilles.
+// Retourne le nombre d'indices obtenus (peut rester au-dessus de la cible si plus rien n'est contractable).
+size_t SimplifyMesh(const MeshData& mesh, const std::vector<uint32_t>& indices,
+					size_t targetIndexCount, std::vector<uint32_t>& result);
+
+// Construit levelCount niveaux (le niveau 0 est le mesh d'origine) avec un ratio de
+// triangles ratio^level. Les niveaux sont calcules en parallele.
+void BuildLodChain(const MeshData& mesh, int levelCount, float ratio, std::vector<MeshLod>& lods);
+
+// Distance de Hausdorff symetrique entre deux ensembles de triangles du meme mesh, estimee sur des
+// points echantillonnes sur les sommets, les aretes et l'interieur des triangles de chaque ensemble.
+float ComputeHausdorffDistance(const MeshData& mesh, const std::vector<uint32_t>& a, const std::vector<uint32_t>& b);
+
+#endif //__MESH_SIMPLIFY_H__
@@ -0,0 +1,355 @@
+#include "OcclusionCulling.h"
+
+#include <cmath>
+#include <algorithm>
+#include <map>
+
+#include "Parallel.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE__)
+#define OCCLUSION_USE_SSE 1
+#include <xmmintrin.h>
+#endif
+
+// en dessous, le sommet est considere derriere le plan proche
+static const float MinClipW = 1e-5f;
+
+void OcclusionCuller::Create(int width, int height)
+{
+	m_TilesX = (width + TileSize - 1) / TileSize;
+	m_TilesY = (height + TileSize - 1) / TileSize;
+	m_Width = m_TilesX * TileSize;
+	m_Height = m_TilesY * TileSize;
+	m_TileBins.assign(m_TilesX * m_TilesY, std::vector<uint32_t>());
+
+	m_MaxLevels.clear();
+	m_MinLevels.clear();
+	m_LevelWidth.clear();
+	m_LevelHeight.clear();
+	int levelWidth = m_Width, levelHeight = m_Height;
+	for(;;)
+	{
+		m_MaxLevels.push_back(std::vector<float>(levelWidth * levelHeight, 1.0f));
+		m_MinLevels.push_back(std::vector<float>(levelWidth * levelHeight, 1.0f));
+		m_LevelWidth.push_back(levelWidth);
+		m_LevelHeight.push_back(levelHeight);
+		if(levelWidth == 1 && levelHeight == 1)
+			break;
+		levelWidth = (levelWidth + 1) / 2;
+		levelHeight = (levelHeight + 1) / 2;
+	}
+}
+
+void OcclusionCuller::Begin(const glm::mat4& viewProjection)
+{
+	m_ViewProjection = viewProjection;
+	m_Triangles.clear();
+	for(size_t tile = 0; tile < m_TileBins.size(); ++tile)
+		m_TileBins[tile].clear();
+	std::fill(m_MaxLevels[0].begin(), m_MaxLevels[0].end(), 1.0f);
+}
+
+void OcclusionCuller::AddOccluder(const std::vector<float>& positions, const std::vector<uint32_t>& indices, const glm::mat4& worldMatrix)
+{
+	const glm::mat4 matrix = m_ViewProjection * worldMatrix;
+
+	for(size_t index = 0; index + 2 < indices.size(); index += 3)
+	{
+		glm::vec3 screen[3];
+		bool clipped = false;
+		for(int corner = 0; corner < 3; ++corner)
+		{
+			const float* p = &positions[indices[index + corner] * 3];
+			const glm::vec4 clip = matrix * glm::vec4(p[0], p[1], p[2], 1.0f);
+			// pas de clipping contre le plan proche : un triangle qui le traverse n'occulte rien,
+			// ce qui reste conservatif
+			if(clip.w < MinClipW)
+			{
+				clipped = true;
+				break;
+			}
+			const float invW = 1.0f / clip.w;
+			screen[corner] = glm::vec3((clip.x * invW * 0.5f + 0.5f) * m_Width,
+									   (clip.y * invW * 0.5f + 0.5f) * m_Height,
+									   clip.z * invW * 0.5f + 0.5f);
+		}
+		if(clipped)
+			continue;
+
+		// aire signee : les faces arriere et degenerees sont ignorees
+		const float area = (screen[1].x - screen[0].x) * (screen[2].y - screen[0].y)
+						 - (screen[1].y - screen[0].y) * (screen[2].x - screen[0].x);
+		if(area <= 0.0f)
+			continue;
+
+		Triangle triangle;
+		triangle.minX = std::max((int) floorf(std::min(screen[0].x, std::min(screen[1].x, screen[2].x))), 0);
+		triangle.minY = std::max((int) floorf(std::min(screen[0].y, std::min(screen[1].y, screen[2].y))), 0);
+		triangle.maxX = std::min((int) ceilf(std::max(screen[0].x, std::max(screen[1].x, screen[2].x))), m_Width - 1);
+		triangle.maxY = std::min((int) ceilf(std::max(screen[0].y, std::max(screen[1].y, screen[2].y))), m_Height - 1);
+		if(triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+			continue;
+
+		// arete i allant du sommet i au sommet i+1, positive du cote du sommet oppose
+		const float invArea = 1.0f / area;
+		triangle.depthA = triangle.depthB = triangle.depthC = 0.0f;
+		for(int edge = 0; edge < 3; ++edge)
+		{
+			const glm::vec3& a = screen[edge];
+			const glm::vec3& b = screen[(edge + 1) % 3];
+			triangle.edgeA[edge] = a.y - b.y;
+			triangle.edgeB[edge] = b.x - a.x;
+			triangle.edgeC[edge] = -(triangle.edgeA[edge] * a.x + triangle.edgeB[edge] * a.y);
+
+			// la coordonnee barycentrique du sommet oppose a l'arete vaut edge(p) / area,
+			// z/w etant affine a l'ecran, la profondeur est la combinaison des trois
+			const float z = screen[(edge + 2) % 3].z * invArea;
+			triangle.depthA += triangle.edgeA[edge] * z;
+			triangle.depthB += triangle.edgeB[edge] * z;
+			triangle.depthC += triangle.edgeC[edge] * z;
+		}
+
+		const uint32_t triangleIndex = (uint32_t) m_Triangles.size();
+		m_Triangles.push_back(triangle);
+		for(int tileY = triangle.minY / TileSize; tileY <= triangle.maxY / TileSize; ++tileY)
+		{
+			for(int tileX = triangle.minX / TileSize; tileX <= triangle.maxX / TileSize; ++tileX)
+				m_TileBins[tileY * m_TilesX + tileX].push_back(triangleIndex);
+		}
+	}
+}
+
+void OcclusionCuller::RasterizeTile(int tile)
+{
+	const int tileMinX = (tile % m_TilesX) * TileSize;
+	const int tileMinY = (tile / m_TilesX) * TileSize;
+	float* depth = &m_MaxLevels[0][0];
+
+	const std::vector<uint32_t>& bin = m_TileBins[tile];
+	for(size_t i = 0; i < bin.size(); ++i)
+	{
+		const Triangle& triangle = m_Triangles[bin[i]];
+		// debut aligne sur 4 pixels, la tuile etant un multiple de 4 on ne deborde pas
+		const int minX = std::max(triangle.minX, tileMinX) & ~3;
+		const int maxX = std::min(triangle.maxX, tileMinX + TileSize - 1);
+		const int minY = std::max(triangle.minY, tileMinY);
+		const int maxY = std::min(triangle.maxY, tileMinY + TileSize - 1);
+
+		for(int y = minY; y <= maxY; ++y)
+		{
+			const float py = y + 0.5f;
+			float* row = depth + y * m_Width;
+#ifdef OCCLUSION_USE_SSE
+			const __m128 offsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+			const __m128 e0Row = _mm_set1_ps(triangle.edgeB[0] * py + triangle.edgeC[0]);
+			const __m128 e1Row = _mm_set1_ps(triangle.edgeB[1] * py + triangle.edgeC[1]);
+			const __m128 e2Row = _mm_set1_ps(triangle.edgeB[2] * py + triangle.edgeC[2]);
+			const __m128 zRow = _mm_set1_ps(triangle.depthB * py + triangle.depthC);
+			const __m128 a0 = _mm_set1_ps(triangle.edgeA[0]);
+			const __m128 a1 = _mm_set1_ps(triangle.edgeA[1]);
+			const __m128 a2 = _mm_set1_ps(triangle.edgeA[2]);
+			const __m128 az = _mm_set1_ps(triangle.depthA);
+			const __m128 zero = _mm_setzero_ps();
+			for(int x = minX; x <= maxX; x += 4)
+			{
+				const __m128 px = _mm_add_ps(_mm_set1_ps((float) x), offsets);
+				const __m128 e0 = _mm_add_ps(_mm_mul_ps(a0, px), e0Row);
+				const __m128 e1 = _mm_add_ps(_mm_mul_ps(a1, px), e1Row);
+				const __m128 e2 = _mm_add_ps(_mm_mul_ps(a2, px), e2Row);
+				const __m128 inside = _mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_and_ps(_mm_cmpge_ps(e1, zero), _mm_cmpge_ps(e2, zero)));
+				if(_mm_movemask_ps(inside) == 0)
+					continue;
+				const __m128 z = _mm_add_ps(_mm_mul_ps(az, px), zRow);
+				const __m128 previous = _mm_loadu_ps(row + x);
+				const __m128 nearest = _mm_min_ps(previous, z);
+				_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, previous)));
+			}
+#else
+			for(int x = minX; x <= maxX; ++x)
+			{
+				const float px = x + 0.5f;
+				if(triangle.edgeA[0] * px + triangle.edgeB[0] * py + triangle.edgeC[0] < 0.0f
+				   || triangle.edgeA[1] * px + triangle.edgeB[1] * py + triangle.edgeC[1] < 0.0f
+				   || triangle.edgeA[2] * px + triangle.edgeB[2] * py + triangle.edgeC[2] < 0.0f)
+					continue;
+				const float z = triangle.depthA * px + triangle.depthB * py + triangle.depthC;
+				row[x] = std::min(row[x], z);
+			}
+#endif
+		}
+	}
+}
+
+void OcclusionCuller::Rasterize()
+{
+	// une tuile n'est ecrite que par un seul thread : aucune synchronisation
+	ParallelFor(m_TileBins.size(), [this](size_t tile) { RasterizeTile((int) tile); });
+	BuildHierarchy();
+}
+
+void OcclusionCuller::BuildHierarchy()
+{
+	m_MinLevels[0] = m_MaxLevels[0];
+	for(size_t level = 1; level < m_MaxLevels.size(); ++level)
+	{
+		const int sourceWidth = m_LevelWidth[level - 1];
+		const int sourceHeight = m_LevelHeight[level - 1];
+		const std::vector<float>& sourceMax = m_MaxLevels[level - 1];
+		const std::vector<float>& sourceMin = m_MinLevels[level - 1];
+		std::vector<float>& targetMax = m_MaxLevels[level];
+		std::vector<float>& targetMin = m_MinLevels[level];
+
+		for(int y = 0; y < m_LevelHeight[level]; ++y)
+		{
+			// pour une taille impaire le dernier texel ne couvre qu'une ligne / colonne
+			const int y0 = y * 2, y1 = std::min(y * 2 + 1, sourceHeight - 1);
+			for(int x = 0; x < m_LevelWidth[level]; ++x)
+			{
+				const int x0 = x * 2, x1 = std::min(x * 2 + 1, sourceWidth - 1);
+				targetMax[y * m_LevelWidth[level] + x] = std::max(std::max(sourceMax[y0 * sourceWidth + x0], sourceMax[y0 * sourceWidth + x1]),
+																  std::max(sourceMax[y1 * sourceWidth + x0], sourceMax[y1 * sourceWidth + x1]));
+				targetMin[y * m_LevelWidth[level] + x] = std::min(std::min(sourceMin[y0 * sourceWidth + x0], sourceMin[y0 * sourceWidth + x1]),
+																  std::min(sourceMin[y1 * sourceWidth + x0], sourceMin[y1 * sourceWidth + x1]));
+			}
+		}
+	}
+}
+
+bool OcclusionCuller::IsOccluded(const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::mat4& worldMatrix) const
+{
+	const glm::mat4 matrix = m_ViewProjection * worldMatrix;
+
+	// rectangle ecran et profondeur la plus proche des 8 coins de la boite
+	float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f, nearestDepth = 1.0f;
+	for(int corner = 0; corner < 8; ++corner)
+	{
+		const glm::vec3 p((corner & 1) ? boundsMax.x : boundsMin.x,
+						  (corner & 2) ? boundsMax.y : boundsMin.y,
+						  (corner & 4) ? boundsMax.z : boundsMin.z);
+		const glm::vec4 clip = matrix * glm::vec4(p, 1.0f);
+		// la boite traverse le plan proche : on la considere visible
+		if(clip.w < MinClipW)
+			return false;
+		const float invW = 1.0f / clip.w;
+		const float x = (clip.x * invW * 0.5f + 0.5f) * m_Width;
+		const float y = (clip.y * invW * 0.5f + 0.5f) * m_Height;
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		nearestDepth = std::min(nearestDepth, clip.z * invW * 0.5f + 0.5f);
+	}
+
+	const int x0 = std::max((int) floorf(minX), 0);
+	const int y0 = std::max((int) floorf(minY), 0);
+	const int x1 = std::min((int) floorf(maxX), m_Width - 1);
+	const int y1 = std::min((int) floorf(maxY), m_Height - 1);
+	// hors ecran : c'est au frustum culling de decider
+	if(x0 > x1 || y0 > y1)
+		return false;
+
+	// niveau ou le rectangle couvre au plus 4 x 4 texels
+	int level = 0;
+	while(level + 1 < (int) m_MaxLevels.size() && (((x1 >> level) - (x0 >> level)) > 3 || ((y1 >> level) - (y0 >> level)) > 3))
+		++level;
+
+	// niveau grossier (au plus 2 x 2 texels) : la boite est devant tous les occulteurs
+	// ou derriere le plus lointain, on conclut sans descendre
+	const int coarse = std::min(level + 1, (int) m_MaxLevels.size() - 1);
+	{
+		float coarseMin = 1.0f, coarseMax = 0.0f;
+		const int width = m_LevelWidth[coarse];
+		for(int y = y0 >> coarse; y <= (y1 >> coarse); ++y)
+		{
+			for(int x = x0 >> coarse; x <= (x1 >> coarse); ++x)
+			{
+				coarseMin = std::min(coarseMin, m_MinLevels[coarse][y * width + x]);
+				coarseMax = std::max(coarseMax, m_MaxLevels[coarse][y * width + x]);
+			}
+		}
+		if(nearestDepth <= coarseMin)
+			return false;
+		if(nearestDepth > coarseMax)
+			return true;
+	}
+
+	const int width = m_LevelWidth[level];
+	for(int y = y0 >> level; y <= (y1 >> level); ++y)
+	{
+		for(int x = x0 >> level; x <= (x1 >> level); ++x)
+		{
+			if(m_MaxLevels[level][y * width + x] >= nearestDepth)
+				return false;
+		}
+	}
+	return true;
+}
+
+void BuildConservativeOccluder(const std::vector<float>& positions, const uint32_t* indices, size_t indexCount, float error,
+							   std::vector<float>& occluderPositions, std::vector<uint32_t>& occluderIndices)
+{
+	// soudure par position : les coutures d'UV ou de normales ne doivent pas ouvrir de fente en deplacant les sommets
+	struct PositionLess
+	{
+		bool operator()(const glm::vec3& a, const glm::vec3& b) const
+		{
+			if(a.x != b.x) return a.x < b.x;
+			if(a.y != b.y) return a.y < b.y;
+			return a.z < b.z;
+		}
+	};
+	std::map<glm::vec3, uint32_t, PositionLess> welded;
+	std::vector<glm::vec3> points;
+	occluderIndices.resize(indexCount);
+	for(size_t i = 0; i < indexCount; ++i)
+	{
+		const float* p = &positions[indices[i] * 3];
+		const glm::vec3 point(p[0], p[1], p[2]);
+		std::map<glm::vec3, uint32_t, PositionLess>::iterator found = welded.find(point);
+		if(found == welded.end())
+		{
+			found = welded.insert(std::make_pair(point, (uint32_t) points.size())).first;
+			points.push_back(point);
+		}
+		occluderIndices[i] = found->second;
+	}
+
+	// normales des sommets ponderees par l'aire des faces (faces avant dans le sens trigonometrique : vers l'exterieur)
+	std::vector<glm::vec3> normals(points.size(), glm::vec3(0.0f));
+	std::vector<glm::vec3> faceNormals(indexCount / 3);
+	for(size_t t = 0; t + 2 < indexCount; t += 3)
+	{
+		const glm::vec3& a = points[occluderIndices[t]];
+		const glm::vec3 normal = glm::cross(points[occluderIndices[t + 1]] - a, points[occluderIndices[t + 2]] - a);
+		for(int corner = 0; corner < 3; ++corner)
+			normals[occluderIndices[t + corner]] += normal;
+		const float length = glm::length(normal);
+		faceNormals[t / 3] = length > 0.0f ? normal / length : glm::vec3(0.0f);
+	}
+	for(size_t v = 0; v < normals.size(); ++v)
+	{
+		const float length = glm::length(normals[v]);
+		normals[v] = length > 0.0f ? normals[v] / length : glm::vec3(0.0f);
+	}
+
+	// une face recule de deplacement * dot(normale du sommet, normale de la face) : le deplacement est divise par
+	// le plus petit de ces cosinus autour du sommet (borne pour les sommets tres pointus). L'erreur est estimee
+	// par echantillonnage (ComputeHausdorffDistance) et peut etre un peu depassee entre deux points : marge de 25 %
+	std::vector<float> minCosine(points.size(), 1.0f);
+	for(size_t t = 0; t + 2 < indexCount; t += 3)
+	{
+		for(int corner = 0; corner < 3; ++corner)
+		{
+			const uint32_t v = occluderIndices[t + corner];
+			minCosine[v] = std::min(minCosine[v], glm::dot(normals[v], faceNormals[t / 3]));
+		}
+	}
+	occluderPositions.resize(points.size() * 3);
+	for(size_t v = 0; v < points.size(); ++v)
+	{
+		const glm::vec3 point = points[v] - normals[v] * (1.25f * error / std::max(minCosine[v], 0.5f));
+		occluderPositions[v * 3 + 0] = point.x;
+		occluderPositions[v * 3 + 1] = point.y;
+		occluderPositions[v * 3 + 2] = point.z;
+	}
+}
@@ -0,0 +1,77 @@
+#ifndef __OCCLUSION_CULLING_H__
+#define __OCCLUSION_CULLING_H__
+
+#include <vector>
+#include <cstdint>
+
+#include "glm/glm.hpp"
+
+// Occlusion culling logiciel, entierement sur le CPU (aucun appel OpenGL) :
+// - les occulteurs (meshs simplifies) sont rasterises dans un petit depth buffer decoupe en tuiles,
+//   chaque tuile est traitee par un thread et 4 pixels a la fois avec SSE
+// - on construit ensuite une hierarchie min/max de ce depth buffer (HiZ)
+// - une instance est cachee si le point le plus proche de sa boite est derriere
+//   la profondeur la plus lointaine des occulteurs sur toute sa surface a l'ecran
+// Les profondeurs sont celles d'OpenGL ramenees dans [0, 1] (0 = plan proche).
+class OcclusionCuller
+{
+public:
+	static const int TileSize = 32;
+
+	OcclusionCuller() : m_Width(0), m_Height(0), m_TilesX(0), m_TilesY(0) {}
+
+	// la resolution est arrondie au multiple de TileSize superieur
+	void Create(int width, int height);
+
+	// vide le depth buffer et la liste d'occulteurs
+	void Begin(const glm::mat4& viewProjection);
+	// triangles de positions locales (3 floats par sommet), faces avant dans le sens trigonometrique
+	void AddOccluder(const std::vector<float>& positions, const std::vector<uint32_t>& indices, const glm::mat4& worldMatrix);
+	// rasterisation parallele des occulteurs puis construction de la hierarchie
+	void Rasterize();
+
+	// true si la boite locale [boundsMin, boundsMax] transformee par worldMatrix est entierement cachee
+	bool IsOccluded(const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::mat4& worldMatrix) const;
+
+	inline int GetWidth() const { return m_Width; }
+	inline int GetHeight() const { return m_Height; }
+	inline size_t GetTriangleCount() const { return m_Triangles.size(); }
+	// niveau 0 du depth buffer, ligne 0 en bas
+	inline const float* GetDepth() const { return &m_MaxLevels[0][0]; }
+
+private:
+	// triangle en coordonnees ecran (pixels) avec les equations de ses aretes et de sa profondeur
+	struct Triangle
+	{
+		float edgeA[3], edgeB[3], edgeC[3];		// arete i : A.x + B.y + C >= 0 a l'interieur
+		float depthA, depthB, depthC;			// z = A.x + B.y + C
+		int minX, minY, maxX, maxY;				// boite englobante en pixels (inclusive)
+	};
+
+	void RasterizeTile(int tile);
+	void BuildHierarchy();
+
+	int m_Width, m_Height;
+	int m_TilesX, m_TilesY;
+	glm::mat4 m_ViewProjection;
+
+	std::vector<Triangle> m_Triangles;
+	std::vector<std::vector<uint32_t> > m_TileBins;		// triangles qui touchent chaque tuile
+
+	// m_MaxLevels[0] == m_MinLevels[0] == depth buffer, niveau n = reduction 2x2 du niveau n-1
+	std::vector<std::vector<float> > m_MaxLevels;
+	std::vector<std::vector<float> > m_MinLevels;
+	std::vector<int> m_LevelWidth, m_LevelHeight;
+};
+
+// Occulteur conservatif tire d'un niveau simplifie : chaque point du niveau est a moins de error (distance de
+// Hausdorff) de la surface d'origine, il peut donc deborder de la silhouette reelle et cacher a tort ce qui est
+// juste derriere. Les sommets, soudes par position, sont rentres le long de leur normale assez pour que chaque
+// face recule d'au moins error : l'occulteur reste dans le volume d'origine tant que error est petit devant le
+// mesh (au-dela, le retrait replie la surface sur elle-meme) : voir OccluderMaxError.
+// erreur maximale du niveau choisi comme occulteur, relative au rayon de la sphere englobante
+static const float OccluderMaxError = 0.1f;
+void BuildConservativeOccluder(const std::vector<float>& positions, const uint32_t* indices, size_t indexCount, float error,
+							   std::vector<float>& occluderPositions, std::vector<uint32_t>& occluderIndices);
+
+#endif //__OCCLUSION_CULLING_H__
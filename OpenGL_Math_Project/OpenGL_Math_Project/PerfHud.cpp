@@ -0,0 +1,323 @@
+#include "PerfHud.h"
+
+#include <cstdio>
+#include <cstring>
+#include <cstddef>
+#include <algorithm>
+
+#include "stb/stb_easy_font.h"
+
+// le texte stb_easy_font fait 12 unites par ligne, agrandi d'un facteur TextScale
+static const float TextScale = 1.5f;
+static const float LineHeight = 12.0f * TextScale;
+static const float PanelWidth = 350.0f;
+static const float Margin = 8.0f;
+static const float GraphHeight = 36.0f;
+static const char* HudPassName = "Overlay";
+
+static const uint8_t PanelColor[4] = { 0, 0, 0, 160 };
+static const uint8_t TextColor[4] = { 255, 255, 255, 255 };
+static const uint8_t DimColor[4] = { 170, 170, 170, 255 };
+static const uint8_t GraphBackColor[4] = { 40, 40, 40, 200 };
+static const uint8_t CpuColor[4] = { 90, 200, 255, 255 };
+static const uint8_t GpuColor[4] = { 255, 170, 60, 255 };
+static const uint8_t DrawCallColor[4] = { 140, 230, 110, 255 };
+
+static float Milliseconds(std::chrono::high_resolution_clock::duration duration)
+{
+	return std::chrono::duration<float, std::milli>(duration).count();
+}
+
+void PerfHud::Create()
+{
+	m_Shader.LoadVertexShader("hud.vs");
+	m_Shader.LoadFragmentShader("hud.fs");
+	m_Shader.Create();
+
+	// deux triangles par quad, dans l'ordre des sommets de stb_easy_font (sens horaire a l'ecran)
+	std::vector<uint16_t> indices(MaxQuads * 6);
+	for(int quad = 0; quad < MaxQuads; ++quad)
+	{
+		const uint16_t first = (uint16_t) (quad * 4);
+		uint16_t* index = &indices[quad * 6];
+		index[0] = first; index[1] = first + 1; index[2] = first + 2;
+		index[3] = first; index[4] = first + 2; index[5] = first + 3;
+	}
+	m_Vertices.resize(MaxQuads * 4);
+
+	glGenVertexArrays(1, &m_VAO);
+	glBindVertexArray(m_VAO);
+	glGenBuffers(1, &m_IndexBuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_IndexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint16_t), &indices[0], GL_STATIC_DRAW);
+	glGenBuffers(1, &m_VertexBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, m_VertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, m_Vertices.size() * sizeof(Vertex), nullptr, GL_STREAM_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*) offsetof(Vertex, x));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), (GLvoid*) offsetof(Vertex, color));
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	m_TimerQueries = GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+	for(int i = 0; i < QueryLatency; ++i)
+	{
+		if(m_TimerQueries)
+			glGenQueries(MaxPasses + 1, m_Queries[i].queries);
+		m_Queries[i].markCount = 0;
+	}
+	std::fill(m_CpuHistory, m_CpuHistory + HistorySize, 0.0f);
+	std::fill(m_GpuHistory, m_GpuHistory + HistorySize, 0.0f);
+	std::fill(m_DrawCallHistory, m_DrawCallHistory + HistorySize, 0.0f);
+	m_Frame = 0;
+	m_HistoryIndex = m_HistoryCount = 0;
+}
+
+void PerfHud::Destroy()
+{
+	if(m_TimerQueries)
+	{
+		for(int i = 0; i < QueryLatency; ++i)
+			glDeleteQueries(MaxPasses + 1, m_Queries[i].queries);
+	}
+	m_TimerQueries = false;
+	if(m_VAO)
+		glDeleteVertexArrays(1, &m_VAO);
+	if(m_VertexBuffer)
+		glDeleteBuffers(1, &m_VertexBuffer);
+	if(m_IndexBuffer)
+		glDeleteBuffers(1, &m_IndexBuffer);
+	m_VAO = m_VertexBuffer = m_IndexBuffer = 0;
+	m_Shader.Destroy();
+	std::vector<Vertex>().swap(m_Vertices);
+}
+
+void PerfHud::BeginFrame()
+{
+	const std::chrono::high_resolution_clock::time_point now = std::chrono::high_resolution_clock::now();
+	if(m_Frame > 0)
+		m_CpuFrameTime = Milliseconds(now - m_FrameStart);
+	m_FrameStart = now;
+
+	// le slot de cette frame a servi QueryLatency frames plus tot
+	FrameQueries& frame = m_Queries[m_Frame % QueryLatency];
+	if(m_TimerQueries && frame.markCount > 1)
+		CollectQueries(frame);
+	frame.markCount = 0;
+}
+
+void PerfHud::CollectQueries(FrameQueries& frame)
+{
+	// les timestamps se terminent dans l'ordre : si le dernier est pret, tous le sont
+	GLint available = 0;
+	glGetQueryObjectiv(frame.queries[frame.markCount - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+	if(!available)
+	{
+		++m_LostFrames;
+		return;
+	}
+
+	GLuint64 timestamps[MaxPasses + 1];
+	for(int i = 0; i < frame.markCount; ++i)
+		glGetQueryObjectui64v(frame.queries[i], GL_QUERY_RESULT, &timestamps[i]);
+
+	m_PassNames.clear();
+	m_PassTimes.clear();
+	m_HudGpuTime = 0.0f;
+	for(int i = 0; i + 1 < frame.markCount; ++i)
+	{
+		const float time = (float) ((timestamps[i + 1] - timestamps[i]) / 1.0e6);
+		if(frame.names[i] == HudPassName)
+		{
+			m_HudGpuTime = time;
+			continue;
+		}
+		m_PassNames.push_back(frame.names[i]);
+		m_PassTimes.push_back(time);
+	}
+	m_GpuFrameTime = (float) ((timestamps[frame.markCount - 1] - timestamps[0]) / 1.0e6);
+}
+
+void PerfHud::MarkPass(const char* name)
+{
+	FrameQueries& frame = m_Queries[m_Frame % QueryLatency];
+	// le dernier timestamp est reserve a la fin de la frame
+	if(!m_TimerQueries || frame.markCount >= MaxPasses)
+		return;
+	glQueryCounter(frame.queries[frame.markCount], GL_TIMESTAMP);
+	frame.names[frame.markCount++] = name;
+}
+
+void PerfHud::EndFrame(const FrameStats& stats, int width, int height)
+{
+	const std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	m_CpuRenderTime = Milliseconds(start - m_FrameStart);
+
+	m_CpuHistory[m_HistoryIndex] = m_CpuFrameTime;
+	m_GpuHistory[m_HistoryIndex] = m_GpuFrameTime;
+	m_DrawCallHistory[m_HistoryIndex] = (float) stats.drawCalls;
+	m_HistoryIndex = (m_HistoryIndex + 1) % HistorySize;
+	m_HistoryCount = std::min(m_HistoryCount + 1, HistorySize);
+
+	if(m_Visible)
+	{
+		MarkPass(HudPassName);
+		BuildGeometry(stats, width);
+
+		m_HudUploadBytes = m_QuadCount * 4 * sizeof(Vertex);
+		glBindBuffer(GL_ARRAY_BUFFER, m_VertexBuffer);
+		// orphelinage comme pour le DrawBatch : pas d'attente sur le dessin de la frame precedente
+		glBufferData(GL_ARRAY_BUFFER, m_Vertices.size() * sizeof(Vertex), nullptr, GL_STREAM_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, m_HudUploadBytes, &m_Vertices[0]);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		const GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+		const GLboolean cullFace = glIsEnabled(GL_CULL_FACE);
+		const GLboolean blend = glIsEnabled(GL_BLEND);
+		glDisable(GL_DEPTH_TEST);
+		glDisable(GL_CULL_FACE);
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+		glUseProgram(m_Shader.GetProgram());
+		glUniform2f(glGetUniformLocation(m_Shader.GetProgram(), "u_screenSize"), (float) width, (float) height);
+		glBindVertexArray(m_VAO);
+		glDrawElements(GL_TRIANGLES, m_QuadCount * 6, GL_UNSIGNED_SHORT, 0);
+		glBindVertexArray(0);
+		glUseProgram(0);
+
+		if(depthTest)
+			glEnable(GL_DEPTH_TEST);
+		if(cullFace)
+			glEnable(GL_CULL_FACE);
+		if(!blend)
+			glDisable(GL_BLEND);
+	}
+	else
+	{
+		m_HudUploadBytes = 0;
+	}
+
+	// ferme la derniere passe
+	FrameQueries& frame = m_Queries[m_Frame % QueryLatency];
+	if(m_TimerQueries && frame.markCount > 0)
+		glQueryCounter(frame.queries[frame.markCount++], GL_TIMESTAMP);
+	++m_Frame;
+
+	m_HudCpuTime = m_Visible ? Milliseconds(std::chrono::high_resolution_clock::now() - start) : 0.0f;
+}
+
+void PerfHud::AddQuad(float x0, float y0, float x1, float y1, const uint8_t color[4])
+{
+	if(m_QuadCount >= MaxQuads)
+		return;
+	Vertex* vertex = &m_Vertices[m_QuadCount * 4];
+	const float xs[4] = { x0, x1, x1, x0 };
+	const float ys[4] = { y0, y0, y1, y1 };
+	for(int i = 0; i < 4; ++i)
+	{
+		vertex[i].x = xs[i];
+		vertex[i].y = ys[i];
+		vertex[i].z = 0.0f;
+		memcpy(vertex[i].color, color, 4);
+	}
+	++m_QuadCount;
+}
+
+// Ecrit une ligne de texte, retourne l'ordonnee de la ligne suivante
+float PerfHud::AddText(float x, float y, const char* text, const uint8_t color[4])
+{
+	// tampon plein : &m_Vertices[m_QuadCount * 4] serait hors du vecteur
+	if(m_QuadCount >= MaxQuads)
+		return y + LineHeight;
+	char line[128];
+	strncpy(line, text, sizeof(line) - 1);
+	line[sizeof(line) - 1] = '\0';
+	unsigned char textColor[4] = { color[0], color[1], color[2], color[3] };
+
+	Vertex* first = &m_Vertices[m_QuadCount * 4];
+	const int quads = stb_easy_font_print(0.0f, 0.0f, line, textColor, first, (MaxQuads - m_QuadCount) * 4 * (int) sizeof(Vertex));
+	for(int i = 0; i < quads * 4; ++i)
+	{
+		first[i].x = x + first[i].x * TextScale;
+		first[i].y = y + first[i].y * TextScale;
+	}
+	m_QuadCount += quads;
+	return y + LineHeight;
+}
+
+// Historique en barres, du plus ancien (a gauche) au plus recent, sur une hauteur de maxValue
+void PerfHud::AddGraph(float x, float y, const char* label, const float* history, float maxValue, const uint8_t color[4])
+{
+	y = AddText(x, y, label, DimColor);
+	const float barWidth = (PanelWidth - 2.0f * Margin) / HistorySize;
+	AddQuad(x, y, x + barWidth * HistorySize, y + GraphHeight, GraphBackColor);
+	for(int i = 0; i < m_HistoryCount; ++i)
+	{
+		const float value = history[(m_HistoryIndex - m_HistoryCount + i + HistorySize) % HistorySize];
+		const float barHeight = std::min(value / maxValue, 1.0f) * GraphHeight;
+		const float left = x + barWidth * (HistorySize - m_HistoryCount + i);
+		AddQuad(left, y + GraphHeight - barHeight, left + barWidth, y + GraphHeight, color);
+	}
+}
+
+void PerfHud::BuildGeometry(const FrameStats& stats, int width)
+{
+	const float left = std::max((float) width - PanelWidth - Margin, 0.0f);
+	const float x = left + Margin;
+	float y = Margin * 2.0f;
+	char text[128];
+
+	// le fond est le premier quad, sa hauteur n'est connue qu'a la fin
+	m_QuadCount = 0;
+	AddQuad(0.0f, 0.0f, 0.0f, 0.0f, PanelColor);
+
+	snprintf(text, sizeof(text), "Image CPU %.2f ms (%.0f ips)", m_CpuFrameTime, m_CpuFrameTime > 0.0f ? 1000.0f / m_CpuFrameTime : 0.0f);
+	y = AddText(x, y, text, TextColor);
+	snprintf(text, sizeof(text), "Rendu CPU %.2f ms", m_CpuRenderTime);
+	y = AddText(x, y, text, TextColor);
+	if(m_TimerQueries)
+	{
+		snprintf(text, sizeof(text), "Image GPU %.2f ms (%d perdues)", m_GpuFrameTime, m_LostFrames);
+		y = AddText(x, y, text, TextColor);
+		for(size_t pass = 0; pass < m_PassNames.size(); ++pass)
+		{
+			snprintf(text, sizeof(text), "  %-11s %.3f ms", m_PassNames[pass], m_PassTimes[pass]);
+			y = AddText(x, y, text, DimColor);
+		}
+	}
+	else
+	{
+		y = AddText(x, y, "Requetes de temps GPU absentes", DimColor);
+	}
+	snprintf(text, sizeof(text), "Appels %d  Triangles %d", stats.drawCalls, stats.triangles);
+	y = AddText(x, y, text, TextColor);
+	snprintf(text, sizeof(text), "Etats %d  Envois %.1f Ko", stats.stateChanges, stats.uploadBytes / 1024.0f);
+	y = AddText(x, y, text, TextColor);
+	snprintf(text, sizeof(text), "Overlay %.3f ms CPU %.3f ms GPU %.1f Ko", m_HudCpuTime, m_HudGpuTime, m_HudUploadBytes / 1024.0f);
+	y = AddText(x, y, text, DimColor);
+
+	// echelles fixes pour les temps (33 ms = 30 fps), automatique pour les appels
+	float maxDrawCalls = 1.0f;
+	for(int i = 0; i < HistorySize; ++i)
+		maxDrawCalls = std::max(maxDrawCalls, m_DrawCallHistory[i]);
+	y += Margin;
+	AddGraph(x, y, "Image CPU ms (0-33)", m_CpuHistory, 33.3f, CpuColor);
+	y += LineHeight + GraphHeight + Margin;
+	AddGraph(x, y, "Image GPU ms (0-33)", m_GpuHistory, 33.3f, GpuColor);
+	y += LineHeight + GraphHeight + Margin;
+	snprintf(text, sizeof(text), "Appels (0-%.0f)", maxDrawCalls);
+	AddGraph(x, y, text, m_DrawCallHistory, maxDrawCalls, DrawCallColor);
+	y += LineHeight + GraphHeight + Margin;
+
+	// fond du panneau
+	const float xs[4] = { left, left + PanelWidth, left + PanelWidth, left };
+	const float ys[4] = { Margin, Margin, y, y };
+	for(int i = 0; i < 4; ++i)
+	{
+		m_Vertices[i].x = xs[i];
+		m_Vertices[i].y = ys[i];
+	}
+}
@@ -0,0 +1,108 @@
+#ifndef __PERF_HUD_H__
+#define __PERF_HUD_H__
+
+#include <vector>
+#include <chrono>
+#include <cstdint>
+
+#include "Common.h"
+#include "EsgiShader.h"
+
+// Compteurs d'une frame, remplis par le rendu au fil des passes
+struct FrameStats
+{
+	int drawCalls;
+	int triangles;
+	int stateChanges;		// programmes, VAO et textures lies
+	size_t uploadBytes;		// octets envoyes dans des buffers ou des textures
+
+	FrameStats() : drawCalls(0), triangles(0), stateChanges(0), uploadBytes(0) {}
+};
+
+// Overlay de performances dessine par-dessus la TweakBar :
+// - temps CPU de la frame et du rendu, temps GPU de chaque passe (glQueryCounter, relus QueryLatency
+//   frames plus tard sans jamais attendre le GPU : une frame pas encore prete est simplement perdue)
+// - compteurs de FrameStats et historiques glissants (CPU, GPU, appels de dessin) en barres
+// - texte stb_easy_font et barres sont des quads ecrits dans un seul vertex buffer dynamique,
+//   dessines en un seul glDrawElements. Le cout du HUD lui-meme (CPU, GPU, octets) est affiche.
+class PerfHud
+{
+public:
+	static const int HistorySize = 120;
+	static const int MaxPasses = 8;
+	static const int QueryLatency = 3;
+	static const int MaxQuads = 16384;		// 4 sommets par quad : les indices tiennent sur 16 bits
+
+	PerfHud() : m_Visible(true), m_VAO(0), m_VertexBuffer(0), m_IndexBuffer(0), m_TimerQueries(false), m_Frame(0)
+			  , m_GpuFrameTime(0.0f), m_HudGpuTime(0.0f), m_LostFrames(0), m_HistoryIndex(0), m_HistoryCount(0)
+			  , m_CpuFrameTime(0.0f), m_CpuRenderTime(0.0f), m_HudCpuTime(0.0f), m_HudUploadBytes(0), m_QuadCount(0) {}
+
+	void Create();
+	void Destroy();
+
+	// debut de Render : recupere les timestamps emis QueryLatency frames plus tot
+	void BeginFrame();
+	// la passe precedente se termine ici et la passe name commence (name doit rester valide)
+	void MarkPass(const char* name);
+	// fin de la frame, apres TwDraw : dessine le HUD s'il est visible
+	void EndFrame(const FrameStats& stats, int width, int height);
+
+	inline bool IsVisible() const { return m_Visible; }
+	inline void Toggle() { m_Visible = !m_Visible; }
+
+private:
+	struct Vertex
+	{
+		float x, y, z;
+		uint8_t color[4];		// format de stb_easy_font_print
+	};
+
+	struct FrameQueries
+	{
+		GLuint queries[MaxPasses + 1];
+		const char* names[MaxPasses];
+		int markCount;			// timestamps emis, le dernier ferme la derniere passe
+	};
+
+	void CollectQueries(FrameQueries& frame);
+	void AddQuad(float x0, float y0, float x1, float y1, const uint8_t color[4]);
+	float AddText(float x, float y, const char* text, const uint8_t color[4]);
+	void AddGraph(float x, float y, const char* label, const float* history, float maxValue, const uint8_t color[4]);
+	void BuildGeometry(const FrameStats& stats, int width);
+
+	bool m_Visible;
+	EsgiShader m_Shader;
+	GLuint m_VAO;
+	GLuint m_VertexBuffer;
+	GLuint m_IndexBuffer;
+
+	bool m_TimerQueries;		// GL 3.3 ou ARB_timer_query, sinon pas de temps GPU
+	FrameQueries m_Queries[QueryLatency];
+	uint32_t m_Frame;
+	std::chrono::high_resolution_clock::time_point m_FrameStart;
+
+	// derniers temps GPU relus, en millisecondes
+	std::vector<const char*> m_PassNames;
+	std::vector<float> m_PassTimes;
+	float m_GpuFrameTime;
+	float m_HudGpuTime;
+	int m_LostFrames;		// timestamps pas encore disponibles apres QueryLatency frames
+
+	// historiques circulaires : m_HistoryCount echantillons, le prochain est ecrit en m_HistoryIndex
+	float m_CpuHistory[HistorySize];
+	float m_GpuHistory[HistorySize];
+	float m_DrawCallHistory[HistorySize];
+	int m_HistoryIndex;
+	int m_HistoryCount;
+
+	// temps CPU en millisecondes
+	float m_CpuFrameTime;
+	float m_CpuRenderTime;
+	float m_HudCpuTime;
+	size_t m_HudUploadBytes;
+
+	std::vector<Vertex> m_Vertices;
+	int m_QuadCount;
+};
+
+#endif //__PERF_HUD_H__
@@ -0,0 +1,142 @@
+#ifndef __RAY_PACKET_H__
+#define __RAY_PACKET_H__
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// Flottants par paquets de 8 : AVX si le compilateur le permet (/arch:AVX), sinon deux registres SSE,
+// sinon une boucle scalaire. Les masques sont des Float8 dont les lignes valent 0 ou 0xffffffff.
+#if defined(__AVX__)
+#define RAY_PACKET_USE_AVX 1
+#include <immintrin.h>
+#elif defined(_M_IX86) || defined(_M_X64) || defined(__SSE__)
+#define RAY_PACKET_USE_SSE 1
+#include <emmintrin.h>
+#endif
+
+struct Float8
+{
+#if defined(RAY_PACKET_USE_AVX)
+	__m256 v;
+#elif defined(RAY_PACKET_USE_SSE)
+	__m128 lo, hi;
+#else
+	float f[8];
+#endif
+};
+
+#if defined(RAY_PACKET_USE_AVX)
+
+inline Float8 Set1(float value) { Float8 r; r.v = _mm256_set1_ps(value); return r; }
+inline Float8 Load8(const float* values) { Float8 r; r.v = _mm256_loadu_ps(values); return r; }
+inline void Store8(float* values, const Float8& a) { _mm256_storeu_ps(values, a.v); }
+inline Float8 operator+(const Float8& a, const Float8& b) { Float8 r; r.v = _mm256_add_ps(a.v, b.v); return r; }
+inline Float8 operator-(const Float8& a, const Float8& b) { Float8 r; r.v = _mm256_sub_ps(a.v, b.v); return r; }
+inline Float8 operator*(const Float8& a, const Float8& b) { Float8 r; r.v = _mm256_mul_ps(a.v, b.v); return r; }
+inline Float8 operator/(const Float8& a, const Float8& b) { Float8 r; r.v = _mm256_div_ps(a.v, b.v); return r; }
+inline Float8 Min(const Float8& a, const Float8& b) { Float8 r; r.v = _mm256_min_ps(a.v, b.v); return r; }
+inline Float8 Max(const Float8& a, const Float8& b) { Float8 r; r.v = _mm256_max_ps(a.v, b.v); return r; }
+inline Float8 Sqrt(const Float8& a) { Float8 r; r.v = _mm256_sqrt_ps(a.v); return r; }
+inline Float8 CmpLt(const Float8& a, const Float8& b) { Float8 r; r.v = _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ); return r; }
+inline Float8 CmpLe(const Float8& a, const Float8& b) { Float8 r; r.v = _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ); return r; }
+inline Float8 CmpGt(const Float8& a, const Float8& b) { Float8 r; r.v = _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ); return r; }
+inline Float8 CmpGe(const Float8& a, const Float8& b) { Float8 r; r.v = _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ); return r; }
+inline Float8 operator&(const Float8& a, const Float8& b) { Float8 r; r.v = _mm256_and_ps(a.v, b.v); return r; }
+inline Float8 operator|(const Float8& a, const Float8& b) { Float8 r; r.v = _mm256_or_ps(a.v, b.v); return r; }
+// mask ? a : b
+inline Float8 Select(const Float8& mask, const Float8& a, const Float8& b) { Float8 r; r.v = _mm256_blendv_ps(b.v, a.v, mask.v); return r; }
+inline int MoveMask(const Float8& mask) { return _mm256_movemask_ps(mask.v); }
+
+#elif defined(RAY_PACKET_USE_SSE)
+
+inline Float8 Set1(float value) { Float8 r; r.lo = r.hi = _mm_set1_ps(value); return r; }
+inline Float8 Load8(const float* values) { Float8 r; r.lo = _mm_loadu_ps(values); r.hi = _mm_loadu_ps(values + 4); return r; }
+inline void Store8(float* values, const Float8& a) { _mm_storeu_ps(values, a.lo); _mm_storeu_ps(values + 4, a.hi); }
+#define RAY_PACKET_SSE_BINARY(name, intrinsic) \
+	inline Float8 name(const Float8& a, const Float8& b) { Float8 r; r.lo = intrinsic(a.lo, b.lo); r.hi = intrinsic(a.hi, b.hi); return r; }
+RAY_PACKET_SSE_BINARY(operator+, _mm_add_ps)
+RAY_PACKET_SSE_BINARY(operator-, _mm_sub_ps)
+RAY_PACKET_SSE_BINARY(operator*, _mm_mul_ps)
+RAY_PACKET_SSE_BINARY(operator/, _mm_div_ps)
+RAY_PACKET_SSE_BINARY(Min, _mm_min_ps)
+RAY_PACKET_SSE_BINARY(Max, _mm_max_ps)
+RAY_PACKET_SSE_BINARY(CmpLt, _mm_cmplt_ps)
+RAY_PACKET_SSE_BINARY(CmpLe, _mm_cmple_ps)
+RAY_PACKET_SSE_BINARY(CmpGt, _mm_cmpgt_ps)
+RAY_PACKET_SSE_BINARY(CmpGe, _mm_cmpge_ps)
+RAY_PACKET_SSE_BINARY(operator&, _mm_and_ps)
+RAY_PACKET_SSE_BINARY(operator|, _mm_or_ps)
+#undef RAY_PACKET_SSE_BINARY
+inline Float8 Sqrt(const Float8& a) { Float8 r; r.lo = _mm_sqrt_ps(a.lo); r.hi = _mm_sqrt_ps(a.hi); return r; }
+inline Float8 Select(const Float8& mask, const Float8& a, const Float8& b)
+{
+	Float8 r;
+	r.lo = _mm_or_ps(_mm_and_ps(mask.lo, a.lo), _mm_andnot_ps(mask.lo, b.lo));
+	r.hi = _mm_or_ps(_mm_and_ps(mask.hi, a.hi), _mm_andnot_ps(mask.hi, b.hi));
+	return r;
+}
+inline int MoveMask(const Float8& mask) { return _mm_movemask_ps(mask.lo) | (_mm_movemask_ps(mask.hi) << 4); }
+
+#else
+
+inline float MaskLane(bool value) { const uint32_t bits = value ? 0xffffffffu : 0u; float f; memcpy(&f, &bits, 4); return f; }
+inline uint32_t LaneBits(float value) { uint32_t bits; memcpy(&bits, &value, 4); return bits; }
+inline Float8 Set1(float value) { Float8 r; for(int i = 0; i < 8; ++i) r.f[i] = value; return r; }
+inline Float8 Load8(const float* values) { Float8 r; memcpy(r.f, values, sizeof(r.f)); return r; }
+inline void Store8(float* values, const Float8& a) { memcpy(values, a.f, sizeof(a.f)); }
+#define RAY_PACKET_SCALAR_BINARY(name, expression) \
+	inline Float8 name(const Float8& a, const Float8& b) { Float8 r; for(int i = 0; i < 8; ++i) { const float x = a.f[i], y = b.f[i]; r.f[i] = (expression); } return r; }
+RAY_PACKET_SCALAR_BINARY(operator+, x + y)
+RAY_PACKET_SCALAR_BINARY(operator-, x - y)
+RAY_PACKET_SCALAR_BINARY(operator*, x * y)
+RAY_PACKET_SCALAR_BINARY(operator/, x / y)
+RAY_PACKET_SCALAR_BINARY(Min, x < y ? x : y)
+RAY_PACKET_SCALAR_BINARY(Max, x > y ? x : y)
+RAY_PACKET_SCALAR_BINARY(CmpLt, MaskLane(x < y))
+RAY_PACKET_SCALAR_BINARY(CmpLe, MaskLane(x <= y))
+RAY_PACKET_SCALAR_BINARY(CmpGt, MaskLane(x > y))
+RAY_PACKET_SCALAR_BINARY(CmpGe, MaskLane(x >= y))
+RAY_PACKET_SCALAR_BINARY(operator&, MaskLane((LaneBits(x) & LaneBits(y)) != 0))
+RAY_PACKET_SCALAR_BINARY(operator|, MaskLane((LaneBits(x) | LaneBits(y)) != 0))
+#undef RAY_PACKET_SCALAR_BINARY
+inline Float8 Sqrt(const Float8& a) { Float8 r; for(int i = 0; i < 8; ++i) r.f[i] = sqrtf(a.f[i]); return r; }
+inline Float8 Select(const Float8& mask, const Float8& a, const Float8& b) { Float8 r; for(int i = 0; i < 8; ++i) r.f[i] = LaneBits(mask.f[i]) ? a.f[i] : b.f[i]; return r; }
+inline int MoveMask(const Float8& mask) { int bits = 0; for(int i = 0; i < 8; ++i) bits |= (LaneBits(mask.f[i]) ? 1 : 0) << i; return bits; }
+
+#endif
+
+// Paquet de 8 rayons (en pratique un bloc de 4x2 pixels, coherents)
+struct RayPacket
+{
+	Float8 originX, originY, originZ;
+	Float8 directionX, directionY, directionZ;
+	Float8 inverseDirectionX, inverseDirectionY, inverseDirectionZ;
+	Float8 active;			// masque des rayons a tracer
+};
+
+// Plus proche impact de chaque rayon du paquet, distance sert aussi de maxDistance pendant le parcours
+struct PacketHit
+{
+	Float8 distance;
+	Float8 u, v;			// barycentriques, voir TriangleHit
+	int32_t triangle[8];	// index du triangle dans le mesh d'origine
+	int32_t instance[8];	// -1 : aucun impact
+};
+
+// Test des dalles des 8 rayons contre une boite : retourne le masque des rayons actifs qui la touchent
+// avant maxDistance, enter recoit leur distance d'entree
+inline Float8 IntersectPacketAabb(const RayPacket& packet, const float* boundsMin, const float* boundsMax, const Float8& maxDistance, Float8& enter)
+{
+	const Float8 x0 = (Set1(boundsMin[0]) - packet.originX) * packet.inverseDirectionX;
+	const Float8 x1 = (Set1(boundsMax[0]) - packet.originX) * packet.inverseDirectionX;
+	const Float8 y0 = (Set1(boundsMin[1]) - packet.originY) * packet.inverseDirectionY;
+	const Float8 y1 = (Set1(boundsMax[1]) - packet.originY) * packet.inverseDirectionY;
+	const Float8 z0 = (Set1(boundsMin[2]) - packet.originZ) * packet.inverseDirectionZ;
+	const Float8 z1 = (Set1(boundsMax[2]) - packet.originZ) * packet.inverseDirectionZ;
+	enter = Max(Max(Min(x0, x1), Min(y0, y1)), Max(Min(z0, z1), Set1(0.0f)));
+	const Float8 exit = Min(Min(Max(x0, x1), Max(y0, y1)), Min(Max(z0, z1), maxDistance));
+	return CmpLe(enter, exit) & packet.active;
+}
+
+#endif //__RAY_PACKET_H__
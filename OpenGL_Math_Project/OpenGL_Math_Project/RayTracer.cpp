@@ -0,0 +1,505 @@
+#ifndef _CRT_SECURE_NO_WARNINGS
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "RayTracer.h"
+
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb/stb_image_write.h"
+
+#include "DynamicBvh.h"
+#include "Parallel.h"
+
+// decalage des origines des rayons d'ombre le long de la normale (unites monde)
+static const float ShadowBias = 1e-3f;
+// couleur des rayons perdus sans skybox (glClearColor)
+static const glm::vec4 BackgroundColor(0.5f, 0.5f, 0.5f, 1.0f);
+
+static inline uint32_t PackColor(const glm::vec4& color)
+{
+	const glm::vec4 c = glm::clamp(color, 0.0f, 1.0f) * 255.0f + 0.5f;
+	return (uint32_t) c.r | ((uint32_t) c.g << 8) | ((uint32_t) c.b << 16) | ((uint32_t) c.a << 24);
+}
+
+// --- SoftwareCubeMap -------------------------------------------------------
+
+bool SoftwareCubeMap::Load(const char* filenames[])
+{
+	for(int face = 0; face < 6; ++face)
+	{
+		if(!faces[face].Load(filenames[face]))
+			return false;
+	}
+	return true;
+}
+
+glm::vec4 SoftwareCubeMap::Sample(const glm::vec3& direction) const
+{
+	const glm::vec3 a = glm::abs(direction);
+	int face;
+	float sc, tc, ma;
+	if(a.x >= a.y && a.x >= a.z)
+	{
+		face = direction.x >= 0.0f ? 0 : 1;
+		sc = direction.x >= 0.0f ? -direction.z : direction.z;
+		tc = -direction.y;
+		ma = a.x;
+	}
+	else if(a.y >= a.z)
+	{
+		face = direction.y >= 0.0f ? 2 : 3;
+		sc = direction.x;
+		tc = direction.y >= 0.0f ? direction.z : -direction.z;
+		ma = a.y;
+	}
+	else
+	{
+		face = direction.z >= 0.0f ? 4 : 5;
+		sc = direction.z >= 0.0f ? direction.x : -direction.x;
+		tc = -direction.y;
+		ma = a.z;
+	}
+	if(ma <= 0.0f)
+		return BackgroundColor;
+	return faces[face].Sample((sc / ma + 1.0f) * 0.5f, (tc / ma + 1.0f) * 0.5f);
+}
+
+// --- Construction ----------------------------------------------------------
+
+RayTracer::RayTracer()
+	: m_NodeCount(0), m_Depth(0), m_Skybox(NULL), m_LightDirection(0.0f, 0.0f, -1.0f), m_Shadows(true), m_PacketTracing(true), m_ThreadCount(0), m_RayCount(0)
+{
+}
+
+void RayTracer::Begin()
+{
+	m_Instances.clear();
+	m_NodeCount = 0;
+	m_Depth = 0;
+}
+
+void RayTracer::AddInstance(const TriangleBvh& bvh, const SoftwareMesh& mesh, const glm::mat4& worldMatrix, const SoftwareTexture& texture)
+{
+	AddFlatInstance(bvh, mesh, worldMatrix, glm::vec4(1.0f));
+	m_Instances.back().texture = &texture;
+}
+
+void RayTracer::AddInstance(const TriangleBvh& bvh, const SoftwareMesh& mesh, const glm::mat4& worldMatrix,
+							const std::vector<Submesh>& submeshes, const std::vector<const SoftwareTexture*>& textures)
+{
+	AddFlatInstance(bvh, mesh, worldMatrix, glm::vec4(1.0f));
+	m_Instances.back().texture = textures[0];
+	m_Instances.back().submeshes = &submeshes;
+	m_Instances.back().textures = &textures;
+}
+
+void RayTracer::AddFlatInstance(const TriangleBvh& bvh, const SoftwareMesh& mesh, const glm::mat4& worldMatrix, const glm::vec4& color)
+{
+	Instance instance;
+	instance.bvh = &bvh;
+	instance.mesh = &mesh;
+	instance.texture = NULL;
+	instance.submeshes = NULL;
+	instance.textures = NULL;
+	instance.color = color;
+	instance.worldMatrix = worldMatrix;
+	instance.inverseWorldMatrix = glm::inverse(worldMatrix);
+	const Aabb bounds = TransformAabb(Aabb(bvh.GetBoundsMin(), bvh.GetBoundsMax()), worldMatrix);
+	instance.boundsMin = bounds.min;
+	instance.boundsMax = bounds.max;
+	m_Instances.push_back(instance);
+}
+
+void RayTracer::Build()
+{
+	m_Nodes.resize(std::max<size_t>(2 * m_Instances.size(), 1));
+	m_NodeCount = 1;
+	m_Depth = 0;
+	if(m_Instances.empty())
+	{
+		m_Nodes[0].triangleCount = 0;
+		m_Nodes[0].leftFirst = 0;
+		return;
+	}
+	BuildNode(0, 0, (uint32_t) m_Instances.size(), 0);
+}
+
+// Les plages sont peu nombreuses (une par materiau) : recherche lineaire
+const SoftwareTexture& RayTracer::TriangleTexture(const Instance& instance, int32_t triangle)
+{
+	if(instance.submeshes)
+	{
+		const uint32_t index = (uint32_t) triangle * 3;
+		for(size_t s = 0; s < instance.submeshes->size(); ++s)
+		{
+			const Submesh& submesh = (*instance.submeshes)[s];
+			if(index >= submesh.firstIndex && index < submesh.firstIndex + submesh.indexCount)
+				return *(*instance.textures)[submesh.material];
+		}
+	}
+	return *instance.texture;
+}
+
+// quelques dizaines d'instances : coupe au milieu de l'axe le plus etendu des centres, une instance par feuille
+void RayTracer::BuildNode(uint32_t nodeIndex, uint32_t first, uint32_t count, int depth)
+{
+	m_Depth = std::max(m_Depth, depth);
+	glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX), centerMin(FLT_MAX), centerMax(-FLT_MAX);
+	for(uint32_t i = first; i < first + count; ++i)
+	{
+		boundsMin = glm::min(boundsMin, m_Instances[i].boundsMin);
+		boundsMax = glm::max(boundsMax, m_Instances[i].boundsMax);
+		const glm::vec3 center = (m_Instances[i].boundsMin + m_Instances[i].boundsMax) * 0.5f;
+		centerMin = glm::min(centerMin, center);
+		centerMax = glm::max(centerMax, center);
+	}
+	TriangleBvhNode& node = m_Nodes[nodeIndex];
+	for(int axis = 0; axis < 3; ++axis)
+	{
+		node.boundsMin[axis] = boundsMin[axis];
+		node.boundsMax[axis] = boundsMax[axis];
+	}
+	if(count == 1)
+	{
+		node.leftFirst = first;
+		node.triangleCount = 1;
+		return;
+	}
+
+	const glm::vec3 extent = centerMax - centerMin;
+	const int axis = (extent.x >= extent.y && extent.x >= extent.z) ? 0 : (extent.y >= extent.z ? 1 : 2);
+	const uint32_t half = count / 2;
+	std::nth_element(m_Instances.begin() + first, m_Instances.begin() + first + half, m_Instances.begin() + first + count,
+					 [axis](const Instance& a, const Instance& b) { return a.boundsMin[axis] + a.boundsMax[axis] < b.boundsMin[axis] + b.boundsMax[axis]; });
+
+	const uint32_t left = m_NodeCount;
+	m_NodeCount += 2;
+	node.leftFirst = left;
+	node.triangleCount = 0;
+	BuildNode(left, first, half, depth + 1);
+	BuildNode(left + 1, first + half, count - half, depth + 1);
+}
+
+// --- Parcours --------------------------------------------------------------
+
+void RayTracer::TracePacket(const RayPacket& packet, PacketHit& hit) const
+{
+	if(m_NodeCount == 0)
+		return;
+
+	// chaque niveau laisse au plus un enfant sur la pile : pile locale, le tas seulement pour un arbre profond
+	uint32_t localStack[64];
+	std::vector<uint32_t> heapStack;
+	uint32_t* stack = localStack;
+	if(m_Depth >= 63)
+	{
+		heapStack.resize(m_Depth + 2);
+		stack = &heapStack[0];
+	}
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+	Float8 enter;
+	while(stackSize > 0)
+	{
+		const TriangleBvhNode& node = m_Nodes[stack[--stackSize]];
+		if(MoveMask(IntersectPacketAabb(packet, node.boundsMin, node.boundsMax, hit.distance, enter)) == 0)
+			continue;
+		if(node.triangleCount == 0)
+		{
+			stack[stackSize++] = node.leftFirst + 1;
+			stack[stackSize++] = node.leftFirst;
+			continue;
+		}
+
+		// paquet dans le repere local de l'instance : memes parametres t que dans le repere monde
+		const Instance& instance = m_Instances[node.leftFirst];
+		const glm::mat4& m = instance.inverseWorldMatrix;
+		RayPacket local;
+		local.originX = Set1(m[0][0]) * packet.originX + Set1(m[1][0]) * packet.originY + Set1(m[2][0]) * packet.originZ + Set1(m[3][0]);
+		local.originY = Set1(m[0][1]) * packet.originX + Set1(m[1][1]) * packet.originY + Set1(m[2][1]) * packet.originZ + Set1(m[3][1]);
+		local.originZ = Set1(m[0][2]) * packet.originX + Set1(m[1][2]) * packet.originY + Set1(m[2][2]) * packet.originZ + Set1(m[3][2]);
+		local.directionX = Set1(m[0][0]) * packet.directionX + Set1(m[1][0]) * packet.directionY + Set1(m[2][0]) * packet.directionZ;
+		local.directionY = Set1(m[0][1]) * packet.directionX + Set1(m[1][1]) * packet.directionY + Set1(m[2][1]) * packet.directionZ;
+		local.directionZ = Set1(m[0][2]) * packet.directionX + Set1(m[1][2]) * packet.directionY + Set1(m[2][2]) * packet.directionZ;
+		const Float8 one = Set1(1.0f);
+		local.inverseDirectionX = one / local.directionX;
+		local.inverseDirectionY = one / local.directionY;
+		local.inverseDirectionZ = one / local.directionZ;
+		local.active = packet.active;
+		instance.bvh->IntersectPacket(local, hit, (int32_t) node.leftFirst);
+	}
+}
+
+void RayTracer::TraceSingle(const RayPacket& packet, PacketHit& hit) const
+{
+	float ox[8], oy[8], oz[8], dx[8], dy[8], dz[8], distances[8], us[8], vs[8];
+	Store8(ox, packet.originX);
+	Store8(oy, packet.originY);
+	Store8(oz, packet.originZ);
+	Store8(dx, packet.directionX);
+	Store8(dy, packet.directionY);
+	Store8(dz, packet.directionZ);
+	Store8(distances, hit.distance);
+	Store8(us, hit.u);
+	Store8(vs, hit.v);
+	const int active = MoveMask(packet.active);
+
+	uint32_t localStack[64];
+	std::vector<uint32_t> heapStack;
+	uint32_t* stack = localStack;
+	if(m_Depth >= 63)
+	{
+		heapStack.resize(m_Depth + 2);
+		stack = &heapStack[0];
+	}
+	for(int lane = 0; lane < 8; ++lane)
+	{
+		if(!(active & (1 << lane)) || m_NodeCount == 0)
+			continue;
+		const glm::vec3 origin(ox[lane], oy[lane], oz[lane]);
+		const glm::vec3 direction(dx[lane], dy[lane], dz[lane]);
+		const glm::vec3 inverseDirection = 1.0f / direction;
+
+		int stackSize = 0;
+		stack[stackSize++] = 0;
+		while(stackSize > 0)
+		{
+			const TriangleBvhNode& node = m_Nodes[stack[--stackSize]];
+			const Aabb box(glm::vec3(node.boundsMin[0], node.boundsMin[1], node.boundsMin[2]),
+						   glm::vec3(node.boundsMax[0], node.boundsMax[1], node.boundsMax[2]));
+			if(IntersectRayAabb(origin, inverseDirection, box, distances[lane]) < 0.0f)
+				continue;
+			if(node.triangleCount == 0)
+			{
+				stack[stackSize++] = node.leftFirst + 1;
+				stack[stackSize++] = node.leftFirst;
+				continue;
+			}
+
+			const Instance& instance = m_Instances[node.leftFirst];
+			TriangleHit triangleHit;
+			if(instance.bvh->Intersect(glm::vec3(instance.inverseWorldMatrix * glm::vec4(origin, 1.0f)),
+									   glm::vec3(instance.inverseWorldMatrix * glm::vec4(direction, 0.0f)), distances[lane], triangleHit))
+			{
+				distances[lane] = triangleHit.distance;
+				us[lane] = triangleHit.u;
+				vs[lane] = triangleHit.v;
+				hit.triangle[lane] = (int32_t) triangleHit.triangle;
+				hit.instance[lane] = (int32_t) node.leftFirst;
+			}
+		}
+	}
+	hit.distance = Load8(distances);
+	hit.u = Load8(us);
+	hit.v = Load8(vs);
+}
+
+void RayTracer::Trace(const RayPacket& packet, PacketHit& hit) const
+{
+	if(m_PacketTracing)
+		TracePacket(packet, hit);
+	else
+		TraceSingle(packet, hit);
+}
+
+// --- Rendu -----------------------------------------------------------------
+
+void RayTracer::Render(const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix, int width, int height, std::vector<uint32_t>& pixels)
+{
+	pixels.resize(width * height);
+
+	// pour une projection perspective, le point du plan lointain vu par un pixel est affine en x et y
+	Camera camera;
+	camera.width = width;
+	camera.height = height;
+	camera.eye = glm::vec3(glm::inverse(viewMatrix)[3]);
+	const glm::mat4 inverseViewProjection = glm::inverse(projectionMatrix * viewMatrix);
+	glm::vec4 corners[3] = { glm::vec4(-1.0f, 1.0f, 1.0f, 1.0f), glm::vec4(1.0f, 1.0f, 1.0f, 1.0f), glm::vec4(-1.0f, -1.0f, 1.0f, 1.0f) };
+	for(int corner = 0; corner < 3; ++corner)
+	{
+		corners[corner] = inverseViewProjection * corners[corner];
+		corners[corner] /= corners[corner].w;
+	}
+	camera.topLeft = glm::vec3(corners[0]);
+	camera.right = (glm::vec3(corners[1]) - camera.topLeft) / (float) width;
+	camera.down = (glm::vec3(corners[2]) - camera.topLeft) / (float) height;
+
+	const int tilesX = (width + TileSize - 1) / TileSize;
+	const int tilesY = (height + TileSize - 1) / TileSize;
+	m_RayCount = 0;
+	ParallelFor(tilesX * tilesY, [&](size_t tile) {
+		m_RayCount += RenderTile((int) tile, camera, pixels);
+	}, m_ThreadCount);
+}
+
+uint64_t RayTracer::RenderTile(int tile, const Camera& camera, std::vector<uint32_t>& pixels) const
+{
+	const int tilesX = (camera.width + TileSize - 1) / TileSize;
+	const int tileMinX = (tile % tilesX) * TileSize;
+	const int tileMinY = (tile / tilesX) * TileSize;
+	const glm::vec3 toLight = -m_LightDirection;
+	uint64_t rayCount = 0;
+
+	for(int blockY = tileMinY; blockY < std::min(tileMinY + TileSize, camera.height); blockY += 2)
+	{
+		for(int blockX = tileMinX; blockX < std::min(tileMinX + TileSize, camera.width); blockX += 4)
+		{
+			// rayons primaires d'un bloc de 4x2 pixels
+			float ox[8], oy[8], oz[8], dx[8], dy[8], dz[8], activeLanes[8];
+			for(int lane = 0; lane < 8; ++lane)
+			{
+				const int x = blockX + (lane & 3), y = blockY + (lane >> 2);
+				const glm::vec3 target = camera.topLeft + camera.right * (x + 0.5f) + camera.down * (y + 0.5f);
+				const glm::vec3 direction = glm::normalize(target - camera.eye);
+				ox[lane] = camera.eye.x;
+				oy[lane] = camera.eye.y;
+				oz[lane] = camera.eye.z;
+				dx[lane] = direction.x;
+				dy[lane] = direction.y;
+				dz[lane] = direction.z;
+				activeLanes[lane] = (x < camera.width && y < camera.height) ? 1.0f : 0.0f;
+			}
+			RayPacket packet;
+			packet.originX = Load8(ox);
+			packet.originY = Load8(oy);
+			packet.originZ = Load8(oz);
+			packet.directionX = Load8(dx);
+			packet.directionY = Load8(dy);
+			packet.directionZ = Load8(dz);
+			const Float8 one = Set1(1.0f);
+			packet.inverseDirectionX = one / packet.directionX;
+			packet.inverseDirectionY = one / packet.directionY;
+			packet.inverseDirectionZ = one / packet.directionZ;
+			packet.active = CmpGt(Load8(activeLanes), Set1(0.0f));
+
+			PacketHit hit;
+			hit.distance = Set1(FLT_MAX);
+			hit.u = hit.v = Set1(0.0f);
+			for(int lane = 0; lane < 8; ++lane)
+				hit.triangle[lane] = hit.instance[lane] = -1;
+			Trace(packet, hit);
+			const int activeMask = MoveMask(packet.active);
+			for(int lane = 0; lane < 8; ++lane)
+				rayCount += (activeMask >> lane) & 1;
+
+			// ombrage de chaque pixel touche (normale et uv interpolees)
+			float distances[8], us[8], vs[8];
+			Store8(distances, hit.distance);
+			Store8(us, hit.u);
+			Store8(vs, hit.v);
+			glm::vec4 colors[8];
+			glm::vec3 normals[8], points[8];
+			float lamberts[8];
+			for(int lane = 0; lane < 8; ++lane)
+			{
+				lamberts[lane] = 0.0f;
+				if(!(activeMask & (1 << lane)))
+					continue;
+				const glm::vec3 direction(dx[lane], dy[lane], dz[lane]);
+				if(hit.instance[lane] < 0)
+				{
+					colors[lane] = m_Skybox ? m_Skybox->Sample(direction) : BackgroundColor;
+					continue;
+				}
+
+				const Instance& instance = m_Instances[hit.instance[lane]];
+				if(instance.texture == NULL)
+				{
+					colors[lane] = instance.color;
+					continue;
+				}
+				const SoftwareMesh& mesh = *instance.mesh;
+				const uint32_t* triangle = &mesh.indices[hit.triangle[lane] * 3];
+				const float w0 = 1.0f - us[lane] - vs[lane];
+				glm::vec3 normal(0.0f, 0.0f, 1.0f);
+				if(!mesh.normals.empty())
+				{
+					normal = glm::vec3(0.0f);
+					const float weights[3] = { w0, us[lane], vs[lane] };
+					for(int corner = 0; corner < 3; ++corner)
+						normal += weights[corner] * glm::vec3(mesh.normals[triangle[corner] * 3], mesh.normals[triangle[corner] * 3 + 1], mesh.normals[triangle[corner] * 3 + 2]);
+				}
+				normal = glm::normalize(glm::mat3(instance.worldMatrix) * normal);		// mat3(worldMatrix) comme basic.vs
+				glm::vec2 texcoords(0.0f);
+				if(!mesh.texcoords.empty())
+				{
+					texcoords = w0 * glm::vec2(mesh.texcoords[triangle[0] * 2], mesh.texcoords[triangle[0] * 2 + 1])
+							  + us[lane] * glm::vec2(mesh.texcoords[triangle[1] * 2], mesh.texcoords[triangle[1] * 2 + 1])
+							  + vs[lane] * glm::vec2(mesh.texcoords[triangle[2] * 2], mesh.texcoords[triangle[2] * 2 + 1]);
+				}
+				colors[lane] = TriangleTexture(instance, hit.triangle[lane]).Sample(texcoords.x, texcoords.y);
+				lamberts[lane] = std::max(glm::dot(normal, toLight), 0.0f);
+				normals[lane] = normal;
+				points[lane] = camera.eye + direction * distances[lane];
+			}
+
+			// rayons d'ombre vers la lumiere pour les pixels eclaires
+			if(m_Shadows)
+			{
+				for(int lane = 0; lane < 8; ++lane)
+				{
+					activeLanes[lane] = lamberts[lane] > 0.0f ? 1.0f : 0.0f;
+					if(lamberts[lane] > 0.0f)
+					{
+						const glm::vec3 origin = points[lane] + normals[lane] * ShadowBias;
+						ox[lane] = origin.x;
+						oy[lane] = origin.y;
+						oz[lane] = origin.z;
+					}
+				}
+				RayPacket shadow;
+				shadow.active = CmpGt(Load8(activeLanes), Set1(0.0f));
+				const int shadowMask = MoveMask(shadow.active);
+				if(shadowMask)
+				{
+					shadow.originX = Load8(ox);
+					shadow.originY = Load8(oy);
+					shadow.originZ = Load8(oz);
+					shadow.directionX = Set1(toLight.x);
+					shadow.directionY = Set1(toLight.y);
+					shadow.directionZ = Set1(toLight.z);
+					shadow.inverseDirectionX = Set1(1.0f / toLight.x);
+					shadow.inverseDirectionY = Set1(1.0f / toLight.y);
+					shadow.inverseDirectionZ = Set1(1.0f / toLight.z);
+
+					PacketHit occluder;
+					occluder.distance = Set1(FLT_MAX);
+					occluder.u = occluder.v = Set1(0.0f);
+					for(int lane = 0; lane < 8; ++lane)
+						occluder.triangle[lane] = occluder.instance[lane] = -1;
+					Trace(shadow, occluder);
+					for(int lane = 0; lane < 8; ++lane)
+					{
+						if(shadowMask & (1 << lane))
+						{
+							++rayCount;
+							if(occluder.instance[lane] >= 0)
+								lamberts[lane] = 0.0f;
+						}
+					}
+				}
+			}
+
+			for(int lane = 0; lane < 8; ++lane)
+			{
+				if(!(activeMask & (1 << lane)))
+					continue;
+				glm::vec4 color = colors[lane];
+				if(hit.instance[lane] >= 0 && m_Instances[hit.instance[lane]].texture)
+					color *= lamberts[lane];
+				color.a = 1.0f;
+				pixels[(blockY + (lane >> 2)) * camera.width + blockX + (lane & 3)] = PackColor(color);
+			}
+		}
+	}
+	return rayCount;
+}
+
+bool WriteImagePng(const char* filename, int width, int height, const std::vector<uint32_t>& pixels)
+{
+	return stbi_write_png(filename, width, height, 4, &pixels[0], width * 4) != 0;
+}
@@ -0,0 +1,108 @@
+#ifndef __RAY_TRACER_H__
+#define __RAY_TRACER_H__
+
+#include <vector>
+#include <atomic>
+#include <cstdint>
+
+#include "glm/glm.hpp"
+
+#include "RayPacket.h"
+#include "Mesh.h"
+#include "TriangleBvh.h"
+#include "SoftwareRasterizer.h"
+
+// Cubemap CPU : faces dans l'ordre GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, comme pour LoadAndCreateCubeMap
+struct SoftwareCubeMap
+{
+	SoftwareTexture faces[6];
+
+	bool Load(const char* filenames[]);
+	// selection de la face et des coordonnees selon la table de la specification OpenGL
+	glm::vec4 Sample(const glm::vec3& direction) const;
+};
+
+// Lanceur de rayons de reference, entierement sur le CPU (aucun pilote graphique) :
+// - BVH a deux niveaux : BVH des instances (boites monde) au-dessus des TriangleBvh des meshs,
+//   les rayons passent dans le repere local de chaque instance sans etre renormalises
+// - rayons primaires et d'ombre traces par paquets de 8 (blocs de 4x2 pixels), ou un par un pour comparaison
+// - ombrage de basic.fs (texture * N.L avec la lumiere directionnelle), ombres portees optionnelles,
+//   skybox pour les rayons qui ne touchent rien
+// - tuiles de TileSize pixels distribuees dynamiquement entre les coeurs par ParallelFor
+class RayTracer
+{
+public:
+	static const int TileSize = 16;
+
+	RayTracer();
+
+	// vide la liste d'instances
+	void Begin();
+	// ombrage de basic.fs
+	void AddInstance(const TriangleBvh& bvh, const SoftwareMesh& mesh, const glm::mat4& worldMatrix, const SoftwareTexture& texture);
+	// plusieurs materiaux : *textures[submesh.material] pour les triangles de chaque plage du mesh complet
+	void AddInstance(const TriangleBvh& bvh, const SoftwareMesh& mesh, const glm::mat4& worldMatrix,
+					 const std::vector<Submesh>& submeshes, const std::vector<const SoftwareTexture*>& textures);
+	// couleur constante sans eclairage (arrow.fs)
+	void AddFlatInstance(const TriangleBvh& bvh, const SoftwareMesh& mesh, const glm::mat4& worldMatrix, const glm::vec4& color);
+	// construit le BVH des instances, a appeler avant Render
+	void Build();
+
+	inline void SetSkybox(const SoftwareCubeMap* skybox) { m_Skybox = skybox; }
+	// direction DE la lumiere (u_lightDirection)
+	inline void SetLightDirection(const glm::vec3& lightDirection) { m_LightDirection = glm::normalize(lightDirection); }
+	inline void SetShadows(bool shadows) { m_Shadows = shadows; }
+	inline void SetPacketTracing(bool packets) { m_PacketTracing = packets; }
+	// 0 = tous les coeurs
+	inline void SetThreadCount(unsigned int count) { m_ThreadCount = count; }
+
+	// image RGBA8 opaque, ligne 0 en haut (ordre des fichiers image)
+	void Render(const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix, int width, int height, std::vector<uint32_t>& pixels);
+	// rayons primaires et d'ombre traces par le dernier Render
+	inline uint64_t GetRayCount() const { return m_RayCount; }
+
+private:
+	struct Instance
+	{
+		const TriangleBvh* bvh;
+		const SoftwareMesh* mesh;
+		const SoftwareTexture* texture;		// NULL : couleur constante
+		const std::vector<Submesh>* submeshes;	// NULL : texture pour tous les triangles
+		const std::vector<const SoftwareTexture*>* textures;
+		glm::vec4 color;
+		glm::mat4 worldMatrix;
+		glm::mat4 inverseWorldMatrix;
+		glm::vec3 boundsMin, boundsMax;		// repere monde
+	};
+
+	struct Camera
+	{
+		glm::vec3 eye;
+		glm::vec3 topLeft, right, down;		// point du plan lointain au coin haut gauche, puis pas par pixel
+		int width, height;
+	};
+
+	static const SoftwareTexture& TriangleTexture(const Instance& instance, int32_t triangle);
+	void BuildNode(uint32_t node, uint32_t first, uint32_t count, int depth);
+	void TracePacket(const RayPacket& packet, PacketHit& hit) const;
+	void TraceSingle(const RayPacket& packet, PacketHit& hit) const;
+	void Trace(const RayPacket& packet, PacketHit& hit) const;
+	uint64_t RenderTile(int tile, const Camera& camera, std::vector<uint32_t>& pixels) const;
+
+	std::vector<Instance> m_Instances;		// reordonnees par Build, les feuilles en designent une
+	std::vector<TriangleBvhNode> m_Nodes;
+	uint32_t m_NodeCount;
+	int m_Depth;							// profondeur du BVH des instances (taille des piles de parcours)
+
+	const SoftwareCubeMap* m_Skybox;
+	glm::vec3 m_LightDirection;
+	bool m_Shadows;
+	bool m_PacketTracing;
+	unsigned int m_ThreadCount;
+	std::atomic<uint64_t> m_RayCount;
+};
+
+// ecrit une image RGBA8 (ligne 0 en haut) avec stb_image_write
+bool WriteImagePng(const char* filename, int width, int height, const std::vector<uint32_t>& pixels);
+
+#endif //__RAY_TRACER_H__
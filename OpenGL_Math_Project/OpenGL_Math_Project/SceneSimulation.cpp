@@ -0,0 +1,92 @@
+#include "SceneSimulation.h"
+
+void SceneSimulation::Start(PrepareFunction prepare)
+{
+	if(IsRunning())
+		return;
+	m_Prepare = prepare;
+	m_Running = true;
+	m_HasSnapshot = false;
+	m_Thread = std::thread(&SceneSimulation::Run, this);
+}
+
+void SceneSimulation::Stop()
+{
+	if(!IsRunning())
+		return;
+	{
+		// sous le mutex : la simulation ne peut pas manquer le reveil entre son test et son attente
+		std::lock_guard<std::mutex> lock(m_WakeMutex);
+		m_Running = false;
+	}
+	m_Wake.notify_one();
+	m_Thread.join();
+
+	// les entrees non preparees sont abandonnees, la prochaine simulation repart de zero
+	SceneFrameInput input;
+	while(m_Inputs.Pop(input))
+		;
+}
+
+bool SceneSimulation::Post(const SceneFrameInput& input)
+{
+	if(!m_Inputs.Push(input))
+		return false;
+	{
+		// meme raison que dans Stop : l'entree est deja dans la file, seul le reveil est protege
+		std::lock_guard<std::mutex> lock(m_WakeMutex);
+	}
+	m_Wake.notify_one();
+	return true;
+}
+
+const SceneSnapshot& SceneSimulation::Acquire(uint32_t frame)
+{
+	if(m_Snapshots.Acquire())
+		m_HasSnapshot = true;
+	// attente courte (une preparation au plus) : demarrage du pipeline ou derniere frame avant l'attente
+	// des evenements, les entrees regroupees donnent une frame plus recente que celle demandee
+	while(IsRunning() && (!m_HasSnapshot || (frame != 0 && m_Snapshots.GetReadBuffer().frame < frame)))
+	{
+		std::this_thread::yield();
+		if(m_Snapshots.Acquire())
+			m_HasSnapshot = true;
+	}
+	return m_Snapshots.GetReadBuffer();
+}
+
+void SceneSimulation::Run()
+{
+	SceneFrameInput input, next;
+	for(;;)
+	{
+		bool received = false;
+		while(m_Inputs.Pop(next))
+		{
+			if(received)
+			{
+				++m_MergedInputs;
+				if(input.pick && !next.pick)
+				{
+					next.pick = true;
+					next.pickRay = input.pickRay;
+				}
+			}
+			input = next;
+			received = true;
+		}
+
+		if(!received)
+		{
+			std::unique_lock<std::mutex> lock(m_WakeMutex);
+			m_Wake.wait(lock, [this]() { return !m_Running || !m_Inputs.IsEmpty(); });
+			if(!m_Running)
+				return;
+			continue;
+		}
+
+		m_Prepare(input, m_Snapshots.GetWriteBuffer());
+		m_Snapshots.Publish();
+		++m_PreparedFrames;
+	}
+}
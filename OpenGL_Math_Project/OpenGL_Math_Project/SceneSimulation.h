@@ -0,0 +1,123 @@
+#ifndef __SCENE_SIMULATION_H__
+#define __SCENE_SIMULATION_H__
+
+#include <vector>
+#include <cstdint>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#include "glm/glm.hpp"
+
+#include "DynamicBvh.h"
+#include "../common/TripleBuffer.h"
+#include "../common/SpscQueue.h"
+
+// Parametres de la spirale de rochers (TweakBar), copies dans les entrees de chaque frame
+struct SpiralParameters
+{
+	int count;
+	double speed;
+	double ka, kb, kc;
+	int sizeX, sizeY, sizeZ;
+};
+
+// Tout ce dont la preparation d'une frame a besoin : aucune lecture des globales de l'application,
+// la preparation peut tourner sur un autre thread que les callbacks GLUT et la TweakBar
+struct SceneFrameInput
+{
+	uint32_t frame;
+	double time;						// temps simule interpole, en millisecondes
+	glm::mat4 viewMatrix;
+	glm::mat4 projectionMatrix;
+	glm::vec3 cameraPosition;
+	float viewportHeight;				// hauteur reellement rendue, pour le choix des LODs
+	SpiralParameters spiral;
+	glm::vec3 rockRotation;				// repere fixe tourne a la souris, en degres
+	glm::vec4 rockQuaternion;			// repere fixe de la TweakBar
+	bool frustumCulling;
+	bool sceneTreeCulling;
+	bool occlusionCulling;
+	int maxOccluders;
+	float lodPixelError;
+	bool pick;							// clic a traiter sur la scene preparee
+	Ray pickRay;
+};
+
+// Resultat du dernier picking, recopie dans chaque snapshot jusqu'au clic suivant
+struct ScenePick
+{
+	int rock;							// -1 : aucun objet
+	glm::vec3 point;
+	float time;							// en microsecondes
+
+	ScenePick() : rock(-1), point(0.0f), time(0.0f) {}
+};
+
+// Frame preparee, prete a etre soumise : rien n'y reference les donnees de la preparation suivante
+struct SceneSnapshot
+{
+	uint32_t frame;						// frame des entrees utilisees
+	glm::mat4 viewMatrix;
+	glm::mat4 projectionMatrix;
+	std::vector<glm::mat4> rockInstances;
+	std::vector<uint8_t> rockVisibility;
+	std::vector<int> rockLods;			// -1 si culle
+	int visibleRocks, culledRocks, occludedRocks;
+	float occlusionTime;				// en millisecondes
+	float prepareTime;					// preparation complete, en millisecondes
+	size_t arenaBytes;					// tableaux temporaires de la preparation (arena remise a zero par frame)
+	ScenePick pick;
+
+	SceneSnapshot() : frame(0), visibleRocks(0), culledRocks(0), occludedRocks(0), occlusionTime(0.0f), prepareTime(0.0f), arenaBytes(0) {}
+};
+
+// Pipeline a deux threads : le thread de rendu (GLUT) poste les entrees de la frame N+1 dans une file
+// SPSC puis soumet la derniere snapshot publiee (frame N) pendant que le thread de simulation prepare
+// la suivante (spirale, arbre de la scene, culling, LODs, picking).
+// La snapshot passe par un triple buffer sans verrou : aucun des deux threads n'attend l'autre, le rendu
+// a une frame de retard sur ses entrees. Le mutex ne sert qu'a endormir la simulation quand la file est vide.
+// Si la simulation prend du retard, les entrees en attente sont regroupees : seule la plus recente est
+// preparee, un clic n'est jamais perdu.
+class SceneSimulation
+{
+public:
+	typedef void (*PrepareFunction)(const SceneFrameInput& input, SceneSnapshot& snapshot);
+	static const size_t QueueCapacity = 8;
+
+	SceneSimulation() : m_Prepare(NULL), m_Running(false), m_HasSnapshot(false), m_PreparedFrames(0), m_MergedInputs(0) {}
+	~SceneSimulation() { Stop(); }
+
+	// prepare est appelee sur le thread de simulation, elle seule touche aux donnees de la preparation
+	void Start(PrepareFunction prepare);
+	// attend la fin de la preparation en cours
+	void Stop();
+	inline bool IsRunning() const { return m_Thread.joinable(); }
+
+	// thread de rendu : entrees de la frame suivante, false si la file est pleine (a reposter)
+	bool Post(const SceneFrameInput& input);
+	// thread de rendu : derniere snapshot publiee, valable jusqu'a l'appel suivant.
+	// N'attend que la premiere apres Start, ou celle de la frame frame si elle est donnee (non nulle).
+	const SceneSnapshot& Acquire(uint32_t frame = 0);
+
+	inline int GetPreparedFrames() const { return m_PreparedFrames.load(); }
+	inline int GetMergedInputs() const { return m_MergedInputs.load(); }
+
+private:
+	void Run();
+
+	PrepareFunction m_Prepare;
+	SpscQueue<SceneFrameInput, QueueCapacity> m_Inputs;
+	TripleBuffer<SceneSnapshot> m_Snapshots;
+
+	std::thread m_Thread;
+	std::mutex m_WakeMutex;
+	std::condition_variable m_Wake;
+	std::atomic<bool> m_Running;
+	bool m_HasSnapshot;					// thread de rendu
+	std::atomic<int> m_PreparedFrames;
+	std::atomic<int> m_MergedInputs;	// entrees remplacees par une plus recente avant d'etre preparees
+};
+
+#endif //__SCENE_SIMULATION_H__
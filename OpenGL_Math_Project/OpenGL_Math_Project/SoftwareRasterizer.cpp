@@ -0,0 +1,451 @@
+#include "SoftwareRasterizer.h"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include "stb/stb_image.h"
+
+#include "Parallel.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE__)
+#define SOFTWARE_RASTERIZER_USE_SSE 1
+#include <emmintrin.h>
+#endif
+
+static inline uint32_t PackColor(const glm::vec4& color)
+{
+	const glm::vec4 c = glm::clamp(color, 0.0f, 1.0f) * 255.0f + 0.5f;
+	return (uint32_t) c.r | ((uint32_t) c.g << 8) | ((uint32_t) c.b << 16) | ((uint32_t) c.a << 24);
+}
+
+static inline glm::vec4 UnpackColor(uint32_t color)
+{
+	return glm::vec4((float) (color & 0xff), (float) ((color >> 8) & 0xff), (float) ((color >> 16) & 0xff), (float) (color >> 24)) * (1.0f / 255.0f);
+}
+
+// --- SoftwareTexture -------------------------------------------------------
+
+bool SoftwareTexture::Load(const char* filename)
+{
+	int w, h;
+	uint8_t* data = stbi_load(filename, &w, &h, nullptr, STBI_rgb_alpha);
+	if(data == nullptr)
+		return false;
+	width = w;
+	height = h;
+	texels.resize(w * h);
+	memcpy(&texels[0], data, w * h * 4);
+	stbi_image_free(data);
+	return true;
+}
+
+glm::vec4 SoftwareTexture::Sample(float u, float v) const
+{
+	if(texels.empty())
+		return glm::vec4(1.0f);
+
+	// GL_LINEAR + GL_CLAMP_TO_EDGE : centres des texels en (i + 0.5) / taille
+	const float x = u * width - 0.5f;
+	const float y = v * height - 0.5f;
+	const float x0f = floorf(x), y0f = floorf(y);
+	const float fx = x - x0f, fy = y - y0f;
+	const int x0 = std::min(std::max((int) x0f, 0), width - 1);
+	const int y0 = std::min(std::max((int) y0f, 0), height - 1);
+	const int x1 = std::min(std::max((int) x0f + 1, 0), width - 1);
+	const int y1 = std::min(std::max((int) y0f + 1, 0), height - 1);
+
+	const glm::vec4 c00 = UnpackColor(texels[y0 * width + x0]);
+	const glm::vec4 c10 = UnpackColor(texels[y0 * width + x1]);
+	const glm::vec4 c01 = UnpackColor(texels[y1 * width + x0]);
+	const glm::vec4 c11 = UnpackColor(texels[y1 * width + x1]);
+	return glm::mix(glm::mix(c00, c10, fx), glm::mix(c01, c11, fx), fy);
+}
+
+// --- SoftwareRasterizer ----------------------------------------------------
+
+void SoftwareRasterizer::Create(int width, int height)
+{
+	m_Width = width;
+	m_Height = height;
+	m_TilesX = (width + TileSize - 1) / TileSize;
+	m_TilesY = (height + TileSize - 1) / TileSize;
+	m_Stride = m_TilesX * TileSize;
+	m_Color.assign(m_Stride * m_TilesY * TileSize, 0);
+	m_Depth.assign(m_Stride * m_TilesY * TileSize, 1.0f);
+	for(size_t chunk = 0; chunk < m_Chunks.size(); ++chunk)
+		m_Chunks[chunk].bins.assign(m_TilesX * m_TilesY, std::vector<uint32_t>());
+}
+
+void SoftwareRasterizer::Begin(const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix, const glm::vec3& lightDirection, uint32_t clearColor)
+{
+	m_ViewProjection = projectionMatrix * viewMatrix;
+	m_LightDirection = lightDirection;
+	m_ClearColor = clearColor;
+	m_Draws.clear();
+	m_ChunkCount = 0;
+	m_SubmittedTriangles = 0;
+}
+
+void SoftwareRasterizer::AddDraw(const SoftwareMesh& mesh, uint32_t firstIndex, uint32_t indexCount, const glm::mat4& worldMatrix, const SoftwareTexture& texture)
+{
+	Draw draw;
+	draw.mesh = &mesh;
+	draw.firstIndex = firstIndex;
+	draw.indexCount = indexCount;
+	draw.worldMatrix = worldMatrix;
+	draw.texture = &texture;
+	draw.color = glm::vec4(1.0f);
+	m_Draws.push_back(draw);
+}
+
+void SoftwareRasterizer::AddFlatDraw(const SoftwareMesh& mesh, uint32_t firstIndex, uint32_t indexCount, const glm::mat4& worldMatrix, const glm::vec4& color)
+{
+	Draw draw;
+	draw.mesh = &mesh;
+	draw.firstIndex = firstIndex;
+	draw.indexCount = indexCount;
+	draw.worldMatrix = worldMatrix;
+	draw.texture = NULL;
+	draw.color = color;
+	m_Draws.push_back(draw);
+}
+
+size_t SoftwareRasterizer::GetRasterizedTriangleCount() const
+{
+	size_t count = 0;
+	for(size_t chunk = 0; chunk < m_ChunkCount; ++chunk)
+		count += m_Chunks[chunk].triangles.size();
+	return count;
+}
+
+void SoftwareRasterizer::Render()
+{
+	// 1. sommets : un draw par tache
+	m_DrawVertices.resize(m_Draws.size());
+	ParallelFor(m_Draws.size(), [this](size_t draw) { TransformDraw(draw); }, m_ThreadCount);
+
+	// 2. decoupage des draws en lots de triangles, l'ordre des lots est l'ordre de soumission
+	m_ChunkCount = 0;
+	for(uint32_t draw = 0; draw < (uint32_t) m_Draws.size(); ++draw)
+	{
+		const uint32_t triangleCount = m_Draws[draw].indexCount / 3;
+		m_SubmittedTriangles += triangleCount;
+		for(uint32_t first = 0; first < triangleCount; first += ChunkTriangles)
+		{
+			if(m_ChunkCount == m_Chunks.size())
+			{
+				m_Chunks.push_back(Chunk());
+				m_Chunks.back().bins.assign(m_TilesX * m_TilesY, std::vector<uint32_t>());
+			}
+			Chunk& chunk = m_Chunks[m_ChunkCount++];
+			chunk.draw = draw;
+			chunk.firstTriangle = first;
+			chunk.triangleCount = std::min<uint32_t>(ChunkTriangles, triangleCount - first);
+		}
+	}
+	ParallelFor(m_ChunkCount, [this](size_t chunk) { SetupChunk(m_Chunks[chunk]); }, m_ThreadCount);
+
+	// 3. une tuile n'est ecrite que par un seul thread : aucune synchronisation
+	ParallelFor(m_TilesX * m_TilesY, [this](size_t tile) { RasterizeTile((int) tile); }, m_ThreadCount);
+}
+
+void SoftwareRasterizer::TransformDraw(size_t drawIndex)
+{
+	const Draw& draw = m_Draws[drawIndex];
+	const SoftwareMesh& mesh = *draw.mesh;
+	const glm::mat4 matrix = m_ViewProjection * draw.worldMatrix;
+	const glm::mat3 normalMatrix(draw.worldMatrix);		// mat3(worldMatrix) comme basic.vs
+
+	const size_t vertexCount = mesh.positions.size() / 3;
+	const bool hasNormals = mesh.normals.size() >= vertexCount * 3;
+	const bool hasTexcoords = mesh.texcoords.size() >= vertexCount * 2;
+	std::vector<ClipVertex>& vertices = m_DrawVertices[drawIndex];
+	vertices.resize(vertexCount);
+	for(size_t i = 0; i < vertexCount; ++i)
+	{
+		const float* p = &mesh.positions[i * 3];
+		vertices[i].position = matrix * glm::vec4(p[0], p[1], p[2], 1.0f);
+		vertices[i].normal = hasNormals ? normalMatrix * glm::vec3(mesh.normals[i * 3], mesh.normals[i * 3 + 1], mesh.normals[i * 3 + 2])
+										: glm::vec3(0.0f, 0.0f, 1.0f);
+		vertices[i].texcoords = hasTexcoords ? glm::vec2(mesh.texcoords[i * 2], mesh.texcoords[i * 2 + 1]) : glm::vec2(0.0f);
+	}
+}
+
+void SoftwareRasterizer::SetupChunk(Chunk& chunk)
+{
+	chunk.triangles.clear();
+	for(size_t tile = 0; tile < chunk.bins.size(); ++tile)
+		chunk.bins[tile].clear();
+
+	const Draw& draw = m_Draws[chunk.draw];
+	const std::vector<ClipVertex>& vertices = m_DrawVertices[chunk.draw];
+	const uint32_t* indices = &draw.mesh->indices[draw.firstIndex];
+	for(uint32_t triangle = chunk.firstTriangle; triangle < chunk.firstTriangle + chunk.triangleCount; ++triangle)
+	{
+		const ClipVertex* corners[3] = { &vertices[indices[triangle * 3]], &vertices[indices[triangle * 3 + 1]], &vertices[indices[triangle * 3 + 2]] };
+
+		// rejet trivial : les trois sommets hors du meme plan du frustum
+		bool rejected = false;
+		for(int axis = 0; axis < 3 && !rejected; ++axis)
+		{
+			rejected = (corners[0]->position[axis] > corners[0]->position.w && corners[1]->position[axis] > corners[1]->position.w
+						&& corners[2]->position[axis] > corners[2]->position.w)
+					|| (corners[0]->position[axis] < -corners[0]->position.w && corners[1]->position[axis] < -corners[1]->position.w
+						&& corners[2]->position[axis] < -corners[2]->position.w);
+		}
+		if(rejected)
+			continue;
+
+		bool behindNear = false;
+		for(int corner = 0; corner < 3; ++corner)
+			behindNear |= corners[corner]->position.z < -corners[corner]->position.w;
+		if(!behindNear)
+		{
+			SetupTriangle(chunk, *corners[0], *corners[1], *corners[2]);
+			continue;
+		}
+
+		// clipping contre le plan proche (z + w >= 0) : 3 ou 4 sommets, dessines en eventail
+		ClipVertex polygon[4];
+		int polygonSize = 0;
+		for(int corner = 0; corner < 3; ++corner)
+		{
+			const ClipVertex& a = *corners[corner];
+			const ClipVertex& b = *corners[(corner + 1) % 3];
+			const float da = a.position.z + a.position.w;
+			const float db = b.position.z + b.position.w;
+			if(da >= 0.0f)
+				polygon[polygonSize++] = a;
+			if((da >= 0.0f) != (db >= 0.0f))
+			{
+				const float t = da / (da - db);
+				ClipVertex& v = polygon[polygonSize++];
+				v.position = glm::mix(a.position, b.position, t);
+				v.normal = glm::mix(a.normal, b.normal, t);
+				v.texcoords = glm::mix(a.texcoords, b.texcoords, t);
+			}
+		}
+		for(int corner = 2; corner < polygonSize; ++corner)
+			SetupTriangle(chunk, polygon[0], polygon[corner - 1], polygon[corner]);
+	}
+}
+
+void SoftwareRasterizer::SetupTriangle(Chunk& chunk, const ClipVertex& v0, const ClipVertex& v1, const ClipVertex& v2)
+{
+	const ClipVertex* corners[3] = { &v0, &v1, &v2 };
+	glm::vec3 screen[3];
+	float invW[3];
+	for(int corner = 0; corner < 3; ++corner)
+	{
+		const glm::vec4& clip = corners[corner]->position;
+		invW[corner] = 1.0f / clip.w;
+		screen[corner] = glm::vec3((clip.x * invW[corner] * 0.5f + 0.5f) * m_Width,
+								   (clip.y * invW[corner] * 0.5f + 0.5f) * m_Height,
+								   clip.z * invW[corner] * 0.5f + 0.5f);
+	}
+
+	// aire signee : faces arriere (sens horaire) et triangles degeneres elimines comme avec GL_CULL_FACE
+	const float area = (screen[1].x - screen[0].x) * (screen[2].y - screen[0].y)
+					 - (screen[1].y - screen[0].y) * (screen[2].x - screen[0].x);
+	if(!(area > 0.0f))
+		return;
+
+	Triangle triangle;
+	triangle.minX = std::max((int) floorf(std::min(screen[0].x, std::min(screen[1].x, screen[2].x))), 0);
+	triangle.minY = std::max((int) floorf(std::min(screen[0].y, std::min(screen[1].y, screen[2].y))), 0);
+	triangle.maxX = std::min((int) ceilf(std::max(screen[0].x, std::max(screen[1].x, screen[2].x))), m_Width - 1);
+	triangle.maxY = std::min((int) ceilf(std::max(screen[0].y, std::max(screen[1].y, screen[2].y))), m_Height - 1);
+	if(triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+		return;
+	triangle.draw = chunk.draw;
+
+	float attributes[3][PlaneCount];
+	for(int corner = 0; corner < 3; ++corner)
+	{
+		const ClipVertex& v = *corners[corner];
+		attributes[corner][PlaneDepth] = screen[corner].z;
+		attributes[corner][PlaneInvW] = invW[corner];
+		attributes[corner][PlaneU] = v.texcoords.x * invW[corner];
+		attributes[corner][PlaneV] = v.texcoords.y * invW[corner];
+		attributes[corner][PlaneNormalX] = v.normal.x * invW[corner];
+		attributes[corner][PlaneNormalY] = v.normal.y * invW[corner];
+		attributes[corner][PlaneNormalZ] = v.normal.z * invW[corner];
+	}
+	for(int plane = 0; plane < PlaneCount; ++plane)
+		triangle.planeA[plane] = triangle.planeB[plane] = triangle.planeC[plane] = 0.0f;
+
+	// arete i allant du sommet i au sommet i+1, divisee par l'aire : elle vaut la coordonnee
+	// barycentrique du sommet oppose, les attributs sont la combinaison des trois
+	const float invArea = 1.0f / area;
+	triangle.ownerEdges = 0;
+	for(int edge = 0; edge < 3; ++edge)
+	{
+		const glm::vec3& a = screen[edge];
+		const glm::vec3& b = screen[(edge + 1) % 3];
+		const float edgeA = a.y - b.y;
+		const float edgeB = b.x - a.x;
+		// regle haut-gauche : des deux triangles partageant une arete, un seul possede ses pixels
+		if(edgeA > 0.0f || (edgeA == 0.0f && edgeB < 0.0f))
+			triangle.ownerEdges |= 1 << edge;
+		triangle.edgeA[edge] = edgeA * invArea;
+		triangle.edgeB[edge] = edgeB * invArea;
+		triangle.edgeC[edge] = -(edgeA * a.x + edgeB * a.y) * invArea;
+
+		const float* values = attributes[(edge + 2) % 3];
+		for(int plane = 0; plane < PlaneCount; ++plane)
+		{
+			triangle.planeA[plane] += triangle.edgeA[edge] * values[plane];
+			triangle.planeB[plane] += triangle.edgeB[edge] * values[plane];
+			triangle.planeC[plane] += triangle.edgeC[edge] * values[plane];
+		}
+	}
+
+	const uint32_t triangleIndex = (uint32_t) chunk.triangles.size();
+	chunk.triangles.push_back(triangle);
+	for(int tileY = triangle.minY / TileSize; tileY <= triangle.maxY / TileSize; ++tileY)
+	{
+		for(int tileX = triangle.minX / TileSize; tileX <= triangle.maxX / TileSize; ++tileX)
+			chunk.bins[tileY * m_TilesX + tileX].push_back(triangleIndex);
+	}
+}
+
+void SoftwareRasterizer::RasterizeTile(int tile)
+{
+	const int tileMinX = (tile % m_TilesX) * TileSize;
+	const int tileMinY = (tile / m_TilesX) * TileSize;
+
+	for(int y = tileMinY; y < tileMinY + TileSize; ++y)
+	{
+		std::fill(&m_Color[y * m_Stride + tileMinX], &m_Color[y * m_Stride + tileMinX] + TileSize, m_ClearColor);
+		std::fill(&m_Depth[y * m_Stride + tileMinX], &m_Depth[y * m_Stride + tileMinX] + TileSize, 1.0f);
+	}
+
+	const glm::vec3 toLight = -m_LightDirection;
+	for(size_t chunkIndex = 0; chunkIndex < m_ChunkCount; ++chunkIndex)
+	{
+		const Chunk& chunk = m_Chunks[chunkIndex];
+		const std::vector<uint32_t>& bin = chunk.bins[tile];
+		if(bin.empty())
+			continue;
+		const Draw& draw = m_Draws[chunk.draw];
+		const uint32_t flatColor = PackColor(draw.color);
+
+		for(size_t i = 0; i < bin.size(); ++i)
+		{
+			const Triangle& triangle = chunk.triangles[bin[i]];
+			// debut aligne sur 4 pixels, la tuile etant un multiple de 4 on reste dans la ligne
+			const int minX = std::max(triangle.minX, tileMinX) & ~3;
+			const int maxX = std::min(triangle.maxX, tileMinX + TileSize - 1);
+			const int minY = std::max(triangle.minY, tileMinY);
+			const int maxY = std::min(triangle.maxY, tileMinY + TileSize - 1);
+
+			for(int y = minY; y <= maxY; ++y)
+			{
+				const float py = y + 0.5f;
+				uint32_t* colorRow = &m_Color[y * m_Stride];
+				float* depthRow = &m_Depth[y * m_Stride];
+#ifdef SOFTWARE_RASTERIZER_USE_SSE
+				const __m128 offsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+				const __m128 zero = _mm_setzero_ps();
+				__m128 edgeRow[3], edgeA[3], ownerMask[3];
+				for(int edge = 0; edge < 3; ++edge)
+				{
+					edgeRow[edge] = _mm_set1_ps(triangle.edgeB[edge] * py + triangle.edgeC[edge]);
+					edgeA[edge] = _mm_set1_ps(triangle.edgeA[edge]);
+					ownerMask[edge] = _mm_castsi128_ps(_mm_set1_epi32((triangle.ownerEdges & (1 << edge)) ? -1 : 0));
+				}
+				for(int x = minX; x <= maxX; x += 4)
+				{
+					const __m128 px = _mm_add_ps(_mm_set1_ps((float) x), offsets);
+					__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+					for(int edge = 0; edge < 3; ++edge)
+					{
+						// E >= 0 pour les aretes proprietaires, E > 0 sinon
+						const __m128 e = _mm_add_ps(_mm_mul_ps(edgeA[edge], px), edgeRow[edge]);
+						const __m128 covered = _mm_or_ps(_mm_cmpgt_ps(e, zero), _mm_and_ps(ownerMask[edge], _mm_cmpeq_ps(e, zero)));
+						inside = _mm_and_ps(inside, covered);
+					}
+					if(_mm_movemask_ps(inside) == 0)
+						continue;
+
+					const __m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.planeA[PlaneDepth]), px),
+												_mm_set1_ps(triangle.planeB[PlaneDepth] * py + triangle.planeC[PlaneDepth]));
+					const __m128 previous = _mm_loadu_ps(depthRow + x);
+					const __m128 passed = _mm_and_ps(inside, _mm_cmplt_ps(z, previous));
+					const int mask = _mm_movemask_ps(passed);
+					if(mask == 0)
+						continue;
+					_mm_storeu_ps(depthRow + x, _mm_or_ps(_mm_and_ps(passed, z), _mm_andnot_ps(passed, previous)));
+
+					if(draw.texture == NULL)
+					{
+						for(int lane = 0; lane < 4; ++lane)
+						{
+							if(mask & (1 << lane))
+								colorRow[x + lane] = flatColor;
+						}
+						continue;
+					}
+
+					// attributs / w interpoles a l'ecran puis multiplies par w (correction de perspective)
+					__m128 values[PlaneCount];
+					for(int plane = PlaneInvW; plane < PlaneCount; ++plane)
+						values[plane] = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.planeA[plane]), px),
+												   _mm_set1_ps(triangle.planeB[plane] * py + triangle.planeC[plane]));
+					const __m128 w = _mm_div_ps(_mm_set1_ps(1.0f), values[PlaneInvW]);
+					const __m128 u = _mm_mul_ps(values[PlaneU], w);
+					const __m128 v = _mm_mul_ps(values[PlaneV], w);
+					// la normale est renormalisee : le facteur w est inutile
+					const __m128 nx = values[PlaneNormalX], ny = values[PlaneNormalY], nz = values[PlaneNormalZ];
+					const __m128 lengthSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny)), _mm_mul_ps(nz, nz));
+					const __m128 nDotL = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, _mm_set1_ps(toLight.x)), _mm_mul_ps(ny, _mm_set1_ps(toLight.y))),
+													_mm_mul_ps(nz, _mm_set1_ps(toLight.z)));
+					const __m128 lambert = _mm_max_ps(_mm_div_ps(nDotL, _mm_sqrt_ps(_mm_max_ps(lengthSquared, _mm_set1_ps(1e-30f)))), zero);
+
+					float us[4], vs[4], intensities[4];
+					_mm_storeu_ps(us, u);
+					_mm_storeu_ps(vs, v);
+					_mm_storeu_ps(intensities, lambert);
+					for(int lane = 0; lane < 4; ++lane)
+					{
+						if(mask & (1 << lane))
+							colorRow[x + lane] = PackColor(draw.texture->Sample(us[lane], vs[lane]) * intensities[lane]);
+					}
+				}
+#else
+				for(int x = minX; x <= maxX; ++x)
+				{
+					const float px = x + 0.5f;
+					bool inside = true;
+					for(int edge = 0; edge < 3 && inside; ++edge)
+					{
+						const float e = triangle.edgeA[edge] * px + triangle.edgeB[edge] * py + triangle.edgeC[edge];
+						inside = e > 0.0f || (e == 0.0f && (triangle.ownerEdges & (1 << edge)));
+					}
+					if(!inside)
+						continue;
+
+					float values[PlaneCount];
+					for(int plane = 0; plane < PlaneCount; ++plane)
+						values[plane] = triangle.planeA[plane] * px + triangle.planeB[plane] * py + triangle.planeC[plane];
+					if(!(values[PlaneDepth] < depthRow[x]))
+						continue;
+					depthRow[x] = values[PlaneDepth];
+
+					if(draw.texture == NULL)
+					{
+						colorRow[x] = flatColor;
+						continue;
+					}
+					const float w = 1.0f / values[PlaneInvW];
+					const glm::vec3 normal(values[PlaneNormalX], values[PlaneNormalY], values[PlaneNormalZ]);
+					const float lengthSquared = glm::dot(normal, normal);
+					const float lambert = lengthSquared > 0.0f ? std::max(glm::dot(normal, toLight) / sqrtf(lengthSquared), 0.0f) : 0.0f;
+					colorRow[x] = PackColor(draw.texture->Sample(values[PlaneU] * w, values[PlaneV] * w) * lambert);
+				}
+#endif
+			}
+		}
+	}
+}
@@ -0,0 +1,140 @@
+#ifndef __SOFTWARE_RASTERIZER_H__
+#define __SOFTWARE_RASTERIZER_H__
+
+#include <vector>
+#include <cstdint>
+
+#include "glm/glm.hpp"
+
+#include "Mesh.h"
+
+// Texture RGBA8 en memoire CPU, filtrage bilineaire et clamp comme LoadAndCreateTextureRGBA
+struct SoftwareTexture
+{
+	int width;
+	int height;
+	std::vector<uint32_t> texels;		// R | G << 8 | B << 16 | A << 24, ligne 0 en v = 0
+
+	SoftwareTexture() : width(0), height(0) {}
+	bool Load(const char* filename);
+	glm::vec4 Sample(float u, float v) const;
+};
+
+// Mesh CPU : directement le MeshData d'un modele (seuls positions, normals, texcoords et indices sont lus),
+// pour dessiner les donnees de l'AssetManager sans les copier
+typedef MeshData SoftwareMesh;
+
+// Rasteriseur logiciel, backend de rendu sans OpenGL :
+// - les sommets de chaque draw sont transformes en parallele (matrices ViewProj de la camera)
+// - les triangles sont clippes contre le plan proche, les faces arriere eliminees (GL_CULL_FACE),
+//   puis ranges dans des tuiles de TileSize pixels par lots de ChunkTriangles
+// - chaque tuile est rasterisee par un seul thread, 4 pixels a la fois avec SSE (fonctions d'aretes),
+//   avec test de profondeur GL_LESS, uv corrigees en perspective et le Lambert de basic.fs
+// Le resultat est un buffer RGBA8 dont la ligne 0 est en bas, comme glReadPixels.
+class SoftwareRasterizer
+{
+public:
+	static const int TileSize = 64;
+	static const int ChunkTriangles = 2048;
+
+	SoftwareRasterizer() : m_Width(0), m_Height(0), m_Stride(0), m_TilesX(0), m_TilesY(0), m_ThreadCount(0),
+						   m_ChunkCount(0), m_SubmittedTriangles(0) {}
+
+	void Create(int width, int height);
+
+	// lightDirection : direction DE la lumiere (u_lightDirection), clearColor au format du buffer
+	void Begin(const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix, const glm::vec3& lightDirection, uint32_t clearColor);
+	// triangles [firstIndex, firstIndex + indexCount) de mesh, ombrage de basic.fs (texture * N.L)
+	void AddDraw(const SoftwareMesh& mesh, uint32_t firstIndex, uint32_t indexCount, const glm::mat4& worldMatrix, const SoftwareTexture& texture);
+	// couleur constante sans eclairage (arrow.fs)
+	void AddFlatDraw(const SoftwareMesh& mesh, uint32_t firstIndex, uint32_t indexCount, const glm::mat4& worldMatrix, const glm::vec4& color);
+	// transforme, decoupe et rasterise tous les draws de la frame. Les meshs et textures doivent rester valides jusque-la
+	void Render();
+
+	// 0 = tous les coeurs
+	inline void SetThreadCount(unsigned int count) { m_ThreadCount = count; }
+
+	inline int GetWidth() const { return m_Width; }
+	inline int GetHeight() const { return m_Height; }
+	// en pixels, multiple de TileSize
+	inline int GetStride() const { return m_Stride; }
+	inline const uint32_t* GetColorBuffer() const { return &m_Color[0]; }
+	inline size_t GetSubmittedTriangleCount() const { return m_SubmittedTriangles; }
+	size_t GetRasterizedTriangleCount() const;
+
+private:
+	struct Draw
+	{
+		const SoftwareMesh* mesh;
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		glm::mat4 worldMatrix;
+		const SoftwareTexture* texture;		// NULL : couleur constante
+		glm::vec4 color;
+	};
+
+	struct ClipVertex
+	{
+		glm::vec4 position;		// espace de clipping
+		glm::vec3 normal;		// repere monde
+		glm::vec2 texcoords;
+	};
+
+	enum
+	{
+		PlaneDepth,
+		PlaneInvW,
+		PlaneU,
+		PlaneV,
+		PlaneNormalX,
+		PlaneNormalY,
+		PlaneNormalZ,
+		PlaneCount
+	};
+
+	// triangle en coordonnees ecran, chaque attribut est une equation A.x + B.y + C :
+	// profondeur et 1/w sont affines a l'ecran, uv et normale sont divises par w
+	struct Triangle
+	{
+		float edgeA[3], edgeB[3], edgeC[3];		// coordonnees barycentriques
+		float planeA[PlaneCount], planeB[PlaneCount], planeC[PlaneCount];
+		int minX, minY, maxX, maxY;				// boite englobante en pixels (inclusive)
+		uint32_t draw;
+		uint32_t ownerEdges;					// bit i : l'arete i possede les pixels pour lesquels elle vaut 0
+	};
+
+	// lot de triangles consecutifs d'un draw, prepare par un seul thread avec ses propres tuiles
+	struct Chunk
+	{
+		uint32_t draw;
+		uint32_t firstTriangle;
+		uint32_t triangleCount;
+		std::vector<Triangle> triangles;
+		std::vector<std::vector<uint32_t> > bins;
+	};
+
+	void TransformDraw(size_t draw);
+	void SetupChunk(Chunk& chunk);
+	void SetupTriangle(Chunk& chunk, const ClipVertex& v0, const ClipVertex& v1, const ClipVertex& v2);
+	void RasterizeTile(int tile);
+
+	int m_Width, m_Height;
+	int m_Stride;
+	int m_TilesX, m_TilesY;
+	unsigned int m_ThreadCount;
+
+	glm::mat4 m_ViewProjection;
+	glm::vec3 m_LightDirection;
+	uint32_t m_ClearColor;
+
+	std::vector<Draw> m_Draws;
+	std::vector<std::vector<ClipVertex> > m_DrawVertices;
+	std::vector<Chunk> m_Chunks;		// reutilises d'une frame a l'autre
+	size_t m_ChunkCount;
+	size_t m_SubmittedTriangles;
+
+	std::vector<uint32_t> m_Color;
+	std::vector<float> m_Depth;
+};
+
+#endif //__SOFTWARE_RASTERIZER_H__
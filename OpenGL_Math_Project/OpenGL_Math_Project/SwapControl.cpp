@@ -0,0 +1,68 @@
+#include "SwapControl.h"
+
+#include <cstdio>
+
+#include "Common.h"
+
+#ifdef SWAP_CONTROL_EGL
+#include <EGL/egl.h>
+#endif
+
+static const char* g_SwapControlName = "aucune";
+static int g_SwapInterval = SWAP_IMMEDIATE;
+
+int SetSwapInterval(int interval)
+{
+#if defined(SWAP_CONTROL_EGL)
+	// EGL n'a pas de mode adaptatif
+	if(interval < 0)
+		interval = SWAP_VSYNC;
+	if(!eglSwapInterval(eglGetCurrentDisplay(), interval))
+		return g_SwapInterval;
+	g_SwapControlName = "eglSwapInterval";
+#elif defined(_WIN32)
+	if(!WGLEW_EXT_swap_control)
+		return g_SwapInterval;
+	if(interval < 0 && !WGLEW_EXT_swap_control_tear)
+		interval = SWAP_VSYNC;
+	if(!wglSwapIntervalEXT(interval))
+		return g_SwapInterval;
+	g_SwapControlName = interval < 0 ? "WGL_EXT_swap_control_tear" : "WGL_EXT_swap_control";
+#else
+	if(GLXEW_EXT_swap_control)
+	{
+		if(interval < 0 && !GLXEW_EXT_swap_control_tear)
+			interval = SWAP_VSYNC;
+		glXSwapIntervalEXT(glXGetCurrentDisplay(), glXGetCurrentDrawable(), interval);
+		g_SwapControlName = interval < 0 ? "GLX_EXT_swap_control_tear" : "GLX_EXT_swap_control";
+	}
+	else if(GLXEW_MESA_swap_control)
+	{
+		if(interval < 0)
+			interval = SWAP_VSYNC;
+		if(glXSwapIntervalMESA((unsigned int) interval) != 0)
+			return g_SwapInterval;
+		g_SwapControlName = "GLX_MESA_swap_control";
+	}
+	else if(GLXEW_SGI_swap_control)
+	{
+		// SGI refuse 0 : la synchro ne peut pas etre coupee
+		if(interval <= 0)
+			interval = SWAP_VSYNC;
+		if(glXSwapIntervalSGI(interval) != 0)
+			return g_SwapInterval;
+		g_SwapControlName = "GLX_SGI_swap_control";
+	}
+	else
+	{
+		return g_SwapInterval;
+	}
+#endif
+	g_SwapInterval = interval;
+	return interval;
+}
+
+const char* GetSwapControlName()
+{
+	return g_SwapControlName;
+}
@@ -0,0 +1,21 @@
+#ifndef __SWAP_CONTROL_H__
+#define __SWAP_CONTROL_H__
+
+// Intervalle de presentation de glutSwapBuffers
+enum SwapInterval
+{
+	SWAP_ADAPTIVE = -1,		// synchro verticale, sauf si la frame est en retard (elle s'affiche tout de suite)
+	SWAP_IMMEDIATE = 0,		// pas de synchro : tearing possible, latence minimale
+	SWAP_VSYNC = 1
+};
+
+// Applique l'intervalle au contexte courant avec l'extension disponible :
+// WGL_EXT_swap_control (Windows), GLX_EXT_swap_control puis GLX_MESA_swap_control / GLX_SGI_swap_control
+// (Linux), eglSwapInterval si freeglut utilise EGL (SWAP_CONTROL_EGL defini a la compilation).
+// L'adaptatif demande *_EXT_swap_control_tear, sinon il retombe sur la synchro verticale.
+// Retourne l'intervalle reellement applique (celui d'avant si aucune extension n'est la).
+int SetSwapInterval(int interval);
+// extension utilisee par le dernier SetSwapInterval ("aucune" sinon)
+const char* GetSwapControlName();
+
+#endif //__SWAP_CONTROL_H__
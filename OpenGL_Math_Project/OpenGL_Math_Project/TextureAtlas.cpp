@@ -0,0 +1,186 @@
+#include "TextureAtlas.h"
+
+#include <algorithm>
+
+#define STB_RECT_PACK_IMPLEMENTATION
+#include "stb/stb_rect_pack.h"
+
+int TextureAtlas::Add(const SoftwareTexture& image)
+{
+	m_Images.push_back(&image);
+	return (int) m_Images.size() - 1;
+}
+
+// Taille d'un rectangle packe : l'image et sa gouttiere, arrondies au multiple de Gutter superieur
+static int PackedSize(int size)
+{
+	return (size + 2 * TextureAtlas::Gutter + TextureAtlas::Gutter - 1) / TextureAtlas::Gutter * TextureAtlas::Gutter;
+}
+
+bool TextureAtlas::Build(int maxLayerSize)
+{
+	m_Regions.assign(m_Images.size(), AtlasRegion());
+	m_LayerCount = m_FullLayerCount = 0;
+	m_Texels.clear();
+	if(m_Images.empty())
+		return false;
+
+	// plus petite puissance de 2 ou les images pleines et les rectangles packes tiennent
+	int largest = 1;
+	for(size_t i = 0; i < m_Images.size(); ++i)
+		largest = std::max(largest, std::max(m_Images[i]->width, m_Images[i]->height));
+	m_LayerSize = 1;
+	while(m_LayerSize < largest)
+		m_LayerSize *= 2;
+	for(; m_LayerSize <= maxLayerSize; m_LayerSize *= 2)
+	{
+		bool fits = true;
+		for(size_t i = 0; i < m_Images.size() && fits; ++i)
+		{
+			const SoftwareTexture& image = *m_Images[i];
+			const bool full = (image.width == m_LayerSize && image.height == m_LayerSize);
+			fits = full || (PackedSize(image.width) <= m_LayerSize && PackedSize(image.height) <= m_LayerSize);
+		}
+		if(fits)
+			break;
+	}
+	if(m_LayerSize > maxLayerSize)
+		return false;
+
+	// les images pleines d'abord, une couche chacune
+	std::vector<stbrp_rect> pending;
+	for(size_t i = 0; i < m_Images.size(); ++i)
+	{
+		const SoftwareTexture& image = *m_Images[i];
+		if(image.width == m_LayerSize && image.height == m_LayerSize)
+		{
+			m_Regions[i].layer = m_LayerCount++;
+			m_Regions[i].scale = glm::vec2(1.0f);
+			m_Regions[i].offset = glm::vec2(0.0f);
+			continue;
+		}
+		stbrp_rect rect;
+		rect.id = (int) i;
+		rect.w = (stbrp_coord) PackedSize(image.width);
+		rect.h = (stbrp_coord) PackedSize(image.height);
+		rect.x = rect.y = 0;
+		rect.was_packed = 0;
+		pending.push_back(rect);
+	}
+	m_FullLayerCount = m_LayerCount;
+
+	// puis autant de couches atlas que necessaire, chaque passe range ce qu'elle peut
+	std::vector<stbrp_rect> placed;
+	std::vector<int> placedLayers;
+	std::vector<stbrp_node> nodes(m_LayerSize);
+	while(!pending.empty())
+	{
+		stbrp_context context;
+		stbrp_init_target(&context, m_LayerSize, m_LayerSize, &nodes[0], (int) nodes.size());
+		stbrp_pack_rects(&context, &pending[0], (int) pending.size());
+
+		std::vector<stbrp_rect> remaining;
+		for(size_t r = 0; r < pending.size(); ++r)
+		{
+			if(pending[r].was_packed)
+			{
+				placed.push_back(pending[r]);
+				placedLayers.push_back(m_LayerCount);
+			}
+			else
+			{
+				remaining.push_back(pending[r]);
+			}
+		}
+		if(remaining.size() == pending.size())
+			return false;
+		pending.swap(remaining);
+		++m_LayerCount;
+	}
+
+	m_Texels.assign((size_t) m_LayerSize * m_LayerSize * m_LayerCount, 0);
+	for(size_t i = 0; i < m_Images.size(); ++i)
+	{
+		if(m_Regions[i].layer < m_FullLayerCount)
+			CopyImage((int) i, m_Regions[i].layer, 0, 0, m_LayerSize, m_LayerSize, 0);
+	}
+	for(size_t r = 0; r < placed.size(); ++r)
+	{
+		const stbrp_rect& rect = placed[r];
+		const SoftwareTexture& image = *m_Images[rect.id];
+		AtlasRegion& region = m_Regions[rect.id];
+		region.layer = placedLayers[r];
+		region.scale = glm::vec2((float) image.width, (float) image.height) / (float) m_LayerSize;
+		region.offset = glm::vec2((float) (rect.x + Gutter), (float) (rect.y + Gutter)) / (float) m_LayerSize;
+		CopyImage(rect.id, region.layer, rect.x, rect.y, rect.w, rect.h, Gutter);
+	}
+	return true;
+}
+
+// Remplit le rectangle [x, x + width[ x [y, y + height[ de la couche : l'image a partir de (x + gutter, y + gutter),
+// et autour d'elle son texel de bord le plus proche
+void TextureAtlas::CopyImage(int image, int layer, int x, int y, int width, int height, int gutter)
+{
+	const SoftwareTexture& source = *m_Images[image];
+	uint32_t* texels = &m_Texels[(size_t) layer * m_LayerSize * m_LayerSize];
+	for(int row = 0; row < height; ++row)
+	{
+		const int sourceRow = std::min(std::max(row - gutter, 0), source.height - 1);
+		const uint32_t* sourceTexels = &source.texels[(size_t) sourceRow * source.width];
+		uint32_t* destination = &texels[(size_t) (y + row) * m_LayerSize + x];
+		for(int column = 0; column < width; ++column)
+			destination[column] = sourceTexels[std::min(std::max(column - gutter, 0), source.width - 1)];
+	}
+}
+
+GLuint TextureAtlas::CreateTexture()
+{
+	if(m_Texels.empty())
+		return 0;
+
+	glGenTextures(1, &m_Texture);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, m_Texture);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	// au-dela, les gouttieres ne font plus un texel et les images voisines deborderaient
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, MipLevels - 1);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, m_LayerSize, m_LayerSize, m_LayerCount, 0, GL_RGBA, GL_UNSIGNED_BYTE, &m_Texels[0]);
+	glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	std::vector<uint32_t>().swap(m_Texels);
+	return m_Texture;
+}
+
+void TextureAtlas::Destroy()
+{
+	if(m_Texture)
+		glDeleteTextures(1, &m_Texture);
+	m_Texture = 0;
+	m_Images.clear();
+	m_Regions.clear();
+	std::vector<uint32_t>().swap(m_Texels);
+	m_LayerSize = m_LayerCount = m_FullLayerCount = 0;
+}
+
+size_t TextureAtlas::GetMemoryBytes() const
+{
+	size_t bytes = 0;
+	for(int level = 0; level < MipLevels; ++level)
+	{
+		const size_t size = std::max(m_LayerSize >> level, 1);
+		bytes += size * size * 4 * m_LayerCount;
+	}
+	return bytes;
+}
+
+size_t TextureAtlas::GetSeparateMemoryBytes() const
+{
+	size_t bytes = 0;
+	for(size_t i = 0; i < m_Images.size(); ++i)
+		bytes += (size_t) m_Images[i]->width * m_Images[i]->height * 4;
+	return bytes;
+}
@@ -0,0 +1,69 @@
+#ifndef __TEXTURE_ATLAS_H__
+#define __TEXTURE_ATLAS_H__
+
+#include <vector>
+#include <cstdint>
+
+#include "glm/glm.hpp"
+
+#include "Common.h"
+#include "SoftwareRasterizer.h"
+
+// Place d'une image dans le tableau de textures : uv atlas = clamp(uv, 0, 1) * scale + offset, dans la couche layer
+struct AtlasRegion
+{
+	int layer;
+	glm::vec2 scale;
+	glm::vec2 offset;
+};
+
+// Regroupe les textures des materiaux dans un seul GL_TEXTURE_2D_ARRAY, pour que des objets et des
+// materiaux differents partagent la meme liaison de texture (et donc le meme draw) :
+// - les images de la taille des couches occupent une couche entiere
+// - les autres sont packees avec stb_rect_pack dans des couches atlas, entourees d'une gouttiere de
+//   Gutter texels qui replique leurs bords (meme resultat que GL_CLAMP_TO_EDGE en filtrage lineaire)
+// - les rectangles sont alignes sur Gutter texels : jusqu'au niveau MipLevels - 1, un texel de mipmap ne
+//   melange jamais deux images (la gouttiere y fait encore au moins un texel)
+class TextureAtlas
+{
+public:
+	static const int Gutter = 8;
+	static const int MipLevels = 4;
+
+	TextureAtlas() : m_LayerSize(0), m_LayerCount(0), m_FullLayerCount(0), m_Texture(0) {}
+
+	// l'image doit rester valide jusqu'a Build, retourne son index
+	int Add(const SoftwareTexture& image);
+	// couches carrees de la plus petite puissance de 2 qui contient toutes les images (au plus maxLayerSize).
+	// Retourne false si une image ne rentre pas.
+	bool Build(int maxLayerSize);
+	// envoie les couches (et genere les mipmaps) puis libere la copie CPU
+	GLuint CreateTexture();
+	void Destroy();
+
+	inline const AtlasRegion& GetRegion(int image) const { return m_Regions[image]; }
+	inline int GetImageCount() const { return (int) m_Images.size(); }
+	inline int GetLayerSize() const { return m_LayerSize; }
+	inline int GetLayerCount() const { return m_LayerCount; }
+	inline int GetFullLayerCount() const { return m_FullLayerCount; }
+	inline GLuint GetTexture() const { return m_Texture; }
+	// memoire GPU du tableau (mipmaps comprises) et des images dans des textures separees sans mipmaps
+	size_t GetMemoryBytes() const;
+	size_t GetSeparateMemoryBytes() const;
+
+	// texels RGBA8 de la couche (ligne 0 en v = 0), valides entre Build et CreateTexture
+	inline const uint32_t* GetLayerTexels(int layer) const { return &m_Texels[(size_t) layer * m_LayerSize * m_LayerSize]; }
+
+private:
+	void CopyImage(int image, int layer, int x, int y, int width, int height, int gutter);
+
+	std::vector<const SoftwareTexture*> m_Images;
+	std::vector<AtlasRegion> m_Regions;
+	int m_LayerSize;
+	int m_LayerCount;
+	int m_FullLayerCount;
+	std::vector<uint32_t> m_Texels;
+	GLuint m_Texture;
+};
+
+#endif //__TEXTURE_ATLAS_H__
@@ -0,0 +1,570 @@
+#include "TriangleBvh.h"
+
+#include <cmath>
+#include <cfloat>
+#include <atomic>
+#include <algorithm>
+
+#include "Parallel.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE__)
+#define TRIANGLE_BVH_USE_SSE 1
+#include <emmintrin.h>
+#endif
+
+static_assert(sizeof(TriangleBvhNode) == 32, "TriangleBvhNode doit faire 32 octets");
+
+// en dessous, le rayon est considere parallele au triangle
+static const float ParallelEpsilon = 1e-12f;
+// cout d'un noeud interne relatif au test d'un triangle (SAH), eleve car les feuilles sont testees en SSE
+static const float TraversalCost = 2.0f;
+
+struct TriangleBvh::BuildContext
+{
+	std::vector<glm::vec3> triangleMin;
+	std::vector<glm::vec3> triangleMax;
+	std::vector<glm::vec3> centroids;
+	std::atomic<uint32_t> nodesUsed;
+	std::atomic<int> depth;
+	int parallelDepth;		// les niveaux au-dessus sont construits en parallele
+};
+
+// --- Construction ----------------------------------------------------------
+
+void TriangleBvh::Build(const std::vector<float>& positions, const uint32_t* indices, size_t indexCount)
+{
+	const size_t triangleCount = indexCount / 3;
+	m_TriangleIndices.resize(triangleCount);
+	m_Nodes.assign(std::max<size_t>(2 * triangleCount, 1), TriangleBvhNode());
+	m_Vertex0.resize(triangleCount);
+	m_Edge1.resize(triangleCount);
+	m_Edge2.resize(triangleCount);
+
+	BuildContext context;
+	context.triangleMin.resize(triangleCount);
+	context.triangleMax.resize(triangleCount);
+	context.centroids.resize(triangleCount);
+	for(size_t i = 0; i < triangleCount; ++i)
+	{
+		const glm::vec3 a(positions[indices[i * 3 + 0] * 3 + 0], positions[indices[i * 3 + 0] * 3 + 1], positions[indices[i * 3 + 0] * 3 + 2]);
+		const glm::vec3 b(positions[indices[i * 3 + 1] * 3 + 0], positions[indices[i * 3 + 1] * 3 + 1], positions[indices[i * 3 + 1] * 3 + 2]);
+		const glm::vec3 c(positions[indices[i * 3 + 2] * 3 + 0], positions[indices[i * 3 + 2] * 3 + 1], positions[indices[i * 3 + 2] * 3 + 2]);
+		context.triangleMin[i] = glm::min(a, glm::min(b, c));
+		context.triangleMax[i] = glm::max(a, glm::max(b, c));
+		context.centroids[i] = (a + b + c) * (1.0f / 3.0f);
+		m_TriangleIndices[i] = (uint32_t) i;
+		m_Vertex0[i] = glm::vec4(a, 0.0f);
+		m_Edge1[i] = glm::vec4(b - a, 0.0f);
+		m_Edge2[i] = glm::vec4(c - a, 0.0f);
+	}
+
+	// 2^parallelDepth sous-arbres independants au moins autant que de coeurs
+	context.parallelDepth = 0;
+	while((1u << context.parallelDepth) < GetWorkerCount())
+		++context.parallelDepth;
+	context.nodesUsed = 1;
+	context.depth = 0;
+
+	TriangleBvhNode& root = m_Nodes[0];
+	root.leftFirst = 0;
+	root.triangleCount = (uint32_t) triangleCount;
+	if(triangleCount > 0)
+		Subdivide(context, 0, 0);
+	else
+		root.boundsMin[0] = root.boundsMin[1] = root.boundsMin[2] = root.boundsMax[0] = root.boundsMax[1] = root.boundsMax[2] = 0.0f;
+
+	m_NodeCount = context.nodesUsed;
+	m_Depth = context.depth;
+	m_Nodes.resize(m_NodeCount);
+
+	// les donnees de triangles sont rangees dans l'ordre des feuilles pour des acces contigus
+	std::vector<glm::vec4> vertex0(triangleCount), edge1(triangleCount), edge2(triangleCount);
+	for(size_t i = 0; i < triangleCount; ++i)
+	{
+		vertex0[i] = m_Vertex0[m_TriangleIndices[i]];
+		edge1[i] = m_Edge1[m_TriangleIndices[i]];
+		edge2[i] = m_Edge2[m_TriangleIndices[i]];
+	}
+	m_Vertex0.swap(vertex0);
+	m_Edge1.swap(edge1);
+	m_Edge2.swap(edge2);
+}
+
+void TriangleBvh::Subdivide(BuildContext& context, uint32_t nodeIndex, int depth)
+{
+	TriangleBvhNode& node = m_Nodes[nodeIndex];
+	const uint32_t first = node.leftFirst;
+	const uint32_t count = node.triangleCount;
+
+	int maxDepth = context.depth;
+	while(depth > maxDepth && !context.depth.compare_exchange_weak(maxDepth, depth))
+	{
+	}
+
+	glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX), centroidMin(FLT_MAX), centroidMax(-FLT_MAX);
+	for(uint32_t i = first; i < first + count; ++i)
+	{
+		const uint32_t triangle = m_TriangleIndices[i];
+		boundsMin = glm::min(boundsMin, context.triangleMin[triangle]);
+		boundsMax = glm::max(boundsMax, context.triangleMax[triangle]);
+		centroidMin = glm::min(centroidMin, context.centroids[triangle]);
+		centroidMax = glm::max(centroidMax, context.centroids[triangle]);
+	}
+	for(int axis = 0; axis < 3; ++axis)
+	{
+		node.boundsMin[axis] = boundsMin[axis];
+		node.boundsMax[axis] = boundsMax[axis];
+	}
+	if(count <= 1)
+		return;
+
+	// SAH binnee : on repartit les centroides dans BinCount cases par axe et on evalue
+	// les BinCount - 1 plans de coupe entre les cases
+	struct Bin
+	{
+		glm::vec3 boundsMin, boundsMax;
+		uint32_t count;
+	};
+	float bestCost = FLT_MAX;
+	int bestAxis = -1, bestSplit = 0;
+	for(int axis = 0; axis < 3; ++axis)
+	{
+		const float extent = centroidMax[axis] - centroidMin[axis];
+		if(extent <= 0.0f)
+			continue;
+		const float scale = BinCount / extent;
+
+		Bin bins[BinCount];
+		for(int b = 0; b < BinCount; ++b)
+		{
+			bins[b].boundsMin = glm::vec3(FLT_MAX);
+			bins[b].boundsMax = glm::vec3(-FLT_MAX);
+			bins[b].count = 0;
+		}
+		for(uint32_t i = first; i < first + count; ++i)
+		{
+			const uint32_t triangle = m_TriangleIndices[i];
+			const int b = std::min(BinCount - 1, (int) ((context.centroids[triangle][axis] - centroidMin[axis]) * scale));
+			bins[b].boundsMin = glm::min(bins[b].boundsMin, context.triangleMin[triangle]);
+			bins[b].boundsMax = glm::max(bins[b].boundsMax, context.triangleMax[triangle]);
+			++bins[b].count;
+		}
+
+		// balayages gauche -> droite et droite -> gauche pour l'aire et le nombre de chaque cote
+		float leftArea[BinCount - 1], rightArea[BinCount - 1];
+		uint32_t leftCount[BinCount - 1], rightCount[BinCount - 1];
+		glm::vec3 leftMin(FLT_MAX), leftMax(-FLT_MAX), rightMin(FLT_MAX), rightMax(-FLT_MAX);
+		uint32_t leftSum = 0, rightSum = 0;
+		for(int b = 0; b < BinCount - 1; ++b)
+		{
+			leftSum += bins[b].count;
+			leftCount[b] = leftSum;
+			leftMin = glm::min(leftMin, bins[b].boundsMin);
+			leftMax = glm::max(leftMax, bins[b].boundsMax);
+			const glm::vec3 ld = leftMax - leftMin;
+			leftArea[b] = leftSum ? ld.x * ld.y + ld.y * ld.z + ld.z * ld.x : 0.0f;
+
+			const int r = BinCount - 1 - b;
+			rightSum += bins[r].count;
+			rightCount[r - 1] = rightSum;
+			rightMin = glm::min(rightMin, bins[r].boundsMin);
+			rightMax = glm::max(rightMax, bins[r].boundsMax);
+			const glm::vec3 rd = rightMax - rightMin;
+			rightArea[r - 1] = rightSum ? rd.x * rd.y + rd.y * rd.z + rd.z * rd.x : 0.0f;
+		}
+		for(int split = 0; split < BinCount - 1; ++split)
+		{
+			const float cost = leftCount[split] * leftArea[split] + rightCount[split] * rightArea[split];
+			if(cost < bestCost && leftCount[split] > 0 && rightCount[split] > 0)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = split;
+			}
+		}
+	}
+
+	const glm::vec3 d = boundsMax - boundsMin;
+	const float area = d.x * d.y + d.y * d.z + d.z * d.x;
+	const float leafCost = count * area;
+	bestCost += TraversalCost * area;
+	if(count <= (uint32_t) MaxLeafTriangles && (bestAxis < 0 || bestCost >= leafCost))
+		return;
+
+	uint32_t leftCount;
+	if(bestAxis >= 0)
+	{
+		const float scale = BinCount / (centroidMax[bestAxis] - centroidMin[bestAxis]);
+		uint32_t* begin = &m_TriangleIndices[first];
+		uint32_t* middle = std::partition(begin, begin + count, [&](uint32_t triangle) {
+			return std::min(BinCount - 1, (int) ((context.centroids[triangle][bestAxis] - centroidMin[bestAxis]) * scale)) <= bestSplit;
+		});
+		leftCount = (uint32_t) (middle - begin);
+	}
+	else
+	{
+		// tous les centroides sont confondus : coupe arbitraire pour respecter MaxLeafTriangles
+		leftCount = count / 2;
+	}
+
+	const uint32_t leftChild = context.nodesUsed.fetch_add(2);
+	m_Nodes[leftChild].leftFirst = first;
+	m_Nodes[leftChild].triangleCount = leftCount;
+	m_Nodes[leftChild + 1].leftFirst = first + leftCount;
+	m_Nodes[leftChild + 1].triangleCount = count - leftCount;
+	// attention : node peut etre invalide si m_Nodes etait realloue, mais il est dimensionne a l'avance
+	node.leftFirst = leftChild;
+	node.triangleCount = 0;
+
+	if(depth < context.parallelDepth)
+	{
+		ParallelFor(2, [&](size_t child) { Subdivide(context, leftChild + (uint32_t) child, depth + 1); });
+	}
+	else
+	{
+		Subdivide(context, leftChild, depth + 1);
+		Subdivide(context, leftChild + 1, depth + 1);
+	}
+}
+
+// --- Requetes --------------------------------------------------------------
+
+// Moller-Trumbore, les deux faces sont acceptees
+static inline bool IntersectTriangle(const glm::vec3& origin, const glm::vec3& direction, const glm::vec3& v0,
+									 const glm::vec3& e1, const glm::vec3& e2, float maxDistance, float& t, float& u, float& v)
+{
+	const glm::vec3 p = glm::cross(direction, e2);
+	const float det = glm::dot(e1, p);
+	if(fabsf(det) < ParallelEpsilon)
+		return false;
+	const float invDet = 1.0f / det;
+	const glm::vec3 s = origin - v0;
+	u = glm::dot(s, p) * invDet;
+	if(u < 0.0f || u > 1.0f)
+		return false;
+	const glm::vec3 q = glm::cross(s, e1);
+	v = glm::dot(direction, q) * invDet;
+	if(v < 0.0f || u + v > 1.0f)
+		return false;
+	t = glm::dot(e2, q) * invDet;
+	return t > 0.0f && t < maxDistance;
+}
+
+bool TriangleBvh::IntersectBruteForce(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, TriangleHit& hit) const
+{
+	bool found = false;
+	for(size_t i = 0; i < m_TriangleIndices.size(); ++i)
+	{
+		float t, u, v;
+		if(IntersectTriangle(origin, direction, glm::vec3(m_Vertex0[i]), glm::vec3(m_Edge1[i]), glm::vec3(m_Edge2[i]), maxDistance, t, u, v))
+		{
+			maxDistance = t;
+			hit.distance = t;
+			hit.triangle = m_TriangleIndices[i];
+			hit.u = u;
+			hit.v = v;
+			found = true;
+		}
+	}
+	return found;
+}
+
+void TriangleBvh::IntersectPacket(const RayPacket& packet, PacketHit& hit, int32_t instance) const
+{
+	if(m_TriangleIndices.empty())
+		return;
+
+	uint32_t localStack[64];
+	std::vector<uint32_t> heapStack;
+	uint32_t* stack = localStack;
+	if(m_Depth >= 63)
+	{
+		heapStack.resize(m_Depth + 2);
+		stack = &heapStack[0];
+	}
+	int stackSize = 0;
+
+	const Float8 zero = Set1(0.0f), one = Set1(1.0f), epsilon = Set1(ParallelEpsilon);
+	Float8 enter, farEnter;
+	if(MoveMask(IntersectPacketAabb(packet, m_Nodes[0].boundsMin, m_Nodes[0].boundsMax, hit.distance, enter)) == 0)
+		return;
+	uint32_t nodeIndex = 0;
+	for(;;)
+	{
+		const TriangleBvhNode& node = m_Nodes[nodeIndex];
+		if(node.triangleCount > 0)
+		{
+			// Moller-Trumbore : un triangle contre les 8 rayons
+			for(uint32_t i = node.leftFirst; i < node.leftFirst + node.triangleCount; ++i)
+			{
+				const Float8 v0x = Set1(m_Vertex0[i].x), v0y = Set1(m_Vertex0[i].y), v0z = Set1(m_Vertex0[i].z);
+				const Float8 e1x = Set1(m_Edge1[i].x), e1y = Set1(m_Edge1[i].y), e1z = Set1(m_Edge1[i].z);
+				const Float8 e2x = Set1(m_Edge2[i].x), e2y = Set1(m_Edge2[i].y), e2z = Set1(m_Edge2[i].z);
+
+				const Float8 px = packet.directionY * e2z - packet.directionZ * e2y;
+				const Float8 py = packet.directionZ * e2x - packet.directionX * e2z;
+				const Float8 pz = packet.directionX * e2y - packet.directionY * e2x;
+				const Float8 det = e1x * px + e1y * py + e1z * pz;
+				const Float8 invDet = one / det;
+				const Float8 sx = packet.originX - v0x, sy = packet.originY - v0y, sz = packet.originZ - v0z;
+				const Float8 u = (sx * px + sy * py + sz * pz) * invDet;
+				const Float8 qx = sy * e1z - sz * e1y;
+				const Float8 qy = sz * e1x - sx * e1z;
+				const Float8 qz = sx * e1y - sy * e1x;
+				const Float8 v = (packet.directionX * qx + packet.directionY * qy + packet.directionZ * qz) * invDet;
+				const Float8 t = (e2x * qx + e2y * qy + e2z * qz) * invDet;
+
+				const Float8 valid = CmpGe(Max(det, zero - det), epsilon) & CmpGe(u, zero) & CmpGe(v, zero) & CmpLe(u + v, one)
+								   & CmpGt(t, zero) & CmpLt(t, hit.distance) & packet.active;
+				const int mask = MoveMask(valid);
+				if(mask == 0)
+					continue;
+				hit.distance = Select(valid, t, hit.distance);
+				hit.u = Select(valid, u, hit.u);
+				hit.v = Select(valid, v, hit.v);
+				for(int lane = 0; lane < 8; ++lane)
+				{
+					if(mask & (1 << lane))
+					{
+						hit.triangle[lane] = (int32_t) m_TriangleIndices[i];
+						hit.instance[lane] = instance;
+					}
+				}
+			}
+		}
+		else
+		{
+			const uint32_t left = node.leftFirst;
+			const int leftMask = MoveMask(IntersectPacketAabb(packet, m_Nodes[left].boundsMin, m_Nodes[left].boundsMax, hit.distance, enter));
+			const int rightMask = MoveMask(IntersectPacketAabb(packet, m_Nodes[left + 1].boundsMin, m_Nodes[left + 1].boundsMax, hit.distance, farEnter));
+			if(leftMask && rightMask)
+			{
+				// ordre choisi par le premier rayon qui touche les deux enfants
+				float leftEnter[8], rightEnter[8];
+				Store8(leftEnter, enter);
+				Store8(rightEnter, farEnter);
+				const int both = leftMask & rightMask;
+				int lane = 0;
+				while(both && !(both & (1 << lane)))
+					++lane;
+				const bool leftFirst = !both || leftEnter[lane] <= rightEnter[lane];
+				stack[stackSize++] = leftFirst ? left + 1 : left;
+				nodeIndex = leftFirst ? left : left + 1;
+				continue;
+			}
+			if(leftMask || rightMask)
+			{
+				nodeIndex = leftMask ? left : left + 1;
+				continue;
+			}
+		}
+
+		// depile le prochain noeud encore touche par un rayon (les distances ont pu diminuer)
+		bool next = false;
+		while(stackSize > 0 && !next)
+		{
+			nodeIndex = stack[--stackSize];
+			next = MoveMask(IntersectPacketAabb(packet, m_Nodes[nodeIndex].boundsMin, m_Nodes[nodeIndex].boundsMax, hit.distance, enter)) != 0;
+		}
+		if(!next)
+			break;
+	}
+}
+
+#ifdef TRIANGLE_BVH_USE_SSE
+
+// distance d'entree dans la boite du noeud, FLT_MAX si elle est ratee
+static inline float IntersectNode(const TriangleBvhNode& node, __m128 origin, __m128 inverseDirection, __m128 maskXYZ, float maxDistance)
+{
+	// la 4eme composante chargee est leftFirst / triangleCount : elle est remplacee par 0 (entree) et maxDistance (sortie)
+	const __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.boundsMin), origin), inverseDirection);
+	const __m128 t2 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.boundsMax), origin), inverseDirection);
+	__m128 tNear = _mm_and_ps(_mm_min_ps(t1, t2), maskXYZ);
+	__m128 tFar = _mm_or_ps(_mm_and_ps(_mm_max_ps(t1, t2), maskXYZ), _mm_andnot_ps(maskXYZ, _mm_set1_ps(maxDistance)));
+
+	tNear = _mm_max_ps(tNear, _mm_shuffle_ps(tNear, tNear, _MM_SHUFFLE(1, 0, 3, 2)));
+	tNear = _mm_max_ps(tNear, _mm_shuffle_ps(tNear, tNear, _MM_SHUFFLE(2, 3, 0, 1)));
+	tFar = _mm_min_ps(tFar, _mm_shuffle_ps(tFar, tFar, _MM_SHUFFLE(1, 0, 3, 2)));
+	tFar = _mm_min_ps(tFar, _mm_shuffle_ps(tFar, tFar, _MM_SHUFFLE(2, 3, 0, 1)));
+
+	const float enter = _mm_cvtss_f32(tNear);
+	return (enter <= _mm_cvtss_f32(tFar)) ? enter : FLT_MAX;
+}
+
+bool TriangleBvh::Intersect(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, TriangleHit& hit) const
+{
+	if(m_TriangleIndices.empty())
+		return false;
+
+	const __m128 maskXYZ = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+	const __m128 origin4 = _mm_set_ps(0.0f, origin.z, origin.y, origin.x);
+	const __m128 inverseDirection4 = _mm_set_ps(0.0f, 1.0f / direction.z, 1.0f / direction.y, 1.0f / direction.x);
+
+	// rayon replique pour 4 triangles
+	const __m128 ox = _mm_set1_ps(origin.x), oy = _mm_set1_ps(origin.y), oz = _mm_set1_ps(origin.z);
+	const __m128 dx = _mm_set1_ps(direction.x), dy = _mm_set1_ps(direction.y), dz = _mm_set1_ps(direction.z);
+	const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+	const __m128 epsilon = _mm_set1_ps(ParallelEpsilon);
+	const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+
+	// chaque niveau empile au plus un enfant
+	uint32_t localStack[64];
+	std::vector<uint32_t> heapStack;
+	uint32_t* stack = localStack;
+	if(m_Depth >= 63)
+	{
+		heapStack.resize(m_Depth + 2);
+		stack = &heapStack[0];
+	}
+	int stackSize = 0;
+
+	bool found = false;
+	if(IntersectNode(m_Nodes[0], origin4, inverseDirection4, maskXYZ, maxDistance) == FLT_MAX)
+		return false;
+	uint32_t nodeIndex = 0;
+	for(;;)
+	{
+		const TriangleBvhNode& node = m_Nodes[nodeIndex];
+		if(node.triangleCount > 0)
+		{
+			// transposition AoS -> SoA des (au plus) 4 triangles de la feuille
+			const uint32_t first = node.leftFirst;
+			const uint32_t count = node.triangleCount;
+			__m128 v0[4], e1[4], e2[4];
+			for(uint32_t lane = 0; lane < 4; ++lane)
+			{
+				const uint32_t i = first + std::min(lane, count - 1);
+				v0[lane] = _mm_loadu_ps(&m_Vertex0[i].x);
+				e1[lane] = _mm_loadu_ps(&m_Edge1[i].x);
+				e2[lane] = _mm_loadu_ps(&m_Edge2[i].x);
+			}
+			_MM_TRANSPOSE4_PS(v0[0], v0[1], v0[2], v0[3]);
+			_MM_TRANSPOSE4_PS(e1[0], e1[1], e1[2], e1[3]);
+			_MM_TRANSPOSE4_PS(e2[0], e2[1], e2[2], e2[3]);
+
+			// Moller-Trumbore sur 4 triangles
+			const __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2[2]), _mm_mul_ps(dz, e2[1]));
+			const __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2[0]), _mm_mul_ps(dx, e2[2]));
+			const __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2[1]), _mm_mul_ps(dy, e2[0]));
+			const __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1[0], px), _mm_mul_ps(e1[1], py)), _mm_mul_ps(e1[2], pz));
+			const __m128 invDet = _mm_div_ps(one, det);
+			const __m128 sx = _mm_sub_ps(ox, v0[0]), sy = _mm_sub_ps(oy, v0[1]), sz = _mm_sub_ps(oz, v0[2]);
+			const __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), invDet);
+			const __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1[2]), _mm_mul_ps(sz, e1[1]));
+			const __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1[0]), _mm_mul_ps(sx, e1[2]));
+			const __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1[1]), _mm_mul_ps(sy, e1[0]));
+			const __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), invDet);
+			const __m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2[0], qx), _mm_mul_ps(e2[1], qy)), _mm_mul_ps(e2[2], qz)), invDet);
+
+			__m128 valid = _mm_cmpge_ps(_mm_and_ps(det, absMask), epsilon);
+			valid = _mm_and_ps(valid, _mm_cmpge_ps(u, zero));
+			valid = _mm_and_ps(valid, _mm_cmpge_ps(v, zero));
+			valid = _mm_and_ps(valid, _mm_cmple_ps(_mm_add_ps(u, v), one));
+			valid = _mm_and_ps(valid, _mm_cmpgt_ps(t, zero));
+			valid = _mm_and_ps(valid, _mm_cmplt_ps(t, _mm_set1_ps(maxDistance)));
+
+			const int mask = _mm_movemask_ps(valid) & ((1 << count) - 1);
+			if(mask)
+			{
+				float ts[4], us[4], vs[4];
+				_mm_storeu_ps(ts, t);
+				_mm_storeu_ps(us, u);
+				_mm_storeu_ps(vs, v);
+				for(uint32_t lane = 0; lane < count; ++lane)
+				{
+					if((mask & (1 << lane)) && ts[lane] < maxDistance)
+					{
+						maxDistance = ts[lane];
+						hit.distance = ts[lane];
+						hit.triangle = m_TriangleIndices[first + lane];
+						hit.u = us[lane];
+						hit.v = vs[lane];
+						found = true;
+					}
+				}
+			}
+		}
+		else
+		{
+			// les deux enfants sont voisins en memoire : on descend dans le plus proche
+			const uint32_t left = node.leftFirst;
+			float nearDistance = IntersectNode(m_Nodes[left], origin4, inverseDirection4, maskXYZ, maxDistance);
+			float farDistance = IntersectNode(m_Nodes[left + 1], origin4, inverseDirection4, maskXYZ, maxDistance);
+			uint32_t nearChild = left, farChild = left + 1;
+			if(farDistance < nearDistance)
+			{
+				std::swap(nearDistance, farDistance);
+				std::swap(nearChild, farChild);
+			}
+			if(nearDistance != FLT_MAX)
+			{
+				if(farDistance != FLT_MAX)
+					stack[stackSize++] = farChild;
+				nodeIndex = nearChild;
+				continue;
+			}
+		}
+
+		// depile le prochain noeud encore atteignable (maxDistance a pu diminuer)
+		bool next = false;
+		while(stackSize > 0 && !next)
+		{
+			nodeIndex = stack[--stackSize];
+			next = IntersectNode(m_Nodes[nodeIndex], origin4, inverseDirection4, maskXYZ, maxDistance) != FLT_MAX;
+		}
+		if(!next)
+			break;
+	}
+	return found;
+}
+
+#else
+
+bool TriangleBvh::Intersect(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, TriangleHit& hit) const
+{
+	if(m_TriangleIndices.empty())
+		return false;
+
+	const glm::vec3 inverseDirection = 1.0f / direction;
+	std::vector<uint32_t> stack;
+	stack.reserve(m_Depth + 2);
+	stack.push_back(0);
+
+	bool found = false;
+	while(!stack.empty())
+	{
+		const TriangleBvhNode& node = m_Nodes[stack.back()];
+		stack.pop_back();
+
+		const glm::vec3 t1 = (glm::vec3(node.boundsMin[0], node.boundsMin[1], node.boundsMin[2]) - origin) * inverseDirection;
+		const glm::vec3 t2 = (glm::vec3(node.boundsMax[0], node.boundsMax[1], node.boundsMax[2]) - origin) * inverseDirection;
+		const glm::vec3 tNear = glm::min(t1, t2), tFar = glm::max(t1, t2);
+		const float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+		const float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+		if(enter > exit)
+			continue;
+
+		if(node.triangleCount == 0)
+		{
+			stack.push_back(node.leftFirst);
+			stack.push_back(node.leftFirst + 1);
+			continue;
+		}
+		for(uint32_t i = node.leftFirst; i < node.leftFirst + node.triangleCount; ++i)
+		{
+			float t, u, v;
+			if(IntersectTriangle(origin, direction, glm::vec3(m_Vertex0[i]), glm::vec3(m_Edge1[i]), glm::vec3(m_Edge2[i]), maxDistance, t, u, v))
+			{
+				maxDistance = t;
+				hit.distance = t;
+				hit.triangle = m_TriangleIndices[i];
+				hit.u = u;
+				hit.v = v;
+				found = true;
+			}
+		}
+	}
+	return found;
+}
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef __TRIANGLE_BVH_H__
+#define __TRIANGLE_BVH_H__
+
+#include <vector>
+#include <cstdint>
+
+#include "glm/glm.hpp"
+
+#include "RayPacket.h"
+
+// Noeud compact de 32 octets (deux noeuds par ligne de cache) :
+// - noeud interne (triangleCount == 0) : leftFirst = enfant gauche, l'enfant droit le suit
+// - feuille : leftFirst = premier triangle dans l'ordre du BVH
+struct TriangleBvhNode
+{
+	float boundsMin[3];
+	uint32_t leftFirst;
+	float boundsMax[3];
+	uint32_t triangleCount;
+};
+
+struct TriangleHit
+{
+	float distance;			// parametre t du rayon
+	uint32_t triangle;		// index du triangle dans le tableau d'indices d'origine
+	float u, v;				// barycentriques : p = (1 - u - v) * v0 + u * v1 + v * v2
+};
+
+// BVH de triangles d'un mesh (repere local), construit par SAH binnee.
+// Les deux sous-arbres des premiers niveaux sont construits en parallele.
+// Les feuilles ont au plus 4 triangles, testes ensemble avec SSE.
+class TriangleBvh
+{
+public:
+	static const int MaxLeafTriangles = 4;
+	static const int BinCount = 16;
+
+	void Build(const std::vector<float>& positions, const uint32_t* indices, size_t indexCount);
+
+	// plus proche intersection avant maxDistance. La direction n'a pas besoin d'etre normalisee,
+	// distance est alors exprimee en multiples de direction.
+	bool Intersect(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, TriangleHit& hit) const;
+	// paquet de 8 rayons parcouru ensemble : un noeud est visite si au moins un rayon actif le touche.
+	// Les impacts plus proches que hit.distance remplacent ceux de hit et recoivent l'index instance
+	void IntersectPacket(const RayPacket& packet, PacketHit& hit, int32_t instance) const;
+	// version de reference sans BVH ni SIMD (verification)
+	bool IntersectBruteForce(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, TriangleHit& hit) const;
+
+	inline size_t GetNodeCount() const { return m_NodeCount; }
+	inline size_t GetTriangleCount() const { return m_TriangleIndices.size(); }
+	inline int GetDepth() const { return m_Depth; }
+	// boite de la racine, soit celle du mesh
+	inline glm::vec3 GetBoundsMin() const { return m_Nodes.empty() ? glm::vec3(0.0f) : glm::vec3(m_Nodes[0].boundsMin[0], m_Nodes[0].boundsMin[1], m_Nodes[0].boundsMin[2]); }
+	inline glm::vec3 GetBoundsMax() const { return m_Nodes.empty() ? glm::vec3(0.0f) : glm::vec3(m_Nodes[0].boundsMax[0], m_Nodes[0].boundsMax[1], m_Nodes[0].boundsMax[2]); }
+
+	TriangleBvh() : m_NodeCount(0), m_Depth(0) {}
+
+private:
+	struct BuildContext;
+	void Subdivide(BuildContext& context, uint32_t node, int depth);
+
+	std::vector<TriangleBvhNode> m_Nodes;
+	size_t m_NodeCount;
+	int m_Depth;
+	std::vector<uint32_t> m_TriangleIndices;	// ordre du BVH -> triangle d'origine
+	// sommet 0 et aretes de chaque triangle dans l'ordre du BVH (w inutilise, alignement 16 octets)
+	std::vector<glm::vec4> m_Vertex0;
+	std::vector<glm::vec4> m_Edge1;
+	std::vector<glm::vec4> m_Edge2;
+};
+
+#endif //__TRIANGLE_BVH_H__
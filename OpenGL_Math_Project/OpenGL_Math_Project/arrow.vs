@@ -4,7 +4,7 @@ layout(location = 0) in vec4 a_position;
 layout(location = 1) in vec3 a_normal;
 layout(location = 2) in vec2 a_texcoords;
 
-uniform mat4 u_worldMatrix;
+#include "drawdata.glsl"
 
 layout(std140) uniform ViewProj
 {
@@ -20,8 +20,15 @@ out Vertex
 
 void main(void)
 {
-	vec3 N = mat3(u_worldMatrix) * a_normal;
+	int base = int(a_drawIndex) * 7;
+	mat4 worldMatrix = mat4(texelFetch(u_drawData, base), texelFetch(u_drawData, base + 1),
+							texelFetch(u_drawData, base + 2), texelFetch(u_drawData, base + 3));
+	vec4 positionScale = texelFetch(u_drawData, base + 4);
+	vec3 positionOffset = texelFetch(u_drawData, base + 5).xyz;
+
+	vec4 position = vec4(a_position.xyz * positionScale.xyz + positionOffset, 1.0);
+	vec3 N = mat3(worldMatrix) * DecodeNormal(a_normal, positionScale.w > 0.5);
 	OUT.normal = N;
 	OUT.texcoords = a_texcoords;
-	gl_Position = u_projectionMatrix * u_viewMatrix * u_worldMatrix * a_position;
+	gl_Position = u_projectionMatrix * u_viewMatrix * worldMatrix * position;
 }
\ No newline at end of file
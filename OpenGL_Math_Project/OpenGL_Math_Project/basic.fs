@@ -4,6 +4,9 @@
 const vec3 L = vec3(0.0, 0.0, 1.0);
 
 uniform sampler2D u_sampler;
+// toutes les textures des materiaux dans un tableau (TextureAtlas), u_useAtlas > 0.5 pour l'utiliser
+uniform sampler2DArray u_atlas;
+uniform float u_useAtlas;
 
 in Vertex
 {
@@ -11,13 +14,22 @@ in Vertex
 	vec2 texcoords;
 	float useTransparency;
 	vec3 lightDirection;
+	flat vec4 atlasTransform;
+	flat float atlasLayer;
 } IN;
 
 out vec4 Fragment;
 
 void main(void)
 {
-    vec4 texColor = texture(u_sampler, IN.texcoords);
+    vec4 texColor;
+	if(u_useAtlas > 0.5) {
+		// le clamp reproduit GL_CLAMP_TO_EDGE, les gouttieres de l'atlas font le reste en filtrage lineaire
+		vec2 texcoords = clamp(IN.texcoords, 0.0, 1.0) * IN.atlasTransform.xy + IN.atlasTransform.zw;
+		texColor = texture(u_atlas, vec3(texcoords, IN.atlasLayer));
+	} else {
+		texColor = texture(u_sampler, IN.texcoords);
+	}
 
 	if(IN.useTransparency < 0.5) {
 		// calcul du cosinus de l'angle entre les deux vecteurs
@@ -4,9 +4,8 @@ layout(location = 0) in vec4 a_position;
 layout(location = 1) in vec3 a_normal;
 layout(location = 2) in vec2 a_texcoords;
 
-uniform mat4 u_worldMatrix;
+#include "drawdata.glsl"
 
-uniform vec3 u_offset;
 uniform float u_useTransparency;
 uniform vec3 u_lightDirection;
 
@@ -22,14 +21,25 @@ out Vertex
 	vec2 texcoords;
 	float useTransparency;
 	vec3 lightDirection;
+	flat vec4 atlasTransform;
+	flat float atlasLayer;
 } OUT;
 
 void main(void)
 {
-	vec3 N = mat3(u_worldMatrix) * a_normal;
+	int base = int(a_drawIndex) * 7;
+	mat4 worldMatrix = mat4(texelFetch(u_drawData, base), texelFetch(u_drawData, base + 1),
+							texelFetch(u_drawData, base + 2), texelFetch(u_drawData, base + 3));
+	vec4 positionScale = texelFetch(u_drawData, base + 4);
+	vec4 positionOffset = texelFetch(u_drawData, base + 5);
+
+	vec4 position = vec4(a_position.xyz * positionScale.xyz + positionOffset.xyz, 1.0);
+	vec3 N = mat3(worldMatrix) * DecodeNormal(a_normal, positionScale.w > 0.5);
 	OUT.normal = N;
 	OUT.texcoords = a_texcoords;
+	OUT.atlasTransform = texelFetch(u_drawData, base + 6);
+	OUT.atlasLayer = positionOffset.w;
 	OUT.useTransparency = u_useTransparency;
 	OUT.lightDirection = u_lightDirection;
-	gl_Position = u_projectionMatrix * u_viewMatrix * u_worldMatrix * (a_position + vec4(u_offset, 0.0f));
+	gl_Position = u_projectionMatrix * u_viewMatrix * worldMatrix * position;
 }
\ No newline at end of file
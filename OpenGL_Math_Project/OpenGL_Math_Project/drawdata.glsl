@@ -0,0 +1,20 @@
+// Partie commune de basic.vs et arrow.vs, inseree par #include (voir EsgiShader.cpp)
+
+// index du draw dans u_drawData (baseInstance du draw, voir DrawBatch.h)
+layout(location = 3) in uint a_drawIndex;
+
+// Donnees par draw, 7 texels : matrice monde (4 colonnes), puis l'echelle et l'offset du format compact
+// (position en unorm16 relative a l'AABB, voir Mesh.cpp). positionScale.w = 1 si la normale est en octaedre.
+// Pour le format float, scale = 1, offset = 0 et w = 0. positionOffset.w est la couche du tableau de textures
+// et le 7eme texel la transformation des uv vers leur rectangle (voir TextureAtlas.h)
+uniform samplerBuffer u_drawData;
+
+vec3 DecodeNormal(vec3 n, bool octahedral)
+{
+	if(!octahedral)
+		return n;
+	vec3 o = vec3(n.xy, 1.0 - abs(n.x) - abs(n.y));
+	if(o.z < 0.0)
+		o.xy = (1.0 - abs(o.yx)) * vec2(o.x >= 0.0 ? 1.0 : -1.0, o.y >= 0.0 ? 1.0 : -1.0);
+	return normalize(o);
+}
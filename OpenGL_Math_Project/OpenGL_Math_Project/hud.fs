@@ -0,0 +1,10 @@
+#version 330
+
+in vec4 v_color;
+
+out vec4 Fragment;
+
+void main(void)
+{
+	Fragment = v_color;
+}
@@ -0,0 +1,15 @@
+#version 330
+
+// Quads du PerfHud en pixels, origine en haut a gauche (y vers le bas comme stb_easy_font)
+layout (location = 0) in vec2 a_position;
+layout (location = 1) in vec4 a_color;
+out vec4 v_color;
+
+uniform vec2 u_screenSize;
+
+void main(void)
+{
+	vec2 ndc = a_position / u_screenSize * 2.0 - 1.0;
+	gl_Position = vec4(ndc.x, -ndc.y, 0.0, 1.0);
+	v_color = a_color;
+}
@@ -1,10 +1,15 @@
 #define _USE_MATH_DEFINES
 
 #include <cstdio>
+#include <cstdlib>
+#include <cstddef>
 #include <cmath>
+#include <algorithm>
 #include <vector>
 #include <string>
 #include <iostream>
+#include <chrono>
+#include <cstring>
 
 #include "../common/EsgiShader.h"
 #include "Common.h"
@@ -12,6 +17,29 @@
 #include "AntTweakBar.h"
 
 #include "Quaternion.h"
+#include "Mesh.h"
+#include "MeshArena.h"
+#include "AssetManager.h"
+#include "DrawBatch.h"
+#include "Culling.h"
+#include "OcclusionCulling.h"
+#include "DynamicBvh.h"
+#include "TriangleBvh.h"
+#include "SoftwareRasterizer.h"
+#include "RayTracer.h"
+#include "FrameCapture.h"
+#include "TextureAtlas.h"
+#include "PerfHud.h"
+#include "InputLog.h"
+#include "DynamicResolution.h"
+#include "FrameScheduler.h"
+#include "FixedTimestep.h"
+#include "SwapControl.h"
+#include "SceneSimulation.h"
+#include "JobSystem.h"
+#include "FrameAllocator.h"
+#include "AllocationStats.h"
+#include "Benchmarks.h"
 
 TwBar* objTweakBar;
 
@@ -19,8 +47,6 @@ EsgiShader g_BasicShader;
 EsgiShader g_ArrowShader;
 EsgiShader g_SkyboxShader;
 
-int previousTime = 0;
-
 struct ViewProj
 {
 	// Les matrices
@@ -38,6 +64,7 @@ struct ViewProj
 	// Buffer
 	GLuint UBO;
 } g_Camera;
+glm::vec3 g_PreviousCameraPosition;				// avant le dernier pas de simulation (interpolation du rendu)
 
 struct Object
 {
@@ -46,14 +73,42 @@ struct Object
 	glm::vec3 rotation;
 	glm::mat4 worldMatrix;
 
-	// Mesh
+	// Mesh (VBO/IBO/VAO propres a l'objet, sinon allocation d'un modele de g_Assets dans une MeshArena)
+	AssetManager::Handle meshAsset;
 	GLuint VBO;
 	GLuint IBO;
+	MeshArena* arena;
+	MeshArena::Handle allocation;
 	GLuint ElementCount;
 	GLenum PrimitiveType;
+	GLenum IndexType;
 	GLuint VAO;
 
-	// Material
+	// Format de sommet (voir Mesh.h) : position = a_position * positionScale + positionOffset
+	bool compactVertices;
+	glm::vec3 positionScale;
+	glm::vec3 positionOffset;
+
+	// Niveaux de detail : plages de l'IBO qui partagent le VBO, le niveau 0 est le mesh complet
+	std::vector<ModelLod> lods;
+	glm::vec3 boundsMin;
+	glm::vec3 boundsMax;
+	glm::vec3 sphereCenter;
+	float sphereRadius;
+
+	// copie CPU pour l'occlusion culling : LOD grossier rentre de son erreur (BuildConservativeOccluder)
+	std::vector<float> occluderPositions;
+	std::vector<uint32_t> occluderIndices;
+	// BVH de triangles du mesh complet (repere local) pour le picking
+	TriangleBvh triangleBvh;
+	// donnees CPU du modele et images des materiaux, epinglees dans g_Assets tant que l'objet les reference
+	// (rasteriseur logiciel, lanceur de rayons, atlas) : mesh.indices contient tous les LODs, comme l'IBO
+	const ModelData* model;
+	std::vector<const SoftwareTexture*> softwareTextures;
+
+	// Material : une texture de g_Assets par materiau (fusionnes au chargement, voir MergeMaterials), textureObj pour la cubemap
+	std::vector<AssetManager::Handle> materialTextures;
+	std::vector<int> atlasImages;		// image de chaque materiau dans g_TextureAtlas, vide si l'objet n'y est pas
 	GLuint textureObj;
 
 	// Champs divers
@@ -64,10 +119,104 @@ struct Object
 
 Object g_Rock;
 Object g_Arrow;
+Object g_Car;										// mesh multi-formes et multi-materiaux (Smallcar.obj)
 Object g_CubeMap;
+const SoftwareTexture g_MissingTexture;				// materiau dont la texture est introuvable : ombrage sans texture
+MeshArena g_MeshArenas[VERTEX_FORMAT_COUNT];		// une arena de geometrie par format de sommet
+AssetManager g_Assets;								// modeles et textures partages entre les objets
+int assetCpuBudgetMB = 256;							// budgets d'eviction de g_Assets
+int assetGpuBudgetMB = 512;
+float textureCpuMB = 0.0f, textureGpuMB = 0.0f;		// memoire residente de g_Assets par type
+float modelCpuMB = 0.0f, modelGpuMB = 0.0f;
+int assetEvictions = 0;
+int sharedAssets = 0;								// demandes et fichiers servis par un asset deja charge
+DrawBatch g_DrawBatch;								// draws de la frame, envoyes en glMultiDrawElementsIndirect
+const GLuint DrawDataTextureUnit = 1;				// unite de texture du texture buffer u_drawData
+const GLuint AtlasTextureUnit = 2;					// unite de texture du tableau u_atlas
+TextureAtlas g_TextureAtlas;						// textures de tous les materiaux des objets textures
+bool textureAtlas = true;							// un seul bind et un seul Submit pour les objets de l'atlas
+int textureBindCount = 0;							// liaisons de textures de materiaux a la derniere frame
+PerfHud g_PerfHud;									// overlay de performances (touche h)
+FrameStats g_FrameStats;							// compteurs de la frame en cours pour le HUD
+InputLog g_InputLog;								// enregistrement / rejeu des entrees (--record, --replay)
+DynamicResolution g_DynamicResolution;				// scene rendue hors ecran a une echelle reglee sur le temps GPU
+bool dynamicResolution = false;						// l'echelle suit le temps GPU : desactivee par defaut pour que --replay et --capture soient reproductibles
+float resolutionBudget = 12.0f;						// temps GPU vise pour la scene, en millisecondes
+float minResolutionScale = 0.5f;
+float resolutionScale = 1.0f;						// echelle de la derniere frame, sur chaque axe
+float sceneGpuTime = 0.0f;							// derniere mesure du temps GPU de la scene, en millisecondes
+FrameScheduler g_FrameScheduler;					// rendu seulement quand une entree de la frame change
+bool onDemandRendering = true;
+int maxFps = 0;										// plafond de frames par seconde (0 : aucun)
+int renderedFrames = 0;
+float activeCpuUsage = 0.0f, idleCpuUsage = 0.0f;	// en pourcentage d'un coeur
+FixedTimestep g_FixedTimestep;						// simulation a pas fixe, rendu interpole
+int simulationRate = 120;							// pas de simulation par seconde
+int swapInterval = SWAP_ADAPTIVE;					// demande depuis la TweakBar (-1, 0 ou 1)
+int requestedSwapInterval = SWAP_ADAPTIVE;
+int appliedSwapInterval = SWAP_IMMEDIATE;			// retenu par le pilote (sans extension tear : 1 au lieu de -1)
+float frameTimeMean = 0.0f, frameTimeDeviation = 0.0f;	// entre deux presentations, en millisecondes
+#if GL_TRACE
+int glCallCount = 0, glBindCount = 0;				// appels GL interceptes a la derniere frame (GlTrace.h)
+float glUploadKB = 0.0f;
+float glTraceOverhead = 0.0f;						// en millisecondes
+#endif
+bool threadedSimulation = true;						// preparation des frames sur le thread de simulation
+SceneSimulation g_SceneSimulation;
+SceneSnapshot g_SerialSnapshot;						// frame preparee sur le thread de rendu (sans thread de simulation)
+const SceneSnapshot* g_RenderSnapshot = &g_SerialSnapshot;	// frame soumise par le dernier Render
+uint32_t g_SceneFrame = 0;							// derniere frame dont les entrees sont parties en preparation
+bool g_FlushPipeline = false;						// Render attend la snapshot de g_SceneFrame au lieu d'en demander une
+int snapshotLag = 0;								// frames de retard de la snapshot soumise sur ses entrees
+int mergedInputs = 0;
+#if ALLOCATOR_STATS
+int frameHeapAllocations = 0;						// operator new entre les deux derniers Render (tous threads)
+#endif
+float sceneArenaKB = 0.0f;							// arena de la derniere preparation
+float prepareTime = 0.0f;							// preparation de la derniere frame soumise, en millisecondes
+bool g_PickPending = false;							// clic a transmettre avec les entrees de la prochaine frame
+Ray g_PickRay;
+// donnees de la preparation : seule PrepareScene y touche, sur un seul thread a la fois
+SphereBatch g_RockSpheres;							// spheres englobantes monde des rochers
+OcclusionCuller g_OcclusionCuller;					// depth buffer logiciel des occulteurs
+DynamicBvh g_SceneTree;								// index spatial des rochers (userData = index dans rockInstances)
+std::vector<int> g_RockProxies;
+std::vector<int> g_SceneQueryResults;
+LinearArena g_SceneArena(64 * 1024);				// tableaux temporaires d'une preparation, rendus au debut de la suivante
+ScenePick g_LastPick;
 glm::vec3 lightDirection = glm::vec3(0.0f, 0.0f, -1.0f);
 bool wireframe;
 bool transparent;
+bool showCar = false;
+bool compactVertices = true;						// format de sommet quantifie (16 octets) pour les meshs charges
+int rockLodLevels = 4;								// nombre de niveaux de detail generes pour les rochers
+float lodPixelError = 1.0f;							// erreur tolere a l'ecran (en pixels) lors du choix du LOD
+bool multiDraw = true;								// glMultiDrawElementsIndirect, sinon un appel par draw
+int drawCallCount = 0;								// appels de dessin emis a la derniere frame
+bool frustumCulling = true;
+bool sceneTreeCulling = true;						// requete frustum dans g_SceneTree, sinon test SoA de toutes les spheres
+int visibleRockCount = 0, culledRockCount = 0;
+bool occlusionCulling = true;
+int maxOccluders = 8;								// seuls les rochers les plus gros a l'ecran servent d'occulteurs
+int occludedRockCount = 0;
+float occlusionTime = 0.0f;							// en millisecondes
+int g_PickedRock = -1;								// index dans rockInstances du dernier rocher clique
+glm::vec3 g_PickedPoint;							// point d'impact monde du picking
+float pickingTime = 0.0f;							// en microsecondes
+SoftwareRasterizer g_SoftwareRasterizer;			// backend CPU, son image est copiee dans la fenetre
+GLuint g_SoftwareColorTexture;
+GLuint g_SoftwareFramebuffer;
+bool softwareRendering = false;
+float softwareRenderTime = 0.0f;					// en millisecondes
+RayTracer g_RayTracer;								// images de reference (bouton "Reference image")
+SoftwareCubeMap g_SoftwareSkybox;					// faces de la skybox pour le lanceur de rayons, chargees au premier usage
+bool traceShadows = true;
+FrameCapture g_FrameCapture;						// lecture asynchrone des frames (PBO) et encodage en arriere-plan
+bool captureRaw = false;							// sequence brute mappee en memoire plutot qu'un PNG par frame
+const int RawCaptureFrames = 600;					// capacite de la sequence brute lancee depuis la TweakBar
+int capturedFrames = 0;
+int droppedCaptureFrames = 0;
+float captureTime = 0.0f;							// en millisecondes, sur le thread de rendu
 int numCubes = 30, sizeX = 6, sizeY = 6, sizeZ = 6;
 double ka = 5.3, kb = 1.7, kc = 4.1, speed = 1.;
 
@@ -84,6 +233,29 @@ int deltaY;
 unsigned char keyState[255];
 unsigned char mouseButtonsState[10];
 
+static const char* g_SkyboxFiles[] = {
+	//"skybox/right.jpg",
+	//"skybox/left.jpg",
+	//"skybox/top.jpg",
+	//"skybox/bottom.jpg",
+	//"skybox/back.jpg",
+	//"skybox/front.jpg",
+
+	//"skybox/Powerlines/posx.jpg",
+	//"skybox/Powerlines/negx.jpg",
+	//"skybox/Powerlines/posy.jpg",
+	//"skybox/Powerlines/negy.jpg",
+	//"skybox/Powerlines/posz.jpg",
+	//"skybox/Powerlines/negz.jpg",
+
+	"skybox/Park3/posx.jpg",
+	"skybox/Park3/negx.jpg",
+	"skybox/Park3/posy.jpg",
+	"skybox/Park3/negy.jpg",
+	"skybox/Park3/posz.jpg",
+	"skybox/Park3/negz.jpg",
+};
+
 void InitCubemap()
 {
 	static const float skyboxVertices[] = {
@@ -130,30 +302,7 @@ void InitCubemap()
 		 1.0f, -1.0f,  1.0f
 	};
 
-	static const char* skyboxFiles[] = {
-		//"skybox/right.jpg",
-		//"skybox/left.jpg",
-		//"skybox/top.jpg",
-		//"skybox/bottom.jpg",
-		//"skybox/back.jpg",
-		//"skybox/front.jpg",
-
-		//"skybox/Powerlines/posx.jpg",
-		//"skybox/Powerlines/negx.jpg",
-		//"skybox/Powerlines/posy.jpg",
-		//"skybox/Powerlines/negy.jpg",
-		//"skybox/Powerlines/posz.jpg",
-		//"skybox/Powerlines/negz.jpg",
-
-		"skybox/Park3/posx.jpg",
-		"skybox/Park3/negx.jpg",
-		"skybox/Park3/posy.jpg",
-		"skybox/Park3/negy.jpg",
-		"skybox/Park3/posz.jpg",
-		"skybox/Park3/negz.jpg",
-	};
-
-	LoadAndCreateCubeMap(skyboxFiles, g_CubeMap.textureObj);
+	LoadAndCreateCubeMap(g_SkyboxFiles, g_CubeMap.textureObj);
 
 	glGenVertexArrays(1, &g_CubeMap.VAO);
 	glGenBuffers(1, &g_CubeMap.VBO);
@@ -186,108 +335,222 @@ void InitCubemap()
 	glUseProgram(0);
 }
 
-void LoadOBJ(const std::string &inputFile, Object &object)
+// Le modele (mesh, LODs, geometrie dans l'arena) et ses textures viennent de g_Assets : un fichier deja charge
+// pour un autre objet est partage. L'objet pointe sur les donnees CPU du modele et de ses textures, et ne garde
+// que ce qu'il en derive (occulteur, BVH de picking).
+void LoadOBJ(const std::string &inputFile, Object &object, int lodLevels = 1)
 {
-	std::vector<tinyobj::shape_t> shapes;
-	std::vector<tinyobj::material_t> materials;
-
-	std::string err = tinyobj::LoadObj(shapes, materials, inputFile.c_str());
-	const std::vector<unsigned int>& indices = shapes[0].mesh.indices;
-	const std::vector<float>& positions = shapes[0].mesh.positions;
-	const std::vector<float>& normals = shapes[0].mesh.normals;
-	const std::vector<float>& texcoords = shapes[0].mesh.texcoords;
-
-	object.ElementCount = indices.size();
-
-	uint32_t stride = 0;
-
-	if(positions.size())
+	object.meshAsset = g_Assets.AcquireModel(inputFile, lodLevels, compactVertices ? VERTEX_FORMAT_COMPACT : VERTEX_FORMAT_FLOAT);
+	const ModelData* model = g_Assets.GetModel(object.meshAsset);
+	const ModelGpu* gpu = g_Assets.GetModelGpu(object.meshAsset);
+	if(!model || !gpu)
 	{
-		stride += 3 * sizeof(float);
+		printf("%s : modele introuvable ou illisible\n", inputFile.c_str());
+		return;
 	}
-	if(normals.size())
+	const MeshData& mesh = model->mesh;
+
+	object.arena = gpu->arena;
+	object.allocation = gpu->allocation;
+	object.IndexType = gpu->indexType;
+	object.compactVertices = gpu->arena->GetFormat() == VERTEX_FORMAT_COMPACT;
+	object.positionScale = gpu->positionScale;
+	object.positionOffset = gpu->positionOffset;
+
+	object.lods = model->lods;
+	object.ElementCount = object.lods[0].indexCount;
+	object.PrimitiveType = GL_TRIANGLES;
+	object.boundsMin = mesh.boundsMin;
+	object.boundsMax = mesh.boundsMax;
+	object.sphereCenter = mesh.sphereCenter;
+	object.sphereRadius = mesh.sphereRadius;
+
+	// occulteur : le niveau le plus grossier dont l'erreur reste petite devant le mesh, rentre de cette erreur
+	size_t occluderLevel = 0;
+	for(size_t level = 1; level < object.lods.size(); ++level)
 	{
-		stride += 3 * sizeof(float);
+		if(object.lods[level].error <= OccluderMaxError * mesh.sphereRadius)
+			occluderLevel = level;
 	}
-	if(texcoords.size())
+	const ModelLod& occluderLod = object.lods[occluderLevel];
+	BuildConservativeOccluder(mesh.positions, &mesh.indices[occluderLod.firstIndex], occluderLod.indexCount, occluderLod.error,
+							  object.occluderPositions, object.occluderIndices);
+	object.triangleBvh.Build(mesh.positions, &mesh.indices[0], object.lods[0].indexCount);
+	object.model = model;
+
+	// une texture par materiau fusionne, meme si plusieurs formes ou plusieurs objets l'utilisent.
+	// La texture GL n'est creee qu'au premier dessin.
+	const std::vector<std::string>& textures = model->textures;
+	object.materialTextures.resize(textures.size());
+	object.softwareTextures.resize(textures.size());
+	for(size_t material = 0; material < textures.size(); ++material)
 	{
-		stride += 2 * sizeof(float);
+		object.materialTextures[material] = g_Assets.AcquireTexture(textures[material]);
+		const SoftwareTexture* image = g_Assets.GetTextureImage(object.materialTextures[material]);
+		object.softwareTextures[material] = image ? image : &g_MissingTexture;
+		if(!image && !textures[material].empty())
+			printf("%s : texture %s introuvable\n", inputFile.c_str(), textures[material].c_str());
 	}
+}
 
-	const auto count = positions.size() / 3;
-	const auto totalSize = count * stride;
 
-	glGenBuffers(1, &object.IBO);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, object.IBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), &indices[0], GL_STATIC_DRAW);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+// Choisit le niveau le plus grossier dont l'erreur projetee a l'ecran reste sous l'erreur toleree de la frame
+int SelectLod(const Object& object, const glm::mat4& worldMatrix, const glm::vec3& offset, const SceneFrameInput& input)
+{
+	const glm::vec3 center = glm::vec3(worldMatrix * glm::vec4((object.boundsMin + object.boundsMax) * 0.5f + offset, 1.0f));
+	const float scale = std::max(glm::length(glm::vec3(worldMatrix[0])), std::max(glm::length(glm::vec3(worldMatrix[1])), glm::length(glm::vec3(worldMatrix[2]))));
+	const float distance = std::max(glm::length(center - input.cameraPosition), 0.1f);
 
-	glGenBuffers(1, &object.VBO);
-	glBindBuffer(GL_ARRAY_BUFFER, object.VBO);
-	glBufferData(GL_ARRAY_BUFFER, totalSize, nullptr, GL_STATIC_DRAW);
+	// projectionMatrix[1][1] = 1 / tan(fovy / 2) : nombre de pixels par unite a distance 1
+	const float pixelsPerUnit = input.projectionMatrix[1][1] * input.viewportHeight * 0.5f / distance;
+	for(int level = (int) object.lods.size() - 1; level > 0; --level)
+	{
+		if(object.lods[level].error * scale * pixelsPerUnit <= input.lodPixelError)
+			return level;
+	}
+	return 0;
+}
+
+const int CarLod = 0;								// la voiture n'a qu'un niveau de detail (jamais cullee)
+
+// Ajoute un draw d'une plage de l'IBO de l'objet au batch avec ses donnees par draw (matrice monde, format de sommet
+// et rectangle de l'atlas, voir basic.vs)
+void AddDraw(DrawBatch& batch, const Object& object, GLuint firstIndex, GLuint indexCount, const glm::mat4& worldMatrix,
+			 const AtlasRegion* region = nullptr)
+{
+	DrawData data;
+	data.worldMatrix = worldMatrix;
+	data.positionScale = glm::vec4(object.positionScale, object.compactVertices ? 1.0f : 0.0f);
+	data.positionOffset = glm::vec4(object.positionOffset, region ? (float) region->layer : 0.0f);
+	data.texcoordTransform = region ? glm::vec4(region->scale, region->offset) : glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+
+	batch.Add(*object.arena, object.allocation, object.IndexType, firstIndex, indexCount, data);
+}
 
-	// glMapBuffer retourne un pointeur sur la zone memoire allouee par glBufferData 
-	// du Buffer Object qui est actuellement actif - via glBindBuffer(<cible>, <id>)
-	// il est imperatif d'appeler glUnmapBuffer() une fois que l'on a termine car le
-	// driver peut tres bien etre amener a modifier l'emplacement memoire du BO.
-	float* vertices = (float*) glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
-	for(auto index = 0; index < count; ++index)
+// Ajoute les compteurs du dernier Submit du batch a ceux de la frame
+void CountSubmit(const DrawBatch& batch)
+{
+	g_FrameStats.drawCalls += (int) batch.GetSubmitCount();
+	g_FrameStats.triangles += (int) batch.GetSubmitTriangles();
+	g_FrameStats.stateChanges += (int) batch.GetSubmitBinds();
+	g_FrameStats.uploadBytes += batch.GetSubmitUploadBytes();
+}
+
+// Dessine les instances d'un objet texture (basic.fs) materiau par materiau : la texture est liee une seule
+// fois par materiau et toutes les plages de ce materiau (toutes instances confondues) partent dans le meme
+// Submit. lods[i] : niveau de detail de l'instance i, -1 si elle est cullee. Retourne le nombre d'appels.
+// Tableaux bruts : un objet seul (la voiture) passe sa matrice sans construire de vector a chaque frame.
+int SubmitMaterialDraws(DrawBatch& batch, const Object& object, const glm::mat4* instances, const int* lods, size_t instanceCount)
+{
+	int submitCount = 0;
+	for(size_t material = 0; material < object.materialTextures.size(); ++material)
 	{
-		if(positions.size())
-		{
-			memcpy(vertices, &positions[index * 3], 3 * sizeof(float));
-			vertices += 3;
-		}
-		if(normals.size())
+		batch.Clear();
+		for(size_t i = 0; i < instanceCount; ++i)
 		{
-			memcpy(vertices, &normals[index * 3], 3 * sizeof(float));
-			vertices += 3;
+			if(lods[i] < 0)
+				continue;
+			const std::vector<Submesh>& submeshes = object.lods[lods[i]].submeshes;
+			for(size_t s = 0; s < submeshes.size(); ++s)
+			{
+				if(submeshes[s].material == (int) material)
+					AddDraw(batch, object, submeshes[s].firstIndex, submeshes[s].indexCount, instances[i]);
+			}
 		}
-		if(texcoords.size())
+		if(batch.GetDrawCount() == 0)
+			continue;
+
+		glBindTexture(GL_TEXTURE_2D, g_Assets.GetTexture(object.materialTextures[material]));
+		++textureBindCount;
+		batch.Submit(object.PrimitiveType, DrawDataTextureUnit, multiDraw);
+		CountSubmit(batch);
+		submitCount += (int) batch.GetSubmitCount();
+	}
+	return submitCount;
+}
+
+// Mode atlas : ajoute toutes les plages des instances au batch, chacune avec le rectangle de son materiau.
+// Les objets de l'atlas et leurs materiaux partagent alors le meme Submit et la meme liaison de texture.
+void AddAtlasDraws(DrawBatch& batch, const Object& object, const glm::mat4* instances, const int* lods, size_t instanceCount)
+{
+	for(size_t i = 0; i < instanceCount; ++i)
+	{
+		if(lods[i] < 0)
+			continue;
+		const std::vector<Submesh>& submeshes = object.lods[lods[i]].submeshes;
+		for(size_t s = 0; s < submeshes.size(); ++s)
 		{
-			memcpy(vertices, &texcoords[index * 2], 2 * sizeof(float));
-			vertices += 2;
+			AddDraw(batch, object, submeshes[s].firstIndex, submeshes[s].indexCount, instances[i],
+					&g_TextureAtlas.GetRegion(object.atlasImages[submeshes[s].material]));
 		}
 	}
-	glUnmapBuffer(GL_ARRAY_BUFFER);
-
-	glGenVertexArrays(1, &object.VAO);
-	glBindVertexArray(object.VAO);
-	glBindBuffer(GL_ARRAY_BUFFER, object.VBO);
-	uint32_t offset = 3 * sizeof(float);
-	glVertexAttribPointer(0, 3, GL_FLOAT, false, stride, nullptr);
-	glEnableVertexAttribArray(0);
+}
 
-	if(normals.size())
+// Range les textures des objets dans g_TextureAtlas (images CPU des materiaux, epinglees dans g_Assets)
+void BuildTextureAtlas(Object* objects[], int objectCount)
+{
+	for(int o = 0; o < objectCount; ++o)
 	{
-		glVertexAttribPointer(1, 3, GL_FLOAT, false, stride, (GLvoid *) offset);
-		glEnableVertexAttribArray(1);
-		offset += 3 * sizeof(float);
+		Object& object = *objects[o];
+		object.atlasImages.clear();
+		// un materiau sans texture : l'objet garde ses textures separees
+		bool textured = !object.softwareTextures.empty();
+		for(size_t material = 0; material < object.softwareTextures.size(); ++material)
+			textured = textured && !object.softwareTextures[material]->texels.empty();
+		if(!textured)
+			continue;
+		for(size_t material = 0; material < object.softwareTextures.size(); ++material)
+			object.atlasImages.push_back(g_TextureAtlas.Add(*object.softwareTextures[material]));
 	}
 
-	if(texcoords.size())
+	GLint maxLayerSize = 0, maxLayers = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxLayerSize);
+	glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+	if(!g_TextureAtlas.Build(maxLayerSize) || g_TextureAtlas.GetLayerCount() > maxLayers)
 	{
-		glVertexAttribPointer(2, 2, GL_FLOAT, false, stride, (GLvoid *) offset);
-		glEnableVertexAttribArray(2);
-		offset += 2 * sizeof(float);
+		printf("Atlas : les textures ne tiennent pas dans des couches de %d texels, textures separees\n", maxLayerSize);
+		for(int o = 0; o < objectCount; ++o)
+			objects[o]->atlasImages.clear();
+		textureAtlas = false;
+		return;
 	}
+	printf("Atlas : %d textures -> %d couches de %dx%d (%d pleines), %.1f Mo avec %d niveaux de mipmaps (%.1f Mo en textures separees sans mipmaps)\n",
+		   g_TextureAtlas.GetImageCount(), g_TextureAtlas.GetLayerCount(), g_TextureAtlas.GetLayerSize(), g_TextureAtlas.GetLayerSize(),
+		   g_TextureAtlas.GetFullLayerCount(), g_TextureAtlas.GetMemoryBytes() / (1024.0 * 1024.0), TextureAtlas::MipLevels,
+		   g_TextureAtlas.GetSeparateMemoryBytes() / (1024.0 * 1024.0));
+	g_TextureAtlas.CreateTexture();
+}
 
-	glBindVertexArray(0);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-	LoadAndCreateTextureRGBA(materials[0].diffuse_texname.c_str(), object.textureObj);
+// Equivalent pour le rasteriseur logiciel : un draw par plage, avec la texture de son materiau
+void AddSoftwareDraws(SoftwareRasterizer& rasterizer, const Object& object, int lod, const glm::mat4& worldMatrix)
+{
+	const std::vector<Submesh>& submeshes = object.lods[lod].submeshes;
+	for(size_t s = 0; s < submeshes.size(); ++s)
+	{
+		rasterizer.AddDraw(object.model->mesh, submeshes[s].firstIndex, submeshes[s].indexCount, worldMatrix,
+						   *object.softwareTextures[submeshes[s].material]);
+	}
 }
 
 void CleanObjet(Object& objet)
 {
 	if(objet.textureObj)
 		glDeleteTextures(1, &objet.textureObj);
+	for(size_t material = 0; material < objet.materialTextures.size(); ++material)
+		g_Assets.Release(objet.materialTextures[material]);
+	objet.materialTextures.clear();
+	objet.softwareTextures.clear();
 	if(objet.VAO)
 		glDeleteVertexArrays(1, &objet.VAO);
 	if(objet.VBO)
 		glDeleteBuffers(1, &objet.VBO);
 	if(objet.IBO)
 		glDeleteBuffers(1, &objet.IBO);
+	// la geometrie appartient au modele de g_Assets, partage avec les autres objets du meme fichier
+	if(objet.arena)
+		g_Assets.Release(objet.meshAsset);
+	objet.arena = nullptr;
+	objet.model = nullptr;
 }
 
 // Initialisation et terminaison ---
@@ -296,6 +559,117 @@ static  void __stdcall ExitCallbackTw(void* clientData)
 	glutLeaveMainLoop();
 }
 
+static void __stdcall DefragmentArenasCallbackTw(void* clientData)
+{
+	g_MeshArenas[VERTEX_FORMAT_FLOAT].Defragment();
+	g_MeshArenas[VERTEX_FORMAT_FLOAT].PrintStats("float");
+	g_MeshArenas[VERTEX_FORMAT_COMPACT].Defragment();
+	g_MeshArenas[VERTEX_FORMAT_COMPACT].PrintStats("compact");
+}
+
+// Trace la vue courante (tous les rochers, la fleche et la skybox) sur le CPU et l'ecrit dans reference.png
+static void __stdcall TraceReferenceImageCallbackTw(void* clientData)
+{
+	if(g_SoftwareSkybox.faces[0].texels.empty() && !g_SoftwareSkybox.Load(g_SkyboxFiles))
+		printf("Skybox introuvable pour le lanceur de rayons\n");
+
+	// rochers de la frame affichee
+	const std::vector<glm::mat4>& rockInstances = g_RenderSnapshot->rockInstances;
+	g_RayTracer.Begin();
+	for(size_t i = 0; i < rockInstances.size(); ++i)
+		g_RayTracer.AddInstance(g_Rock.triangleBvh, g_Rock.model->mesh, rockInstances[i], g_Rock.lods[0].submeshes, g_Rock.softwareTextures);
+	if(showCar)
+		g_RayTracer.AddInstance(g_Car.triangleBvh, g_Car.model->mesh, g_Car.worldMatrix, g_Car.lods[0].submeshes, g_Car.softwareTextures);
+	g_RayTracer.AddFlatInstance(g_Arrow.triangleBvh, g_Arrow.model->mesh, g_Arrow.worldMatrix, glm::vec4(0.941f, 0.952f, 0.384f, 1.0f));
+	g_RayTracer.Build();
+	g_RayTracer.SetSkybox(g_SoftwareSkybox.faces[0].texels.empty() ? NULL : &g_SoftwareSkybox);
+	g_RayTracer.SetLightDirection(lightDirection);
+	g_RayTracer.SetShadows(traceShadows);
+
+	const int width = glutGet(GLUT_WINDOW_WIDTH);
+	const int height = glutGet(GLUT_WINDOW_HEIGHT);
+	std::vector<uint32_t> pixels;
+	const std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	g_RayTracer.Render(g_Camera.viewMatrix, g_Camera.projectionMatrix, width, height, pixels);
+	const float milliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	printf("Image de reference %dx%d : %.1f ms, %.2f Mrayons/s\n", width, height, milliseconds, g_RayTracer.GetRayCount() / (milliseconds * 1000.0f));
+	if(WriteImagePng("reference.png", width, height, pixels))
+		printf("    ecrite dans reference.png\n");
+}
+
+#if GL_TRACE
+// Demarre ou arrete l'enregistrement des appels GL dans gltrace.bin
+static void __stdcall ToggleGlTraceCallbackTw(void* clientData)
+{
+	if(GlTraceIsCapturing())
+	{
+		GlTraceStopCapture();
+		GlTraceDump("gltrace.bin");
+	}
+	else
+	{
+		GlTraceStartCapture("gltrace.bin");
+	}
+}
+
+static void __stdcall PrintGlCallsCallbackTw(void* clientData)
+{
+	GlTracePrintLastFrame();
+}
+#endif
+
+// Demarre ou arrete la capture des frames de la fenetre
+static void __stdcall ToggleCaptureCallbackTw(void* clientData)
+{
+	if(g_FrameCapture.IsCapturing())
+	{
+		g_FrameCapture.Stop();
+		return;
+	}
+	const int width = glutGet(GLUT_WINDOW_WIDTH);
+	const int height = glutGet(GLUT_WINDOW_HEIGHT);
+	if(captureRaw)
+		g_FrameCapture.Start("capture.raw", FrameCapture::OUTPUT_RAW, width, height, RawCaptureFrames);
+	else
+		g_FrameCapture.Start("frame_", FrameCapture::OUTPUT_PNG, width, height);
+}
+
+// Variables modifiables depuis la TweakBar, suivies par InputLog et FrameScheduler
+template<typename Watcher>
+void WatchTweakVariables(Watcher& watcher)
+{
+	watcher.Watch("rotationQuaternion", &g_Rock.rotationQuaternion);
+	watcher.Watch("lightDirection", &lightDirection);
+	watcher.Watch("numCubes", &numCubes);
+	watcher.Watch("speed", &speed);
+	watcher.Watch("ka", &ka);
+	watcher.Watch("kb", &kb);
+	watcher.Watch("kc", &kc);
+	watcher.Watch("sizeX", &sizeX);
+	watcher.Watch("sizeY", &sizeY);
+	watcher.Watch("sizeZ", &sizeZ);
+	watcher.Watch("lodPixelError", &lodPixelError);
+	watcher.Watch("multiDraw", &multiDraw);
+	watcher.Watch("textureAtlas", &textureAtlas);
+	watcher.Watch("frustumCulling", &frustumCulling);
+	watcher.Watch("sceneTreeCulling", &sceneTreeCulling);
+	watcher.Watch("occlusionCulling", &occlusionCulling);
+	watcher.Watch("maxOccluders", &maxOccluders);
+	watcher.Watch("softwareRendering", &softwareRendering);
+	watcher.Watch("traceShadows", &traceShadows);
+	watcher.Watch("wireframe", &wireframe);
+	watcher.Watch("transparent", &transparent);
+	watcher.Watch("showCar", &showCar);
+	watcher.Watch("dynamicResolution", &dynamicResolution);
+	watcher.Watch("resolutionBudget", &resolutionBudget);
+	watcher.Watch("minResolutionScale", &minResolutionScale);
+	watcher.Watch("simulationRate", &simulationRate);
+	watcher.Watch("swapInterval", &swapInterval);
+	watcher.Watch("threadedSimulation", &threadedSimulation);
+	watcher.Watch("assetCpuBudgetMB", &assetCpuBudgetMB);
+	watcher.Watch("assetGpuBudgetMB", &assetGpuBudgetMB);
+}
+
 void Initialize()
 {
 	printf("Version Pilote OpenGL : %s\n", glGetString(GL_VERSION));
@@ -311,9 +685,14 @@ void Initialize()
 		exit(-1);
 	}
 
-#ifdef _WIN32
-	// on coupe la synchro vertical pour voir l'effet du delta time
-	wglSwapIntervalEXT(0);
+	// synchro adaptative : le pas fixe rend le mouvement independant de la cadence, la synchro
+	// regularise la presentation sans bloquer une frame en retard
+	appliedSwapInterval = SetSwapInterval(swapInterval);
+	printf("Synchro verticale : intervalle %d (%s)\n", appliedSwapInterval, GetSwapControlName());
+
+#if GL_TRACE
+	// avant tout appel GL du projet, pour que les compteurs soient complets
+	GlTraceInstall();
 #endif
 
 	// render states par defaut
@@ -342,10 +721,104 @@ void Initialize()
 			   " group='Spirale' min=0");
 	TwAddVarRW(objTweakBar, "sizeZ", TW_TYPE_INT32, &sizeZ,
 			   " group='Spirale' min=0");
+	TwAddVarRW(objTweakBar, "LOD pixel error", TW_TYPE_FLOAT, &lodPixelError,
+			   " group='LOD' min=0 max=50 step=0.1 help='Erreur maximale tolere a l ecran (en pixels) pour choisir le niveau de detail.' ");
+	TwAddVarRW(objTweakBar, "Multi-draw indirect", TW_TYPE_BOOLCPP, &multiDraw,
+			   " group='Draws' help='Un seul glMultiDrawElementsIndirect par programme au lieu d un appel par objet.' ");
+	TwAddVarRO(objTweakBar, "Draw calls", TW_TYPE_INT32, &drawCallCount, " group='Draws' ");
+	TwAddVarRW(objTweakBar, "Texture atlas", TW_TYPE_BOOLCPP, &textureAtlas,
+			   " group='Draws' help='Rochers et voiture lisent leurs materiaux dans un seul tableau de textures : une liaison et un appel.' ");
+	TwAddVarRO(objTweakBar, "Texture binds", TW_TYPE_INT32, &textureBindCount, " group='Draws' ");
+	TwAddVarRW(objTweakBar, "Frustum culling", TW_TYPE_BOOLCPP, &frustumCulling, " group='Culling' ");
+	TwAddVarRW(objTweakBar, "Scene BVH", TW_TYPE_BOOLCPP, &sceneTreeCulling,
+			   " group='Culling' help='Frustum culling par requete dans l arbre d AABB dynamique plutot que par test de toutes les spheres.' ");
+	TwAddVarRO(objTweakBar, "Visible rocks", TW_TYPE_INT32, &visibleRockCount, " group='Culling' ");
+	TwAddVarRO(objTweakBar, "Culled rocks", TW_TYPE_INT32, &culledRockCount, " group='Culling' ");
+	TwAddVarRW(objTweakBar, "Occlusion culling", TW_TYPE_BOOLCPP, &occlusionCulling, " group='Culling' ");
+	TwAddVarRW(objTweakBar, "Max occluders", TW_TYPE_INT32, &maxOccluders, " group='Culling' min=0 max=256 ");
+	TwAddVarRO(objTweakBar, "Occluded rocks", TW_TYPE_INT32, &occludedRockCount, " group='Culling' ");
+	TwAddVarRO(objTweakBar, "Occlusion ms", TW_TYPE_FLOAT, &occlusionTime, " group='Culling' precision=3 ");
+	TwAddVarRO(objTweakBar, "Picked rock", TW_TYPE_INT32, &g_PickedRock,
+			   " group='Picking' help='Rocher sous le curseur au dernier clic gauche (-1 : aucun).' ");
+	TwAddVarRO(objTweakBar, "Picking us", TW_TYPE_FLOAT, &pickingTime, " group='Picking' precision=2 ");
+	TwAddVarRW(objTweakBar, "Software rasterizer", TW_TYPE_BOOLCPP, &softwareRendering,
+			   " group='Software' help='Rochers et fleche rasterises sur le CPU puis copies dans la fenetre (sans skybox, wireframe ni transparence).' ");
+	TwAddVarRO(objTweakBar, "Software ms", TW_TYPE_FLOAT, &softwareRenderTime, " group='Software' precision=3 ");
+	TwAddVarRW(objTweakBar, "Trace shadows", TW_TYPE_BOOLCPP, &traceShadows, " group='Software' ");
+	TwAddButton(objTweakBar, "Reference image", TraceReferenceImageCallbackTw, NULL,
+				" group='Software' help='Lance des rayons depuis la camera sur le CPU et ecrit reference.png.' ");
+	TwAddButton(objTweakBar, "Start/stop capture", ToggleCaptureCallbackTw, NULL,
+				" group='Capture' help='Enregistre les frames (sans la TweakBar) en frame_00000.png... ou dans capture.raw.' ");
+	TwAddVarRW(objTweakBar, "Raw sequence", TW_TYPE_BOOLCPP, &captureRaw,
+			   " group='Capture' help='Copie les frames dans un fichier brut mappe en memoire au lieu de les encoder en PNG.' ");
+	TwAddVarRO(objTweakBar, "Captured frames", TW_TYPE_INT32, &capturedFrames, " group='Capture' ");
+	TwAddVarRO(objTweakBar, "Dropped frames", TW_TYPE_INT32, &droppedCaptureFrames, " group='Capture' ");
+	TwAddVarRO(objTweakBar, "Capture ms", TW_TYPE_FLOAT, &captureTime, " group='Capture' precision=3 ");
+#if GL_TRACE
+	TwAddVarRO(objTweakBar, "GL calls", TW_TYPE_INT32, &glCallCount, " group='GL trace' ");
+	TwAddVarRO(objTweakBar, "GL binds", TW_TYPE_INT32, &glBindCount, " group='GL trace' ");
+	TwAddVarRO(objTweakBar, "GL upload KB", TW_TYPE_FLOAT, &glUploadKB, " group='GL trace' precision=1 ");
+	TwAddVarRO(objTweakBar, "Trace overhead ms", TW_TYPE_FLOAT, &glTraceOverhead, " group='GL trace' precision=3 ");
+	TwAddButton(objTweakBar, "Print GL calls", PrintGlCallsCallbackTw, NULL,
+				" group='GL trace' help='Affiche dans la console les appels GL de la derniere frame par point d entree.' ");
+	TwAddButton(objTweakBar, "Start/stop GL trace", ToggleGlTraceCallbackTw, NULL,
+				" group='GL trace' help='Enregistre le flux d appels GL dans gltrace.bin (relu avec --gl-trace-dump).' ");
+#endif
+	TwAddButton(objTweakBar, "Defragment arenas", DefragmentArenasCallbackTw, NULL,
+				" group='Memory' help='Compacte les arenas de geometrie et affiche leurs statistiques dans la console.' ");
+	TwAddVarRW(objTweakBar, "Dynamic resolution", TW_TYPE_BOOLCPP, &dynamicResolution,
+			   " group='Resolution' help='Rend la scene hors ecran a une resolution reduite pour tenir le budget GPU, la TweakBar et le HUD restent en natif.' ");
+	TwAddVarRW(objTweakBar, "GPU budget ms", TW_TYPE_FLOAT, &resolutionBudget, " group='Resolution' min=1 max=100 step=0.5 ");
+	TwAddVarRW(objTweakBar, "Min scale", TW_TYPE_FLOAT, &minResolutionScale, " group='Resolution' min=0.25 max=1 step=0.05 ");
+	TwAddVarRO(objTweakBar, "Render scale", TW_TYPE_FLOAT, &resolutionScale, " group='Resolution' precision=2 ");
+	TwAddVarRO(objTweakBar, "Scene GPU ms", TW_TYPE_FLOAT, &sceneGpuTime, " group='Resolution' precision=3 ");
+	TwAddVarRW(objTweakBar, "On-demand rendering", TW_TYPE_BOOLCPP, &onDemandRendering,
+			   " group='Scheduler' help='Ne rend une frame que si la camera, la TweakBar ou le temps d animation (speed) changent.' ");
+	TwAddVarRW(objTweakBar, "Max FPS", TW_TYPE_INT32, &maxFps, " group='Scheduler' min=0 max=1000 help='0 : pas de plafond.' ");
+	TwAddVarRO(objTweakBar, "Rendered frames", TW_TYPE_INT32, &renderedFrames, " group='Scheduler' ");
+	TwAddVarRO(objTweakBar, "CPU % active", TW_TYPE_FLOAT, &activeCpuUsage, " group='Scheduler' precision=1 ");
+	TwAddVarRO(objTweakBar, "CPU % idle", TW_TYPE_FLOAT, &idleCpuUsage, " group='Scheduler' precision=1 ");
+	TwAddVarRW(objTweakBar, "Simulation Hz", TW_TYPE_INT32, &simulationRate, " group='Pacing' min=10 max=1000 ");
+	TwAddVarRW(objTweakBar, "Swap interval", TW_TYPE_INT32, &swapInterval,
+			   " group='Pacing' min=-1 max=1 help='-1 : synchro adaptative, 0 : sans synchro, 1 : synchro verticale.' ");
+	TwAddVarRO(objTweakBar, "Applied swap", TW_TYPE_INT32, &appliedSwapInterval, " group='Pacing' ");
+	TwAddVarRO(objTweakBar, "Frame ms", TW_TYPE_FLOAT, &frameTimeMean, " group='Pacing' precision=3 ");
+	TwAddVarRO(objTweakBar, "Frame std dev ms", TW_TYPE_FLOAT, &frameTimeDeviation, " group='Pacing' precision=3 ");
+	TwAddVarRW(objTweakBar, "Simulation thread", TW_TYPE_BOOLCPP, &threadedSimulation,
+			   " group='Pipeline' help='Spirale, culling, LODs et picking prepares sur un second thread pendant la soumission GL de la frame precedente.' ");
+	TwAddVarRO(objTweakBar, "Prepare ms", TW_TYPE_FLOAT, &prepareTime, " group='Pipeline' precision=3 ");
+	TwAddVarRO(objTweakBar, "Snapshot lag", TW_TYPE_INT32, &snapshotLag, " group='Pipeline' ");
+	TwAddVarRO(objTweakBar, "Merged inputs", TW_TYPE_INT32, &mergedInputs, " group='Pipeline' ");
+#if ALLOCATOR_STATS
+	TwAddVarRO(objTweakBar, "Heap allocs/frame", TW_TYPE_INT32, &frameHeapAllocations,
+			   " group='Memory' help='Appels a operator new par frame (AntTweakBar et le pilote ont leur propre tas).' ");
+#endif
+	TwAddVarRO(objTweakBar, "Scene arena KB", TW_TYPE_FLOAT, &sceneArenaKB, " group='Memory' precision=1 ");
+	TwAddVarRW(objTweakBar, "CPU budget MB", TW_TYPE_INT32, &assetCpuBudgetMB,
+			   " group='Assets' min=0 max=4096 help='Pixels decodes et meshs en memoire. 0 : sans limite. Au-dela, les assets inutilises le plus longtemps sont evinces.' ");
+	TwAddVarRW(objTweakBar, "GPU budget MB", TW_TYPE_INT32, &assetGpuBudgetMB,
+			   " group='Assets' min=0 max=4096 help='Textures et geometrie. 0 : sans limite. La geometrie d un modele reference n est jamais evincee.' ");
+	TwAddVarRO(objTweakBar, "Texture CPU MB", TW_TYPE_FLOAT, &textureCpuMB, " group='Assets' precision=2 ");
+	TwAddVarRO(objTweakBar, "Texture GPU MB", TW_TYPE_FLOAT, &textureGpuMB, " group='Assets' precision=2 ");
+	TwAddVarRO(objTweakBar, "Model CPU MB", TW_TYPE_FLOAT, &modelCpuMB, " group='Assets' precision=2 ");
+	TwAddVarRO(objTweakBar, "Model GPU MB", TW_TYPE_FLOAT, &modelGpuMB, " group='Assets' precision=2 ");
+	TwAddVarRO(objTweakBar, "Evictions", TW_TYPE_INT32, &assetEvictions, " group='Assets' ");
+	TwAddVarRO(objTweakBar, "Shared assets", TW_TYPE_INT32, &sharedAssets,
+			   " group='Assets' help='Demandes d un fichier deja connu et fichiers au contenu identique a un asset deja charge.' ");
 	TwAddVarRW(objTweakBar, "Wireframe", TW_TYPE_BOOLCPP, &wireframe,
 			   " group='Display' key=w help='Toggle wireframe display mode.' ");
 	TwAddVarRW(objTweakBar, "Transparence", TW_TYPE_BOOLCPP, &transparent,
 			   " group='Display'  help='Toggle transparence display mode.' ");
+	TwAddVarRW(objTweakBar, "Car", TW_TYPE_BOOLCPP, &showCar,
+			   " group='Display' help='Voiture multi-materiaux (Smallcar.obj) : un appel de dessin par materiau.' ");
+
+	// comparees a chaque frame par l'enregistrement des entrees et par le rendu a la demande
+	WatchTweakVariables(g_InputLog);
+	WatchTweakVariables(g_FrameScheduler);
+	g_FrameScheduler.Watch("cameraPosition", &g_Camera.position);
+	g_FrameScheduler.Watch("cameraForward", &g_Camera.forward);
+	g_FrameScheduler.Watch("cameraRotation", &g_Camera.rotationMatrix);
+	g_FrameScheduler.Watch("rockRotation", &g_Rock.rotation);
 
 	// Objets OpenGL
 	g_BasicShader.LoadVertexShader("basic.vs");
@@ -372,19 +845,52 @@ void Initialize()
 	auto blockIndex2 = glGetUniformBlockIndex(program, "ViewProj");
 	glUniformBlockBinding(program, blockIndex2, 0);
 
-	// Setup
-	previousTime = glutGet(GLUT_ELAPSED_TIME);
+	// les donnees par draw sont lues dans le texture buffer du DrawBatch
+	glUseProgram(g_BasicShader.GetProgram());
+	glUniform1i(glGetUniformLocation(g_BasicShader.GetProgram(), "u_drawData"), DrawDataTextureUnit);
+	glUniform1i(glGetUniformLocation(g_BasicShader.GetProgram(), "u_atlas"), AtlasTextureUnit);
+	glUseProgram(g_ArrowShader.GetProgram());
+	glUniform1i(glGetUniformLocation(g_ArrowShader.GetProgram(), "u_drawData"), DrawDataTextureUnit);
+	glUseProgram(0);
+
+	// les arenas grossissent au besoin, la taille initiale suffit pour les meshs de la scene
+	g_MeshArenas[VERTEX_FORMAT_FLOAT].Create(VERTEX_FORMAT_FLOAT, 64 * 1024, 256 * 1024);
+	g_MeshArenas[VERTEX_FORMAT_COMPACT].Create(VERTEX_FORMAT_COMPACT, 64 * 1024, 256 * 1024);
+	g_Assets.Create(g_MeshArenas, assetCpuBudgetMB * 1024 * 1024, assetGpuBudgetMB * 1024 * 1024);
+	g_DrawBatch.Create(1024);
+	g_OcclusionCuller.Create(320, 180);
+	g_MeshArenas[VERTEX_FORMAT_FLOAT].SetDrawIndexBuffer(g_DrawBatch.GetDrawIndexBuffer());
+	g_MeshArenas[VERTEX_FORMAT_COMPACT].SetDrawIndexBuffer(g_DrawBatch.GetDrawIndexBuffer());
 
 	const std::string inputFile = "rock.obj";
-	LoadOBJ(inputFile, g_Rock);
+	LoadOBJ(inputFile, g_Rock, rockLodLevels);
 
 	const std::string inputFile2 = "arrow.obj";
 	LoadOBJ(inputFile2, g_Arrow);
 
+	// la voiture est ramenee a 8 unites de long et posee a cote de la spirale
+	LoadOBJ("Smallcar.obj", g_Car);
+	g_Car.position = glm::vec3(14.0f, 0.0f, -6.0f);
+	g_Car.worldMatrix = glm::translate(glm::mat4(1.0f), g_Car.position) * glm::scale(glm::mat4(1.0f), glm::vec3(4.0f / std::max(g_Car.sphereRadius, 0.001f)))
+					  * glm::translate(glm::mat4(1.0f), -g_Car.sphereCenter);
+
+	g_MeshArenas[VERTEX_FORMAT_FLOAT].PrintStats("float");
+	g_MeshArenas[VERTEX_FORMAT_COMPACT].PrintStats("compact");
+
+	// materiaux des rochers et de la voiture dans un seul tableau de textures
+	Object* atlasObjects[] = { &g_Rock, &g_Car };
+	BuildTextureAtlas(atlasObjects, 2);
+	printf("Liaisons de textures par frame : %d en textures separees, 1 avec l'atlas\n",
+		   (int) (g_Rock.materialTextures.size() + g_Car.materialTextures.size()));
+
 	InitCubemap();
 
+	g_PerfHud.Create();
+	g_DynamicResolution.Create();
+
 	// Init de la camra
 	g_Camera.position = glm::vec3(0.0f, 5.0f, 15.0f);
+	g_PreviousCameraPosition = g_Camera.position;
 	g_Camera.forward = glm::vec3(0.0f, 0.0f, -1.0f);
 	g_Camera.right = glm::vec3(1.0f, 0.0f, 0.0f);
 
@@ -403,11 +909,32 @@ void Initialize()
 
 void Terminate()
 {
+	g_FrameScheduler.PrintStats();
+	g_FixedTimestep.PrintStats();
+	g_SceneSimulation.Stop();
+	g_InputLog.Stop();
+	g_FrameCapture.Stop();
+#if GL_TRACE
+	GlTraceStopCapture();
+#endif
 	glDeleteBuffers(1, &g_Camera.UBO);
 
 	CleanObjet(g_Rock);
 	CleanObjet(g_Arrow);
+	CleanObjet(g_Car);
 	CleanObjet(g_CubeMap);
+	g_Assets.PrintStats();
+	g_Assets.Destroy();
+	g_TextureAtlas.Destroy();
+	g_PerfHud.Destroy();
+	g_DynamicResolution.Destroy();
+	g_MeshArenas[VERTEX_FORMAT_FLOAT].Destroy();
+	g_MeshArenas[VERTEX_FORMAT_COMPACT].Destroy();
+	g_DrawBatch.Destroy();
+	if(g_SoftwareFramebuffer)
+		glDeleteFramebuffers(1, &g_SoftwareFramebuffer);
+	if(g_SoftwareColorTexture)
+		glDeleteTextures(1, &g_SoftwareColorTexture);
 
 	g_BasicShader.Destroy();
 	g_ArrowShader.Destroy();
@@ -417,52 +944,119 @@ void Terminate()
 }
 
 // Boucle principale
+void Update();
+
+// Une entree demande une frame : reveille la boucle si elle attendait les evenements
+void RequestFrame()
+{
+	g_FrameScheduler.Invalidate();
+	glutIdleFunc(Update);
+}
+
 void Resize(GLint width, GLint height)
 {
 	glViewport(0, 0, width, height);
+	// les PBO de capture ont la taille de la fenetre au demarrage
+	if(g_FrameCapture.IsCapturing() && (width != g_FrameCapture.GetWidth() || height != g_FrameCapture.GetHeight()))
+		g_FrameCapture.Stop();
 	g_Camera.projectionMatrix = glm::perspectiveFov(45.f, (float) width, (float) height, 0.1f, 1000.f);
 	TwWindowSize(width, height);
+	RequestFrame();
 }
 
-void Update()
+// Un pas de simulation fixe : deplacement de la camera au clavier
+void SimulateStep(float step)
 {
-	///////////////////////////////////////////////////////////////////////////////////// Calcul du temps coul (pour que la puissance du PC influe pas)
-	auto currentTime = glutGet(GLUT_ELAPSED_TIME);
-	auto delta = currentTime - previousTime;
-	previousTime = currentTime;
-	auto elapsedTime = delta / 1000.0f;
+	g_PreviousCameraPosition = g_Camera.position;
 
 	///////////////////////////////////////////////////////////////////////////////////// Gestion du clavier (principalement dplacement)
 	if(keyState['z'] == GLUT_DOWN)
 	{
-		g_Camera.position += elapsedTime* g_Camera.forward * movementSpeed;
+		g_Camera.position += step * g_Camera.forward * movementSpeed;
 	}
 	else if(keyState['s'] == GLUT_DOWN)
 	{
-		g_Camera.position -= elapsedTime* g_Camera.forward * movementSpeed;
+		g_Camera.position -= step * g_Camera.forward * movementSpeed;
 	}
 	
 	if(keyState['q'] == GLUT_DOWN)
 	{
-		g_Camera.position -= elapsedTime* g_Camera.right * movementSpeed;
+		g_Camera.position -= step * g_Camera.right * movementSpeed;
 	}
 	else if(keyState['d'] == GLUT_DOWN)
 	{
-		g_Camera.position += elapsedTime* g_Camera.right * movementSpeed;
+		g_Camera.position += step * g_Camera.right * movementSpeed;
 	}
 
 	if(keyState['e'] == GLUT_DOWN || keyState[' '] == GLUT_DOWN)
 	{
-		g_Camera.position.y += elapsedTime * movementSpeed;
+		g_Camera.position.y += step * movementSpeed;
 	}
 	else if(keyState['a'] == GLUT_DOWN)
 	{
-		g_Camera.position.y -= elapsedTime * movementSpeed;
+		g_Camera.position.y -= step * movementSpeed;
+	}
+}
+
+// entrees de la scene (definies avec les callbacks GLUT), appliquees aussi par le rejeu
+void HandleKey(unsigned char key, bool down);
+void SceneMouseButton(int button, int state, int x, int y, bool handled);
+void SceneMotion(int x, int y);
+void ApplySimulationThreading();
+
+void Update()
+{
+	///////////////////////////////////////////////////////////////////////////////////// Calcul du temps coul (pour que la puissance du PC influe pas)
+	// en rejeu, le temps et les entrees de la frame viennent du log
+	if(!g_InputLog.BeginFrame(FixedTimestep::Now()))
+	{
+		glutLeaveMainLoop();
+		return;
+	}
+	// travail epingle au thread GL par les jobs (uploads...)
+	RunMainThreadJobs();
+
+	const std::vector<InputEvent>& events = g_InputLog.GetFrameEvents();
+	for(size_t i = 0; i < events.size(); ++i)
+	{
+		switch(events[i].type)
+		{
+		case InputEvent::KEY:
+			HandleKey(events[i].key, events[i].down);
+			break;
+		case InputEvent::MOUSE_BUTTON:
+			SceneMouseButton(events[i].button, events[i].state, events[i].x, events[i].y, events[i].handled);
+			break;
+		case InputEvent::MOTION:
+			SceneMotion(events[i].x, events[i].y);
+			break;
+		}
 	}
 
+	// temps de la frame (horloge monotone, ou temps enregistre en rejeu) : simule par pas fixes.
+	// Sortie d'une attente, premiere frame enregistree ou rejouee : pas de rattrapage du temps ecoule
+	const int64_t frameTime = g_InputLog.GetTime();
+	if(g_FrameScheduler.Resume() || (g_InputLog.GetMode() != InputLog::MODE_OFF && g_InputLog.GetFrame() == 0))
+		g_FixedTimestep.Reset(frameTime);
+	g_FixedTimestep.SetStep(1.0 / std::max(simulationRate, 1));
+	const int steps = g_FixedTimestep.Advance(frameTime);
+	for(int i = 0; i < steps; ++i)
+		SimulateStep((float) g_FixedTimestep.GetStep());
+
+	if(requestedSwapInterval != swapInterval)
+	{
+		requestedSwapInterval = swapInterval;
+		appliedSwapInterval = SetSwapInterval(swapInterval);
+	}
+
+	// Echap : le thread de simulation est arrete (et n'est plus relance par un dernier Render) avant la sortie
+	// de la boucle, puis Terminate libere la scene et affiche les bilans, comme a la fin d'un rejeu
 	if(keyState[27] == GLUT_DOWN)
 	{
-		exit(0);
+		threadedSimulation = false;
+		ApplySimulationThreading();
+		glutLeaveMainLoop();
+		return;
 	}
 
 	///////////////////////////////////////////////////////////////////////////////////// Gestion de la souris (drag)
@@ -479,7 +1073,322 @@ void Update()
 		}
 	}
 
-	glutPostRedisplay();
+	// rendu continu tant que quelque chose bouge sans entree : animation de la spirale, deplacement
+	// clavier (jusqu'a la fin de l'interpolation), capture, enregistrement ou rejeu des entrees
+	const bool moving = keyState['z'] == GLUT_DOWN || keyState['s'] == GLUT_DOWN || keyState['q'] == GLUT_DOWN || keyState['d'] == GLUT_DOWN
+					 || keyState['e'] == GLUT_DOWN || keyState[' '] == GLUT_DOWN || keyState['a'] == GLUT_DOWN;
+	const bool continuous = !onDemandRendering || speed != 0.0 || moving || g_PreviousCameraPosition != g_Camera.position
+						 || g_FrameCapture.IsCapturing() || g_InputLog.GetMode() != InputLog::MODE_OFF;
+	if(g_FrameScheduler.Schedule(continuous, maxFps))
+	{
+		glutPostRedisplay();
+	}
+	else if(g_RenderSnapshot->frame != g_SceneFrame)
+	{
+		// avec le thread de simulation, la frame affichee a un retard sur ses entrees :
+		// une derniere frame sans nouvelles entrees soumet la snapshot a jour avant l'attente
+		g_FlushPipeline = true;
+		glutPostRedisplay();
+	}
+	else
+	{
+		// rien n'a change : GLUT attend le prochain evenement sans appeler Update
+		g_FrameScheduler.EnterIdle();
+		glutIdleFunc(NULL);
+	}
+}
+
+// Parametres courants de la spirale (TweakBar)
+SpiralParameters GetSpiralParameters()
+{
+	SpiralParameters spiral;
+	spiral.count = numCubes;
+	spiral.speed = speed;
+	spiral.ka = ka;
+	spiral.kb = kb;
+	spiral.kc = kc;
+	spiral.sizeX = sizeX;
+	spiral.sizeY = sizeY;
+	spiral.sizeZ = sizeZ;
+	return spiral;
+}
+
+// Matrices monde des rochers de la spirale a l'instant currentTime (en millisecondes)
+void GatherSpiralInstances(const SpiralParameters& spiral, double currentTime, std::vector<glm::mat4>& instances)
+{
+	const double ka = spiral.ka, kb = spiral.kb, kc = spiral.kc;
+	const int sizeX = spiral.sizeX, sizeY = spiral.sizeY, sizeZ = spiral.sizeZ;
+	for(auto n = 0; n < spiral.count; ++n) {
+		double t = 0.05*n - (double) (currentTime*spiral.speed) / 2000.0;
+
+		// Set cube position
+		//glMatrixMode(GL_MODELVIEW);
+
+		//glLoadIdentity();
+		//glTranslated(0.6*cos(ka*t), 0.6*cos(kb*t), 0.6*sin(kc*t));
+		glm::mat4 tempWorldMatrix = glm::translate(glm::mat4(1), glm::vec3(sizeX*cos(ka*t), sizeY*cos(kb*t), sizeZ*sin(kc*t)));
+
+		//glRotated(r, 0.2, 0.7, 0.2);
+		tempWorldMatrix = tempWorldMatrix * glm::eulerAngleYXZ(0.2f*(float)cos(ka*t), 0.7f*(float) cos(kb*t), 0.2f*(float) sin(kc*t));
+		//tempWorldMatrix = glm::rotate(tempWorldMatrix, (float)r, glm::vec3(0.2, 0.7, 0.2));
+
+		//glScaled(0.1, 0.1, 0.1);
+		tempWorldMatrix = glm::scale(tempWorldMatrix, glm::vec3(0.3, 0.3, 0.3));
+
+		//glTranslated(-0.5, -0.5, -0.5);
+		tempWorldMatrix = glm::translate(tempWorldMatrix, glm::vec3(0, 0, -50));
+
+		instances.push_back(tempWorldMatrix);
+	}
+}
+
+// Rayon monde contre la scene preparee : arbre de la scene puis BVH de triangles du rocher touche
+void PickRock(const Ray& ray, const std::vector<glm::mat4>& instances, ScenePick& pick)
+{
+	const std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	// le rayon passe dans le repere local sans renormaliser la direction : t reste la distance monde
+	float maxDistance = ray.maxDistance;
+	TriangleHit bestHit;
+	pick.rock = -1;
+	g_SceneTree.RayCast(ray, maxDistance, [&](int rock, float& distance) {
+		const glm::mat4 inverseWorld = glm::inverse(instances[rock]);
+		const glm::vec3 localOrigin = glm::vec3(inverseWorld * glm::vec4(ray.origin, 1.0f));
+		const glm::vec3 localDirection = glm::vec3(inverseWorld * glm::vec4(ray.direction, 0.0f));
+		TriangleHit hit;
+		if(g_Rock.triangleBvh.Intersect(localOrigin, localDirection, distance, hit))
+		{
+			distance = hit.distance;
+			bestHit = hit;
+			pick.rock = rock;
+		}
+	});
+
+	pick.time = std::chrono::duration<float, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+	if(pick.rock >= 0)
+	{
+		pick.point = ray.origin + ray.direction * bestHit.distance;
+		printf("Picking : rocher %d, triangle %u, barycentriques (%.3f, %.3f, %.3f), point (%.3f, %.3f, %.3f), %.2f us\n",
+			   pick.rock, bestHit.triangle, 1.0f - bestHit.u - bestHit.v, bestHit.u, bestHit.v,
+			   pick.point.x, pick.point.y, pick.point.z, pick.time);
+	}
+	else
+	{
+		printf("Picking : aucun objet, %.2f us\n", pick.time);
+	}
+}
+
+// Prepare une frame a partir de ses seules entrees : spirale, reperes fixes, arbre de la scene, culling,
+// LODs puis picking du clic en attente. Appelee par Render ou par le thread de simulation.
+void PrepareScene(const SceneFrameInput& input, SceneSnapshot& snapshot)
+{
+	const auto prepareStart = std::chrono::high_resolution_clock::now();
+	g_SceneArena.Reset();
+	snapshot.frame = input.frame;
+	snapshot.viewMatrix = input.viewMatrix;
+	snapshot.projectionMatrix = input.projectionMatrix;
+
+	// les matrices de tous les rochers sont calculees d'abord, puis cullees en bloc avant d'aller dans le batch
+	std::vector<glm::mat4>& instances = snapshot.rockInstances;
+	instances.clear();
+	GatherSpiralInstances(input.spiral, input.time, instances);
+	/////////////////////////////////////////////////////////////////////////////////////// Rendu d'un objet "repre" fixe (quaternions maison)
+	const glm::vec3 rockPosition(0, 10, 0);
+
+	float yaw = glm::radians(input.rockRotation.y);
+	float pitch = glm::radians(input.rockRotation.x);
+	float roll = glm::radians(input.rockRotation.z);
+
+	glm::mat4 tempWorldMatrix = glm::translate(glm::mat4(1), rockPosition);
+	tempWorldMatrix = tempWorldMatrix * glm::eulerAngleYXZ(yaw, pitch, roll);
+	tempWorldMatrix = glm::translate(tempWorldMatrix, -rockPosition);
+
+	instances.push_back(glm::translate(tempWorldMatrix, rockPosition));
+
+	/////////////////////////////////////////////////////////////////////////////////////// Rendu d'un objet "repre" fixe (quaternions tw)
+	instances.push_back(Quaternion(input.rockQuaternion.x, input.rockQuaternion.y, input.rockQuaternion.z, input.rockQuaternion.w).toRotationMatrix());
+
+	/////////////////////////////////////////////////////////////////////////////////////// Culling des rochers
+	g_RockSpheres.Clear();
+	for(size_t i = 0; i < instances.size(); ++i)
+	{
+		glm::vec3 center;
+		float radius;
+		TransformSphere(instances[i], g_Rock.sphereCenter, g_Rock.sphereRadius, center, radius);
+		g_RockSpheres.Add(center, radius);
+	}
+
+	// l'arbre suit le nombre de rochers, les feuilles sont deplacees puis l'arbre est refit (pas de reconstruction)
+	while(g_RockProxies.size() > instances.size())
+	{
+		g_SceneTree.DestroyProxy(g_RockProxies.back());
+		g_RockProxies.pop_back();
+	}
+	const Aabb rockBounds(g_Rock.boundsMin, g_Rock.boundsMax);
+	for(size_t i = 0; i < instances.size(); ++i)
+	{
+		const Aabb worldBounds = TransformAabb(rockBounds, instances[i]);
+		if(i < g_RockProxies.size())
+			g_SceneTree.SetProxyBounds(g_RockProxies[i], worldBounds);
+		else
+			g_RockProxies.push_back(g_SceneTree.CreateProxy(worldBounds, (int) i));
+	}
+	g_SceneTree.Refit();
+
+	std::vector<uint8_t>& visibility = snapshot.rockVisibility;
+	int visibleCount;
+	Frustum frustum;
+	ExtractFrustumPlanes(input.projectionMatrix * input.viewMatrix, frustum);
+	if(input.frustumCulling && input.sceneTreeCulling)
+	{
+		g_SceneQueryResults.clear();
+		g_SceneTree.QueryFrustum(frustum, g_SceneQueryResults);
+		visibility.assign(instances.size(), 0);
+		for(size_t i = 0; i < g_SceneQueryResults.size(); ++i)
+			visibility[g_SceneQueryResults[i]] = 1;
+		visibleCount = (int) g_SceneQueryResults.size();
+	}
+	else if(input.frustumCulling)
+	{
+		visibleCount = (int) CullSpheres(frustum, g_RockSpheres, visibility);
+	}
+	else
+	{
+		visibility.assign(instances.size(), 1);
+		visibleCount = (int) instances.size();
+	}
+	snapshot.culledRocks = (int) instances.size() - visibleCount;
+
+	// occlusion : les plus gros rochers visibles (rayon / distance) sont rasterises sur le CPU,
+	// puis chaque rocher visible est teste contre la hierarchie de profondeur.
+	// Un occulteur ne peut pas se cacher lui-meme : sa boite est devant son propre mesh simplifie.
+	snapshot.occludedRocks = 0;
+	snapshot.occlusionTime = 0.0f;
+	if(input.occlusionCulling)
+	{
+		const auto start = std::chrono::high_resolution_clock::now();
+
+		ArenaVector<std::pair<float, size_t> > occluders{ ArenaAllocator<std::pair<float, size_t> >(g_SceneArena) };
+		occluders.reserve(visibleCount);
+		for(size_t i = 0; i < instances.size(); ++i)
+		{
+			if(!visibility[i])
+				continue;
+			const glm::vec3 center(g_RockSpheres.centerX[i], g_RockSpheres.centerY[i], g_RockSpheres.centerZ[i]);
+			const float distance = std::max(glm::length(center - input.cameraPosition), 0.1f);
+			occluders.push_back(std::make_pair(-g_RockSpheres.radius[i] / distance, i));
+		}
+		std::sort(occluders.begin(), occluders.end());
+		occluders.resize(std::min(occluders.size(), (size_t) std::max(input.maxOccluders, 0)));
+
+		g_OcclusionCuller.Begin(input.projectionMatrix * input.viewMatrix);
+		for(size_t i = 0; i < occluders.size(); ++i)
+			g_OcclusionCuller.AddOccluder(g_Rock.occluderPositions, g_Rock.occluderIndices, instances[occluders[i].second]);
+		g_OcclusionCuller.Rasterize();
+
+		for(size_t i = 0; i < instances.size(); ++i)
+		{
+			if(visibility[i] && g_OcclusionCuller.IsOccluded(g_Rock.boundsMin, g_Rock.boundsMax, instances[i]))
+			{
+				visibility[i] = 0;
+				++snapshot.occludedRocks;
+			}
+		}
+
+		visibleCount -= snapshot.occludedRocks;
+		snapshot.occlusionTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+	snapshot.visibleRocks = visibleCount;
+
+	snapshot.rockLods.resize(instances.size());
+	for(size_t i = 0; i < instances.size(); ++i)
+		snapshot.rockLods[i] = visibility[i] ? SelectLod(g_Rock, instances[i], glm::vec3(0.0f), input) : -1;
+
+	// le clic vise la frame affichee, l'arbre est deja celui de la frame suivante : au plus un pas d'animation d'ecart
+	if(input.pick && !instances.empty())
+		PickRock(input.pickRay, instances, g_LastPick);
+	snapshot.pick = g_LastPick;
+
+	snapshot.arenaBytes = g_SceneArena.GetUsedBytes();
+	snapshot.prepareTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - prepareStart).count();
+}
+
+// Demarre ou arrete le thread de simulation selon threadedSimulation (thread de rendu, entre deux frames).
+// En rejeu la preparation reste en serie : avec le thread, la snapshot soumise est la derniere prete, ce qui
+// depend de la vitesse de la machine, et les frames rejouees ne seraient plus les memes d'une build a l'autre.
+void ApplySimulationThreading()
+{
+	const bool threaded = threadedSimulation && !g_InputLog.IsReplaying();
+	if(threaded == g_SceneSimulation.IsRunning())
+		return;
+	if(threaded)
+	{
+		g_SceneSimulation.Start(PrepareScene);
+	}
+	else
+	{
+		g_SceneSimulation.Stop();
+		g_RenderSnapshot = &g_SerialSnapshot;
+	}
+}
+
+// Entrees de la prochaine frame : copie de tout ce que la preparation lit (camera, temps, TweakBar, clic)
+void BuildFrameInput(const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix, const glm::vec3& cameraPosition, float viewportHeight,
+					 SceneFrameInput& input)
+{
+	input.frame = g_SceneFrame + 1;
+	// temps simule interpole : la spirale avance au meme rythme que la camera
+	input.time = g_FixedTimestep.GetRenderTime() * 1000.0;
+	input.viewMatrix = viewMatrix;
+	input.projectionMatrix = projectionMatrix;
+	input.cameraPosition = cameraPosition;
+	input.viewportHeight = viewportHeight;
+	input.spiral = GetSpiralParameters();
+	input.rockRotation = g_Rock.rotation;
+	input.rockQuaternion = g_Rock.rotationQuaternion;
+	input.frustumCulling = frustumCulling;
+	input.sceneTreeCulling = sceneTreeCulling;
+	input.occlusionCulling = occlusionCulling;
+	input.maxOccluders = maxOccluders;
+	input.lodPixelError = lodPixelError;
+	input.pick = g_PickPending;
+	input.pickRay = g_PickRay;
+}
+
+// Copie l'image du rasteriseur logiciel dans le framebuffer de la fenetre
+void PresentSoftwareFrame()
+{
+	const int width = g_SoftwareRasterizer.GetWidth();
+	const int height = g_SoftwareRasterizer.GetHeight();
+	static int textureWidth = 0, textureHeight = 0;
+	if(g_SoftwareColorTexture == 0 || textureWidth != width || textureHeight != height)
+	{
+		if(g_SoftwareColorTexture == 0)
+		{
+			glGenTextures(1, &g_SoftwareColorTexture);
+			glGenFramebuffers(1, &g_SoftwareFramebuffer);
+		}
+		glBindTexture(GL_TEXTURE_2D, g_SoftwareColorTexture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, g_SoftwareFramebuffer);
+		glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, g_SoftwareColorTexture, 0);
+		textureWidth = width;
+		textureHeight = height;
+	}
+
+	// la ligne 0 du buffer est en bas comme pour OpenGL : copie directe
+	glBindTexture(GL_TEXTURE_2D, g_SoftwareColorTexture);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, g_SoftwareRasterizer.GetStride());
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, g_SoftwareRasterizer.GetColorBuffer());
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	g_FrameStats.uploadBytes += (size_t) width * height * 4;
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, g_SoftwareFramebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
 }
 
 void Render()
@@ -488,18 +1397,87 @@ void Render()
 	auto width = glutGet(GLUT_WINDOW_WIDTH);
 	auto height = glutGet(GLUT_WINDOW_HEIGHT);
 
+	g_PerfHud.BeginFrame();
+	g_FrameStats = FrameStats();
+#if ALLOCATOR_STATS
+	// allocations depuis le Render precedent : Update, cette frame et la preparation en cours sur l'autre thread
+	static size_t previousAllocations = 0;
+	const size_t allocations = GetAllocationStats().count;
+	frameHeapAllocations = (int) (allocations - previousAllocations);
+	previousAllocations = allocations;
+#endif
+	g_PerfHud.MarkPass("Skybox");
+
+	// le rasterizer logiciel a son propre framebuffer a la taille de la fenetre
+	const bool scaledScene = dynamicResolution && !softwareRendering;
+	if(scaledScene)
+		g_DynamicResolution.BeginScene(width, height, resolutionBudget, minResolutionScale);
+	else
+		g_DynamicResolution.Reset();
+	resolutionScale = g_DynamicResolution.GetScale();
+	sceneGpuTime = g_DynamicResolution.GetGpuTime();
+	// les LODs sont choisis pour la hauteur reellement rendue
+	const float lodHeight = (float) (scaledScene ? g_DynamicResolution.GetRenderHeight() : height);
+
 	glClearColor(0.5f, 0.5f, 0.5f, 1.0f);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 	///////////////////////////////////////////////////////////////////////////////////// Init camera
-	g_Camera.projectionMatrix = glm::perspectiveFov(45.f, (float) width, (float) height, 0.1f, 1000.f);
-	glm::vec3 position = g_Camera.position;
+	const glm::mat4 projectionMatrix = glm::perspectiveFov(45.f, (float) width, (float) height, 0.1f, 1000.f);
+	// position interpolee entre les deux derniers pas de simulation
+	glm::vec3 position = glm::mix(g_PreviousCameraPosition, g_Camera.position, (float) g_FixedTimestep.GetAlpha());
 	glm::vec3 direction = g_Camera.forward;
-	g_Camera.viewMatrix = glm::lookAt(position, position + direction, glm::vec3(0.f, 1.f, 0.f));
+	const glm::mat4 viewMatrix = glm::lookAt(position, position + direction, glm::vec3(0.f, 1.f, 0.f));
+
+	///////////////////////////////////////////////////////////////////////////////////// Preparation de la scene
+	// sans thread de simulation la frame est preparee ici, sinon ses entrees partent en preparation et
+	// c'est la snapshot de la frame precedente qui est soumise pendant ce temps
+	ApplySimulationThreading();
+	SceneFrameInput input;
+	if(g_SceneSimulation.IsRunning())
+	{
+		if(!g_FlushPipeline)
+		{
+			BuildFrameInput(viewMatrix, projectionMatrix, position, lodHeight, input);
+			// file pleine : la simulation a trop de retard, les entrees de la frame suivante la remplaceront
+			if(g_SceneSimulation.Post(input))
+			{
+				g_SceneFrame = input.frame;
+				g_PickPending = false;
+			}
+		}
+		g_RenderSnapshot = &g_SceneSimulation.Acquire(g_FlushPipeline ? g_SceneFrame : 0);
+		mergedInputs = g_SceneSimulation.GetMergedInputs();
+	}
+	else
+	{
+		BuildFrameInput(viewMatrix, projectionMatrix, position, lodHeight, input);
+		PrepareScene(input, g_SerialSnapshot);
+		g_SceneFrame = input.frame;
+		g_PickPending = false;
+		g_RenderSnapshot = &g_SerialSnapshot;
+	}
+	g_FlushPipeline = false;
+	const SceneSnapshot& snapshot = *g_RenderSnapshot;
+	snapshotLag = (int) (g_SceneFrame - snapshot.frame);
+	prepareTime = snapshot.prepareTime;
+	visibleRockCount = snapshot.visibleRocks;
+	culledRockCount = snapshot.culledRocks;
+	occludedRockCount = snapshot.occludedRocks;
+	occlusionTime = snapshot.occlusionTime;
+	sceneArenaKB = snapshot.arenaBytes / 1024.0f;
+	g_PickedRock = snapshot.pick.rock;
+	g_PickedPoint = snapshot.pick.point;
+	pickingTime = snapshot.pick.time;
+
+	// la camera de la snapshot : culling, LODs et image restent coherents
+	g_Camera.viewMatrix = snapshot.viewMatrix;
+	g_Camera.projectionMatrix = snapshot.projectionMatrix;
 
 	glBindBuffer(GL_UNIFORM_BUFFER, g_Camera.UBO);
 	//glBufferData(GL_UNIFORM_BUFFER, sizeof(glm::mat4) * 2, glm::value_ptr(g_Camera.viewMatrix), GL_STREAM_DRAW); // Pourquoi c'est commente ? Ca sert
 	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4) * 2, glm::value_ptr(g_Camera.viewMatrix));
+	g_FrameStats.uploadBytes += sizeof(glm::mat4) * 2;
 
 	////////////////////////////////////////////////////////////////////////////////////// Dessin de la cubemap, de preference en dernier afin de limiter "l'overdraw"
 	////////////////////////////////////////////////////////////////////////////////////// Si on la dessine avant, on a un peu de transparence, mais moche
@@ -517,27 +1495,27 @@ void Render()
 	glDepthMask(GL_FALSE);
 	glDepthFunc(GL_LEQUAL);
 	glDrawArrays(GL_TRIANGLES, 0, 8 * 2 * 3);
+	// programme, cubemap et VAO
+	g_FrameStats.drawCalls += 1;
+	g_FrameStats.triangles += 8 * 2;
+	g_FrameStats.stateChanges += 3;
 
 	// On reset les machins
 	glDepthMask(GL_TRUE);
 	glDepthFunc(GL_LESS);
 
+	g_PerfHud.MarkPass("Scene");
+
 	///////////////////////////////////////////////////////////////////////////////////// Rendu des objets
 	///////// Init objet rock
 	glUseProgram(g_BasicShader.GetProgram());
 
 	glPolygonMode(GL_FRONT_AND_BACK, (wireframe ? GL_LINE : GL_FILL));
 
-	auto worldLocation = glGetUniformLocation(g_BasicShader.GetProgram(), "u_worldMatrix");
-	auto offsetLocation = glGetUniformLocation(g_BasicShader.GetProgram(), "u_offset");
 	auto useTransparencyLocation = glGetUniformLocation(g_BasicShader.GetProgram(), "u_useTransparency");
 	// TODO: l on parle de direction DE la lumire, dans le shader c'est VERS la lumire ?  voir
 	auto lightDirectionLocation = glGetUniformLocation(g_BasicShader.GetProgram(), "u_lightDirection");
 
-	glBindTexture(GL_TEXTURE_2D, g_Rock.textureObj);
-	glBindVertexArray(g_Rock.VAO);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, g_Rock.IBO);
-
 	glUniform3f(lightDirectionLocation, lightDirection.x, lightDirection.y, lightDirection.z);
 
 	if(wireframe) {
@@ -556,77 +1534,65 @@ void Render()
 		glDisable(GL_BLEND); 
 		glUniform1f(useTransparencyLocation, 0);
 	}
+	const bool useAtlas = textureAtlas && g_TextureAtlas.GetTexture() && !g_Rock.atlasImages.empty() && !g_Car.atlasImages.empty();
+	glUniform1f(glGetUniformLocation(g_BasicShader.GetProgram(), "u_useAtlas"), useAtlas ? 1.0f : 0.0f);
+	textureBindCount = 0;
 
 	/////////////////////////////////////////////////////////////////////////////////////// QUEUE DE ROCHERS !
-	auto currentTime = glutGet(GLUT_ELAPSED_TIME);
-
-	for(auto n = 0; n < numCubes; ++n) {
-		double t = 0.05*n - (double) (currentTime*speed) / 2000.0;
-		double r = 5.0*n + (double) (currentTime*speed) / 10.0;
-		float c = (float) n / numCubes;
-
-		// Set cube position
-		//glMatrixMode(GL_MODELVIEW);
-
-		//glLoadIdentity();
-		//glTranslated(0.6*cos(ka*t), 0.6*cos(kb*t), 0.6*sin(kc*t));
-		glm::mat4 tempWorldMatrix = glm::translate(glm::mat4(1), glm::vec3(sizeX*cos(ka*t), sizeY*cos(kb*t), sizeZ*sin(kc*t)));
-
-		//glRotated(r, 0.2, 0.7, 0.2);
-		tempWorldMatrix = tempWorldMatrix * glm::eulerAngleYXZ(0.2f*(float)cos(ka*t), 0.7f*(float) cos(kb*t), 0.2f*(float) sin(kc*t));
-		//tempWorldMatrix = glm::rotate(tempWorldMatrix, (float)r, glm::vec3(0.2, 0.7, 0.2));
-
-		//glScaled(0.1, 0.1, 0.1);
-		tempWorldMatrix = glm::scale(tempWorldMatrix, glm::vec3(0.3, 0.3, 0.3));
-
-		//glTranslated(-0.5, -0.5, -0.5);
-		tempWorldMatrix = glm::translate(tempWorldMatrix, glm::vec3(0, 0, -50));
-
-		g_Rock.position = glm::vec3(0, 0, 0);
-		g_Rock.worldMatrix = tempWorldMatrix;
-
-		glUniform3f(offsetLocation, g_Rock.position.x, g_Rock.position.y, g_Rock.position.z);
-		glUniformMatrix4fv(worldLocation, 1, GL_FALSE, glm::value_ptr(g_Rock.worldMatrix));
-
-		glDrawElements(GL_TRIANGLES, g_Rock.ElementCount, GL_UNSIGNED_INT, 0);
+	// rochers de la snapshot : matrices, visibilite et LODs deja calcules par PrepareScene
+	const std::vector<glm::mat4>& rockInstances = snapshot.rockInstances;
+	if(softwareRendering)
+	{
+		// meme ViewProj, meme culling et memes LODs que le rendu OpenGL, fond de glClearColor
+		if(g_SoftwareRasterizer.GetWidth() != width || g_SoftwareRasterizer.GetHeight() != height)
+			g_SoftwareRasterizer.Create(width, height);
+		g_SoftwareRasterizer.Begin(g_Camera.viewMatrix, g_Camera.projectionMatrix, lightDirection, 0xff808080);
+		for(size_t i = 0; i < rockInstances.size(); ++i)
+		{
+			if(snapshot.rockLods[i] >= 0)
+				AddSoftwareDraws(g_SoftwareRasterizer, g_Rock, snapshot.rockLods[i], rockInstances[i]);
+		}
+		if(showCar)
+			AddSoftwareDraws(g_SoftwareRasterizer, g_Car, 0, g_Car.worldMatrix);
+		drawCallCount = 0;
 	}
-	/////////////////////////////////////////////////////////////////////////////////////// Rendu d'un objet "repre" fixe (quaternions maison)
-	g_Rock.position = glm::vec3(0, 10, 0);
-
-	float yaw = glm::radians(g_Rock.rotation.y);
-	float pitch = glm::radians(g_Rock.rotation.x);
-	float roll = glm::radians(g_Rock.rotation.z);
-
-	glm::mat4 tempWorldMatrix = glm::translate(glm::mat4(1), g_Rock.position);
-	tempWorldMatrix = tempWorldMatrix * glm::eulerAngleYXZ(yaw, pitch, roll);
-	tempWorldMatrix = glm::translate(tempWorldMatrix, -g_Rock.position);
-
-	g_Rock.worldMatrix = tempWorldMatrix;
-
-	glUniform3f(offsetLocation, g_Rock.position.x, g_Rock.position.y, g_Rock.position.z);
-	glUniformMatrix4fv(worldLocation, 1, GL_FALSE, glm::value_ptr(g_Rock.worldMatrix));
-
-	glDrawElements(GL_TRIANGLES, g_Rock.ElementCount, GL_UNSIGNED_INT, 0);
-
-	/////////////////////////////////////////////////////////////////////////////////////// Rendu d'un objet "repre" fixe (quaternions tw)
-	g_Rock.worldMatrix = Quaternion(g_Rock.rotationQuaternion.x, g_Rock.rotationQuaternion.y, g_Rock.rotationQuaternion.z, g_Rock.rotationQuaternion.w).toRotationMatrix();
+	else
+	{
+		if(useAtlas)
+		{
+			// tous les materiaux sont dans l'atlas : une liaison, un batch pour les rochers et la voiture
+			glActiveTexture(GL_TEXTURE0 + AtlasTextureUnit);
+			glBindTexture(GL_TEXTURE_2D_ARRAY, g_TextureAtlas.GetTexture());
+			glActiveTexture(GL_TEXTURE0);
+			textureBindCount = 1;
+			g_DrawBatch.Clear();
+			AddAtlasDraws(g_DrawBatch, g_Rock, rockInstances.data(), snapshot.rockLods.data(), rockInstances.size());
+			if(showCar)
+				AddAtlasDraws(g_DrawBatch, g_Car, &g_Car.worldMatrix, &CarLod, 1);
+			g_DrawBatch.Submit(g_Rock.PrimitiveType, DrawDataTextureUnit, multiDraw);
+			CountSubmit(g_DrawBatch);
+			drawCallCount = (int) g_DrawBatch.GetSubmitCount();
+		}
+		else
+		{
+			drawCallCount = SubmitMaterialDraws(g_DrawBatch, g_Rock, rockInstances.data(), snapshot.rockLods.data(), rockInstances.size());
 
-	glUniform3f(offsetLocation, 0, 0, 0);
-	glUniformMatrix4fv(worldLocation, 1, GL_FALSE, glm::value_ptr(g_Rock.worldMatrix));
+			// la voiture n'est pas cullee (un seul objet), ses formes partent en un appel par materiau
+			if(showCar)
+				drawCallCount += SubmitMaterialDraws(g_DrawBatch, g_Car, &g_Car.worldMatrix, &CarLod, 1);
+		}
+	}
 
-	glDrawElements(GL_TRIANGLES, g_Rock.ElementCount, GL_UNSIGNED_INT, 0);
+	g_FrameStats.stateChanges += 1 + textureBindCount;
 
+	g_PerfHud.MarkPass("Fleche");
 	////////////////////////////////////////////////////////////////////////////////////// Dessin lumire
 	///////// Init objet arrow
 	glUseProgram(g_ArrowShader.GetProgram());
 
 	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 
-	worldLocation = glGetUniformLocation(g_ArrowShader.GetProgram(), "u_worldMatrix");
-
-	glBindTexture(GL_TEXTURE_2D, g_Arrow.textureObj);
-	glBindVertexArray(g_Arrow.VAO);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, g_Arrow.IBO);
+	glBindTexture(GL_TEXTURE_2D, g_Assets.GetTexture(g_Arrow.materialTextures[0]));
 
 	float arrowPositionFactor = 50;
 	g_Arrow.position = -lightDirection * glm::vec3(arrowPositionFactor*20);
@@ -649,16 +1615,36 @@ void Render()
 
 
 	////////////////////////////////////////// Position + rotation (marche pas)
-	tempWorldMatrix = glm::scale(glm::mat4(1.f), glm::vec3(1 / arrowPositionFactor));
+	glm::mat4 tempWorldMatrix = glm::scale(glm::mat4(1.f), glm::vec3(1 / arrowPositionFactor));
 	tempWorldMatrix = glm::translate(tempWorldMatrix, g_Arrow.position);
+	float yaw, pitch, roll;
 	glm::extractEulerAngleXYZ(glm::lookAt(g_Arrow.position, glm::vec3(0.f, 0.f, 0.f), glm::vec3(0.f, 1.f, 0.f)), yaw, pitch, roll);
 	tempWorldMatrix *= glm::eulerAngleYXZ(g_Arrow.position.z > 0 ? -pitch : pitch, g_Arrow.position.z > 0 ? -yaw : yaw, 0.f);
 
 	g_Arrow.worldMatrix = tempWorldMatrix;
 
 	//////////////////////////////////////////
-	glUniformMatrix4fv(worldLocation, 1, GL_FALSE, glm::value_ptr(g_Arrow.worldMatrix));
-	glDrawElements(GL_TRIANGLES, g_Arrow.ElementCount, GL_UNSIGNED_INT, 0);
+	// la fleche utilise un autre programme : second batch
+	if(softwareRendering)
+	{
+		// couleur constante de arrow.fs
+		g_SoftwareRasterizer.AddFlatDraw(g_Arrow.model->mesh, 0, g_Arrow.lods[0].indexCount, g_Arrow.worldMatrix, glm::vec4(0.941f, 0.952f, 0.384f, 1.0f));
+
+		const std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		g_SoftwareRasterizer.Render();
+		softwareRenderTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		PresentSoftwareFrame();
+	}
+	else
+	{
+		g_DrawBatch.Clear();
+		AddDraw(g_DrawBatch, g_Arrow, 0, g_Arrow.lods[0].indexCount, g_Arrow.worldMatrix);
+		g_DrawBatch.Submit(g_Arrow.PrimitiveType, DrawDataTextureUnit, multiDraw);
+		CountSubmit(g_DrawBatch);
+		drawCallCount += (int) g_DrawBatch.GetSubmitCount();
+	}
+	// programme et texture de la fleche
+	g_FrameStats.stateChanges += 2;
 
 	////////////////////////////////////////////////////////////////////////////////////// On reset tous les trucs bidules (pas vraiment obligatoire vu qu'on les crase au prochain passage, mais bon)
 	glBindTexture(GL_TEXTURE_2D, 0);
@@ -668,105 +1654,468 @@ void Render()
 	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 	glEnable(GL_CULL_FACE);
 
+	////////////////////////////////////////////////////////////////////////////////////// Assets : evictions de ce qui n'a pas servi a cette frame
+	g_Assets.SetBudgets((size_t) assetCpuBudgetMB * 1024 * 1024, (size_t) assetGpuBudgetMB * 1024 * 1024);
+	g_Assets.EndFrame();
+	AssetStats assetStats;
+	g_Assets.GetStats(assetStats);
+	textureCpuMB = assetStats.residentBytes[ASSET_TEXTURE][ASSET_CPU] / (1024.0f * 1024.0f);
+	textureGpuMB = assetStats.residentBytes[ASSET_TEXTURE][ASSET_GPU] / (1024.0f * 1024.0f);
+	modelCpuMB = assetStats.residentBytes[ASSET_MODEL][ASSET_CPU] / (1024.0f * 1024.0f);
+	modelGpuMB = assetStats.residentBytes[ASSET_MODEL][ASSET_GPU] / (1024.0f * 1024.0f);
+	assetEvictions = assetStats.evictions[ASSET_TEXTURE] + assetStats.evictions[ASSET_MODEL];
+	sharedAssets = assetStats.sharedRequests + assetStats.sharedContents;
+
+	////////////////////////////////////////////////////////////////////////////////////// Mise a l'echelle de la scene dans la fenetre
+	if(scaledScene)
+		g_DynamicResolution.EndScene();
+
+	////////////////////////////////////////////////////////////////////////////////////// Capture (avant la TweakBar)
+	g_PerfHud.MarkPass("Capture+IHM");
+	g_FrameCapture.CaptureFrame();
+	capturedFrames = g_FrameCapture.GetWrittenFrames();
+	droppedCaptureFrames = g_FrameCapture.GetDroppedFrames();
+	captureTime = g_FrameCapture.GetLastIssueTime();
+
 	////////////////////////////////////////////////////////////////////////////////////// Dessin de TweakBar
 	TwDraw();
+	renderedFrames = g_FrameScheduler.GetRenderedFrames();
+	activeCpuUsage = g_FrameScheduler.GetCpuPercent(false);
+	idleCpuUsage = g_FrameScheduler.GetCpuPercent(true);
+	g_FixedTimestep.GetFrameTimeStats(frameTimeMean, frameTimeDeviation);
+
+	////////////////////////////////////////////////////////////////////////////////////// HUD (par-dessus tout le reste)
+	g_PerfHud.EndFrame(g_FrameStats, width, height);
+
+#if GL_TRACE
+	GlTraceEndFrame();
+	const GlTraceStats& glStats = GlTraceGetLastFrame();
+	glCallCount = (int) glStats.totalCalls;
+	glBindCount = (int) glStats.binds;
+	glUploadKB = glStats.uploadBytes / 1024.0f;
+	glTraceOverhead = glStats.overheadMs + glStats.flushMs;
+#endif
 
 	glutSwapBuffers();
+	g_FixedTimestep.Present(FixedTimestep::Now());
+	g_InputLog.EndFrame();
 }
 
-void mouse(int button, int state, int x, int y)
+// Benchmark (--draw-sweep) : N rochers en grille, un appel par draw contre glMultiDrawElementsIndirect.
+// On mesure le temps CPU de soumission (construction + upload + appels) et le temps GPU (GL_TIME_ELAPSED).
+// Le LOD le plus grossier est utilise pour que le cout mesure soit celui du driver et pas des sommets.
+void RunDrawCountSweep()
+{
+	const int width = glutGet(GLUT_WINDOW_WIDTH);
+	const int height = glutGet(GLUT_WINDOW_HEIGHT);
+	const int lod = (int) g_Rock.lods.size() - 1;
+	const float spacing = glm::length(g_Rock.boundsMax - g_Rock.boundsMin) * 1.2f;
+	const size_t drawCounts[] = { 1, 10, 100, 1000, 10000, 50000 };
+	const int frameCount = 30;
+
+	glViewport(0, 0, width, height);
+	glUseProgram(g_BasicShader.GetProgram());
+	glUniform1f(glGetUniformLocation(g_BasicShader.GetProgram(), "u_useTransparency"), 0);
+	glUniform1f(glGetUniformLocation(g_BasicShader.GetProgram(), "u_useAtlas"), 0);
+	glUniform3f(glGetUniformLocation(g_BasicShader.GetProgram(), "u_lightDirection"), lightDirection.x, lightDirection.y, lightDirection.z);
+	glBindTexture(GL_TEXTURE_2D, g_Assets.GetTexture(g_Rock.materialTextures[0]));
+
+	GLuint query;
+	glGenQueries(1, &query);
+
+	printf("Draw count sweep (%s)\n", DrawBatch::IsMultiDrawSupported() ? "multi-draw indirect disponible" : "multi-draw indirect non supporte");
+	printf("%8s  %-10s %8s %12s %12s %10s\n", "draws", "mode", "appels", "CPU ms", "CPU us/draw", "GPU ms");
+	for(size_t test = 0; test < sizeof(drawCounts) / sizeof(drawCounts[0]); ++test)
+	{
+		const size_t count = drawCounts[test];
+		const int side = (int) ceil(sqrt((double) count));
+
+		// camera reculee pour voir toute la grille
+		const float extent = side * spacing;
+		g_Camera.projectionMatrix = glm::perspectiveFov(45.f, (float) width, (float) height, 0.1f, extent * 4.0f);
+		g_Camera.viewMatrix = glm::lookAt(glm::vec3(0.0f, 0.0f, extent * 1.3f), glm::vec3(0.0f), glm::vec3(0.f, 1.f, 0.f));
+		glBindBuffer(GL_UNIFORM_BUFFER, g_Camera.UBO);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4) * 2, glm::value_ptr(g_Camera.viewMatrix));
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+		for(int mode = 0; mode < 2; ++mode)
+		{
+			const bool indirect = (mode == 1);
+			if(indirect && !DrawBatch::IsMultiDrawSupported())
+				continue;
+
+			double cpuTime = 0.0;
+			GLuint64 gpuTime = 0;
+			for(int frame = 0; frame < frameCount + 1; ++frame)
+			{
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+				const auto start = std::chrono::high_resolution_clock::now();
+				glBeginQuery(GL_TIME_ELAPSED, query);
+				g_DrawBatch.Clear();
+				for(size_t i = 0; i < count; ++i)
+				{
+					const glm::vec3 position((int) (i % side) - side * 0.5f, (int) (i / side) - side * 0.5f, 0.0f);
+					AddDraw(g_DrawBatch, g_Rock, g_Rock.lods[lod].firstIndex, g_Rock.lods[lod].indexCount, glm::translate(glm::mat4(1.0f), position * spacing));
+				}
+				g_DrawBatch.Submit(g_Rock.PrimitiveType, DrawDataTextureUnit, indirect);
+				glEndQuery(GL_TIME_ELAPSED);
+				const auto stop = std::chrono::high_resolution_clock::now();
+
+				GLuint64 elapsed = 0;
+				glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+				glutSwapBuffers();
+
+				// la premiere frame sert de chauffe (allocation des buffers, compilation differee du driver)
+				if(frame == 0)
+					continue;
+				cpuTime += std::chrono::duration<double, std::milli>(stop - start).count();
+				gpuTime += elapsed;
+			}
+
+			cpuTime /= frameCount;
+			printf("%8u  %-10s %8u %12.3f %12.3f %10.3f\n", (unsigned) count, indirect ? "indirect" : "par draw",
+				   (unsigned) g_DrawBatch.GetSubmitCount(), cpuTime, cpuTime * 1000.0 / count, gpuTime / 1.0e6 / frameCount);
+		}
+	}
+
+	glDeleteQueries(1, &query);
+	glBindVertexArray(0);
+	glUseProgram(0);
+}
+
+// Benchmark (--pipeline-bench) : debit de la boucle de rendu complete (Render, swap sans synchro) a grand
+// nombre de rochers, preparation de la scene sur le thread de rendu puis sur le thread de simulation.
+// Le thread de rendu ne fait que soumettre la snapshot la plus recente : sans synchro il peut aller plus
+// vite que la simulation, le debit reel de la scene est celui des snapshots preparees.
+void RunPipelineBenchmark()
+{
+	const int rockCounts[] = { 1000, 10000, 50000 };
+	const int frameCount = 100;
+	const int savedNumCubes = numCubes;
+	const bool savedThreaded = threadedSimulation;
+
+	printf("Pipeline simulation / rendu (%u coeurs)\n", std::thread::hardware_concurrency());
+	printf("%8s  %-8s %10s %12s %12s %12s\n", "rochers", "mode", "frames/s", "snapshots/s", "rendu ms", "prepa ms");
+	for(size_t test = 0; test < sizeof(rockCounts) / sizeof(rockCounts[0]); ++test)
+	{
+		numCubes = rockCounts[test];
+		for(int mode = 0; mode < 2; ++mode)
+		{
+			threadedSimulation = (mode == 1);
+			// chauffe : allocation des snapshots, des feuilles de l'arbre et des buffers du batch
+			for(int frame = 0; frame < 5; ++frame)
+				Render();
+
+			const int preparedStart = g_SceneSimulation.GetPreparedFrames();
+			double renderTime = 0.0, prepareSum = 0.0;
+			const auto start = std::chrono::high_resolution_clock::now();
+			for(int frame = 0; frame < frameCount; ++frame)
+			{
+				const auto frameStart = std::chrono::high_resolution_clock::now();
+				Render();
+				renderTime += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - frameStart).count();
+				prepareSum += g_RenderSnapshot->prepareTime;
+			}
+			const double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+			const int snapshots = threadedSimulation ? g_SceneSimulation.GetPreparedFrames() - preparedStart : frameCount;
+
+			printf("%8d  %-8s %10.1f %12.1f %12.3f %12.3f\n", numCubes, threadedSimulation ? "threads" : "serie",
+				   frameCount / seconds, snapshots / seconds, renderTime / frameCount, prepareSum / frameCount);
+		}
+	}
+
+	numCubes = savedNumCubes;
+	threadedSimulation = savedThreaded;
+	ApplySimulationThreading();
+}
+
+// Verification (--alloc-check) : une fois la chauffe passee (snapshots, feuilles de l'arbre, buffers du
+// batch et arenas a leur taille), une frame complete (Update puis Render) ne doit plus appeler operator new,
+// avec et sans thread de simulation, avec l'arbre de la scene (refit et requete frustum) puis le test SoA des
+// spheres, occlusion culling active. Les tas d'AntTweakBar, de freeglut et du
+// pilote ne passent pas par operator new et ne sont pas comptes. Retourne false si une frame alloue, ou si
+// la build n'a pas les compteurs (ALLOCATOR_STATS).
+bool RunFrameAllocationCheck()
+{
+#if !ALLOCATOR_STATS
+	printf("Allocations par frame : ECHEC (compteurs absents, compiler avec ALLOCATOR_STATS=1)\n");
+	return false;
+#else
+	const int warmupFrames = 30;
+	const int frameCount = 200;
+	const bool savedThreaded = threadedSimulation;
+	const bool savedFrustum = frustumCulling;
+	const bool savedSceneTree = sceneTreeCulling;
+	const bool savedOcclusion = occlusionCulling;
+	frustumCulling = true;
+	occlusionCulling = true;
+
+	bool passed = true;
+	for(int mode = 0; mode < 4; ++mode)
+	{
+		threadedSimulation = (mode & 1) != 0;
+		sceneTreeCulling = (mode & 2) == 0;
+		for(int frame = 0; frame < warmupFrames; ++frame)
+		{
+			Update();
+			Render();
+		}
+
+		ResetAllocationPeak();
+		const AllocationStats before = GetAllocationStats();
+		int allocatingFrames = 0;
+		for(int frame = 0; frame < frameCount; ++frame)
+		{
+			const size_t frameStart = GetAllocationStats().count;
+			Update();
+			Render();
+			if(GetAllocationStats().count != frameStart)
+				++allocatingFrames;
+		}
+		const AllocationStats after = GetAllocationStats();
+
+		printf("Allocations %-8s %-7s : %zu operator new en %d frames (%d frames qui allouent), pic %.1f Ko au-dessus de %.1f Ko\n",
+			   threadedSimulation ? "threads" : "serie", sceneTreeCulling ? "arbre" : "spheres", after.count - before.count, frameCount, allocatingFrames,
+			   (after.peakBytes - before.liveBytes) / 1024.0, before.liveBytes / 1024.0);
+		const AllocatorStats arena = g_SceneArena.GetStats();
+		printf("  arena de la scene : %zu allocations, %zu blocs du tas, pic %.1f Ko\n", arena.allocations, arena.heapAllocations, arena.peakBytes / 1024.0);
+		passed = passed && after.count == before.count;
+	}
+
+	threadedSimulation = savedThreaded;
+	frustumCulling = savedFrustum;
+	sceneTreeCulling = savedSceneTree;
+	occlusionCulling = savedOcclusion;
+	ApplySimulationThreading();
+
+	printf("Allocations par frame : %s\n", passed ? "OK (aucune)" : "ECHEC");
+	return passed;
+#endif
+}
+
+// Rayon monde du pixel (x, y) dans la vue affichee
+Ray GetPickRay(int x, int y)
+{
+	const float width = (float) glutGet(GLUT_WINDOW_WIDTH);
+	const float height = (float) glutGet(GLUT_WINDOW_HEIGHT);
+	const glm::vec2 ndc(2.0f * (x + 0.5f) / width - 1.0f, 1.0f - 2.0f * (y + 0.5f) / height);
+	const glm::mat4 inverseViewProjection = glm::inverse(g_Camera.projectionMatrix * g_Camera.viewMatrix);
+	glm::vec4 nearPoint = inverseViewProjection * glm::vec4(ndc, -1.0f, 1.0f);
+	glm::vec4 farPoint = inverseViewProjection * glm::vec4(ndc, 1.0f, 1.0f);
+	nearPoint /= nearPoint.w;
+	farPoint /= farPoint.w;
+
+	Ray ray;
+	ray.origin = glm::vec3(nearPoint);
+	ray.direction = glm::normalize(glm::vec3(farPoint - nearPoint));
+	ray.maxDistance = glm::length(glm::vec3(farPoint - nearPoint));
+	return ray;
+}
+
+// Clic deja passe par la TweakBar (handled) : appele par mouse ou par le rejeu des entrees
+void SceneMouseButton(int button, int state, int x, int y, bool handled)
 {
 	mouseButtonsState[button] = state;
-	if(!TwEventMouseButtonGLUT(button, state, x, y))
+	if(!handled)
 	{
 		if(state == GLUT_DOWN)
 		{
 			oldX = x;
 			oldY = y;
+			// le rayon part avec les entrees de la frame suivante : l'arbre de la scene appartient a la preparation
+			if(button == GLUT_LEFT_BUTTON && !g_RenderSnapshot->rockInstances.empty())
+			{
+				g_PickRay = GetPickRay(x, y);
+				g_PickPending = true;
+			}
 		}
 	}
-	glutPostRedisplay();
 }
 
-void motion(int x, int y)
+void mouse(int button, int state, int x, int y)
 {
-	if(!TwEventMouseMotionGLUT(x, y))
+	const bool handled = TwEventMouseButtonGLUT(button, state, x, y) != 0;
+	// en rejeu la souris ne pilote plus la scene, la TweakBar reste utilisable
+	if(!g_InputLog.IsReplaying())
 	{
-		deltaX = oldX - x;
-		deltaY = oldY - y;
-
-		int width = glutGet(GLUT_WINDOW_WIDTH);
-		int height = glutGet(GLUT_WINDOW_HEIGHT);
+		g_InputLog.RecordMouseButton(button, state, x, y, handled);
+		SceneMouseButton(button, state, x, y, handled);
+	}
+	RequestFrame();
+}
 
-		Quaternion qX(
-			sin(((y) * M_PI) / height),
-			0,
-			0,
-			cos(((y) * M_PI) / height)
+// Deplacement souris non consomme par la TweakBar
+void SceneMotion(int x, int y)
+{
+	deltaX = oldX - x;
+	deltaY = oldY - y;
+
+	int width = glutGet(GLUT_WINDOW_WIDTH);
+	int height = glutGet(GLUT_WINDOW_HEIGHT);
+
+	Quaternion qX(
+		sin(((y) * M_PI) / height),
+		0,
+		0,
+		cos(((y) * M_PI) / height)
+		);
+	Quaternion qY(
+		0,
+		sin(((x) * M_PI) / width),
+		0,
+		cos(((x) * M_PI) / width)
+		);
+
+	Quaternion rotation = qY * qX;
+
+	// Rotation objet
+	if(mouseButtonsState[GLUT_LEFT_BUTTON] == GLUT_DOWN)
+	{
+		// TODO: bof, quand l'objet est tourn, la rotation devient galre
+		g_Rock.rotation.x -= deltaY;
+		g_Rock.rotation.y -= deltaX;
+	}
+	// Rotation camera
+	else if(mouseButtonsState[GLUT_RIGHT_BUTTON] == GLUT_DOWN)
+	{
+		horizontalAngleCamera += mouseSpeedCamera * deltaX;
+		verticalAngleCamera += mouseSpeedCamera * deltaY;
+
+		// Vecteur avant
+		glm::vec3 forward = glm::vec3(
+			cos(verticalAngleCamera) * sin(horizontalAngleCamera),
+			sin(verticalAngleCamera),
+			cos(verticalAngleCamera) * cos(horizontalAngleCamera)
 			);
-		Quaternion qY(
-			0,
-			sin(((x) * M_PI) / width),
+
+		// Vecteur droite
+		glm::vec3 right = glm::vec3(
+			sin(horizontalAngleCamera - M_PI / 2.0f),
 			0,
-			cos(((x) * M_PI) / width)
+			cos(horizontalAngleCamera - M_PI / 2.0f)
 			);
 
-		Quaternion rotation = qY * qX;
+		// Vecteur haut
+		glm::vec3 up = glm::cross(g_Camera.forward, g_Camera.right);
 
-		// Rotation objet
-		if(mouseButtonsState[GLUT_LEFT_BUTTON] == GLUT_DOWN)
-		{
-			// TODO: bof, quand l'objet est tourn, la rotation devient galre
-			g_Rock.rotation.x -= deltaY;
-			g_Rock.rotation.y -= deltaX;
-		}
-		// Rotation camera
-		else if(mouseButtonsState[GLUT_RIGHT_BUTTON] == GLUT_DOWN)
-		{
-			horizontalAngleCamera += mouseSpeedCamera * deltaX;
-			verticalAngleCamera += mouseSpeedCamera * deltaY;
-
-			// Vecteur avant
-			glm::vec3 forward = glm::vec3(
-				cos(verticalAngleCamera) * sin(horizontalAngleCamera),
-				sin(verticalAngleCamera),
-				cos(verticalAngleCamera) * cos(horizontalAngleCamera)
-				);
-
-			// Vecteur droite
-			glm::vec3 right = glm::vec3(
-				sin(horizontalAngleCamera - M_PI / 2.0f),
-				0,
-				cos(horizontalAngleCamera - M_PI / 2.0f)
-				);
-
-			// Vecteur haut
-			glm::vec3 up = glm::cross(g_Camera.forward, g_Camera.right);
-
-			g_Camera.forward = forward;
-			g_Camera.right = right;
-			g_Camera.rotationMatrix = rotation.toRotationMatrix();
-		}
+		g_Camera.forward = forward;
+		g_Camera.right = right;
+		g_Camera.rotationMatrix = rotation.toRotationMatrix();
+	}
 
-		oldX = x;
-		oldY = y;
+	oldX = x;
+	oldY = y;
+}
+
+void motion(int x, int y)
+{
+	if(!TwEventMouseMotionGLUT(x, y) && !g_InputLog.IsReplaying())
+	{
+		g_InputLog.RecordMotion(x, y);
+		SceneMotion(x, y);
 	}
 
-	glutPostRedisplay();
+	RequestFrame();
+}
+
+// survol de la TweakBar (surbrillance des lignes)
+void passiveMotion(int x, int y)
+{
+	if(TwEventMouseMotionGLUT(x, y))
+		RequestFrame();
 }
 
+void special(int key, int x, int y)
+{
+	if(TwEventSpecialGLUT(key, x, y))
+		RequestFrame();
+}
+
+void HandleKey(unsigned char key, bool down)
+{
+	// bascule une seule fois par appui (pas a chaque repetition de la touche)
+	if(down && key == 'h' && keyState[key] != GLUT_DOWN)
+		g_PerfHud.Toggle();
+	keyState[key] = down ? GLUT_DOWN : GLUT_UP;
+}
+
+// en rejeu, seule Echap reste active
 void keyboard(unsigned char key, int x, int y)
 {
-	keyState[key] = GLUT_DOWN;
+	if(g_InputLog.IsReplaying() && key != 27)
+		return;
+	g_InputLog.RecordKey(key, true);
+	HandleKey(key, true);
+	RequestFrame();
 }
 
 void keyboardUp(unsigned char key, int x, int y)
 {
-	keyState[key] = GLUT_UP;
+	if(g_InputLog.IsReplaying() && key != 27)
+		return;
+	g_InputLog.RecordKey(key, false);
+	HandleKey(key, false);
+	RequestFrame();
 }
 
 int main(int argc, char* argv[])
 {
+	// le contexte GL sera cree sur ce thread
+	SetMainThread();
+
+	// benchmarks CPU : pas besoin de fenetre
+	for(int i = 1; i < argc; ++i)
+	{
+		if(strcmp(argv[i], "--job-bench") == 0)
+			return RunJobSystemBenchmark() ? 0 : 1;
+		if(strcmp(argv[i], "--bvh-bench") == 0)
+		{
+			RunDynamicBvhBenchmark();
+			return 0;
+		}
+		if(strcmp(argv[i], "--pick-bench") == 0)
+		{
+			RunTriangleBvhBenchmark();
+			return 0;
+		}
+		if(strcmp(argv[i], "--obj-bench") == 0)
+		{
+			RunObjLoaderBenchmark();
+			return 0;
+		}
+		if(strcmp(argv[i], "--cull-check") == 0)
+			return RunCullingCheck() ? 0 : 1;
+		if(strcmp(argv[i], "--lod-check") == 0)
+			return RunLodCheck() ? 0 : 1;
+		if(strcmp(argv[i], "--occlusion-check") == 0)
+			return RunOcclusionCheck() ? 0 : 1;
+		if(strcmp(argv[i], "--pipeline-check") == 0)
+			return RunPipelineCheck() ? 0 : 1;
+		// --gl-trace-dump fichier : resume d'une trace enregistree par --gl-trace
+		if(strcmp(argv[i], "--gl-trace-dump") == 0 && i + 1 < argc)
+			return GlTraceDump(argv[i + 1]) ? 0 : 1;
+		if(strcmp(argv[i], "--raster-bench") == 0)
+		{
+			// spirale a t = 0 vue depuis la position initiale de la camera (voir Initialize)
+			std::vector<glm::mat4> instances;
+			GatherSpiralInstances(GetSpiralParameters(), 0, instances);
+			const glm::vec3 position(0.0f, 5.0f, 15.0f);
+			const glm::mat4 viewMatrix = glm::lookAt(position, position + glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.f, 1.f, 0.f));
+			RunSoftwareRasterizerBenchmark(instances, viewMatrix, glm::perspectiveFov(45.f, 1280.f, 720.f, 0.1f, 1000.f), lightDirection);
+			return 0;
+		}
+		if(strcmp(argv[i], "--trace-bench") == 0)
+		{
+			std::vector<glm::mat4> instances;
+			GatherSpiralInstances(GetSpiralParameters(), 0, instances);
+			const glm::vec3 position(0.0f, 5.0f, 15.0f);
+			const glm::mat4 viewMatrix = glm::lookAt(position, position + glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.f, 1.f, 0.f));
+			RunRayTracerBenchmark(instances, viewMatrix, glm::perspectiveFov(45.f, 1280.f, 720.f, 0.1f, 1000.f), lightDirection, g_SkyboxFiles);
+			return 0;
+		}
+	}
+
 	glutInit(&argc, argv);
 	glutInitDisplayMode(GLUT_RGBA | GLUT_DOUBLE | GLUT_DEPTH);
 	glutInitWindowSize(1280, 720);
@@ -778,16 +2127,66 @@ int main(int argc, char* argv[])
 #endif
 	Initialize();
 
+	// benchmark sans boucle interactive
+	for(int i = 1; i < argc; ++i)
+	{
+		if(strcmp(argv[i], "--draw-sweep") == 0)
+		{
+			SetSwapInterval(SWAP_IMMEDIATE);
+			RunDrawCountSweep();
+			Terminate();
+			return 0;
+		}
+		if(strcmp(argv[i], "--pipeline-bench") == 0)
+		{
+			SetSwapInterval(SWAP_IMMEDIATE);
+			RunPipelineBenchmark();
+			Terminate();
+			return 0;
+		}
+		if(strcmp(argv[i], "--alloc-check") == 0)
+		{
+			SetSwapInterval(SWAP_IMMEDIATE);
+			const bool passed = RunFrameAllocationCheck();
+			Terminate();
+			return passed ? 0 : 1;
+		}
+		// --capture [frames] : PNG, --capture-raw frames : sequence brute (capture.raw)
+		if(strcmp(argv[i], "--capture") == 0 || strcmp(argv[i], "--capture-raw") == 0)
+		{
+			const bool raw = strcmp(argv[i], "--capture-raw") == 0;
+			const int frames = i + 1 < argc ? atoi(argv[i + 1]) : 0;
+			g_FrameCapture.Start(raw ? "capture.raw" : "frame_", raw ? FrameCapture::OUTPUT_RAW : FrameCapture::OUTPUT_PNG,
+								 glutGet(GLUT_WINDOW_WIDTH), glutGet(GLUT_WINDOW_HEIGHT), raw && frames <= 0 ? RawCaptureFrames : frames);
+		}
+#if GL_TRACE
+		// --gl-trace : enregistre les appels GL de toute la session dans gltrace.bin
+		if(strcmp(argv[i], "--gl-trace") == 0)
+			GlTraceStartCapture("gltrace.bin");
+#endif
+		// --record fichier : enregistre les entrees de la session ; --replay fichier : les rejoue a
+		// l'identique (meme taille de fenetre, meme temps par frame) puis affiche les temps de frame
+		if(strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+			g_InputLog.StartRecording(argv[i + 1], glutGet(GLUT_WINDOW_WIDTH), glutGet(GLUT_WINDOW_HEIGHT));
+		if(strcmp(argv[i], "--replay") == 0 && i + 1 < argc && g_InputLog.StartReplay(argv[i + 1]))
+		{
+			glutReshapeWindow(g_InputLog.GetWidth(), g_InputLog.GetHeight());
+			// temps de frame non plafonnes par la synchro
+			swapInterval = requestedSwapInterval = SWAP_IMMEDIATE;
+			appliedSwapInterval = SetSwapInterval(SWAP_IMMEDIATE);
+		}
+	}
+
 	glutReshapeFunc(Resize);
 	glutIdleFunc(Update);
 	glutDisplayFunc(Render);
 
 	glutMouseFunc((GLUTmousebuttonfun) mouse);
 	glutMotionFunc((GLUTmousemotionfun) motion);
-	glutPassiveMotionFunc((GLUTmousemotionfun) TwEventMouseMotionGLUT);
+	glutPassiveMotionFunc(passiveMotion);
 	glutKeyboardFunc((GLUTkeyboardfun) keyboard);
 	glutKeyboardUpFunc(keyboardUp);
-	glutSpecialFunc((GLUTspecialfun) TwEventSpecialGLUT);
+	glutSpecialFunc(special);
 	TwGLUTModifiersFunc(glutGetModifiers);
 
 	glutMainLoop();
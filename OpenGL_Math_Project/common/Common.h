@@ -14,6 +14,11 @@
 #pragma comment(lib, "freeglut.lib")
 #pragma comment(lib, "opengl32.lib")
 #pragma comment(lib, "glew32s.lib")
+#else
+// Linux : GLX (glxew pour le controle de la synchro)
+#include <GL/glew.h>
+#include <GL/glxew.h>
+#include "GL/freeglut.h"
 #endif
 
 #include "../common/EsgiShader.h"
@@ -32,4 +37,7 @@
 bool LoadAndCreateTextureRGBA(const char *filename, GLuint &texID);
 bool LoadAndCreateCubeMap(const char* filesname[], GLuint &cubeMapID);
 
+// interception des appels GL (active en Debug), voir GlTrace.h
+#include "GlTrace.h"
+
 #endif // ESGI_COMMON_H
\ No newline at end of file
@@ -8,12 +8,14 @@
 // --- Includes --------------------------------------------------------------
 
 #include "EsgiShader.h"
+#include "FrameAllocator.h"
 #define GLEW_STATIC
 #include "GL/glew.h"
 
 #include <cstdio>
 #include <cstdlib>
 #include <cstdarg>
+#include <cstring>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -37,7 +39,8 @@ void GL_PRINT(const char *format, ...)
 
 // --- Fonctions -------------------------------------------------------------
 
-static char* FileToString(const char *sourceFile) 
+// le texte est alloue dans l'arena de travail du thread, rendu par l'ArenaScope de l'appelant
+static char* FileToString(const char *sourceFile, LinearArena& arena) 
 {
      char* text = NULL;
      
@@ -53,7 +56,7 @@ static char* FileToString(const char *sourceFile)
              
              if (count > 0) 
 			 {
-                 text = (char*)malloc(count + 1);
+                 text = arena.AllocateArray<char>(count + 1);
                  count = fread(text, sizeof(char), count, file);
                  text[count] = '\0';
              }
@@ -65,16 +68,60 @@ static char* FileToString(const char *sourceFile)
      return text;
 }
 
+// GLSL 330 n'a pas d'include : chaque ligne #include "fichier" (en debut de ligne, un seul niveau)
+// est coupee du texte et remplacee par le contenu du fichier, les morceaux sont passes tels quels
+// a glShaderSource. Le chemin est relatif au repertoire courant, comme celui des shaders
+static const int MaxShaderSources = 16;
+
+static int SplitIncludes(char* text, LinearArena& arena, const char* sources[])
+{
+	int count = 0;
+	sources[count++] = text;
+	char* line = text;
+	while(line != NULL && *line != '\0')
+	{
+		char* next = strchr(line, '\n');
+		if(strncmp(line, "#include \"", 10) == 0)
+		{
+			char* name = line + 10;
+			char* end = strchr(name, '"');
+			if(end == NULL || (next != NULL && end > next) || count + 2 > MaxShaderSources) {
+				GL_PRINT("Include de shader invalide\n");
+				return 0;
+			}
+			*end = '\0';
+			const char* included = FileToString(name, arena);
+			if(included == NULL) {
+				GL_PRINT("Include de shader introuvable : %s\n", name);
+				return 0;
+			}
+			// termine le morceau precedent, le suivant reprend au retour a la ligne
+			*line = '\0';
+			sources[count++] = included;
+			if(next != NULL)
+				sources[count++] = next;
+		}
+		line = next ? next + 1 : NULL;
+	}
+	return count;
+}
+
 ///
 // Cree un shader object, charge le code source du shader et le compile
 //
 static GLuint LoadShader(GLenum type, const char *sourceFile)
 {
 	// Preload le fichier de shader
-	char *shaderSrc = FileToString(sourceFile);
+	ArenaScope scratch(GetScratchArena());
+	char *shaderSrc = FileToString(sourceFile, scratch.GetArena());
 	if (shaderSrc == NULL) {
 		return false;
 	}
+	const char* sources[MaxShaderSources];
+	int sourceCount = SplitIncludes(shaderSrc, scratch.GetArena(), sources);
+	if (sourceCount == 0) {
+		return 0;
+	}
 	
 	// Cree le shader object
 	GLuint shader = glCreateShader(type);
@@ -83,14 +130,11 @@ static GLuint LoadShader(GLenum type, const char *sourceFile)
 	}
 
 	// Load the shader source
-	glShaderSource(shader, 1, (const char **)&shaderSrc, NULL);
+	glShaderSource(shader, sourceCount, sources, NULL);
 
 	// Compile le shader
 	glCompileShader(shader);
 
-	// on n'a plus besoin du fichier texte
-	free(shaderSrc);
-
 	// verifie le status de la compilation
 	GLint compiled;
 	glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
@@ -103,12 +147,10 @@ static GLuint LoadShader(GLenum type, const char *sourceFile)
 
 		if (infoLen > 1)
 		{
-			char* infoLog = (char *)malloc(sizeof(char) * infoLen);
+			char* infoLog = scratch.GetArena().AllocateArray<char>(infoLen);
 
 			glGetShaderInfoLog(shader, infoLen, NULL, infoLog);
 			GL_PRINT("Error compiling shader:\n%s\n", infoLog);  
-
-			free(infoLog);
 		}
 
 		// on supprime le shader object car il est inutilisable
@@ -184,12 +226,11 @@ bool EsgiShader::Create()
 
 		if (infoLen > 1)
 		{
-			char* infoLog = (char *)malloc(sizeof(char) * infoLen);
+			ArenaScope scratch(GetScratchArena());
+			char* infoLog = scratch.GetArena().AllocateArray<char>(infoLen);
 
 			glGetProgramInfoLog(m_ProgramObject, infoLen, NULL, infoLog);
 			GL_PRINT("Erreur de lien du programme:\n%s\n", infoLog);                     
-
-			free(infoLog);
 		}
 
 		glDeleteProgram(m_ProgramObject);
@@ -206,12 +247,11 @@ bool EsgiShader::Create()
 	glGetProgramiv(m_ProgramObject, GL_INFO_LOG_LENGTH, &infoLen);
 	if (infoLen > 1)
 	{
-		char* infoLog = (char *)malloc(sizeof(char) * infoLen);
+		ArenaScope scratch(GetScratchArena());
+		char* infoLog = scratch.GetArena().AllocateArray<char>(infoLen);
 
 		glGetProgramInfoLog(m_ProgramObject, infoLen, NULL, infoLog);
 		GL_PRINT("Resultat de la validation du programme:\n%s\n", infoLog);                     
-
-		free(infoLog);
 	}
 #endif
 
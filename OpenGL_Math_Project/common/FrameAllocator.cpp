@@ -0,0 +1,188 @@
+#include "FrameAllocator.h"
+
+#include <algorithm>
+
+static const size_t ArenaGranularity = 4096;			// capacite des arenas agrandies, en octets
+static const size_t ScratchArenaCapacity = 256 * 1024;	// bloc initial des arenas de travail
+
+static inline size_t AlignUp(size_t value, size_t alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+LinearArena::LinearArena(size_t capacity) : m_Block(NULL), m_Capacity(capacity), m_Offset(0), m_Overflow(NULL), m_OverflowBytes(0), m_HighWater(0)
+#if ALLOCATOR_STATS
+										  , m_Allocations(0), m_HeapAllocations(0), m_PeakBytes(0)
+#endif
+{
+}
+
+LinearArena::~LinearArena()
+{
+	Reset();
+	::operator delete(m_Block);
+}
+
+void* LinearArena::Allocate(size_t size, size_t alignment)
+{
+	if(!m_Block && m_Capacity > 0)
+	{
+		m_Block = static_cast<uint8_t*>(::operator new(m_Capacity));
+#if ALLOCATOR_STATS
+		++m_HeapAllocations;
+#endif
+	}
+
+	// l'alignement est celui de l'adresse, pas seulement du decalage dans le bloc
+	void* pointer;
+	const uintptr_t base = reinterpret_cast<uintptr_t>(m_Block);
+	const size_t start = AlignUp(base + m_Offset, alignment) - base;
+	if(m_Block && start + size <= m_Capacity)
+	{
+		m_Offset = start + size;
+		pointer = m_Block + start;
+	}
+	else
+	{
+		pointer = AllocateOverflow(size, alignment);
+	}
+
+	m_HighWater = std::max(m_HighWater, GetUsedBytes());
+#if ALLOCATOR_STATS
+	++m_Allocations;
+	m_PeakBytes = std::max(m_PeakBytes, GetUsedBytes());
+#endif
+	return pointer;
+}
+
+void* LinearArena::AllocateOverflow(size_t size, size_t alignment)
+{
+	// l'entete est suivi de la zone alignee
+	Overflow* overflow = static_cast<Overflow*>(::operator new(sizeof(Overflow) + alignment + size));
+	overflow->next = m_Overflow;
+	// le bloc de remplacement devra aussi contenir le remplissage d'alignement
+	overflow->size = size + alignment;
+	m_Overflow = overflow;
+	m_OverflowBytes += overflow->size;
+#if ALLOCATOR_STATS
+	++m_HeapAllocations;
+#endif
+	const uintptr_t data = reinterpret_cast<uintptr_t>(overflow) + sizeof(Overflow);
+	return reinterpret_cast<void*>(AlignUp(data, alignment));
+}
+
+void LinearArena::Rewind(const Marker& marker)
+{
+	while(m_Overflow != marker.overflow)
+	{
+		Overflow* next = m_Overflow->next;
+		m_OverflowBytes -= m_Overflow->size;
+		::operator delete(m_Overflow);
+		m_Overflow = next;
+	}
+	m_Offset = marker.offset;
+	if(m_Offset != 0 || m_Overflow)
+		return;
+
+	// arena vide : si le plus gros besoin depuis la derniere fois n'a pas tenu dans le bloc, le bloc
+	// est remplace (alloue au prochain Allocate) par un bloc assez grand pour lui
+	if(m_HighWater > m_Capacity)
+	{
+		::operator delete(m_Block);
+		m_Block = NULL;
+		m_Capacity = AlignUp(m_HighWater + m_HighWater / 4, ArenaGranularity);
+	}
+	m_HighWater = 0;
+}
+
+#if ALLOCATOR_STATS
+AllocatorStats LinearArena::GetStats() const
+{
+	AllocatorStats stats;
+	stats.allocations = m_Allocations;
+	stats.heapAllocations = m_HeapAllocations;
+	stats.usedBytes = GetUsedBytes();
+	stats.peakBytes = m_PeakBytes;
+	return stats;
+}
+#endif
+
+FixedBlockPool::FixedBlockPool(size_t blockSize, size_t blocksPerChunk)
+	: m_BlockSize(AlignUp(std::max(blockSize, sizeof(FreeBlock)), Alignment)), m_BlocksPerChunk(std::max(blocksPerChunk, (size_t) 1))
+	, m_FreeList(NULL), m_Chunks(NULL), m_LiveBlocks(0)
+#if ALLOCATOR_STATS
+	, m_Allocations(0), m_HeapAllocations(0), m_PeakBlocks(0)
+#endif
+{
+}
+
+FixedBlockPool::~FixedBlockPool()
+{
+	while(m_Chunks)
+	{
+		Chunk* next = m_Chunks->next;
+		::operator delete(m_Chunks);
+		m_Chunks = next;
+	}
+}
+
+void FixedBlockPool::AllocateChunk()
+{
+	// entete du paquet puis ses blocs, chaines dans la liste libre dans l'ordre des adresses
+	const size_t header = AlignUp(sizeof(Chunk), Alignment);
+	uint8_t* memory = static_cast<uint8_t*>(::operator new(header + m_BlockSize * m_BlocksPerChunk));
+	Chunk* chunk = reinterpret_cast<Chunk*>(memory);
+	chunk->next = m_Chunks;
+	m_Chunks = chunk;
+	for(size_t i = m_BlocksPerChunk; i-- > 0; )
+	{
+		FreeBlock* block = reinterpret_cast<FreeBlock*>(memory + header + i * m_BlockSize);
+		block->next = m_FreeList;
+		m_FreeList = block;
+	}
+#if ALLOCATOR_STATS
+	++m_HeapAllocations;
+#endif
+}
+
+void* FixedBlockPool::Allocate()
+{
+	if(!m_FreeList)
+		AllocateChunk();
+	FreeBlock* block = m_FreeList;
+	m_FreeList = block->next;
+	++m_LiveBlocks;
+#if ALLOCATOR_STATS
+	++m_Allocations;
+	m_PeakBlocks = std::max(m_PeakBlocks, m_LiveBlocks);
+#endif
+	return block;
+}
+
+void FixedBlockPool::Free(void* pointer)
+{
+	if(!pointer)
+		return;
+	FreeBlock* block = static_cast<FreeBlock*>(pointer);
+	block->next = m_FreeList;
+	m_FreeList = block;
+	--m_LiveBlocks;
+}
+
+#if ALLOCATOR_STATS
+AllocatorStats FixedBlockPool::GetStats() const
+{
+	AllocatorStats stats;
+	stats.allocations = m_Allocations;
+	stats.heapAllocations = m_HeapAllocations;
+	stats.usedBytes = m_LiveBlocks * m_BlockSize;
+	stats.peakBytes = m_PeakBlocks * m_BlockSize;
+	return stats;
+}
+#endif
+
+LinearArena& GetScratchArena()
+{
+	static thread_local LinearArena arena(ScratchArenaCapacity);
+	return arena;
+}
@@ -0,0 +1,278 @@
+#ifndef ESGI_FRAME_ALLOCATOR_H
+#define ESGI_FRAME_ALLOCATOR_H
+
+// --- Includes --------------------------------------------------------------
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Statistiques des allocateurs (nombre d'allocations, pic memoire) : actives en Debug, ou avec
+// ALLOCATOR_STATS=1. En Release les compteurs ne coutent rien et GetStats n'existe pas. Le meme
+// interrupteur remplace operator new / delete pour compter les allocations du tas (AllocationStats.h).
+#ifndef ALLOCATOR_STATS
+#ifdef _DEBUG
+#define ALLOCATOR_STATS 1
+#else
+#define ALLOCATOR_STATS 0
+#endif
+#endif
+
+// --- Types -----------------------------------------------------------------
+
+// Allocateurs pour les chemins chauds, sans aller-retour par le tas :
+// - LinearArena : allocation par simple increment dans un bloc, tout est rendu d'un coup par Reset
+//   (debut de frame) ou en revenant a une marque (ArenaScope). Ce qui ne tient pas dans le bloc part
+//   sur le tas et le bloc est agrandi la prochaine fois que l'arena est vide : apres quelques frames
+//   de chauffe, plus aucune allocation
+// - FixedBlockPool : blocs de taille fixe pris par paquets, liste libre, allocation et liberation en O(1)
+// - ObjectPool<T> : objets d'un type construits dans un FixedBlockPool
+// - ArenaAllocator<T> et PoolAllocator<T> : adaptateurs pour les conteneurs de la STL
+// Aucun n'est protege contre les acces concurrents : une arena par thread (GetScratchArena), un pool
+// partage est protege par son proprietaire.
+
+struct AllocatorStats
+{
+	size_t allocations;			// allocations servies depuis la creation
+	size_t heapAllocations;		// blocs demandes au tas (blocs de l'arena, debordements, paquets du pool)
+	size_t usedBytes;			// en cours
+	size_t peakBytes;			// maximum de usedBytes depuis la creation
+};
+
+class LinearArena
+{
+public:
+	static const size_t DefaultAlignment = 16;
+
+	// Position de l'arena, pour rendre d'un coup tout ce qui a ete alloue depuis
+	struct Marker
+	{
+		size_t offset;
+		void* overflow;
+
+		Marker() : offset(0), overflow(NULL) {}
+	};
+
+	// capacity : taille du bloc, alloue au premier Allocate
+	explicit LinearArena(size_t capacity = 0);
+	~LinearArena();
+
+	void* Allocate(size_t size, size_t alignment = DefaultAlignment);
+	// tableau non initialise, rien n'est detruit au Reset
+	template<typename T>
+	inline T* AllocateArray(size_t count) { return static_cast<T*>(Allocate(count * sizeof(T), alignof(T))); }
+
+	inline Marker GetMarker() const
+	{
+		Marker marker;
+		marker.offset = m_Offset;
+		marker.overflow = m_Overflow;
+		return marker;
+	}
+	// rend tout ce qui a ete alloue depuis marker (les marques plus recentes deviennent invalides)
+	void Rewind(const Marker& marker);
+	// debut de frame : tout est rendu
+	inline void Reset() { Rewind(Marker()); }
+
+	inline size_t GetCapacity() const { return m_Capacity; }
+	inline size_t GetUsedBytes() const { return m_Offset + m_OverflowBytes; }
+#if ALLOCATOR_STATS
+	AllocatorStats GetStats() const;
+#endif
+
+private:
+	// debordement : un bloc du tas par allocation, chaines du plus recent au plus ancien
+	struct Overflow
+	{
+		Overflow* next;
+		size_t size;
+	};
+
+	LinearArena(const LinearArena&);
+	LinearArena& operator=(const LinearArena&);
+
+	void* AllocateOverflow(size_t size, size_t alignment);
+
+	uint8_t* m_Block;
+	size_t m_Capacity;
+	size_t m_Offset;
+	Overflow* m_Overflow;
+	size_t m_OverflowBytes;
+	size_t m_HighWater;				// maximum de GetUsedBytes depuis que l'arena etait vide
+#if ALLOCATOR_STATS
+	size_t m_Allocations;
+	size_t m_HeapAllocations;
+	size_t m_PeakBytes;
+#endif
+};
+
+// Rend a la sortie du bloc tout ce qui a ete alloue dans l'arena pendant le bloc
+class ArenaScope
+{
+public:
+	explicit ArenaScope(LinearArena& arena) : m_Arena(arena), m_Marker(arena.GetMarker()) {}
+	~ArenaScope() { m_Arena.Rewind(m_Marker); }
+
+	inline LinearArena& GetArena() const { return m_Arena; }
+
+private:
+	ArenaScope(const ArenaScope&);
+	ArenaScope& operator=(const ArenaScope&);
+
+	LinearArena& m_Arena;
+	LinearArena::Marker m_Marker;
+};
+
+class FixedBlockPool
+{
+public:
+	static const size_t Alignment = 16;
+
+	// blockSize est arrondi a un multiple de Alignment, les blocs sont pris au tas par blocksPerChunk
+	FixedBlockPool(size_t blockSize, size_t blocksPerChunk = 64);
+	// les paquets sont rendus au tas, les blocs encore pris deviennent invalides
+	~FixedBlockPool();
+
+	void* Allocate();
+	void Free(void* block);
+
+	inline size_t GetBlockSize() const { return m_BlockSize; }
+	inline size_t GetLiveBlocks() const { return m_LiveBlocks; }
+#if ALLOCATOR_STATS
+	AllocatorStats GetStats() const;
+#endif
+
+private:
+	struct FreeBlock
+	{
+		FreeBlock* next;
+	};
+	struct Chunk
+	{
+		Chunk* next;
+	};
+
+	FixedBlockPool(const FixedBlockPool&);
+	FixedBlockPool& operator=(const FixedBlockPool&);
+
+	void AllocateChunk();
+
+	size_t m_BlockSize;
+	size_t m_BlocksPerChunk;
+	FreeBlock* m_FreeList;
+	Chunk* m_Chunks;
+	size_t m_LiveBlocks;
+#if ALLOCATOR_STATS
+	size_t m_Allocations;
+	size_t m_HeapAllocations;
+	size_t m_PeakBlocks;
+#endif
+};
+
+template<typename T>
+class ObjectPool
+{
+public:
+	static_assert(alignof(T) <= FixedBlockPool::Alignment, "alignement trop grand pour un FixedBlockPool");
+
+	explicit ObjectPool(size_t objectsPerChunk = 64) : m_Pool(sizeof(T), objectsPerChunk) {}
+
+	template<typename... Args>
+	inline T* Create(Args&&... args) { return new(m_Pool.Allocate()) T(std::forward<Args>(args)...); }
+	inline void Destroy(T* object)
+	{
+		if(!object)
+			return;
+		object->~T();
+		m_Pool.Free(object);
+	}
+
+	inline size_t GetLiveCount() const { return m_Pool.GetLiveBlocks(); }
+#if ALLOCATOR_STATS
+	inline AllocatorStats GetStats() const { return m_Pool.GetStats(); }
+#endif
+
+private:
+	FixedBlockPool m_Pool;
+};
+
+// Adaptateur STL vers une LinearArena : deallocate ne fait rien, la memoire est rendue avec l'arena.
+// Un vector qui grandit laisse ses anciens tableaux dans l'arena : reserver la taille finale d'abord.
+template<typename T>
+class ArenaAllocator
+{
+public:
+	typedef T value_type;
+
+	ArenaAllocator(LinearArena& arena) : m_Arena(&arena) {}
+	template<typename U>
+	ArenaAllocator(const ArenaAllocator<U>& other) : m_Arena(other.GetArena()) {}
+
+	inline T* allocate(size_t count) { return m_Arena->AllocateArray<T>(count); }
+	inline void deallocate(T*, size_t) {}
+
+	inline LinearArena* GetArena() const { return m_Arena; }
+
+private:
+	LinearArena* m_Arena;
+};
+
+template<typename T, typename U>
+inline bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return a.GetArena() == b.GetArena(); }
+template<typename T, typename U>
+inline bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return a.GetArena() != b.GetArena(); }
+
+template<typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T> >;
+
+// Adaptateur STL vers un FixedBlockPool pour les conteneurs a noeuds (list, map, set) : les noeuds
+// alloues un par un qui tiennent dans un bloc viennent du pool, le reste (tableaux) du tas
+template<typename T>
+class PoolAllocator
+{
+public:
+	typedef T value_type;
+
+	PoolAllocator(FixedBlockPool& pool) : m_Pool(&pool) {}
+	template<typename U>
+	PoolAllocator(const PoolAllocator<U>& other) : m_Pool(other.GetPool()) {}
+
+	inline T* allocate(size_t count)
+	{
+		if(FromPool(count))
+			return static_cast<T*>(m_Pool->Allocate());
+		return static_cast<T*>(::operator new(count * sizeof(T)));
+	}
+	inline void deallocate(T* pointer, size_t count)
+	{
+		if(FromPool(count))
+			m_Pool->Free(pointer);
+		else
+			::operator delete(pointer);
+	}
+
+	inline FixedBlockPool* GetPool() const { return m_Pool; }
+
+private:
+	inline bool FromPool(size_t count) const
+	{
+		return count == 1 && sizeof(T) <= m_Pool->GetBlockSize() && alignof(T) <= FixedBlockPool::Alignment;
+	}
+
+	FixedBlockPool* m_Pool;
+};
+
+template<typename T, typename U>
+inline bool operator==(const PoolAllocator<T>& a, const PoolAllocator<U>& b) { return a.GetPool() == b.GetPool(); }
+template<typename T, typename U>
+inline bool operator!=(const PoolAllocator<T>& a, const PoolAllocator<U>& b) { return a.GetPool() != b.GetPool(); }
+
+// --- Fonctions -------------------------------------------------------------
+
+// Arena de travail du thread appelant (chargements, tampons temporaires), a utiliser avec un ArenaScope.
+// Son bloc est alloue au premier usage et grandit jusqu'a contenir le plus gros besoin rencontre.
+LinearArena& GetScratchArena();
+
+#endif // ESGI_FRAME_ALLOCATOR_H
@@ -0,0 +1,339 @@
+#define GL_TRACE_NO_MACROS
+#include "Common.h"
+#include "GlTrace.h"
+
+#include <cstdio>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <chrono>
+
+static const char TraceMagic[8] = { 'E', 'S', 'G', 'I', 'G', 'L', 'T', '1' };
+
+static const char* g_EntryNames[GL_TRACE_ENTRY_COUNT] = {
+	"Frame",
+#define GL_TRACE_NAME(name) "gl" #name,
+	GL_TRACE_GLEW_ENTRIES(GL_TRACE_NAME)
+	GL_TRACE_CORE_ENTRIES(GL_TRACE_NAME)
+#undef GL_TRACE_NAME
+};
+
+const char* GlTraceEntryName(int entry)
+{
+	return (entry >= 0 && entry < GL_TRACE_ENTRY_COUNT) ? g_EntryNames[entry] : "?";
+}
+
+#if GL_TRACE
+
+static GlTraceStats g_CurrentFrame;
+static GlTraceStats g_LastFrame;
+static uint32_t g_FrameIndex = 0;
+static FILE* g_TraceFile = nullptr;
+static std::vector<uint8_t> g_TraceBuffer;		// enregistrements de la frame, ecrits en un fwrite
+static bool g_Recording = false;
+// cout d'un appel intercepte mesure par GlTraceInstall, en nanosecondes
+static double g_CountNs = 0.0;
+static double g_RecordNs = 0.0;
+static void* g_Originals[GL_TRACE_ENTRY_COUNT];
+
+void GlTraceRecord(int entry, const void* arguments, size_t size)
+{
+	++g_CurrentFrame.calls[entry];
+	if(!g_Recording)
+		return;
+	const size_t offset = g_TraceBuffer.size();
+	g_TraceBuffer.resize(offset + 3 + size);
+	uint8_t* record = &g_TraceBuffer[offset];
+	record[0] = (uint8_t) (entry & 0xff);
+	record[1] = (uint8_t) (entry >> 8);
+	record[2] = (uint8_t) size;
+	if(size)
+		memcpy(record + 3, arguments, size);
+}
+
+void GlTraceAddBytes(size_t bytes)
+{
+	g_CurrentFrame.uploadBytes += bytes;
+}
+
+size_t GlTraceTextureBytes(int width, int height, int depth, unsigned int format, unsigned int type)
+{
+	size_t components = 4;
+	switch(format)
+	{
+	case GL_RED: case GL_DEPTH_COMPONENT: case GL_RED_INTEGER: components = 1; break;
+	case GL_RG: case GL_RG_INTEGER: components = 2; break;
+	case GL_RGB: case GL_BGR: case GL_RGB_INTEGER: components = 3; break;
+	default: break;
+	}
+	size_t componentSize = 1;
+	switch(type)
+	{
+	case GL_UNSIGNED_SHORT: case GL_SHORT: case GL_HALF_FLOAT: componentSize = 2; break;
+	case GL_UNSIGNED_INT: case GL_INT: case GL_FLOAT: componentSize = 4; break;
+	// formats compacts : un texel tient dans un seul entier
+	case GL_UNSIGNED_INT_8_8_8_8: case GL_UNSIGNED_INT_8_8_8_8_REV: case GL_UNSIGNED_INT_2_10_10_10_REV:
+		components = 1; componentSize = 4; break;
+	default: break;
+	}
+	return (size_t) width * height * depth * components * componentSize;
+}
+
+// Octets envoyes par les fonctions GLEW interceptees, rien par defaut
+template<int Entry>
+struct GlTraceBytes
+{
+	template<typename... P>
+	static inline void Count(P...) {}
+};
+
+template<>
+struct GlTraceBytes<GL_TRACE_BufferData>
+{
+	static inline void Count(GLenum, GLsizeiptr size, const void* data, GLenum) { if(data) GlTraceAddBytes(size); }
+};
+
+template<>
+struct GlTraceBytes<GL_TRACE_BufferSubData>
+{
+	static inline void Count(GLenum, GLintptr, GLsizeiptr size, const void*) { GlTraceAddBytes(size); }
+};
+
+template<>
+struct GlTraceBytes<GL_TRACE_BufferStorage>
+{
+	static inline void Count(GLenum, GLsizeiptr size, const void* data, GLbitfield) { if(data) GlTraceAddBytes(size); }
+};
+
+template<>
+struct GlTraceBytes<GL_TRACE_TexImage3D>
+{
+	static inline void Count(GLenum, GLint, GLint, GLsizei width, GLsizei height, GLsizei depth, GLint, GLenum format, GLenum type, const void* pixels)
+	{
+		if(pixels)
+			GlTraceAddBytes(GlTraceTextureBytes(width, height, depth, format, type));
+	}
+};
+
+// remplace le pointeur de GLEW : enregistre, compte les octets puis appelle la fonction du driver
+template<int Entry, typename R, typename... P>
+static R GLAPIENTRY GlTraceHook(P... arguments)
+{
+	GlTraceCall(Entry, arguments...);
+	GlTraceBytes<Entry>::Count(arguments...);
+	return ((R (GLAPIENTRY*)(P...)) g_Originals[Entry])(arguments...);
+}
+
+template<int Entry, typename R, typename... P>
+static void GlTraceInstallHook(R (GLAPIENTRY*& pointer)(P...))
+{
+	g_Originals[Entry] = (void*) pointer;
+	// fonction absente du driver : on laisse le pointeur nul pour que les tests GLEW restent valides
+	if(pointer)
+		pointer = &GlTraceHook<Entry, R, P...>;
+}
+
+// Cout moyen d'un appel a GlTraceCall (deux arguments), en nanosecondes
+static double MeasureCallCost(bool recording)
+{
+	// par paquets de la taille d'une frame chargee : le tampon est vide entre deux paquets comme a GlTraceEndFrame
+	// et reste dans sa reserve, sans reallocation pendant la mesure
+	const int batchSize = 1000;
+	const int iterations = 200 * batchSize;
+	g_Recording = recording;
+	const std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	for(int i = 0; i < iterations; ++i)
+	{
+		GlTraceCall(GL_TRACE_Uniform1f, (GLint) i, (GLfloat) i);
+		if((i + 1) % batchSize == 0)
+			g_TraceBuffer.clear();
+	}
+	const double ns = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count();
+	g_Recording = false;
+	g_TraceBuffer.clear();
+	return ns / iterations;
+}
+
+void GlTraceInstall()
+{
+#define GL_TRACE_INSTALL(name) GlTraceInstallHook<GL_TRACE_##name>(__glew##name);
+	GL_TRACE_GLEW_ENTRIES(GL_TRACE_INSTALL)
+#undef GL_TRACE_INSTALL
+
+	g_TraceBuffer.reserve(256 * 1024);
+	g_CountNs = MeasureCallCost(false);
+	g_RecordNs = MeasureCallCost(true);
+	g_CurrentFrame = GlTraceStats();
+	g_LastFrame = GlTraceStats();
+	printf("GL trace : %d points d'entree interceptes, %.1f ns par appel (%.1f ns en enregistrant)\n",
+		   GL_TRACE_ENTRY_COUNT - 1, g_CountNs, g_RecordNs);
+}
+
+void GlTraceEndFrame()
+{
+	GlTraceStats& frame = g_CurrentFrame;
+	frame.totalCalls = frame.binds = frame.drawCalls = 0;
+	for(int entry = 1; entry < GL_TRACE_ENTRY_COUNT; ++entry)
+		frame.totalCalls += frame.calls[entry];
+	frame.binds = frame.calls[GL_TRACE_BindBuffer] + frame.calls[GL_TRACE_BindBufferBase] + frame.calls[GL_TRACE_BindFramebuffer]
+				+ frame.calls[GL_TRACE_BindVertexArray] + frame.calls[GL_TRACE_BindTexture] + frame.calls[GL_TRACE_UseProgram]
+				+ frame.calls[GL_TRACE_ActiveTexture];
+	frame.drawCalls = frame.calls[GL_TRACE_DrawArrays] + frame.calls[GL_TRACE_DrawElements] + frame.calls[GL_TRACE_DrawElementsBaseVertex]
+					+ frame.calls[GL_TRACE_DrawElementsInstancedBaseVertexBaseInstance] + frame.calls[GL_TRACE_MultiDrawElementsIndirect];
+	frame.overheadMs = (float) (frame.totalCalls * (g_Recording ? g_RecordNs : g_CountNs) / 1.0e6);
+	frame.flushMs = 0.0f;
+
+	if(g_Recording)
+	{
+		const std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		GlTraceCall(GL_TRACE_Frame, g_FrameIndex);
+		fwrite(&g_TraceBuffer[0], 1, g_TraceBuffer.size(), g_TraceFile);
+		g_TraceBuffer.clear();
+		frame.flushMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	g_LastFrame = frame;
+	g_CurrentFrame = GlTraceStats();
+	++g_FrameIndex;
+}
+
+const GlTraceStats& GlTraceGetLastFrame()
+{
+	return g_LastFrame;
+}
+
+void GlTracePrintLastFrame()
+{
+	const GlTraceStats& frame = g_LastFrame;
+	std::vector<int> entries;
+	for(int entry = 1; entry < GL_TRACE_ENTRY_COUNT; ++entry)
+	{
+		if(frame.calls[entry])
+			entries.push_back(entry);
+	}
+	std::stable_sort(entries.begin(), entries.end(), [&frame](int a, int b) { return frame.calls[a] > frame.calls[b]; });
+
+	printf("GL trace, frame %u : %u appels, %u liaisons, %u draws, %.1f Ko envoyes, surcout estime %.3f ms\n",
+		   g_FrameIndex - 1, frame.totalCalls, frame.binds, frame.drawCalls, frame.uploadBytes / 1024.0, frame.overheadMs);
+	for(size_t i = 0; i < entries.size(); ++i)
+		printf("%8u  %s\n", frame.calls[entries[i]], g_EntryNames[entries[i]]);
+}
+
+bool GlTraceStartCapture(const char* path)
+{
+	GlTraceStopCapture();
+	g_TraceFile = fopen(path, "wb");
+	if(!g_TraceFile)
+	{
+		printf("GL trace : impossible de creer %s\n", path);
+		return false;
+	}
+	const uint32_t entryCount = GL_TRACE_ENTRY_COUNT;
+	fwrite(TraceMagic, 1, sizeof(TraceMagic), g_TraceFile);
+	fwrite(&entryCount, sizeof(entryCount), 1, g_TraceFile);
+	for(int entry = 0; entry < GL_TRACE_ENTRY_COUNT; ++entry)
+		fwrite(g_EntryNames[entry], 1, strlen(g_EntryNames[entry]) + 1, g_TraceFile);
+	g_Recording = true;
+	return true;
+}
+
+void GlTraceStopCapture()
+{
+	if(!g_TraceFile)
+		return;
+	// appels depuis la derniere fin de frame
+	if(!g_TraceBuffer.empty())
+		fwrite(&g_TraceBuffer[0], 1, g_TraceBuffer.size(), g_TraceFile);
+	g_TraceBuffer.clear();
+	fclose(g_TraceFile);
+	g_TraceFile = nullptr;
+	g_Recording = false;
+}
+
+bool GlTraceIsCapturing()
+{
+	return g_Recording;
+}
+
+#endif // GL_TRACE
+
+bool GlTraceDump(const char* path)
+{
+	FILE* file = fopen(path, "rb");
+	if(!file)
+	{
+		printf("GL trace : impossible d'ouvrir %s\n", path);
+		return false;
+	}
+	std::vector<uint8_t> data;
+	uint8_t chunk[64 * 1024];
+	size_t read;
+	while((read = fread(chunk, 1, sizeof(chunk), file)) > 0)
+		data.insert(data.end(), chunk, chunk + read);
+	fclose(file);
+
+	uint32_t entryCount = 0;
+	if(data.size() < sizeof(TraceMagic) + sizeof(entryCount) || memcmp(&data[0], TraceMagic, sizeof(TraceMagic)) != 0)
+	{
+		printf("GL trace : %s n'est pas une trace\n", path);
+		return false;
+	}
+	memcpy(&entryCount, &data[sizeof(TraceMagic)], sizeof(entryCount));
+
+	// les noms viennent du fichier : une trace reste lisible si la liste des points d'entree change
+	size_t offset = sizeof(TraceMagic) + sizeof(entryCount);
+	std::vector<std::string> names;
+	for(uint32_t entry = 0; entry < entryCount && offset < data.size(); ++entry)
+	{
+		const char* name = (const char*) &data[offset];
+		const size_t length = strnlen(name, data.size() - offset);
+		names.push_back(std::string(name, length));
+		offset += length + 1;
+	}
+	if(names.size() < entryCount)
+	{
+		printf("GL trace : %s tronquee, %zu noms sur %u\n", path, names.size(), entryCount);
+		return false;
+	}
+
+	std::vector<uint64_t> calls(entryCount, 0);
+	uint64_t totalCalls = 0;
+	uint32_t frames = 0;
+	while(offset + 3 <= data.size())
+	{
+		const uint32_t entry = data[offset] | (data[offset + 1] << 8);
+		const size_t size = data[offset + 2];
+		if(entry >= entryCount || offset + 3 + size > data.size())
+		{
+			printf("GL trace : enregistrement invalide a l'octet %zu\n", offset);
+			return false;
+		}
+		offset += 3 + size;
+		++calls[entry];
+		if(entry == GL_TRACE_Frame)
+			++frames;
+		else
+			++totalCalls;
+	}
+
+	std::vector<uint32_t> entries;
+	for(uint32_t entry = 1; entry < entryCount; ++entry)
+	{
+		if(calls[entry])
+			entries.push_back(entry);
+	}
+	std::stable_sort(entries.begin(), entries.end(), [&calls](uint32_t a, uint32_t b) { return calls[a] > calls[b]; });
+
+	printf("%s : %u frames, %llu appels (%.1f par frame), %zu octets\n", path, frames, (unsigned long long) totalCalls,
+		   frames ? (double) totalCalls / frames : 0.0, data.size());
+	for(size_t i = 0; i < entries.size(); ++i)
+	{
+		if(entries[i] >= names.size())
+		{
+			printf("GL trace : point d'entree %u sans nom\n", entries[i]);
+			return false;
+		}
+		printf("%10llu  %s\n", (unsigned long long) calls[entries[i]], names[entries[i]].c_str());
+	}
+	return true;
+}
@@ -0,0 +1,169 @@
+#ifndef __GL_TRACE_H__
+#define __GL_TRACE_H__
+
+// Couche d'interception des appels OpenGL : compte les appels par point d'entree, les liaisons et
+// les octets envoyes (glBufferData, glBufferSubData, glTexImage2D...) et peut enregistrer le flux
+// d'appels dans un fichier binaire compact.
+// - les fonctions chargees par GLEW (GL 1.2 et plus) sont interceptees en remplacant les pointeurs
+//   __glewXxx par GlTraceInstall : tous les fichiers du projet sont couverts sans modification
+// - les fonctions GL 1.1 (exportees directement par opengl32) sont redirigees par les macros de ce
+//   fichier, inclus a la fin de Common.h
+// Actif en Debug (ou avec GL_TRACE=1), sans aucune trace dans le code en Release (GL_TRACE=0).
+// Les appels faits par AntTweakBar (qui charge ses propres pointeurs) ne sont pas vus.
+//
+// Fichier de trace : "ESGIGLT1", uint32 nombre de points d'entree, leurs noms (termines par 0),
+// puis une suite d'enregistrements [uint16 point d'entree][uint8 taille][arguments bruts].
+// Le point d'entree 0 (Frame) marque la fin d'une frame, son argument est le numero de frame (uint32).
+
+#ifndef GL_TRACE
+#ifdef _DEBUG
+#define GL_TRACE 1
+#else
+#define GL_TRACE 0
+#endif
+#endif
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// points d'entree suivis : remplaces dans la table de GLEW
+#define GL_TRACE_GLEW_ENTRIES(X) \
+	X(ActiveTexture) X(AttachShader) X(BeginQuery) X(BindBuffer) X(BindBufferBase) X(BindFramebuffer) \
+	X(BindRenderbuffer) X(BindVertexArray) X(BlendEquation) X(BlitFramebuffer) X(BufferData) \
+	X(BufferStorage) X(BufferSubData) X(CheckFramebufferStatus) X(ClientWaitSync) X(CompileShader) \
+	X(CopyBufferSubData) X(CreateProgram) X(CreateShader) X(DeleteBuffers) X(DeleteFramebuffers) \
+	X(DeleteProgram) X(DeleteQueries) X(DeleteRenderbuffers) X(DeleteShader) X(DeleteSync) \
+	X(DeleteVertexArrays) X(DetachShader) X(DisableVertexAttribArray) X(DrawElementsBaseVertex) \
+	X(DrawElementsInstancedBaseVertexBaseInstance) X(EnableVertexAttribArray) X(EndQuery) X(FenceSync) \
+	X(FramebufferRenderbuffer) X(FramebufferTexture2D) X(GenBuffers) X(GenFramebuffers) X(GenQueries) \
+	X(GenRenderbuffers) X(GenVertexArrays) X(GenerateMipmap) X(GetProgramInfoLog) X(GetProgramiv) \
+	X(GetQueryObjectiv) X(GetQueryObjectui64v) X(GetShaderInfoLog) X(GetShaderiv) X(GetUniformBlockIndex) \
+	X(GetUniformLocation) X(LinkProgram) X(MapBufferRange) X(MultiDrawElementsIndirect) X(QueryCounter) \
+	X(RenderbufferStorage) X(ShaderSource) X(TexBuffer) X(TexImage3D) X(Uniform1f) X(Uniform1i) X(Uniform2f) \
+	X(Uniform3f) X(UniformBlockBinding) X(UnmapBuffer) X(UseProgram) X(ValidateProgram) \
+	X(VertexAttribDivisor) X(VertexAttribI1ui) X(VertexAttribIPointer) X(VertexAttribPointer)
+
+// points d'entree GL 1.1 : rediriges par macro
+#define GL_TRACE_CORE_ENTRIES(X) \
+	X(BindTexture) X(BlendFunc) X(Clear) X(ClearColor) X(DeleteTextures) X(DepthFunc) X(DepthMask) X(Disable) \
+	X(DrawArrays) X(DrawElements) X(Enable) X(GenTextures) X(GetIntegerv) X(GetString) X(IsEnabled) \
+	X(PixelStorei) X(PolygonMode) X(ReadPixels) X(TexImage2D) X(TexParameteri) X(TexSubImage2D) X(Viewport)
+
+enum GlTraceEntry
+{
+	GL_TRACE_Frame,
+#define GL_TRACE_ENUM(name) GL_TRACE_##name,
+	GL_TRACE_GLEW_ENTRIES(GL_TRACE_ENUM)
+	GL_TRACE_CORE_ENTRIES(GL_TRACE_ENUM)
+#undef GL_TRACE_ENUM
+	GL_TRACE_ENTRY_COUNT
+};
+
+// Compteurs d'une frame
+struct GlTraceStats
+{
+	uint32_t calls[GL_TRACE_ENTRY_COUNT];
+	uint32_t totalCalls;
+	uint32_t binds;				// glBind*, glUseProgram et glActiveTexture
+	uint32_t drawCalls;
+	size_t uploadBytes;			// octets lus par le driver depuis la memoire du programme
+	float overheadMs;			// cout estime de l'interception sur la frame (etalonne par GlTraceInstall)
+	float flushMs;				// ecriture de la trace dans le fichier
+};
+
+const char* GlTraceEntryName(int entry);
+
+#if GL_TRACE
+
+// a appeler une fois apres glewInit
+void GlTraceInstall();
+// fin de frame (avant glutSwapBuffers) : fige les compteurs de la frame et ecrit la trace
+void GlTraceEndFrame();
+const GlTraceStats& GlTraceGetLastFrame();
+// affiche les points d'entree appeles pendant la derniere frame, du plus frequent au plus rare
+void GlTracePrintLastFrame();
+
+bool GlTraceStartCapture(const char* path);
+void GlTraceStopCapture();
+bool GlTraceIsCapturing();
+
+// appele par les fonctions interceptees
+void GlTraceRecord(int entry, const void* arguments, size_t size);
+void GlTraceAddBytes(size_t bytes);
+size_t GlTraceTextureBytes(int width, int height, int depth, unsigned int format, unsigned int type);
+
+// arguments copies tels quels dans la trace (les pointeurs sont enregistres comme des adresses)
+template<typename... A>
+inline void GlTraceCall(int entry, A... arguments)
+{
+	uint8_t packed[128];
+	size_t size = 0;
+	int expand[] = { 0, (memcpy(packed + size, &arguments, sizeof(A)), size += sizeof(A), 0)... };
+	(void) expand;
+	GlTraceRecord(entry, packed, size);
+}
+
+// appel d'une fonction GL 1.1 : enregistre puis transmet. Les types des arguments ne sont deduits
+// que du prototype, les conversions implicites (0 vers un pointeur...) restent celles de l'appel direct
+template<typename T>
+struct GlTraceIdentity
+{
+	typedef T Type;
+};
+
+template<int Entry, typename R, typename... P>
+inline R GlTraceCore(R (GLAPIENTRY* function)(P...), typename GlTraceIdentity<P>::Type... arguments)
+{
+	GlTraceCall(Entry, arguments...);
+	return function(arguments...);
+}
+
+inline void GlTraceTexImage2D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLint border,
+							  GLenum format, GLenum type, const void* pixels)
+{
+	if(pixels)
+		GlTraceAddBytes(GlTraceTextureBytes(width, height, 1, format, type));
+	GlTraceCore<GL_TRACE_TexImage2D>(glTexImage2D, target, level, internalFormat, width, height, border, format, type, pixels);
+}
+
+inline void GlTraceTexSubImage2D(GLenum target, GLint level, GLint x, GLint y, GLsizei width, GLsizei height,
+								 GLenum format, GLenum type, const void* pixels)
+{
+	if(pixels)
+		GlTraceAddBytes(GlTraceTextureBytes(width, height, 1, format, type));
+	GlTraceCore<GL_TRACE_TexSubImage2D>(glTexSubImage2D, target, level, x, y, width, height, format, type, pixels);
+}
+
+// redirection des fonctions GL 1.1 (le nom n'est pas re-developpe dans sa propre macro)
+#ifndef GL_TRACE_NO_MACROS
+#define glTexImage2D(...) GlTraceTexImage2D(__VA_ARGS__)
+#define glTexSubImage2D(...) GlTraceTexSubImage2D(__VA_ARGS__)
+#define glBindTexture(...) GlTraceCore<GL_TRACE_BindTexture>(glBindTexture, __VA_ARGS__)
+#define glBlendFunc(...) GlTraceCore<GL_TRACE_BlendFunc>(glBlendFunc, __VA_ARGS__)
+#define glClear(...) GlTraceCore<GL_TRACE_Clear>(glClear, __VA_ARGS__)
+#define glClearColor(...) GlTraceCore<GL_TRACE_ClearColor>(glClearColor, __VA_ARGS__)
+#define glDeleteTextures(...) GlTraceCore<GL_TRACE_DeleteTextures>(glDeleteTextures, __VA_ARGS__)
+#define glDepthFunc(...) GlTraceCore<GL_TRACE_DepthFunc>(glDepthFunc, __VA_ARGS__)
+#define glDepthMask(...) GlTraceCore<GL_TRACE_DepthMask>(glDepthMask, __VA_ARGS__)
+#define glDisable(...) GlTraceCore<GL_TRACE_Disable>(glDisable, __VA_ARGS__)
+#define glDrawArrays(...) GlTraceCore<GL_TRACE_DrawArrays>(glDrawArrays, __VA_ARGS__)
+#define glDrawElements(...) GlTraceCore<GL_TRACE_DrawElements>(glDrawElements, __VA_ARGS__)
+#define glEnable(...) GlTraceCore<GL_TRACE_Enable>(glEnable, __VA_ARGS__)
+#define glGenTextures(...) GlTraceCore<GL_TRACE_GenTextures>(glGenTextures, __VA_ARGS__)
+#define glGetIntegerv(...) GlTraceCore<GL_TRACE_GetIntegerv>(glGetIntegerv, __VA_ARGS__)
+#define glGetString(...) GlTraceCore<GL_TRACE_GetString>(glGetString, __VA_ARGS__)
+#define glIsEnabled(...) GlTraceCore<GL_TRACE_IsEnabled>(glIsEnabled, __VA_ARGS__)
+#define glPixelStorei(...) GlTraceCore<GL_TRACE_PixelStorei>(glPixelStorei, __VA_ARGS__)
+#define glPolygonMode(...) GlTraceCore<GL_TRACE_PolygonMode>(glPolygonMode, __VA_ARGS__)
+#define glReadPixels(...) GlTraceCore<GL_TRACE_ReadPixels>(glReadPixels, __VA_ARGS__)
+#define glTexParameteri(...) GlTraceCore<GL_TRACE_TexParameteri>(glTexParameteri, __VA_ARGS__)
+#define glViewport(...) GlTraceCore<GL_TRACE_Viewport>(glViewport, __VA_ARGS__)
+#endif
+
+#endif // GL_TRACE
+
+// lit un fichier de trace et affiche le nombre d'appels par point d'entree (disponible meme en Release)
+bool GlTraceDump(const char* path);
+
+#endif //__GL_TRACE_H__
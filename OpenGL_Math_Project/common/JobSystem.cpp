@@ -0,0 +1,442 @@
+#include "JobSystem.h"
+#include "Parallel.h"
+
+#include <cstdint>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <algorithm>
+#include <memory>
+
+static const int MaxThreads = 64;				// threads pouvant avoir une deque en meme temps
+static const int64_t DequeCapacity = 1024;		// puissance de 2
+static const size_t JobPoolSize = 1024;			// jobs en vol par thread avant execution directe
+static const int SpinsBeforeSleep = 64;			// essais sans travail avant qu'un thread de travail dorme
+
+// Deque de Chase-Lev a capacite fixe (Le et al., "Correct and Efficient Work-Stealing for Weak Memory
+// Models", 2013). Les barrieres de l'article sont remplacees par des operations seq_cst : meme code sur
+// x86, et ThreadSanitizer voit les synchronisations.
+class JobDeque
+{
+public:
+	JobDeque() : m_Top(0), m_Bottom(0)
+	{
+		for(int64_t i = 0; i < DequeCapacity; ++i)
+			m_Slots[i].store(NULL, std::memory_order_relaxed);
+	}
+
+	// proprietaire : false si la deque est pleine
+	bool Push(Job* job)
+	{
+		const int64_t bottom = m_Bottom.load(std::memory_order_relaxed);
+		if(bottom - m_Top.load(std::memory_order_acquire) >= DequeCapacity)
+			return false;
+		m_Slots[bottom & (DequeCapacity - 1)].store(job, std::memory_order_relaxed);
+		// publie le job (et son payload) pour les voleurs
+		m_Bottom.store(bottom + 1, std::memory_order_release);
+		return true;
+	}
+
+	// proprietaire : dernier job empile (LIFO, le plus chaud en cache)
+	Job* Pop()
+	{
+		const int64_t bottom = m_Bottom.load(std::memory_order_relaxed) - 1;
+		m_Bottom.store(bottom, std::memory_order_seq_cst);
+		int64_t top = m_Top.load(std::memory_order_seq_cst);
+		if(top > bottom)
+		{
+			m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+			return NULL;
+		}
+		Job* job = m_Slots[bottom & (DequeCapacity - 1)].load(std::memory_order_relaxed);
+		if(top == bottom)
+		{
+			// dernier job : course avec un voleur, celui qui avance m_Top le prend
+			if(!m_Top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				job = NULL;
+			m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+		}
+		return job;
+	}
+
+	// autres threads : plus ancien job empile (FIFO, en general le plus gros sous-arbre)
+	Job* Steal()
+	{
+		int64_t top = m_Top.load(std::memory_order_seq_cst);
+		const int64_t bottom = m_Bottom.load(std::memory_order_seq_cst);
+		if(top >= bottom)
+			return NULL;
+		Job* job = m_Slots[top & (DequeCapacity - 1)].load(std::memory_order_relaxed);
+		if(!m_Top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			return NULL;
+		return job;
+	}
+
+private:
+	alignas(64) std::atomic<int64_t> m_Top;
+	alignas(64) std::atomic<int64_t> m_Bottom;
+	std::atomic<Job*> m_Slots[DequeCapacity];
+};
+
+// Deque et pool de jobs d'un thread (thread de travail ou thread qui a lance des jobs)
+struct ThreadSlot
+{
+	JobDeque deque;
+	std::unique_ptr<Job[]> jobs;		// alloue au premier enregistrement, garde si le slot est repris
+	size_t nextJob;
+	bool used;							// sous m_SlotMutex
+	uint32_t random;					// debut de la recherche des victimes de vol
+
+	ThreadSlot() : nextJob(0), used(false), random(0) {}
+};
+
+class JobScheduler
+{
+public:
+	JobScheduler();
+	~JobScheduler();
+
+	ThreadSlot* RegisterThread();
+	void ReleaseThread(ThreadSlot* slot);
+
+	Job* FindJob(ThreadSlot* self);
+	void Execute(Job* job);
+	void WakeWorkers();
+
+	void PostMainThreadJob(Job* job);
+	int RunMainThreadJobs();
+	void SetActiveWorkers(unsigned int activeWorkers);
+	inline unsigned int GetWorkerCount() const { return (unsigned int) m_Workers.size(); }
+
+private:
+	void WorkerLoop(unsigned int index);
+
+	ThreadSlot m_Slots[MaxThreads];
+	std::atomic<int> m_SlotCount;		// slots deja utilises une fois : les voleurs ne regardent pas au-dela
+	std::mutex m_SlotMutex;
+
+	std::vector<std::thread> m_Workers;
+	std::atomic<bool> m_Running;
+	std::atomic<unsigned int> m_ActiveWorkers;
+	// sommeil des threads de travail : m_Epoch change a chaque job publie. Les threads au-dela de
+	// m_ActiveWorkers attendent sur m_ParkCondition, les reveils de jobs ne les concernent pas
+	std::mutex m_SleepMutex;
+	std::condition_variable m_WakeCondition;
+	std::condition_variable m_ParkCondition;
+	std::atomic<uint32_t> m_Epoch;
+	std::atomic<int> m_Sleeping;
+
+	std::mutex m_MainMutex;
+	std::vector<Job*> m_MainJobs;
+	std::vector<Job*> m_MainRunning;	// thread GL seulement
+};
+
+// Etat par thread. Les threads de travail se desenregistrent eux-memes avant la destruction de l'ordonnanceur.
+struct ThreadState
+{
+	ThreadSlot* slot;
+	bool registered;					// enregistrement tente (slot NULL : plus de slot libre)
+	JobCounter* currentCounter;
+	bool mainThread;
+
+	ThreadState() : slot(NULL), registered(false), currentCounter(NULL), mainThread(false) {}
+	~ThreadState();
+};
+
+static JobScheduler& GetScheduler()
+{
+	static JobScheduler scheduler;
+	return scheduler;
+}
+
+static thread_local ThreadState t_Thread;
+
+ThreadState::~ThreadState()
+{
+	if(slot)
+		GetScheduler().ReleaseThread(slot);
+}
+
+static ThreadSlot* GetThreadSlot()
+{
+	if(!t_Thread.registered)
+	{
+		t_Thread.slot = GetScheduler().RegisterThread();
+		t_Thread.registered = true;
+	}
+	return t_Thread.slot;
+}
+
+JobScheduler::JobScheduler() : m_SlotCount(0), m_Running(true), m_Epoch(0), m_Sleeping(0)
+{
+	// le thread qui attend un compteur travaille aussi : un thread de travail de moins que de coeurs
+	const unsigned int workerCount = ::GetWorkerCount() - 1;
+	m_ActiveWorkers = workerCount;
+	for(unsigned int i = 0; i < workerCount; ++i)
+		m_Workers.push_back(std::thread(&JobScheduler::WorkerLoop, this, i));
+}
+
+JobScheduler::~JobScheduler()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_SleepMutex);
+		m_Running = false;
+	}
+	m_WakeCondition.notify_all();
+	m_ParkCondition.notify_all();
+	for(size_t i = 0; i < m_Workers.size(); ++i)
+		m_Workers[i].join();
+}
+
+ThreadSlot* JobScheduler::RegisterThread()
+{
+	std::lock_guard<std::mutex> lock(m_SlotMutex);
+	for(int i = 0; i < MaxThreads; ++i)
+	{
+		ThreadSlot& slot = m_Slots[i];
+		if(slot.used)
+			continue;
+		slot.used = true;
+		if(!slot.jobs)
+			slot.jobs.reset(new Job[JobPoolSize]);
+		slot.random = 2654435761u * (i + 1);
+		if(i >= m_SlotCount.load())
+			m_SlotCount = i + 1;
+		return &slot;
+	}
+	// au-dela de MaxThreads, les jobs du thread sont executes directement
+	return NULL;
+}
+
+void JobScheduler::ReleaseThread(ThreadSlot* slot)
+{
+	// les jobs encore dans la deque restent volables, le prochain proprietaire les depilera
+	std::lock_guard<std::mutex> lock(m_SlotMutex);
+	slot->used = false;
+}
+
+Job* JobScheduler::FindJob(ThreadSlot* self)
+{
+	if(self)
+	{
+		if(Job* job = self->deque.Pop())
+			return job;
+	}
+
+	// victimes dans un ordre pseudo-aleatoire different pour chaque thread
+	const int slotCount = m_SlotCount.load(std::memory_order_acquire);
+	if(slotCount == 0)
+		return NULL;
+	uint32_t start = 0;
+	if(self)
+	{
+		self->random ^= self->random << 13;
+		self->random ^= self->random >> 17;
+		self->random ^= self->random << 5;
+		start = self->random;
+	}
+	for(int i = 0; i < slotCount; ++i)
+	{
+		ThreadSlot& victim = m_Slots[(start + i) % slotCount];
+		if(&victim == self)
+			continue;
+		if(Job* job = victim.deque.Steal())
+			return job;
+	}
+	return NULL;
+}
+
+void JobScheduler::Execute(Job* job)
+{
+	JobCounter* counter = job->counter;
+	JobCounter* parentCounter = t_Thread.currentCounter;
+	t_Thread.currentCounter = counter;
+	job->invoke(*job);
+	t_Thread.currentCounter = parentCounter;
+
+	// le job est rendu au pool avant que l'attente du compteur puisse se terminer
+	if(job->heap)
+		delete job;
+	else
+		job->free.store(true, std::memory_order_release);
+	JobCounterDone(*counter);
+}
+
+void JobScheduler::WakeWorkers()
+{
+	m_Epoch.fetch_add(1);
+	if(m_Sleeping.load() == 0)
+		return;
+	// sous le mutex : un thread entre son test de m_Epoch et son attente ne manque pas le reveil
+	std::lock_guard<std::mutex> lock(m_SleepMutex);
+	m_WakeCondition.notify_one();
+}
+
+void JobScheduler::WorkerLoop(unsigned int index)
+{
+	// pas par GetThreadSlot : l'ordonnanceur est peut-etre encore en construction
+	ThreadSlot* self = RegisterThread();
+	t_Thread.slot = self;
+	t_Thread.registered = true;
+	int spins = 0;
+	while(m_Running.load(std::memory_order_relaxed))
+	{
+		if(index >= m_ActiveWorkers.load())
+		{
+			std::unique_lock<std::mutex> lock(m_SleepMutex);
+			m_ParkCondition.wait(lock, [&]() { return !m_Running || index < m_ActiveWorkers.load(); });
+			continue;
+		}
+
+		const uint32_t epoch = m_Epoch.load();
+		if(Job* job = FindJob(self))
+		{
+			Execute(job);
+			spins = 0;
+			continue;
+		}
+		if(++spins < SpinsBeforeSleep)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+		spins = 0;
+
+		// rien a voler depuis epoch : dort jusqu'a la publication d'un job
+		std::unique_lock<std::mutex> lock(m_SleepMutex);
+		++m_Sleeping;
+		m_WakeCondition.wait(lock, [&]() { return !m_Running || m_Epoch.load() != epoch || index >= m_ActiveWorkers.load(); });
+		--m_Sleeping;
+	}
+
+	// avant la destruction de l'ordonnanceur, pas dans le destructeur de ThreadState
+	if(self)
+		ReleaseThread(self);
+	t_Thread.slot = NULL;
+}
+
+void JobScheduler::PostMainThreadJob(Job* job)
+{
+	std::lock_guard<std::mutex> lock(m_MainMutex);
+	m_MainJobs.push_back(job);
+}
+
+int JobScheduler::RunMainThreadJobs()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_MainMutex);
+		m_MainRunning.swap(m_MainJobs);
+	}
+	// un job peut en poster d'autres : ils passeront au prochain appel
+	const int count = (int) m_MainRunning.size();
+	for(size_t i = 0; i < m_MainRunning.size(); ++i)
+		Execute(m_MainRunning[i]);
+	m_MainRunning.clear();
+	return count;
+}
+
+void JobScheduler::SetActiveWorkers(unsigned int activeWorkers)
+{
+	std::lock_guard<std::mutex> lock(m_SleepMutex);
+	m_ActiveWorkers = std::min(activeWorkers, GetWorkerCount());
+	m_WakeCondition.notify_all();
+	m_ParkCondition.notify_all();
+}
+
+// --- API ---------------------------------------------------------------------
+
+void JobCounterAdd(JobCounter& counter, int count)
+{
+	counter.m_Pending.fetch_add(count, std::memory_order_relaxed);
+}
+
+void JobCounterDone(JobCounter& counter)
+{
+	counter.m_Pending.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+Job* AllocateJob()
+{
+	ThreadSlot* slot = GetThreadSlot();
+	if(!slot)
+		return NULL;
+	for(size_t i = 0; i < JobPoolSize; ++i)
+	{
+		Job& job = slot->jobs[(slot->nextJob + i) % JobPoolSize];
+		if(job.free.load(std::memory_order_acquire))
+		{
+			job.free.store(false, std::memory_order_relaxed);
+			slot->nextJob = (slot->nextJob + i + 1) % JobPoolSize;
+			return &job;
+		}
+	}
+	return NULL;
+}
+
+void SubmitJob(Job* job)
+{
+	// AllocateJob a enregistre le thread
+	JobScheduler& scheduler = GetScheduler();
+	if(!t_Thread.slot->deque.Push(job))
+	{
+		scheduler.Execute(job);
+		return;
+	}
+	scheduler.WakeWorkers();
+}
+
+JobCounter* GetCurrentJobCounter()
+{
+	return t_Thread.currentCounter;
+}
+
+void WaitForCounter(JobCounter& counter)
+{
+	JobScheduler& scheduler = GetScheduler();
+	ThreadSlot* self = GetThreadSlot();
+	while(!counter.IsDone())
+	{
+		if(t_Thread.mainThread && scheduler.RunMainThreadJobs() > 0)
+			continue;
+		if(Job* job = scheduler.FindJob(self))
+		{
+			scheduler.Execute(job);
+			continue;
+		}
+		// les jobs restants tournent sur d'autres threads
+		std::this_thread::yield();
+	}
+}
+
+void SetMainThread()
+{
+	t_Thread.mainThread = true;
+}
+
+bool IsMainThread()
+{
+	return t_Thread.mainThread;
+}
+
+void PostMainThreadJob(Job* job)
+{
+	GetScheduler().PostMainThreadJob(job);
+}
+
+int RunMainThreadJobs()
+{
+	if(!t_Thread.mainThread)
+		return 0;
+	return GetScheduler().RunMainThreadJobs();
+}
+
+void SetActiveJobWorkers(unsigned int activeWorkers)
+{
+	GetScheduler().SetActiveWorkers(activeWorkers);
+}
+
+unsigned int GetJobWorkerCount()
+{
+	return GetScheduler().GetWorkerCount();
+}
@@ -0,0 +1,156 @@
+#ifndef ESGI_JOB_SYSTEM_H
+#define ESGI_JOB_SYSTEM_H
+
+// --- Includes --------------------------------------------------------------
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+
+// Nombre de threads de travail impose a la compilation (JOB_WORKER_COUNT=n) plutot qu'un par coeur moins
+// le thread principal : pour verifier l'ordonnanceur avec plusieurs threads sur une machine a un coeur
+// (voir JobSystemCheck.cpp). 0 : selon le nombre de coeurs.
+#ifndef JOB_WORKER_COUNT
+#define JOB_WORKER_COUNT 0
+#endif
+
+// --- Types -----------------------------------------------------------------
+
+// Ordonnanceur de jobs partage par tout le programme (ParallelFor, chargements, culling...) :
+// - GetWorkerCount() - 1 threads de travail demarres au premier usage, le thread qui attend aide
+// - chaque thread qui lance des jobs a sa deque de Chase-Lev : il empile et depile par le bas sans
+//   verrou, les threads sans travail volent par le haut la deque d'un autre
+// - un job et ses enfants (RunChildJob) decrementent le meme JobCounter, WaitForCounter attend
+//   tout l'arbre en executant d'autres jobs plutot que de dormir
+// - les jobs epingles au thread GL (RunOnMainThread) attendent que ce thread appelle RunMainThreadJobs
+// Un thread de travail sans job s'endort apres quelques essais : pas de CPU consomme au repos.
+
+// Nombre de jobs non termines d'un groupe
+class JobCounter
+{
+public:
+	JobCounter() : m_Pending(0) {}
+
+	inline bool IsDone() const { return m_Pending.load(std::memory_order_acquire) == 0; }
+
+private:
+	friend void JobCounterAdd(JobCounter& counter, int count);
+	friend void JobCounterDone(JobCounter& counter);
+
+	JobCounter(const JobCounter&);
+	JobCounter& operator=(const JobCounter&);
+
+	std::atomic<int> m_Pending;
+};
+
+// Un job : fonction copiee dans le job lui-meme (pas d'allocation), compteur du groupe
+struct Job
+{
+	static const size_t PayloadSize = 96;
+
+	void (*invoke)(Job& job);			// appelle puis detruit la fonction de payload
+	JobCounter* counter;
+	std::atomic<bool> free;				// le job peut etre reutilise par le thread proprietaire
+	bool heap;							// alloue par new hors du pool, detruit apres execution
+	std::aligned_storage<PayloadSize, 16>::type payload;
+
+	Job() : invoke(NULL), counter(NULL), free(true), heap(false) {}
+
+	template<typename Func>
+	static void Invoke(Job& job)
+	{
+		Func& func = *reinterpret_cast<Func*>(&job.payload);
+		func();
+		func.~Func();
+	}
+};
+
+// --- Fonctions -------------------------------------------------------------
+
+void JobCounterAdd(JobCounter& counter, int count);
+void JobCounterDone(JobCounter& counter);
+
+// Job du pool du thread appelant (NULL si tous ses jobs sont encore en vol) et publication dans sa deque.
+// SubmitJob execute le job tout de suite si la deque est pleine.
+Job* AllocateJob();
+void SubmitJob(Job* job);
+
+// Compteur du job en cours d'execution sur ce thread (NULL hors d'un job)
+JobCounter* GetCurrentJobCounter();
+
+// Attend que tous les jobs du compteur soient finis, en executant des jobs en attendant
+// (ceux du thread GL aussi si l'appelant est le thread GL)
+void WaitForCounter(JobCounter& counter);
+
+// Lance func() sur un thread de travail, counter compte le job jusqu'a la fin de func
+template<typename Func>
+void RunJob(const Func& func, JobCounter& counter)
+{
+	static_assert(sizeof(Func) <= Job::PayloadSize, "fonction trop grosse pour un job, capturer par reference");
+	JobCounterAdd(counter, 1);
+	Job* job = AllocateJob();
+	if(!job)
+	{
+		// plus de job libre : trop de travail en vol, autant le faire tout de suite
+		func();
+		JobCounterDone(counter);
+		return;
+	}
+	new(&job->payload) Func(func);
+	job->invoke = &Job::Invoke<Func>;
+	job->counter = &counter;
+	SubmitJob(job);
+}
+
+// Depuis un job : lance un enfant compte par le meme compteur que son parent, attendre le parent attend
+// aussi l'enfant. Hors d'un job, func est execute tout de suite.
+template<typename Func>
+void RunChildJob(const Func& func)
+{
+	JobCounter* counter = GetCurrentJobCounter();
+	if(counter)
+		RunJob(func, *counter);
+	else
+		func();
+}
+
+// Le thread appelant devient le thread GL (a appeler depuis main, avant tout RunOnMainThread)
+void SetMainThread();
+bool IsMainThread();
+
+// Jobs epingles au thread GL : executes par RunMainThreadJobs (une fois par frame) ou pendant un
+// WaitForCounter appele par le thread GL
+void PostMainThreadJob(Job* job);
+template<typename Func>
+void RunOnMainThread(const Func& func, JobCounter& counter)
+{
+	static_assert(sizeof(Func) <= Job::PayloadSize, "fonction trop grosse pour un job, capturer par reference");
+	JobCounterAdd(counter, 1);
+	if(IsMainThread())
+	{
+		func();
+		JobCounterDone(counter);
+		return;
+	}
+	Job* job = AllocateJob();
+	if(!job)
+	{
+		// pool vide : le job est alloue sur le tas, libere par le thread GL
+		job = new Job();
+		job->heap = true;
+	}
+	new(&job->payload) Func(func);
+	job->invoke = &Job::Invoke<Func>;
+	job->counter = &counter;
+	PostMainThreadJob(job);
+}
+// Thread GL : execute les jobs qui lui sont epingles, renvoie leur nombre
+int RunMainThreadJobs();
+
+// Benchmarks de passage a l'echelle : seuls les activeWorkers premiers threads de travail cherchent
+// du travail, les autres dorment (GetJobWorkerCount() : tous, la valeur au demarrage)
+void SetActiveJobWorkers(unsigned int activeWorkers);
+unsigned int GetJobWorkerCount();
+
+#endif // ESGI_JOB_SYSTEM_H
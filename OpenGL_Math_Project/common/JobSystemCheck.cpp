@@ -0,0 +1,149 @@
+// Verification autonome de l'ordonnanceur de jobs, a compiler a part (pas dans le projet Visual Studio) avec
+// ThreadSanitizer et des threads de travail imposes, meme sur une machine a un coeur :
+//
+//   g++ -std=c++11 -g -O1 -fsanitize=thread -pthread -DJOB_WORKER_COUNT=3 JobSystemCheck.cpp JobSystem.cpp -o JobSystemCheck
+//
+// Chaque cas est repete avec 0, 1... JOB_WORKER_COUNT threads de travail actifs. Le programme retourne 1 si un
+// resultat est faux ; ThreadSanitizer signale en plus les courses de donnees (TSAN_OPTIONS=halt_on_error=1).
+
+#include "JobSystem.h"
+#include "Parallel.h"
+
+#include <cstdio>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// --- Cas verifies ------------------------------------------------------------
+
+// ParallelFor dans un ParallelFor : les jobs internes sont lances depuis des jobs, sur tous les threads
+static bool CheckNestedParallelFor()
+{
+	const size_t outerCount = 64, innerCount = 500;
+	std::vector<unsigned int> sums(outerCount, 0);
+	std::atomic<unsigned int> total(0);
+	ParallelFor(outerCount, [&](size_t outer) {
+		std::vector<unsigned int> values(innerCount, 0);
+		ParallelFor(innerCount, [&](size_t inner) { values[inner] = (unsigned int) (outer * innerCount + inner); });
+		unsigned int sum = 0;
+		for(size_t inner = 0; inner < innerCount; ++inner)
+			sum += values[inner];
+		sums[outer] = sum;
+		total.fetch_add(1, std::memory_order_relaxed);
+	});
+
+	bool passed = total.load() == outerCount;
+	for(size_t outer = 0; outer < outerCount; ++outer)
+	{
+		const unsigned int first = (unsigned int) (outer * innerCount);
+		passed &= sums[outer] == first * (unsigned int) innerCount + (unsigned int) (innerCount * (innerCount - 1) / 2);
+	}
+	return passed;
+}
+
+// Arbre binaire d'enfants : seul le job racine est attendu, chaque feuille ecrit sa propre case
+static void ChildTreeNode(int depth, size_t index, std::vector<int>& leaves)
+{
+	if(depth == 0)
+	{
+		++leaves[index];
+		return;
+	}
+	RunChildJob([depth, index, &leaves]() { ChildTreeNode(depth - 1, index * 2, leaves); });
+	RunChildJob([depth, index, &leaves]() { ChildTreeNode(depth - 1, index * 2 + 1, leaves); });
+}
+
+static bool CheckChildJobTree()
+{
+	const int depth = 12;
+	std::vector<int> leaves((size_t) 1 << depth, 0);
+	JobCounter root;
+	RunJob([&leaves]() { ChildTreeNode(depth, 0, leaves); }, root);
+	WaitForCounter(root);
+
+	bool passed = root.IsDone();
+	for(size_t i = 0; i < leaves.size(); ++i)
+		passed &= leaves[i] == 1;
+	return passed;
+}
+
+// Jobs epingles au thread principal, postes depuis un autre thread et depuis ses jobs, pendant que le
+// thread principal les execute une "frame" apres l'autre
+static bool CheckMainThreadJobs()
+{
+	const int jobCount = 200;
+	std::vector<int> values(jobCount * 2, 0);
+	std::atomic<int> wrongThread(0);
+	std::atomic<bool> finished(false);
+
+	std::thread poster([&]() {
+		JobCounter counter;
+		for(int i = 0; i < jobCount; ++i)
+		{
+			RunOnMainThread([&values, &wrongThread, i]() {
+				if(!IsMainThread())
+					wrongThread.fetch_add(1);
+				values[i] += i;
+			}, counter);
+			// depuis un job de travail : l'epinglage ne depend pas du thread qui poste
+			JobCounter nested;
+			const int slot = jobCount + i;
+			RunJob([&values, &wrongThread, &counter, slot, i]() {
+				RunOnMainThread([&values, &wrongThread, slot, i]() {
+					if(!IsMainThread())
+						wrongThread.fetch_add(1);
+					values[slot] += i;
+				}, counter);
+			}, nested);
+			WaitForCounter(nested);
+		}
+		WaitForCounter(counter);
+		finished.store(true);
+	});
+
+	while(!finished.load())
+	{
+		RunMainThreadJobs();
+		std::this_thread::yield();
+	}
+	poster.join();
+
+	bool passed = wrongThread.load() == 0;
+	for(int i = 0; i < jobCount; ++i)
+		passed &= values[i] == i && values[jobCount + i] == i;
+	return passed;
+}
+
+// --- Programme ---------------------------------------------------------------
+
+int main()
+{
+	SetMainThread();
+
+	const unsigned int workers = GetJobWorkerCount();
+	printf("JobSystem : %u threads de travail (JOB_WORKER_COUNT=%d)\n", workers, JOB_WORKER_COUNT);
+	if(workers == 0)
+		printf("    aucun thread de travail : compiler avec -DJOB_WORKER_COUNT=3 pour verifier les vols\n");
+
+	bool passed = true;
+	for(unsigned int active = 0; active <= workers; ++active)
+	{
+		SetActiveJobWorkers(active);
+		for(int repeat = 0; repeat < 3; ++repeat)
+		{
+			const bool nested = CheckNestedParallelFor();
+			const bool children = CheckChildJobTree();
+			const bool mainThread = CheckMainThreadJobs();
+			if(!nested || !children || !mainThread)
+			{
+				printf("    %u actifs, essai %d :%s%s%s ECHEC\n", active, repeat, nested ? "" : " ParallelFor imbrique",
+					   children ? "" : " arbre d'enfants", mainThread ? "" : " jobs du thread principal");
+			}
+			passed &= nested && children && mainThread;
+		}
+		printf("    %u threads de travail actifs : %s\n", active, passed ? "OK" : "ECHEC");
+	}
+	SetActiveJobWorkers(workers);
+	printf("%s\n", passed ? "OK" : "ECHEC");
+	return passed ? 0 : 1;
+}
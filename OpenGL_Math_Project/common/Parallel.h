@@ -0,0 +1,66 @@
+#ifndef ESGI_PARALLEL_H
+#define ESGI_PARALLEL_H
+
+// --- Includes --------------------------------------------------------------
+
+#include <thread>
+#include <atomic>
+#include <algorithm>
+
+#include "JobSystem.h"
+
+// --- Fonctions -------------------------------------------------------------
+
+// Nombre de threads de calcul (au moins 1 meme si la plateforme ne sait pas repondre), ou les threads de
+// travail imposes par JOB_WORKER_COUNT plus le thread appelant
+inline unsigned int GetWorkerCount()
+{
+	if(JOB_WORKER_COUNT > 0)
+		return JOB_WORKER_COUNT + 1;
+	const unsigned int count = std::thread::hardware_concurrency();
+	return count ? count : 1;
+}
+
+// Appelle func(index) pour chaque index de [0, count) en repartissant les index
+// sur tous les coeurs (ou au plus maxThreads si non nul, pour les mesures de passage a l'echelle).
+// Les index sont pris par blocs de taille adaptative (decoupage guide) : chaque prise est une fraction
+// du reste, gros blocs au debut pour limiter les acces au compteur partage, petits a la fin pour
+// equilibrer. Les jobs passent par l'ordonnanceur de JobSystem.h, pas de thread cree par appel.
+// Le thread appelant participe au travail et attend la fin.
+template<typename Func>
+void ParallelFor(size_t count, const Func& func, unsigned int maxThreads = 0)
+{
+	const unsigned int workerCount = maxThreads ? std::min(maxThreads, GetWorkerCount()) : GetWorkerCount();
+	const size_t jobCount = std::min<size_t>(workerCount, count);
+	if(jobCount <= 1)
+	{
+		for(size_t index = 0; index < count; ++index)
+			func(index);
+		return;
+	}
+
+	// blocs d'au moins 1 / (GuidedChunksPerJob * jobCount) du reste
+	const size_t GuidedChunksPerJob = 4;
+	std::atomic<size_t> next(0);
+	auto worker = [&]() {
+		size_t begin = next.load(std::memory_order_relaxed);
+		while(begin < count)
+		{
+			const size_t remaining = count - begin;
+			const size_t grain = std::max<size_t>(1, remaining / (GuidedChunksPerJob * jobCount));
+			if(!next.compare_exchange_weak(begin, begin + grain, std::memory_order_relaxed))
+				continue;
+			for(size_t index = begin; index < begin + grain; ++index)
+				func(index);
+			begin = next.load(std::memory_order_relaxed);
+		}
+	};
+
+	JobCounter counter;
+	for(size_t i = 1; i < jobCount; ++i)
+		RunJob(worker, counter);
+	worker();
+	WaitForCounter(counter);
+}
+
+#endif // ESGI_PARALLEL_H
@@ -0,0 +1,53 @@
+#ifndef ESGI_SPSC_QUEUE_H
+#define ESGI_SPSC_QUEUE_H
+
+// --- Includes --------------------------------------------------------------
+
+#include <atomic>
+#include <cstddef>
+
+// --- Classes ---------------------------------------------------------------
+
+// File circulaire sans verrou a un producteur et un consommateur, de capacite fixe (puissance de 2).
+// Les compteurs ne font que croitre, la case est (compteur & (Capacity - 1)) ; chacun est ecrit par un
+// seul thread et place sur sa propre ligne de cache pour eviter le faux partage.
+template<typename T, size_t Capacity>
+class SpscQueue
+{
+	static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity doit etre une puissance de 2");
+
+public:
+	SpscQueue() : m_Head(0), m_Tail(0) {}
+
+	// producteur : false si la file est pleine (rien n'est ecrit)
+	bool Push(const T& value)
+	{
+		const size_t head = m_Head.load(std::memory_order_relaxed);
+		if(head - m_Tail.load(std::memory_order_acquire) == Capacity)
+			return false;
+		m_Items[head & (Capacity - 1)] = value;
+		m_Head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	// consommateur : false si la file est vide
+	bool Pop(T& value)
+	{
+		const size_t tail = m_Tail.load(std::memory_order_relaxed);
+		if(tail == m_Head.load(std::memory_order_acquire))
+			return false;
+		value = m_Items[tail & (Capacity - 1)];
+		m_Tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// approximatif si l'autre thread travaille en meme temps
+	inline bool IsEmpty() const { return m_Head.load(std::memory_order_acquire) == m_Tail.load(std::memory_order_acquire); }
+
+private:
+	alignas(64) std::atomic<size_t> m_Head;		// prochaine case ecrite (producteur)
+	alignas(64) std::atomic<size_t> m_Tail;		// prochaine case lue (consommateur)
+	alignas(64) T m_Items[Capacity];
+};
+
+#endif // ESGI_SPSC_QUEUE_H
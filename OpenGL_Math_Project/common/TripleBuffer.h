@@ -0,0 +1,49 @@
+#ifndef ESGI_TRIPLE_BUFFER_H
+#define ESGI_TRIPLE_BUFFER_H
+
+// --- Includes --------------------------------------------------------------
+
+#include <atomic>
+
+// --- Classes ---------------------------------------------------------------
+
+// Echange sans verrou de la derniere valeur produite entre un producteur et un consommateur.
+// Trois tampons : celui du producteur, celui du consommateur et celui du milieu, echange par un
+// seul index atomique (bit NewBit : le tampon du milieu n'a pas encore ete lu).
+// Aucun des deux n'attend l'autre : le producteur peut remplacer une valeur jamais lue (seule la plus
+// recente compte) et le consommateur relit la sienne tant que rien de nouveau n'est publie.
+// Les tampons sont reutilises : leurs allocations (std::vector...) survivent d'une publication a l'autre.
+template<typename T>
+class TripleBuffer
+{
+public:
+	TripleBuffer() : m_Middle(1), m_Write(0), m_Read(2) {}
+
+	// producteur : tampon a remplir, puis Publish pour le rendre visible
+	inline T& GetWriteBuffer() { return m_Buffers[m_Write]; }
+	inline void Publish()
+	{
+		m_Write = m_Middle.exchange(m_Write | NewBit, std::memory_order_acq_rel) & IndexMask;
+	}
+
+	// consommateur : true si une nouvelle valeur a ete recuperee dans GetReadBuffer
+	inline bool Acquire()
+	{
+		if(!(m_Middle.load(std::memory_order_relaxed) & NewBit))
+			return false;
+		m_Read = m_Middle.exchange(m_Read, std::memory_order_acq_rel) & IndexMask;
+		return true;
+	}
+	inline const T& GetReadBuffer() const { return m_Buffers[m_Read]; }
+
+private:
+	static const int NewBit = 4;
+	static const int IndexMask = 3;
+
+	T m_Buffers[3];
+	std::atomic<int> m_Middle;
+	int m_Write;		// ecrit seulement par le producteur
+	int m_Read;			// ecrit seulement par le consommateur
+};
+
+#endif // ESGI_TRIPLE_BUFFER_H